@@ -56,6 +56,7 @@
 #include "util-var-name.h"
 #include "util-optimize.h"
 #include "util-logopenfile.h"
+#include "util-logwriter.h"
 
 #define DEFAULT_LOG_FILENAME "alert-debug.log"
 
@@ -84,6 +85,10 @@ typedef struct AlertDebugLogThread_ {
     LogFileCtx *file_ctx;
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
     MemBuffer *buffer;
+    /** our buffer if the file is written asynchronously */
+    LogWriterBuffer *log_buf;
+    /** alerts logged by this thread, added to the file_ctx total on exit */
+    uint64_t alerts;
 } AlertDebugLogThread;
 
 static void CreateTimeString (const struct timeval *ts, char *str, size_t size) {
@@ -340,11 +345,9 @@ TmEcode AlertDebugLogger(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq,
         }
     }
 
-    SCMutexLock(&aft->file_ctx->fp_mutex);
-    (void)MemBufferPrintToFPAsString(aft->buffer, aft->file_ctx->fp);
-    fflush(aft->file_ctx->fp);
-    aft->file_ctx->alerts += p->alerts.cnt;
-    SCMutexUnlock(&aft->file_ctx->fp_mutex);
+    if (LogFileWrite(aft->file_ctx, aft->log_buf,
+                (const char *)aft->buffer->buffer, aft->buffer->offset) == 0)
+        aft->alerts += p->alerts.cnt;
 
     return TM_ECODE_OK;
 }
@@ -400,11 +403,9 @@ TmEcode AlertDebugLogDecoderEvent(ThreadVars *tv, Packet *p, void *data, PacketQ
     PrintRawDataToBuffer(aft->buffer->buffer, &aft->buffer->offset, aft->buffer->size,
                          GET_PKT_DATA(p), GET_PKT_LEN(p));
 
-    SCMutexLock(&aft->file_ctx->fp_mutex);
-    (void)MemBufferPrintToFPAsString(aft->buffer, aft->file_ctx->fp);
-    fflush(aft->file_ctx->fp);
-    aft->file_ctx->alerts += p->alerts.cnt;
-    SCMutexUnlock(&aft->file_ctx->fp_mutex);
+    if (LogFileWrite(aft->file_ctx, aft->log_buf,
+                (const char *)aft->buffer->buffer, aft->buffer->offset) == 0)
+        aft->alerts += p->alerts.cnt;
 
     return TM_ECODE_OK;
 }
@@ -445,6 +446,8 @@ TmEcode AlertDebugLogThreadInit(ThreadVars *t, void *initdata, void **data)
         return TM_ECODE_FAILED;
     }
 
+    aft->log_buf = LogWriterRegisterThread(aft->file_ctx, t);
+
     *data = (void *)aft;
     return TM_ECODE_OK;
 }
@@ -470,7 +473,14 @@ void AlertDebugLogExitPrintStats(ThreadVars *tv, void *data) {
         return;
     }
 
-    SCLogInfo("(%s) Alerts %" PRIu64 "", tv->name, aft->file_ctx->alerts);
+    SCLogInfo("(%s) Alerts %" PRIu64 "", tv->name, aft->alerts);
+
+    /* the total is printed once all threads are done, see
+     * AlertDebugLogDeInitCtx() */
+    SCMutexLock(&aft->file_ctx->fp_mutex);
+    aft->file_ctx->alerts += aft->alerts;
+    aft->alerts = 0;
+    SCMutexUnlock(&aft->file_ctx->fp_mutex);
 }
 
 static void AlertDebugLogDeInitCtx(OutputCtx *output_ctx)
@@ -478,7 +488,12 @@ static void AlertDebugLogDeInitCtx(OutputCtx *output_ctx)
     if (output_ctx != NULL) {
         LogFileCtx *logfile_ctx = (LogFileCtx *)output_ctx->data;
         if (logfile_ctx != NULL) {
+            uint64_t alerts = logfile_ctx->alerts;
+
+            /* the packet threads have exited and added their counts,
+             * this also joins the writer thread */
             LogFileFreeCtx(logfile_ctx);
+            SCLogInfo("Alert debug log wrote %" PRIu64 " alerts", alerts);
         }
         SCFree(output_ctx);
     }
@@ -504,6 +519,9 @@ OutputCtx *AlertDebugLogInitCtx(ConfNode *conf)
     if (SCConfLogOpenGeneric(conf, file_ctx, DEFAULT_LOG_FILENAME) < 0) {
         goto error;
     }
+    if (LogWriterSetup(file_ctx, conf) < 0) {
+        goto error;
+    }
 
     OutputCtx *output_ctx = SCMalloc(sizeof(OutputCtx));
     if (unlikely(output_ctx == NULL))
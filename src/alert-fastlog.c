@@ -58,6 +58,7 @@
 #include "util-proto-name.h"
 #include "util-optimize.h"
 #include "util-logopenfile.h"
+#include "util-logwriter.h"
 
 #ifdef __tile__
 #include "source-mpipe.h" /* logging is in here for the time being */
@@ -65,6 +66,9 @@
 
 #define DEFAULT_LOG_FILENAME "fast.log"
 
+/** max size of a single alert record */
+#define MAX_FASTLOG_ALERT_SIZE 2048
+
 #define MODULE_NAME "AlertFastLog"
 
 TmEcode AlertFastLog (ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
@@ -109,6 +113,10 @@ void TmModuleAlertFastLogIPv6Register (void) {
 typedef struct AlertFastLogThread_ {
     /** LogFileCtx has the pointer to the file and a mutex to allow multithreading */
     LogFileCtx* file_ctx;
+    /** our buffer if the file is written asynchronously */
+    LogWriterBuffer *log_buf;
+    /** alerts logged by this thread, added to the file_ctx total on exit */
+    uint64_t alerts;
 } AlertFastLogThread;
 
 static void CreateTimeString (const struct timeval *ts, char *str, size_t size) {
@@ -121,6 +129,22 @@ static void CreateTimeString (const struct timeval *ts, char *str, size_t size)
             t->tm_min, t->tm_sec, (uint32_t) ts->tv_usec);
 }
 
+/** \internal
+ *  \brief write a formatted alert record, truncating it if it didn't fit
+ *         the buffer */
+static void AlertFastLogWrite(AlertFastLogThread *aft, char *buf, int len)
+{
+    if (len < 0)
+        return;
+    if (len >= MAX_FASTLOG_ALERT_SIZE) {
+        len = MAX_FASTLOG_ALERT_SIZE - 1;
+        buf[len - 1] = '\n';
+    }
+
+    if (LogFileWrite(aft->file_ctx, aft->log_buf, buf, len) == 0)
+        aft->alerts++;
+}
+
 TmEcode AlertFastLogIPv4(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQueue *postpq)
 {
     AlertFastLogThread *aft = (AlertFastLogThread *)data;
@@ -157,28 +181,34 @@ TmEcode AlertFastLogIPv4(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq,
             snprintf(proto, sizeof(proto), "PROTO:%03" PRIu32, IPV4_GET_IPPROTO(p));
         }
 
-        SCMutexLock(&aft->file_ctx->fp_mutex);
+        /* identical alerts coalesced into this one by alert aggregation */
+        char count[32] = "";
+        if (pa->count > 1) {
+            snprintf(count, sizeof(count), " [Count: %" PRIu32 "]", pa->count);
+        }
+
 #ifdef __tile__
         if (aft->file_ctx->filetype == tile_pcie) {
+            SCMutexLock(&aft->file_ctx->fp_mutex);
             TileTrioPrintf(aft->file_ctx->pcie_ctx,
                 "%s  %s[**] [%" PRIu32 ":%" PRIu32 ":%"
                 PRIu32 "] %s [**] [Classification: %s] [Priority: %"PRIu32"]"
-                " {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf, action,
+                "%s {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf, action,
                 pa->s->gid, pa->s->id, pa->s->rev, pa->s->msg, pa->s->class_msg, pa->s->prio,
-                proto, srcip, p->sp, dstip, p->dp);
-        } else {
+                count, proto, srcip, p->sp, dstip, p->dp);
+            SCMutexUnlock(&aft->file_ctx->fp_mutex);
+            aft->alerts++;
+            continue;
+        }
 #endif
-        fprintf(aft->file_ctx->fp, "%s  %s[**] [%" PRIu32 ":%" PRIu32 ":%"
+        char alert_buffer[MAX_FASTLOG_ALERT_SIZE];
+        int len = snprintf(alert_buffer, sizeof(alert_buffer),
+                "%s  %s[**] [%" PRIu32 ":%" PRIu32 ":%"
                 PRIu32 "] %s [**] [Classification: %s] [Priority: %"PRIu32"]"
-                " {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf, action,
+                "%s {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf, action,
                 pa->s->gid, pa->s->id, pa->s->rev, pa->s->msg, pa->s->class_msg, pa->s->prio,
-                proto, srcip, p->sp, dstip, p->dp);
-        fflush(aft->file_ctx->fp);
-#ifdef __tile__
-        }
-#endif
-        aft->file_ctx->alerts++;
-        SCMutexUnlock(&aft->file_ctx->fp_mutex);
+                count, proto, srcip, p->sp, dstip, p->dp);
+        AlertFastLogWrite(aft, alert_buffer, len);
     }
 
     return TM_ECODE_OK;
@@ -220,17 +250,21 @@ TmEcode AlertFastLogIPv6(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq,
             snprintf(proto, sizeof(proto), "PROTO:%03" PRIu32, IP_GET_IPPROTO(p));
         }
 
-        SCMutexLock(&aft->file_ctx->fp_mutex);
-        fprintf(aft->file_ctx->fp, "%s  %s[**] [%" PRIu32 ":%" PRIu32 ":%"
+        /* identical alerts coalesced into this one by alert aggregation */
+        char count[32] = "";
+        if (pa->count > 1) {
+            snprintf(count, sizeof(count), " [Count: %" PRIu32 "]", pa->count);
+        }
+
+        char alert_buffer[MAX_FASTLOG_ALERT_SIZE];
+        int len = snprintf(alert_buffer, sizeof(alert_buffer),
+                "%s  %s[**] [%" PRIu32 ":%" PRIu32 ":%"
                 PRIu32 "] %s [**] [Classification: %s] [Priority: %"
-                PRIu32 "] {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf,
+                PRIu32 "]%s {%s} %s:%" PRIu32 " -> %s:%" PRIu32 "\n", timebuf,
                 action, pa->s->gid, pa->s->id, pa->s->rev, pa->s->msg, pa->s->class_msg,
-                pa->s->prio, proto, srcip, p->sp,
+                pa->s->prio, count, proto, srcip, p->sp,
                 dstip, p->dp);
-
-        fflush(aft->file_ctx->fp);
-        aft->file_ctx->alerts++;
-        SCMutexUnlock(&aft->file_ctx->fp_mutex);
+        AlertFastLogWrite(aft, alert_buffer, len);
     }
 
     return TM_ECODE_OK;
@@ -261,23 +295,24 @@ TmEcode AlertFastLogDecoderEvent(ThreadVars *tv, Packet *p, void *data, PacketQu
             action = "[wDrop] ";
         }
 
-        SCMutexLock(&aft->file_ctx->fp_mutex);
-        fprintf(aft->file_ctx->fp, "%s  %s[**] [%" PRIu32 ":%" PRIu32
-                ":%" PRIu32 "] %s [**] [Classification: %s] [Priority: "
-                "%" PRIu32 "] [**] [Raw pkt: ", timebuf, action, pa->s->gid,
-                pa->s->id, pa->s->rev, pa->s->msg, pa->s->class_msg, pa->s->prio);
-
-        PrintRawLineHexFp(aft->file_ctx->fp, GET_PKT_DATA(p), GET_PKT_LEN(p) < 32 ? GET_PKT_LEN(p) : 32);
+        char rawhex[32 * 3 + 1] = "";
+        PrintRawLineHexBuf(rawhex, sizeof(rawhex), GET_PKT_DATA(p),
+                GET_PKT_LEN(p) < 32 ? GET_PKT_LEN(p) : 32);
 
+        char pcap_cnt[64] = "";
         if (p->pcap_cnt != 0) {
-            fprintf(aft->file_ctx->fp, "] [pcap file packet: %"PRIu64"]\n", p->pcap_cnt);
-        } else {
-            fprintf(aft->file_ctx->fp, "]\n");
+            snprintf(pcap_cnt, sizeof(pcap_cnt), " [pcap file packet: %"PRIu64"]",
+                    p->pcap_cnt);
         }
 
-        fflush(aft->file_ctx->fp);
-        aft->file_ctx->alerts++;
-        SCMutexUnlock(&aft->file_ctx->fp_mutex);
+        char alert_buffer[MAX_FASTLOG_ALERT_SIZE];
+        int len = snprintf(alert_buffer, sizeof(alert_buffer),
+                "%s  %s[**] [%" PRIu32 ":%" PRIu32
+                ":%" PRIu32 "] %s [**] [Classification: %s] [Priority: "
+                "%" PRIu32 "] [**] [Raw pkt: %s]%s\n", timebuf, action, pa->s->gid,
+                pa->s->id, pa->s->rev, pa->s->msg, pa->s->class_msg, pa->s->prio,
+                rawhex, pcap_cnt);
+        AlertFastLogWrite(aft, alert_buffer, len);
     }
 
     return TM_ECODE_OK;
@@ -310,6 +345,7 @@ TmEcode AlertFastLogThreadInit(ThreadVars *t, void *initdata, void **data)
     }
     /** Use the Ouptut Context (file pointer and mutex) */
     aft->file_ctx = ((OutputCtx *)initdata)->data;
+    aft->log_buf = LogWriterRegisterThread(aft->file_ctx, t);
 
     *data = (void *)aft;
     return TM_ECODE_OK;
@@ -335,7 +371,15 @@ void AlertFastLogExitPrintStats(ThreadVars *tv, void *data) {
         return;
     }
 
-    SCLogInfo("Fast log output wrote %" PRIu64 " alerts", aft->file_ctx->alerts);
+    SCLogInfo("(%s) Fast log output wrote %" PRIu64 " alerts", tv->name,
+              aft->alerts);
+
+    /* the total is printed once all threads are done, see
+     * AlertFastLogDeInitCtx() */
+    SCMutexLock(&aft->file_ctx->fp_mutex);
+    aft->file_ctx->alerts += aft->alerts;
+    aft->alerts = 0;
+    SCMutexUnlock(&aft->file_ctx->fp_mutex);
 }
 
 /**
@@ -355,6 +399,10 @@ OutputCtx *AlertFastLogInitCtx(ConfNode *conf)
         LogFileFreeCtx(logfile_ctx);
         return NULL;
     }
+    if (LogWriterSetup(logfile_ctx, conf) < 0) {
+        LogFileFreeCtx(logfile_ctx);
+        return NULL;
+    }
 
     OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
     if (unlikely(output_ctx == NULL))
@@ -368,7 +416,12 @@ OutputCtx *AlertFastLogInitCtx(ConfNode *conf)
 static void AlertFastLogDeInitCtx(OutputCtx *output_ctx)
 {
     LogFileCtx *logfile_ctx = (LogFileCtx *)output_ctx->data;
+    uint64_t alerts = logfile_ctx->alerts;
+
+    /* the packet threads have exited and added their counts, this also
+     * joins the writer thread */
     LogFileFreeCtx(logfile_ctx);
+    SCLogInfo("Fast log output wrote %" PRIu64 " alerts", alerts);
     SCFree(output_ctx);
 }
 
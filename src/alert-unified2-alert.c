@@ -168,6 +168,7 @@ typedef struct Unified2AlertThread_ {
 #define UNIFIED2_PACKET_SIZE        (sizeof(Unified2Packet) - 4)
 
 SC_ATOMIC_DECLARE(unsigned int, unified2_event_id);  /**< Atomic counter, to link relative event */
+SC_ATOMIC_DECLARE(unsigned int, unified2_thread_cnt); /**< Numbers the per thread files */
 
 /** prototypes */
 TmEcode Unified2Alert (ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
@@ -904,6 +905,47 @@ int Unified2IPv4TypeAlert (ThreadVars *tv, Packet *p, void *data, PacketQueue *p
  *  \retval TM_ECODE_FAILED on failure
  */
 
+/**
+ *  \brief Set up the file of a thread in multi mode.
+ *
+ *  The files of a thread are named <prefix>.<thread number>.<timestamp>.
+ *  The size limit applies per thread. Event ids come from the global
+ *  counter, so records of all threads can be merged without collisions.
+ *
+ *  \param shared the output's LogFileCtx holding the settings
+ *
+ *  \retval file_ctx owned by the thread, NULL on error
+ */
+static LogFileCtx *Unified2AlertNewThreadFileCtx(ThreadVars *t, LogFileCtx *shared)
+{
+    char prefix[PATH_MAX];
+
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    if (file_ctx == NULL) {
+        SCLogError(SC_ERR_UNIFIED2_ALERT_GENERIC, "Couldn't create new file_ctx");
+        return NULL;
+    }
+
+    snprintf(prefix, sizeof(prefix), "%s.%u", shared->prefix,
+             SC_ATOMIC_ADD(unified2_thread_cnt, 1));
+    file_ctx->prefix = SCStrdup(prefix);
+    if (file_ctx->prefix == NULL) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
+    file_ctx->size_limit = shared->size_limit;
+    file_ctx->flags = LOGFILE_PER_THREAD;
+
+    if (Unified2AlertOpenFileCtx(file_ctx, file_ctx->prefix) < 0) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
+
+    SCLogInfo("%s: unified2 alerts go to %s", t->name ? t->name : "",
+              file_ctx->filename);
+    return file_ctx;
+}
+
 TmEcode Unified2AlertThreadInit(ThreadVars *t, void *initdata, void **data)
 {
     Unified2AlertThread *aun = SCMalloc(sizeof(Unified2AlertThread));
@@ -919,8 +961,18 @@ TmEcode Unified2AlertThreadInit(ThreadVars *t, void *initdata, void **data)
     /** Use the Ouptut Context (file pointer and mutex) */
     aun->file_ctx = ((OutputCtx *)initdata)->data;
 
+    if (aun->file_ctx->flags & LOGFILE_PER_THREAD) {
+        aun->file_ctx = Unified2AlertNewThreadFileCtx(t, aun->file_ctx);
+        if (aun->file_ctx == NULL) {
+            SCFree(aun);
+            return TM_ECODE_FAILED;
+        }
+    }
+
     aun->data = SCMalloc(sizeof(Unified2AlertFileHeader) + sizeof(Unified2Packet) + IPV4_MAXPACKET_LEN);
     if (aun->data == NULL) {
+        if (aun->file_ctx->flags & LOGFILE_PER_THREAD)
+            LogFileFreeCtx(aun->file_ctx);
         SCFree(aun);
         return TM_ECODE_FAILED;
     }
@@ -947,7 +999,12 @@ TmEcode Unified2AlertThreadDeinit(ThreadVars *t, void *data)
         goto error;
     }
 
-    if (!(aun->file_ctx->flags & LOGFILE_ALERTS_PRINTED)) {
+    if (aun->file_ctx->flags & LOGFILE_PER_THREAD) {
+        SCLogInfo("Alert unified2 module wrote %"PRIu64" alerts to %s.*",
+                aun->file_ctx->alerts, aun->file_ctx->prefix);
+        LogFileFreeCtx(aun->file_ctx);
+        aun->file_ctx = NULL;
+    } else if (!(aun->file_ctx->flags & LOGFILE_ALERTS_PRINTED)) {
         SCLogInfo("Alert unified2 module wrote %"PRIu64" alerts",
                 aun->file_ctx->alerts);
 
@@ -1018,6 +1075,20 @@ OutputCtx *Unified2AlertInitCtx(ConfNode *conf)
         }
     }
 
+    if (conf != NULL) {
+        const char *mode = ConfNodeLookupChildValue(conf, "mode");
+        if (mode != NULL) {
+            if (strcasecmp(mode, "multi") == 0) {
+                file_ctx->flags |= LOGFILE_PER_THREAD;
+            } else if (strcasecmp(mode, "normal") != 0) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "Failed to initialize unified2 output, invalid mode: %s, "
+                    "expected \"normal\" or \"multi\"", mode);
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
     if (conf != NULL) {
         const char *sensor_id_s = NULL;
         sensor_id_s = ConfNodeLookupChildValue(conf, "sensor-id");
@@ -1029,9 +1100,12 @@ OutputCtx *Unified2AlertInitCtx(ConfNode *conf)
         }
     }
 
-    ret = Unified2AlertOpenFileCtx(file_ctx, filename);
-    if (ret < 0)
-        goto error;
+    /* in multi mode the threads open their own files */
+    if (!(file_ctx->flags & LOGFILE_PER_THREAD)) {
+        ret = Unified2AlertOpenFileCtx(file_ctx, filename);
+        if (ret < 0)
+            goto error;
+    }
 
     OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
     if (unlikely(output_ctx == NULL))
@@ -1039,10 +1113,12 @@ OutputCtx *Unified2AlertInitCtx(ConfNode *conf)
     output_ctx->data = file_ctx;
     output_ctx->DeInit = Unified2AlertDeInitCtx;
 
-    SCLogInfo("Unified2-alert initialized: filename %s, limit %"PRIu64" MB",
-              filename, file_ctx->size_limit / (1024*1024));
+    SCLogInfo("Unified2-alert initialized: filename %s, limit %"PRIu64" MB%s",
+              filename, file_ctx->size_limit / (1024*1024),
+              (file_ctx->flags & LOGFILE_PER_THREAD) ? " per thread" : "");
 
     SC_ATOMIC_INIT(unified2_event_id);
+    SC_ATOMIC_INIT(unified2_thread_cnt);
 
     return output_ctx;
 
@@ -1624,6 +1700,60 @@ error:
         SCFree(filename);
     return r;
 }
+
+/**
+ *  \test Test that threads get their own files in multi mode
+ *
+ *  \retval 1 on succces
+ *  \retval 0 on failure
+ */
+static int Unified2TestMulti01(void)
+{
+    int r = 0;
+    ThreadVars tv;
+    OutputCtx *oc;
+    LogFileCtx *lf;
+    void *data1 = NULL, *data2 = NULL;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+
+    oc = Unified2AlertInitCtx(NULL);
+    if (oc == NULL)
+        return 0;
+    lf = (LogFileCtx *)oc->data;
+    /* what "mode: multi" sets */
+    lf->flags |= LOGFILE_PER_THREAD;
+
+    if (Unified2AlertThreadInit(&tv, oc, &data1) != TM_ECODE_OK)
+        goto end;
+    if (Unified2AlertThreadInit(&tv, oc, &data2) != TM_ECODE_OK)
+        goto end;
+
+    LogFileCtx *lf1 = ((Unified2AlertThread *)data1)->file_ctx;
+    LogFileCtx *lf2 = ((Unified2AlertThread *)data2)->file_ctx;
+    if (lf1 == lf || lf2 == lf || lf1 == lf2) {
+        printf("threads share a file_ctx: ");
+        goto end;
+    }
+    if (lf1->fp == NULL || lf2->fp == NULL)
+        goto end;
+    if (strcmp(lf1->prefix, "unified2.alert.1") != 0 ||
+        strcmp(lf2->prefix, "unified2.alert.2") != 0) {
+        printf("unexpected prefixes %s %s: ", lf1->prefix, lf2->prefix);
+        goto end;
+    }
+    if (lf1->size_limit != lf->size_limit)
+        goto end;
+
+    r = 1;
+end:
+    if (data1 != NULL)
+        Unified2AlertThreadDeinit(&tv, data1);
+    if (data2 != NULL)
+        Unified2AlertThreadDeinit(&tv, data2);
+    Unified2AlertDeInitCtx(oc);
+    return r;
+}
 #endif
 
 /**
@@ -1637,5 +1767,6 @@ void Unified2RegisterTests (void) {
     UtRegisterTest("Unified2Test04 -- PPP test", Unified2Test04, 1);
     UtRegisterTest("Unified2Test05 -- Inline test", Unified2Test05, 1);
     UtRegisterTest("Unified2TestRotate01 -- Rotate File", Unified2TestRotate01, 1);
+    UtRegisterTest("Unified2TestMulti01 -- Per thread files", Unified2TestMulti01, 1);
 #endif /* UNITTESTS */
 }
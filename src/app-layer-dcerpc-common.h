@@ -170,6 +170,8 @@ typedef struct DCERPCRequest_ {
     uint8_t *stub_data_buffer;
     /* length of the above buffer */
     uint32_t stub_data_buffer_len;
+    /* allocated size of the above buffer */
+    uint32_t stub_data_buffer_size;
     /* used by the dce preproc to indicate fresh entry in the stub data buffer */
     uint8_t stub_data_fresh;
     uint8_t first_request_seen;
@@ -180,6 +182,8 @@ typedef struct DCERPCResponse_ {
     uint8_t *stub_data_buffer;
     /* length of the above buffer */
     uint32_t stub_data_buffer_len;
+    /* allocated size of the above buffer */
+    uint32_t stub_data_buffer_size;
     /* used by the dce preproc to indicate fresh entry in the stub data buffer */
     uint8_t stub_data_fresh;
 } DCERPCResponse;
@@ -238,7 +242,14 @@ typedef struct DCERPCUDP_ {
 #define USER_DATA_NOT_READABLE          6 /* not used */
 #define NO_PSAP_AVAILABLE               7 /* not used */
 
+/** initial size of a stub data buffer */
+#define DCERPC_STUB_MIN_SIZE            1024
+/** default and maximum for the stub data kept per direction. The dce
+ *  payload inspection uses 16 bit lengths. */
+#define DCERPC_STUB_DEFAULT_MAX_SIZE    65535
+
 int32_t DCERPCParser(DCERPC *, uint8_t *, uint32_t);
+int DCERPCStubAppend(uint8_t **, uint32_t *, uint32_t *, uint8_t *, uint16_t);
 void hexdump(const void *buf, size_t len);
 void printUUID(char *type, DCERPCUuidEntry *uuid);
 
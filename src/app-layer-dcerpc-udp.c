@@ -51,6 +51,7 @@ static uint32_t FragmentDataParser(Flow *f, void *dcerpcudp_state,
 	DCERPCUDPState *sstate = (DCERPCUDPState *) dcerpcudp_state;
     uint8_t **stub_data_buffer = NULL;
     uint32_t *stub_data_buffer_len = NULL;
+    uint32_t *stub_data_buffer_size = NULL;
     uint8_t *stub_data_fresh = NULL;
     uint16_t stub_len = 0;
 
@@ -58,12 +59,14 @@ static uint32_t FragmentDataParser(Flow *f, void *dcerpcudp_state,
     if (sstate->dcerpc.dcerpchdrudp.type == REQUEST) {
         stub_data_buffer = &sstate->dcerpc.dcerpcrequest.stub_data_buffer;
         stub_data_buffer_len = &sstate->dcerpc.dcerpcrequest.stub_data_buffer_len;
+        stub_data_buffer_size = &sstate->dcerpc.dcerpcrequest.stub_data_buffer_size;
         stub_data_fresh = &sstate->dcerpc.dcerpcrequest.stub_data_fresh;
 
     /* response PDU.  Retrieve the response stub buffer */
     } else {
         stub_data_buffer = &sstate->dcerpc.dcerpcresponse.stub_data_buffer;
         stub_data_buffer_len = &sstate->dcerpc.dcerpcresponse.stub_data_buffer_len;
+        stub_data_buffer_size = &sstate->dcerpc.dcerpcresponse.stub_data_buffer_size;
         stub_data_fresh = &sstate->dcerpc.dcerpcresponse.stub_data_fresh;
     }
 
@@ -80,16 +83,13 @@ static uint32_t FragmentDataParser(Flow *f, void *dcerpcudp_state,
         *stub_data_buffer_len = 0;
     }
 
-    *stub_data_buffer = SCRealloc(*stub_data_buffer, *stub_data_buffer_len + stub_len);
-    if (*stub_data_buffer == NULL) {
+    if (DCERPCStubAppend(stub_data_buffer, stub_data_buffer_len,
+                         stub_data_buffer_size, input, stub_len) < 0) {
         SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
         goto end;
     }
-    memcpy(*stub_data_buffer + *stub_data_buffer_len, input, stub_len);
 
     *stub_data_fresh = 1;
-    /* length of the buffered stub */
-    *stub_data_buffer_len += stub_len;
 
    sstate->dcerpc.fraglenleft -= stub_len;
    sstate->dcerpc.bytesprocessed += stub_len;
@@ -63,6 +63,9 @@
 
 #include "util-spm.h"
 #include "util-unittest.h"
+#include "util-misc.h"
+
+#include "conf.h"
 
 #include "app-layer-dcerpc.h"
 
@@ -1081,10 +1084,71 @@ static uint32_t DCERPCParseREQUEST(DCERPC *dcerpc, uint8_t *input, uint32_t inpu
     SCReturnUInt((uint32_t)(p - input));
 }
 
+/** max bytes of stub data kept per direction, see DCERPCStubAppend() */
+static uint32_t dcerpc_stub_max_size = DCERPC_STUB_DEFAULT_MAX_SIZE;
+
+/**
+ * \brief Append a stub fragment to a request or response stub buffer.
+ *
+ * The buffer is kept for the lifetime of the state and reused for every
+ * stub, so it is only (re)allocated when a stub is larger than any stub
+ * before it. The stub is capped at dcerpc_stub_max_size bytes: once a
+ * stub grows past that, the oldest bytes are dropped so the buffer holds
+ * a window with the most recent fragments.
+ *
+ * \param buffer pointer to the stub buffer
+ * \param buffer_len pointer to the length of the buffered stub
+ * \param buffer_size pointer to the allocated size of the buffer
+ * \param data fragment to append
+ * \param data_len length of the fragment
+ *
+ * \retval 0 ok
+ * \retval -1 out of memory, the buffer is left untouched
+ */
+int DCERPCStubAppend(uint8_t **buffer, uint32_t *buffer_len,
+                     uint32_t *buffer_size, uint8_t *data, uint16_t data_len)
+{
+    uint32_t max = dcerpc_stub_max_size;
+    uint32_t drop = 0;
+
+    /* see what we need to drop to stay within the window */
+    if (data_len >= max) {
+        data += data_len - max;
+        data_len = max;
+        drop = *buffer_len;
+    } else if (*buffer_len + data_len > max) {
+        drop = *buffer_len + data_len - max;
+    }
+    uint32_t len = *buffer_len - drop;
+
+    if (len + data_len > *buffer_size) {
+        uint32_t size = *buffer_size ? *buffer_size : DCERPC_STUB_MIN_SIZE;
+        while (size < len + data_len)
+            size *= 2;
+        if (size > max)
+            size = max;
+
+        uint8_t *ptr = SCRealloc(*buffer, size);
+        if (unlikely(ptr == NULL))
+            return -1;
+
+        *buffer = ptr;
+        *buffer_size = size;
+    }
+
+    if (drop > 0 && len > 0)
+        memmove(*buffer, *buffer + drop, len);
+
+    memcpy(*buffer + len, data, data_len);
+    *buffer_len = len + data_len;
+    return 0;
+}
+
 static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_len) {
     SCEnter();
     uint8_t **stub_data_buffer = NULL;
     uint32_t *stub_data_buffer_len = NULL;
+    uint32_t *stub_data_buffer_size = NULL;
     uint8_t *stub_data_fresh = NULL;
     uint16_t stub_len = 0;
 
@@ -1092,12 +1156,14 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
     if (dcerpc->dcerpchdr.type == REQUEST) {
         stub_data_buffer = &dcerpc->dcerpcrequest.stub_data_buffer;
         stub_data_buffer_len = &dcerpc->dcerpcrequest.stub_data_buffer_len;
+        stub_data_buffer_size = &dcerpc->dcerpcrequest.stub_data_buffer_size;
         stub_data_fresh = &dcerpc->dcerpcrequest.stub_data_fresh;
 
     /* response PDU.  Retrieve the response stub buffer */
     } else {
         stub_data_buffer = &dcerpc->dcerpcresponse.stub_data_buffer;
         stub_data_buffer_len = &dcerpc->dcerpcresponse.stub_data_buffer_len;
+        stub_data_buffer_size = &dcerpc->dcerpcresponse.stub_data_buffer_size;
         stub_data_fresh = &dcerpc->dcerpcresponse.stub_data_fresh;
     }
 
@@ -1133,16 +1199,13 @@ static uint32_t StubDataParser(DCERPC *dcerpc, uint8_t *input, uint32_t input_le
         dcerpc->pdu_fragged = 1;
     }
 
-    *stub_data_buffer = SCRealloc(*stub_data_buffer, *stub_data_buffer_len + stub_len);
-    if (*stub_data_buffer == NULL) {
+    if (DCERPCStubAppend(stub_data_buffer, stub_data_buffer_len,
+                         stub_data_buffer_size, input, stub_len) < 0) {
         SCLogError(SC_ERR_MEM_ALLOC, "Error allocating memory");
         goto end;
     }
-    memcpy(*stub_data_buffer + *stub_data_buffer_len, input, stub_len);
 
     *stub_data_fresh = 1;
-    /* length of the buffered stub */
-    *stub_data_buffer_len += stub_len;
     /* To see the total reassembled stubdata */
     //hexdump(*stub_data_buffer, *stub_data_buffer_len);
 
@@ -1880,9 +1943,41 @@ void DCERPCUpdateTransactionId(void *state, uint16_t *id) {
     SCReturn;
 }
 
+/**
+ *  \brief Load the stub data cap from the config.
+ *
+ *  app-layer:
+ *    dcerpc:
+ *      max-stub-size: 64kb
+ */
+static void DCERPCLoadConfig(void) {
+    char *str = NULL;
+
+    if (ConfGet("app-layer.dcerpc.max-stub-size", &str) == 1 && str != NULL) {
+        uint32_t size = 0;
+        if (ParseSizeStringU32(str, &size) < 0 || size == 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                       "app-layer.dcerpc.max-stub-size from conf file - %s. "
+                       "Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+        if (size > DCERPC_STUB_DEFAULT_MAX_SIZE) {
+            SCLogWarning(SC_ERR_INVALID_VALUE, "app-layer.dcerpc.max-stub-size "
+                         "%"PRIu32" is larger than the maximum of %u, using "
+                         "the maximum", size, DCERPC_STUB_DEFAULT_MAX_SIZE);
+            size = DCERPC_STUB_DEFAULT_MAX_SIZE;
+        }
+        dcerpc_stub_max_size = size;
+    }
+
+    SCLogDebug("dcerpc stub data max size %"PRIu32, dcerpc_stub_max_size);
+}
+
 void RegisterDCERPCParsers(void) {
     char *proto_name = "dcerpc";
 
+    DCERPCLoadConfig();
+
     /** DCERPC */
     AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_DCERPC, "|05 00|", 2, 0, STREAM_TOSERVER);
 
@@ -6018,6 +6113,59 @@ end:
     return result;
 }
 
+/**
+ * \test the stub buffer is reused and keeps a window of the most recent
+ *       fragments once the cap is reached.
+ */
+int DCERPCParserTest20(void) {
+    int result = 0;
+    uint8_t *buffer = NULL;
+    uint32_t buffer_len = 0;
+    uint32_t buffer_size = 0;
+    uint8_t frag1[] = "0123456789";
+    uint8_t frag2[] = "abcdefghij";
+    uint8_t frag3[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    uint32_t max_size = dcerpc_stub_max_size;
+
+    dcerpc_stub_max_size = 16;
+
+    if (DCERPCStubAppend(&buffer, &buffer_len, &buffer_size, frag1, 10) < 0 ||
+        buffer_len != 10 || buffer_size != 16 || memcmp(buffer, frag1, 10) != 0) {
+        printf("first fragment not stored: ");
+        goto end;
+    }
+    uint8_t *ptr = buffer;
+
+    /* 20 bytes, only the last 16 are kept */
+    if (DCERPCStubAppend(&buffer, &buffer_len, &buffer_size, frag2, 10) < 0 ||
+        buffer_len != 16 || memcmp(buffer, "456789abcdefghij", 16) != 0) {
+        printf("window not slid: ");
+        goto end;
+    }
+
+    /* fragment larger than the cap */
+    if (DCERPCStubAppend(&buffer, &buffer_len, &buffer_size, frag3, 26) < 0 ||
+        buffer_len != 16 || memcmp(buffer, "KLMNOPQRSTUVWXYZ", 16) != 0) {
+        printf("large fragment not windowed: ");
+        goto end;
+    }
+
+    /* a new stub reuses the buffer */
+    buffer_len = 0;
+    if (DCERPCStubAppend(&buffer, &buffer_len, &buffer_size, frag1, 10) < 0 ||
+        buffer != ptr || buffer_size != 16 || buffer_len != 10) {
+        printf("buffer not reused: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    dcerpc_stub_max_size = max_size;
+    if (buffer != NULL)
+        SCFree(buffer);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void DCERPCParserRegisterTests(void) {
@@ -6041,6 +6189,7 @@ void DCERPCParserRegisterTests(void) {
     UtRegisterTest("DCERPCParserTest17", DCERPCParserTest17, 1);
     UtRegisterTest("DCERPCParserTest18", DCERPCParserTest18, 1);
     UtRegisterTest("DCERPCParserTest19", DCERPCParserTest19, 1);
+    UtRegisterTest("DCERPCParserTest20", DCERPCParserTest20, 1);
 #endif /* UNITTESTS */
 
     return;
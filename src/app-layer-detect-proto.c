@@ -43,12 +43,15 @@
 
 #include "util-print.h"
 #include "util-pool.h"
+#include "util-misc.h"
 #include "util-unittest.h"
 #include "util-unittest-helper.h"
 
 #include "flow.h"
 #include "flow-util.h"
 
+#include "conf.h"
+
 #include "stream-tcp-private.h"
 #include "stream-tcp-reassemble.h"
 #include "stream-tcp.h"
@@ -57,6 +60,7 @@
 #include "app-layer-protos.h"
 #include "app-layer-parser.h"
 #include "app-layer-detect-proto.h"
+#include "app-layer.h"
 
 #include "util-spm.h"
 #include "util-cuda.h"
@@ -66,6 +70,10 @@
 
 #define INSPECT_BYTES  32
 
+/** default proto detection budget of a tcp flow */
+#define ALP_DETECT_DEFAULT_MAX_BYTES    65536
+#define ALP_DETECT_DEFAULT_MAX_CHUNKS   64
+
 /* undef __SC_CUDA_SUPPORT__.  We will get back to this later.  Need to
  * analyze the performance of cuda support for app layer */
 #undef __SC_CUDA_SUPPORT__
@@ -94,6 +102,9 @@ void AlpProtoInit(AlpProtoDetectCtx *ctx) {
     ctx->toclient.min_len = INSPECT_BYTES;
     ctx->toserver.min_len = INSPECT_BYTES;
 
+    ctx->max_bytes = ALP_DETECT_DEFAULT_MAX_BYTES;
+    ctx->max_chunks = ALP_DETECT_DEFAULT_MAX_CHUNKS;
+
     ctx->mpm_pattern_id_store = MpmPatternIdTableInitHash();
 }
 
@@ -106,7 +117,7 @@ void AlpProtoInit(AlpProtoDetectCtx *ctx) {
  *  \param proto the proto id
  *  \initonly
  */
-static void AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co, uint16_t ip_proto, uint16_t proto) {
+static AlpProtoSignature *AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co, uint16_t ip_proto, uint16_t proto) {
     AlpProtoSignature *s = SCMalloc(sizeof(AlpProtoSignature));
     if (unlikely(s == NULL)) {
         SCLogError(SC_ERR_FATAL, "Error allocating memory. Signature not loaded. Not enough memory so.. exiting..");
@@ -126,6 +137,85 @@ static void AlpProtoAddSignature(AlpProtoDetectCtx *ctx, DetectContentData *co,
     }
 
     ctx->sigs++;
+    return s;
+}
+
+/**
+ *  \brief Add a signature to the prefilter of a direction. If the pattern
+ *         isn't at a fixed offset, the prefilter is disabled for the
+ *         direction and the mpm is used.
+ *
+ *  \initonly
+ */
+static void AlpProtoAddPrefilter(AlpProtoDetectDirection *dir, AlpProtoSignature *s) {
+    DetectContentData *co = s->co;
+
+    if (dir->prefilter_off)
+        return;
+
+    if (co->depth <= co->offset ||
+        co->depth - co->offset > co->content_len) {
+        SCLogDebug("pattern not at a fixed offset, no prefilter");
+        dir->prefilter_off = 1;
+        return;
+    }
+
+    /* too short a window, the pattern can never match */
+    if (co->depth - co->offset < co->content_len)
+        return;
+
+    /* offsets are kept ordered, so we inspect the buffer left to right */
+    int i;
+    for (i = 0; i < dir->prefilter_cnt; i++) {
+        if (dir->prefilter[i].offset >= co->offset)
+            break;
+    }
+    if (i == dir->prefilter_cnt || dir->prefilter[i].offset != co->offset) {
+        if (dir->prefilter_cnt == ALP_PREFILTER_MAX_OFFSETS) {
+            SCLogDebug("too many pattern offsets, no prefilter");
+            dir->prefilter_off = 1;
+            return;
+        }
+        memmove(&dir->prefilter[i + 1], &dir->prefilter[i],
+                (dir->prefilter_cnt - i) * sizeof(AlpProtoPrefilter));
+        memset(&dir->prefilter[i], 0x00, sizeof(AlpProtoPrefilter));
+        dir->prefilter[i].offset = co->offset;
+        dir->prefilter_cnt++;
+    }
+
+    /* append, so signatures are tried in the order they were added */
+    AlpProtoSignature **bucket = &dir->prefilter[i].sigs[co->content[0]];
+    while (*bucket != NULL)
+        bucket = &(*bucket)->pf_next;
+    *bucket = s;
+}
+
+/**
+ *  \brief Match a buffer against the prefilter of a direction
+ *
+ *  \retval proto the detected proto or ALPROTO_UNKNOWN if no match
+ */
+static uint16_t AlpProtoMatchPrefilter(AlpProtoDetectDirection *dir,
+        uint8_t *buf, uint16_t buflen, uint16_t ip_proto)
+{
+    int i;
+    for (i = 0; i < dir->prefilter_cnt; i++) {
+        AlpProtoPrefilter *pf = &dir->prefilter[i];
+        if (pf->offset >= buflen)
+            break;
+
+        AlpProtoSignature *s = pf->sigs[buf[pf->offset]];
+        for ( ; s != NULL; s = s->pf_next) {
+            if (s->ip_proto != ip_proto || s->co->depth > buflen)
+                continue;
+
+            if (memcmp(buf + pf->offset, s->co->content,
+                       s->co->content_len) == 0)
+                return s->proto;
+        }
+    }
+
+    return ALPROTO_UNKNOWN;
 }
 
 #ifdef __tilegx__
@@ -254,7 +344,8 @@ void AlpProtoAdd(AlpProtoDetectCtx *ctx, char *name, uint16_t ip_proto, uint16_t
         dir->min_len = depth;
 
     /* finally turn into a signature and add to the ctx */
-    AlpProtoAddSignature(ctx, cd, ip_proto, al_proto);
+    AlpProtoSignature *s = AlpProtoAddSignature(ctx, cd, ip_proto, al_proto);
+    AlpProtoAddPrefilter(dir, s);
 }
 
 #ifdef UNITTESTS
@@ -303,6 +394,22 @@ void AlpProtoFinalizeThread(ThreadVars *tv, AlpProtoDetectCtx *ctx, AlpProtoDete
         tctx->alproto_local_storage[i] = AppLayerGetProtocolParserLocalStorage(tv, i);
     }
 
+    if (tv != NULL) {
+        tctx->tv = tv;
+        tctx->counter_alproto_pm = SCPerfTVRegisterCounter("app_layer.detect.pm", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
+        tctx->counter_alproto_pp = SCPerfTVRegisterCounter("app_layer.detect.pp", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
+        tctx->counter_alproto_unknown = SCPerfTVRegisterCounter("app_layer.detect.unknown", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
+        tctx->counter_alproto_budget = SCPerfTVRegisterCounter("app_layer.detect.budget_exceeded", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
+    }
+
     return;
 }
 
@@ -364,8 +471,64 @@ void AlpProtoFinalizeGlobal(AlpProtoDetectCtx *ctx) {
     }
 }
 
+/**
+ *  \brief Load the tcp proto detection budget from the config.
+ *
+ *  app-layer:
+ *    proto-detect:
+ *      max-bytes: 64kb
+ *      max-chunks: 64
+ */
+static void AlpProtoLoadConfig(AlpProtoDetectCtx *ctx) {
+    char *str = NULL;
+
+    if (ConfGet("app-layer.proto-detect.max-bytes", &str) == 1) {
+        if (ParseSizeStringU32(str, &ctx->max_bytes) < 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing "
+                       "app-layer.proto-detect.max-bytes from conf file - %s. "
+                       "Killing engine", str);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    intmax_t value = 0;
+    if (ConfGetInt("app-layer.proto-detect.max-chunks", &value) == 1) {
+        if (value < 0 || value > UINT16_MAX) {
+            SCLogError(SC_ERR_INVALID_VALUE, "Invalid value for "
+                       "app-layer.proto-detect.max-chunks: %"PRIdMAX, value);
+            exit(EXIT_FAILURE);
+        }
+        ctx->max_chunks = (uint16_t)value;
+    }
+
+    SCLogInfo("protocol detection budget: %"PRIu32" bytes, %"PRIu16" chunks "
+              "(0 is unlimited)", ctx->max_bytes, ctx->max_chunks);
+}
+
+/**
+ *  \brief Check if a tcp flow has used up its proto detection budget.
+ *
+ *  \param ctx Global app layer detection context
+ *  \param chunks number of detection calls in this direction, including
+ *                calls that re-inspect data not yet consumed
+ *  \param buflen bytes of this direction inspected so far
+ *
+ *  \retval 1 budget exceeded, give up detection
+ *  \retval 0 keep trying
+ */
+int AlpProtoDetectBudgetExceeded(AlpProtoDetectCtx *ctx, uint16_t chunks,
+                                 uint32_t buflen)
+{
+    if (ctx->max_bytes > 0 && buflen >= ctx->max_bytes)
+        return 1;
+    if (ctx->max_chunks > 0 && chunks >= ctx->max_chunks)
+        return 1;
+    return 0;
+}
+
 void AppLayerDetectProtoThreadInit(void) {
     AlpProtoInit(&alp_proto_ctx);
+    AlpProtoLoadConfig(&alp_proto_ctx);
     RegisterAppLayerParsers();
     AlpProtoFinalizeGlobal(&alp_proto_ctx);
 
@@ -405,6 +568,10 @@ uint16_t AppLayerDetectGetProtoPMParser(AlpProtoDetectCtx *ctx,
         SCReturnUInt(ALPROTO_UNKNOWN);
     }
 
+    if (!dir->prefilter_off) {
+        SCReturnUInt(AlpProtoMatchPrefilter(dir, buf, buflen, ipproto));
+    }
+
     /* see if we can limit the data we inspect */
     uint16_t searchlen = buflen;
     if (searchlen > dir->max_len)
@@ -644,8 +811,10 @@ uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *ctx,
             } else {
                 alproto = AppLayerDetectGetProtoPMParser(ctx, tctx, buf, buflen,
                                                          flags, ipproto);
-                if (alproto != ALPROTO_UNKNOWN)
+                if (alproto != ALPROTO_UNKNOWN) {
+                    AlpProtoDetectCounterIncr(tctx, counter_alproto_pm);
                     return alproto;
+                }
                 /* the alproto hasn't been detected at this point */
                 if (f->flags & FLOW_TS_PP_ALPROTO_DETECT_DONE) {
                     f->flags |= FLOW_TS_PM_PP_ALPROTO_DETECT_DONE;
@@ -656,13 +825,15 @@ uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *ctx,
         } else {
             alproto = AppLayerDetectGetProtoPMParser(ctx, tctx, buf, buflen,
                                                      flags, ipproto);
-            if (alproto != ALPROTO_UNKNOWN)
+            if (alproto != ALPROTO_UNKNOWN) {
+                AlpProtoDetectCounterIncr(tctx, counter_alproto_pm);
                 return alproto;
+            }
         }
         /* If we have reached here, the PM parser has failed to detect the
          * alproto */
-        return AppLayerDetectGetProtoProbingParser(ctx, f, buf, buflen,
-                                                   flags, ipproto);
+        alproto = AppLayerDetectGetProtoProbingParser(ctx, f, buf, buflen,
+                                                      flags, ipproto);
 
         /* STREAM_TOCLIENT */
     } else {
@@ -672,8 +843,10 @@ uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *ctx,
             } else {
                 alproto = AppLayerDetectGetProtoPMParser(ctx, tctx, buf, buflen,
                                                          flags, ipproto);
-                if (alproto != ALPROTO_UNKNOWN)
+                if (alproto != ALPROTO_UNKNOWN) {
+                    AlpProtoDetectCounterIncr(tctx, counter_alproto_pm);
                     return alproto;
+                }
                 if (f->flags & FLOW_TC_PP_ALPROTO_DETECT_DONE) {
                     f->flags |= FLOW_TC_PM_PP_ALPROTO_DETECT_DONE;
                     return ALPROTO_UNKNOWN;
@@ -683,12 +856,18 @@ uint16_t AppLayerDetectGetProto(AlpProtoDetectCtx *ctx,
         } else {
             alproto = AppLayerDetectGetProtoPMParser(ctx, tctx, buf, buflen,
                                                      flags, ipproto);
-            if (alproto != ALPROTO_UNKNOWN)
+            if (alproto != ALPROTO_UNKNOWN) {
+                AlpProtoDetectCounterIncr(tctx, counter_alproto_pm);
                 return alproto;
+            }
         }
-        return AppLayerDetectGetProtoProbingParser(ctx, f, buf, buflen,
-                                                       flags, ipproto);
+        alproto = AppLayerDetectGetProtoProbingParser(ctx, f, buf, buflen,
+                                                      flags, ipproto);
     }
+
+    if (alproto != ALPROTO_UNKNOWN)
+        AlpProtoDetectCounterIncr(tctx, counter_alproto_pp);
+    return alproto;
 }
 
 /* VJ Originally I thought of having separate app layer
@@ -1546,6 +1725,61 @@ int AlpDetectTest14(void) {
     return r;
 }
 
+/** \test anchored patterns are matched by the prefilter, a pattern that
+ *        isn't at a fixed offset disables it */
+int AlpDetectTest15(void) {
+    uint8_t l7data[] = "POST / HTTP/1.1\r\n";
+    uint8_t l7data_smb[] = "\x00\x00\x00\x85\xffSMBr";
+    int r = 0;
+    AlpProtoDetectCtx ctx;
+    AlpProtoDetectThreadCtx tctx;
+
+    AlpProtoInit(&ctx);
+
+    AlpProtoAdd(&ctx, "http", IPPROTO_TCP, ALPROTO_HTTP, "GET", 3, 0, STREAM_TOSERVER);
+    AlpProtoAdd(&ctx, "http", IPPROTO_TCP, ALPROTO_HTTP, "POST", 4, 0, STREAM_TOSERVER);
+    AlpProtoAdd(&ctx, "smb", IPPROTO_TCP, ALPROTO_SMB, "|ff|SMB", 8, 4, STREAM_TOSERVER);
+    AlpProtoAdd(&ctx, "http", IPPROTO_TCP, ALPROTO_HTTP, "HTTP", 4, 0, STREAM_TOCLIENT);
+    AlpProtoAdd(&ctx, "ftp", IPPROTO_TCP, ALPROTO_FTP, "220 ", 8, 0, STREAM_TOCLIENT);
+
+    if (ctx.toserver.prefilter_off || ctx.toserver.prefilter_cnt != 2 ||
+        ctx.toserver.prefilter[0].offset != 0 ||
+        ctx.toserver.prefilter[1].offset != 4) {
+        printf("toserver prefilter not set up: ");
+        goto end;
+    }
+    if (!ctx.toclient.prefilter_off) {
+        printf("toclient prefilter should be off: ");
+        goto end;
+    }
+
+    AlpProtoFinalizeGlobal(&ctx);
+    AlpProtoFinalizeThread(NULL, &ctx, &tctx);
+
+    uint16_t proto = AppLayerDetectGetProtoPMParser(&ctx, &tctx, l7data, sizeof(l7data) - 1, STREAM_TOSERVER, IPPROTO_TCP);
+    if (proto != ALPROTO_HTTP) {
+        printf("proto %" PRIu16 " != %" PRIu16 ": ", proto, ALPROTO_HTTP);
+        goto end;
+    }
+
+    proto = AppLayerDetectGetProtoPMParser(&ctx, &tctx, l7data_smb, sizeof(l7data_smb) - 1, STREAM_TOSERVER, IPPROTO_TCP);
+    if (proto != ALPROTO_SMB) {
+        printf("proto %" PRIu16 " != %" PRIu16 ": ", proto, ALPROTO_SMB);
+        goto end;
+    }
+
+    proto = AppLayerDetectGetProtoPMParser(&ctx, &tctx, l7data, 3, STREAM_TOSERVER, IPPROTO_TCP);
+    if (proto != ALPROTO_UNKNOWN) {
+        printf("proto %" PRIu16 " != %" PRIu16 " on a short buffer: ", proto, ALPROTO_UNKNOWN);
+        goto end;
+    }
+
+    r = 1;
+end:
+    AlpProtoTestDestroy(&ctx);
+    return r;
+}
+
 /** \test test if the engine detect the proto and match with it */
 static int AlpDetectTestSig1(void)
 {
@@ -1993,6 +2227,130 @@ end:
     return result;
 }
 
+/** \test the byte budget of a direction gives up detection */
+static int AlpDetectTestBudget01(void)
+{
+    int result = 0;
+    Flow *f = NULL;
+    TcpSession ssn;
+    AlpProtoDetectThreadCtx tctx;
+    uint8_t buf[] = "zzzzzzzz";
+    uint32_t max_bytes = alp_proto_ctx.max_bytes;
+    uint16_t max_chunks = alp_proto_ctx.max_chunks;
+
+    memset(&ssn, 0, sizeof(TcpSession));
+    alp_proto_ctx.max_bytes = 4096;
+    alp_proto_ctx.max_chunks = 0;
+    AlpProtoFinalize2Thread(NULL, &tctx);
+
+    f = UTHBuildFlow(AF_INET, "1.1.1.1", "2.2.2.2", 1024, 9999);
+    if (f == NULL)
+        goto end;
+    f->protoctx = &ssn;
+
+    ssn.client.ra_app_base_seq = 100;
+    ssn.client.last_ack = 101 + 1000;
+
+    FLOWLOCK_WRLOCK(f);
+    AppLayerHandleTCPData(&tctx, f, &ssn, buf, sizeof(buf) - 1,
+                          STREAM_TOSERVER|STREAM_START);
+    FLOWLOCK_UNLOCK(f);
+    if (f->flags & FLOW_NO_APPLAYER_INSPECTION) {
+        printf("budget exceeded after 1000 bytes: ");
+        goto end;
+    }
+
+    /* the chunk itself stays small, the direction has grown */
+    ssn.client.last_ack = 101 + 4096;
+
+    FLOWLOCK_WRLOCK(f);
+    AppLayerHandleTCPData(&tctx, f, &ssn, buf, sizeof(buf) - 1,
+                          STREAM_TOSERVER|STREAM_START);
+    FLOWLOCK_UNLOCK(f);
+    if (!(f->flags & FLOW_NO_APPLAYER_INSPECTION) ||
+        !(ssn.flags & STREAMTCP_FLAG_APPPROTO_DETECTION_COMPLETED)) {
+        printf("byte budget not exceeded after 4096 bytes: ");
+        goto end;
+    }
+    if (f->alproto != ALPROTO_UNKNOWN) {
+        printf("alproto %"PRIu16" != %"PRIu16": ", f->alproto, ALPROTO_UNKNOWN);
+        goto end;
+    }
+
+    result = 1;
+end:
+    alp_proto_ctx.max_bytes = max_bytes;
+    alp_proto_ctx.max_chunks = max_chunks;
+    AlpProtoDeFinalize2Thread(&tctx);
+    UTHFreeFlow(f);
+    return result;
+}
+
+/** \test the chunk budget is counted per direction */
+static int AlpDetectTestBudget02(void)
+{
+    int result = 0;
+    Flow *f = NULL;
+    TcpSession ssn;
+    AlpProtoDetectThreadCtx tctx;
+    uint8_t buf[] = "zzzzzzzz";
+    uint32_t max_bytes = alp_proto_ctx.max_bytes;
+    uint16_t max_chunks = alp_proto_ctx.max_chunks;
+    int i;
+
+    memset(&ssn, 0, sizeof(TcpSession));
+    alp_proto_ctx.max_bytes = 0;
+    alp_proto_ctx.max_chunks = 4;
+    AlpProtoFinalize2Thread(NULL, &tctx);
+
+    f = UTHBuildFlow(AF_INET, "1.1.1.1", "2.2.2.2", 1024, 9999);
+    if (f == NULL)
+        goto end;
+    f->protoctx = &ssn;
+
+    ssn.client.ra_app_base_seq = 100;
+    ssn.client.last_ack = 101 + sizeof(buf) - 1;
+    ssn.server.ra_app_base_seq = 200;
+    ssn.server.last_ack = 201 + sizeof(buf) - 1;
+
+    /* 3 calls in each direction stay within a budget of 4 */
+    for (i = 0; i < 3; i++) {
+        FLOWLOCK_WRLOCK(f);
+        AppLayerHandleTCPData(&tctx, f, &ssn, buf, sizeof(buf) - 1,
+                              STREAM_TOSERVER|STREAM_START);
+        AppLayerHandleTCPData(&tctx, f, &ssn, buf, sizeof(buf) - 1,
+                              STREAM_TOCLIENT|STREAM_START);
+        FLOWLOCK_UNLOCK(f);
+    }
+    if (f->flags & FLOW_NO_APPLAYER_INSPECTION) {
+        printf("budget exceeded after 3 calls per direction: ");
+        goto end;
+    }
+    if (ssn.alproto_detect_ts_cnt != 3 || ssn.alproto_detect_tc_cnt != 3) {
+        printf("detect cnt %"PRIu16"/%"PRIu16" != 3/3: ",
+               ssn.alproto_detect_ts_cnt, ssn.alproto_detect_tc_cnt);
+        goto end;
+    }
+
+    FLOWLOCK_WRLOCK(f);
+    AppLayerHandleTCPData(&tctx, f, &ssn, buf, sizeof(buf) - 1,
+                          STREAM_TOSERVER|STREAM_START);
+    FLOWLOCK_UNLOCK(f);
+    if (!(f->flags & FLOW_NO_APPLAYER_INSPECTION) ||
+        !(ssn.flags & STREAMTCP_FLAG_APPPROTO_DETECTION_COMPLETED)) {
+        printf("chunk budget not exceeded after 4 toserver calls: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    alp_proto_ctx.max_bytes = max_bytes;
+    alp_proto_ctx.max_chunks = max_chunks;
+    AlpProtoDeFinalize2Thread(&tctx);
+    UTHFreeFlow(f);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void AlpDetectRegisterTests(void) {
@@ -2011,10 +2369,13 @@ void AlpDetectRegisterTests(void) {
     UtRegisterTest("AlpDetectTest12", AlpDetectTest12, 1);
     UtRegisterTest("AlpDetectTest13", AlpDetectTest13, 1);
     UtRegisterTest("AlpDetectTest14", AlpDetectTest14, 1);
+    UtRegisterTest("AlpDetectTest15", AlpDetectTest15, 1);
     UtRegisterTest("AlpDetectTestSig1", AlpDetectTestSig1, 1);
     UtRegisterTest("AlpDetectTestSig2", AlpDetectTestSig2, 1);
     UtRegisterTest("AlpDetectTestSig3", AlpDetectTestSig3, 1);
     UtRegisterTest("AlpDetectTestSig4", AlpDetectTestSig4, 1);
     UtRegisterTest("AlpDetectTestSig5", AlpDetectTestSig5, 1);
+    UtRegisterTest("AlpDetectTestBudget01", AlpDetectTestBudget01, 1);
+    UtRegisterTest("AlpDetectTestBudget02", AlpDetectTestBudget02, 1);
 #endif /* UNITTESTS */
 }
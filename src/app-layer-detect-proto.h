@@ -37,10 +37,22 @@ typedef struct AlpProtoSignature_ {
     DetectContentData *co;              /**< content match that needs to match */
     struct AlpProtoSignature_ *next;    /**< next signature */
     struct AlpProtoSignature_ *map_next;    /**< next signature with same id */
+    struct AlpProtoSignature_ *pf_next;     /**< next signature in the same
+                                                 prefilter bucket */
 } AlpProtoSignature;
 
 #define ALP_DETECT_MAX 256
 
+/** max number of distinct pattern offsets the prefilter handles */
+#define ALP_PREFILTER_MAX_OFFSETS 4
+
+/** \brief Signatures of a direction whose pattern sits at a fixed offset,
+ *         bucketed by the first byte of the pattern */
+typedef struct AlpProtoPrefilter_ {
+    uint16_t offset;
+    AlpProtoSignature *sigs[256];
+} AlpProtoPrefilter;
+
 typedef struct AlpProtoDetectDirection_ {
     MpmCtx mpm_ctx;
     uint32_t id;
@@ -52,6 +64,12 @@ typedef struct AlpProtoDetectDirection_ {
                                          tell the stream engine to feed data
                                          to app layer as soon as it has min
                                          size data */
+
+    /** if all patterns are at a fixed offset, they are matched by looking
+     *  up the byte at that offset instead of running the mpm */
+    AlpProtoPrefilter prefilter[ALP_PREFILTER_MAX_OFFSETS];
+    uint8_t prefilter_cnt;
+    uint8_t prefilter_off;         /**< set if a pattern can't be prefiltered */
 } AlpProtoDetectDirection;
 
 typedef struct AlpProtoDetectCtx_ {
@@ -76,6 +94,11 @@ typedef struct AlpProtoDetectCtx_ {
     AppLayerProbingParser *probing_parsers;
     AppLayerProbingParserInfo *probing_parsers_info;
     uint16_t sigs;              /**< number of sigs */
+
+    /** budget of a tcp flow: detection is given up after this many bytes
+     *  in a direction or this many chunks. 0 means no limit. */
+    uint32_t max_bytes;
+    uint16_t max_chunks;
 } AlpProtoDetectCtx;
 
 extern AlpProtoDetectCtx alp_proto_ctx;
@@ -107,5 +130,14 @@ void AlpProtoDeFinalize2Thread (AlpProtoDetectThreadCtx *);
 void AlpProtoTestDestroy(AlpProtoDetectCtx *);
 void AlpProtoDestroy(void);
 
+int AlpProtoDetectBudgetExceeded(AlpProtoDetectCtx *, uint16_t, uint32_t);
+
+/** \brief increment a proto detection counter of the thread ctx, if the
+ *         ctx belongs to a thread that has counters */
+#define AlpProtoDetectCounterIncr(tctx, c) do {                 \
+        if ((tctx)->tv != NULL)                                 \
+            SCPerfCounterIncr((tctx)->c, (tctx)->tv->sc_perf_pca); \
+    } while (0)
+
 #endif /* __APP_LAYER_DETECT_PROTO_H__ */
 
@@ -48,102 +48,195 @@
 #include "util-unittest.h"
 #include "util-debug.h"
 #include "util-memcmp.h"
+#include "util-line.h"
+#include "util-ftp.h"
+
+/** ftp command names, grouped by first letter */
+SCEnumCharMap ftp_decoder_event_table[ ] = {
+    { "MAX_LINE_LEN_EXCEEDED", FTP_DECODER_EVENT_MAX_LINE_LEN_EXCEEDED },
+    { NULL,                    -1 },
+};
+
+/** max length of a request line, excluding the delimiter */
+static uint32_t ftp_max_line_len = LINE_BUFFER_DEFAULT_MAX_LEN;
+
+static const struct {
+    const char *name;
+    uint8_t len;
+    FtpRequestCommand command;
+} ftp_commands[] = {
+    { "abor", 4, FTP_COMMAND_ABOR },
+    { "acct", 4, FTP_COMMAND_ACCT },
+    { "allo", 4, FTP_COMMAND_ALLO },
+    { "appe", 4, FTP_COMMAND_APPE },
+    { "cdup", 4, FTP_COMMAND_CDUP },
+    { "chmod", 5, FTP_COMMAND_CHMOD },
+    { "cwd", 3, FTP_COMMAND_CWD },
+    { "dele", 4, FTP_COMMAND_DELE },
+    { "help", 4, FTP_COMMAND_HELP },
+    { "idle", 4, FTP_COMMAND_IDLE },
+    { "list", 4, FTP_COMMAND_LIST },
+    { "mail", 4, FTP_COMMAND_MAIL },
+    { "mdtm", 4, FTP_COMMAND_MDTM },
+    { "mkd", 3, FTP_COMMAND_MKD },
+    { "mlfl", 4, FTP_COMMAND_MLFL },
+    { "mode", 4, FTP_COMMAND_MODE },
+    { "mrcp", 4, FTP_COMMAND_MRCP },
+    { "mrsq", 4, FTP_COMMAND_MRSQ },
+    { "msam", 4, FTP_COMMAND_MSAM },
+    { "msnd", 4, FTP_COMMAND_MSND },
+    { "msom", 4, FTP_COMMAND_MSOM },
+    { "nlst", 4, FTP_COMMAND_NLST },
+    { "noop", 4, FTP_COMMAND_NOOP },
+    { "pass", 4, FTP_COMMAND_PASS },
+    { "pasv", 4, FTP_COMMAND_PASV },
+    { "port", 4, FTP_COMMAND_PORT },
+    { "pwd", 3, FTP_COMMAND_PWD },
+    { "quit", 4, FTP_COMMAND_QUIT },
+    { "rein", 4, FTP_COMMAND_REIN },
+    { "rest", 4, FTP_COMMAND_REST },
+    { "retr", 4, FTP_COMMAND_RETR },
+    { "rmd", 3, FTP_COMMAND_RMD },
+    { "rnfr", 4, FTP_COMMAND_RNFR },
+    { "rnto", 4, FTP_COMMAND_RNTO },
+    { "site", 4, FTP_COMMAND_SITE },
+    { "size", 4, FTP_COMMAND_SIZE },
+    { "smnt", 4, FTP_COMMAND_SMNT },
+    { "stat", 4, FTP_COMMAND_STAT },
+    { "stor", 4, FTP_COMMAND_STOR },
+    { "stou", 4, FTP_COMMAND_STOU },
+    { "stru", 4, FTP_COMMAND_STRU },
+    { "syst", 4, FTP_COMMAND_SYST },
+    { "type", 4, FTP_COMMAND_TYPE },
+    { "umask", 5, FTP_COMMAND_UMASK },
+    { "user", 4, FTP_COMMAND_USER },
+};
+
+#define FTP_COMMANDS_CNT (sizeof(ftp_commands) / sizeof(ftp_commands[0]))
+
+/** per first letter the range [first, last) of ftp_commands entries */
+static uint8_t ftp_command_first[26];
+static uint8_t ftp_command_last[26];
+
+static void FTPSetCommandTable(void)
+{
+    uint8_t i;
+
+    memset(ftp_command_first, 0, sizeof(ftp_command_first));
+    memset(ftp_command_last, 0, sizeof(ftp_command_last));
+
+    for (i = 0; i < FTP_COMMANDS_CNT; i++) {
+        int letter = ftp_commands[i].name[0] - 'a';
+        if (ftp_command_last[letter] == 0)
+            ftp_command_first[letter] = i;
+        ftp_command_last[letter] = i + 1;
+    }
+}
 
 /**
- * \brief This function is called to determine and set which command is being
+ * \brief This function is called to determine which command is being
  * transfered to the ftp server
- * \param ftp_state the ftp state structure for the parser
- * \param input input line of the command
+ * \param input the command, without arguments
  * \param len of the command
  *
- * \retval 1 when the command is parsed, 0 otherwise
+ * \retval command the command or FTP_COMMAND_UNKNOWN
  */
-static int FTPParseRequestCommand(void *ftp_state, uint8_t *input,
-                                  uint32_t input_len) {
-    SCEnter();
-    FtpState *fstate = (FtpState *)ftp_state;
-
-    if (input_len >= 4) {
-        if (SCMemcmpLowercase("port", input, 4) == 0) {
-            fstate->command = FTP_COMMAND_PORT;
+static FtpRequestCommand FTPParseRequestCommand(uint8_t *input,
+                                                uint32_t input_len) {
+    if (input_len == 0)
+        return FTP_COMMAND_UNKNOWN;
+
+    int letter = u8_tolower(input[0]) - 'a';
+    if (letter < 0 || letter >= 26)
+        return FTP_COMMAND_UNKNOWN;
+
+    uint8_t i;
+    for (i = ftp_command_first[letter]; i < ftp_command_last[letter]; i++) {
+        if (ftp_commands[i].len == input_len &&
+            SCMemcmpLowercase((void *)ftp_commands[i].name, input,
+                              input_len) == 0) {
+            return ftp_commands[i].command;
         }
-
-        /* else {
-         *     Add the ftp commands you need here
-         * }
-         */
     }
-    return 1;
+    return FTP_COMMAND_UNKNOWN;
 }
 
 /**
- * \brief This function is called to retrieve the request line and parse it
+ * \brief Check if the stored PORT line points to another host than the
+ *        client.
+ */
+static int FTPPortLineBounces(Flow *f, FtpState *fstate)
+{
+    if (f == NULL || fstate->port_line == NULL)
+        return 0;
+
+    return FtpPortArgsBounce(fstate->port_line, fstate->port_line_len,
+            f->src.address.address_un_data32[0],
+            fstate->arg_offset);
+}
+
+/**
+ * \brief This function is called to parse a request line
+ *
+ * Detection only runs after all lines of a chunk are parsed, so a PORT
+ * line is kept as the current command until the end of the chunk. Only
+ * a later PORT line that bounces while the stored one doesn't replaces
+ * it.
+ *
+ * \param f flow, used to check for ftpbounce
  * \param ftp_state the ftp state structure for the parser
- * \param input input line of the command
- * \param input_len length of the request
- * \param output the resulting output
+ * \param input the request line, without the delimiter
+ * \param input_len length of the request line
+ * \param port_seen set if a PORT line is stored for this chunk
  *
  * \retval 1 when the command is parsed, 0 otherwise
  */
-static int FTPParseRequestCommandLine(Flow *f, void *ftp_state, AppLayerParserState
-                                      *pstate, uint8_t *input,uint32_t input_len,
-                                      void *local_data, AppLayerParserResult *output) {
+static int FTPParseRequestCommandLine(Flow *f, void *ftp_state, uint8_t *input,
+                                      uint32_t input_len, int *port_seen) {
     SCEnter();
     //PrintRawDataFp(stdout, input,input_len);
 
     FtpState *fstate = (FtpState *)ftp_state;
-    uint16_t max_fields = 2;
-    uint16_t u = 0;
-    uint32_t offset = 0;
 
-    if (pstate == NULL)
-        return -1;
+    /* REQUEST COMMAND, the argument follows the first space */
+    uint8_t *sp = memchr(input, 0x20, input_len);
+    uint32_t command_len = (sp != NULL) ? (uint32_t)(sp - input) : input_len;
+    FtpRequestCommand command = FTPParseRequestCommand(input, command_len);
 
-    for (u = pstate->parse_field; u < max_fields; u++) {
-
-        switch(u) {
-            case 0: /* REQUEST COMMAND */
-            {
-                const uint8_t delim[] = { 0x20, };
-                int r = AlpParseFieldByDelimiter(output, pstate,
-                                FTP_FIELD_REQUEST_COMMAND, delim, sizeof(delim),
-                                input, input_len, &offset);
-
-                if (r == 0) {
-                    pstate->parse_field = 0;
-                    return 0;
-                }
-                fstate->arg_offset = offset;
-                FTPParseRequestCommand(ftp_state, input, input_len);
-                break;
-            }
-            case 1: /* REQUEST COMMAND ARG */
-            {
-                switch (fstate->command) {
-                    case FTP_COMMAND_PORT:
-                        /* We don't need to parse args, we are going to check
-                        * the ftpbounce condition directly from detect-ftpbounce
-                        */
-                        if (fstate->port_line != NULL)
-                            SCFree(fstate->port_line);
-                        fstate->port_line = SCMalloc(input_len);
-                        if (fstate->port_line == NULL)
-                            return 0;
-                        fstate->port_line = memcpy(fstate->port_line, input,
-                                                   input_len);
-                        fstate->port_line_len = input_len;
-                    break;
-                    default:
-                    break;
-                } /* end switch command specified args */
+    if (*port_seen) {
+        if (command != FTP_COMMAND_PORT || sp == NULL ||
+            FTPPortLineBounces(f, fstate))
+            return command != FTP_COMMAND_UNKNOWN;
+    }
 
+    fstate->command = command;
+    fstate->arg_offset = (sp != NULL) ? command_len + 1 : input_len;
+
+    /* REQUEST COMMAND ARG */
+    switch (fstate->command) {
+        case FTP_COMMAND_PORT:
+            if (sp == NULL)
                 break;
+            /* We don't need to parse args, we are going to check
+             * the ftpbounce condition directly from detect-ftpbounce
+             */
+            if (fstate->port_line != NULL)
+                SCFree(fstate->port_line);
+            fstate->port_line = SCMalloc(input_len);
+            if (fstate->port_line == NULL) {
+                fstate->port_line_len = 0;
+                return 0;
             }
-        }
-    }
-
-    pstate->parse_field = 0;
-    return 1;
+            fstate->port_line = memcpy(fstate->port_line, input,
+                                       input_len);
+            fstate->port_line_len = input_len;
+            *port_seen = 1;
+            break;
+        default:
+            break;
+    } /* end switch command specified args */
+
+    return fstate->command != FTP_COMMAND_UNKNOWN;
 }
 
 /**
@@ -163,27 +256,26 @@ static int FTPParseRequest(Flow *f, void *ftp_state,
     SCEnter();
     /* PrintRawDataFp(stdout, input,input_len); */
 
-    uint32_t offset = 0;
+    FtpState *fstate = (FtpState *)ftp_state;
+    int32_t len = (int32_t)input_len;
+    LineSpan span;
+    int port_seen = 0;
+    int r = 0;
 
     if (pstate == NULL)
         return -1;
 
-
-    //PrintRawDataFp(stdout, pstate->store, pstate->store_len);
-
-    const uint8_t delim[] = { 0x0D, 0x0A };
-    int r = AlpParseFieldByDelimiter(output, pstate, FTP_FIELD_REQUEST_LINE,
-                                     delim, sizeof(delim), input, input_len,
-                                     &offset);
-    if (r == 0) {
-        pstate->parse_field = 0;
-        return 0;
+    while (LineBufferGetLine(&fstate->request_lb, ftp_max_line_len, &input,
+                             &len, &span) == 0) {
+        if (span.truncated) {
+            AppLayerDecoderEventsSetEvent(f,
+                    FTP_DECODER_EVENT_MAX_LINE_LEN_EXCEEDED);
+        }
+        r = FTPParseRequestCommandLine(f, ftp_state, span.line, span.len,
+                                       &port_seen);
     }
-    if (pstate->store_len)
-        PrintRawDataFp(stdout, pstate->store, pstate->store_len);
 
-    pstate->parse_field = 0;
-    return 1;
+    return r;
 }
 
 /**
@@ -253,6 +345,7 @@ static void FTPStateFree(void *s) {
     FtpState *fstate = (FtpState *) s;
     if (fstate->port_line != NULL)
         SCFree(fstate->port_line);
+    LineBufferFree(&fstate->request_lb);
     SCFree(s);
 #ifdef DEBUG
     SCMutexLock(&ftp_state_mem_lock);
@@ -266,6 +359,8 @@ static void FTPStateFree(void *s) {
 void RegisterFTPParsers(void) {
     char *proto_name = "ftp";
 
+    ftp_max_line_len = LineBufferConfGetMaxLen("app-layer.ftp.max-line-length");
+
     /** FTP */
     AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_FTP, "USER ", 5, 0, STREAM_TOSERVER);
     AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_FTP, "PASS ", 5, 0, STREAM_TOSERVER);
@@ -275,10 +370,10 @@ void RegisterFTPParsers(void) {
                           FTPParseRequest);
     AppLayerRegisterProto(proto_name, ALPROTO_FTP, STREAM_TOCLIENT,
                           FTPParseResponse);
-    AppLayerRegisterParser("ftp.request_command_line", ALPROTO_FTP,
-                           FTP_FIELD_REQUEST_LINE, FTPParseRequestCommandLine,
-                           "ftp");
     AppLayerRegisterStateFuncs(ALPROTO_FTP, FTPStateAlloc, FTPStateFree);
+    AppLayerDecoderEventsModuleRegister(ALPROTO_FTP, ftp_decoder_event_table);
+
+    FTPSetCommandTable();
 }
 
 void FTPAtExitPrintStats(void) {
@@ -536,6 +631,113 @@ end:
     FLOW_DESTROY(&f);
     return result;
 }
+/** \test a PORT line followed by another command in the same chunk is
+ *        still the command seen by detection */
+int FTPParserTest11(void) {
+    int result = 0;
+    Flow f;
+    uint8_t ftpbuf1[] = "PORT 192,168,1,1,0,80\r\nSTOR x\r\n";
+    uint32_t ftplen1 = sizeof(ftpbuf1) - 1; /* minus the \0 */
+    uint8_t ftpbuf2[] = "PASV\r\n";
+    uint32_t ftplen2 = sizeof(ftpbuf2) - 1; /* minus the \0 */
+    TcpSession ssn;
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    int r = AppLayerParse(NULL, &f, ALPROTO_FTP, STREAM_TOSERVER|STREAM_START,
+                          ftpbuf1, ftplen1);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+
+    FtpState *ftp_state = f.alstate;
+    if (ftp_state == NULL) {
+        printf("no ftp state: ");
+        goto end;
+    }
+
+    if (ftp_state->command != FTP_COMMAND_PORT) {
+        printf("expected command %" PRIu32 ", got %" PRIu32 ": ",
+               FTP_COMMAND_PORT, ftp_state->command);
+        goto end;
+    }
+
+    if (ftp_state->port_line_len != 21 ||
+        memcmp(ftp_state->port_line, "PORT 192,168,1,1,0,80", 21) != 0 ||
+        ftp_state->arg_offset != 5) {
+        printf("port line not stored: ");
+        goto end;
+    }
+
+    /* command without argument in the next chunk */
+    r = AppLayerParse(NULL, &f, ALPROTO_FTP, STREAM_TOSERVER, ftpbuf2, ftplen2);
+    if (r != 0) {
+        printf("toserver chunk 2 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+
+    if (ftp_state->command != FTP_COMMAND_PASV) {
+        printf("expected command %" PRIu32 ", got %" PRIu32 ": ",
+               FTP_COMMAND_PASV, ftp_state->command);
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    return result;
+}
+
+/** \test of two PORT lines in one chunk the bouncing one is kept */
+int FTPParserTest12(void) {
+    int result = 0;
+    Flow f;
+    uint8_t ftpbuf1[] = "PORT 10,0,0,1,0,80\r\nPORT 192,168,1,1,0,80\r\n"
+                        "PORT 10,0,0,1,0,81\r\n";
+    uint32_t ftplen1 = sizeof(ftpbuf1) - 1; /* minus the \0 */
+    TcpSession ssn;
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    f.src.address.address_un_data32[0] = htonl(0x0a000001); /* 10.0.0.1 */
+
+    StreamTcpInitConfig(TRUE);
+
+    int r = AppLayerParse(NULL, &f, ALPROTO_FTP, STREAM_TOSERVER|STREAM_START,
+                          ftpbuf1, ftplen1);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+
+    FtpState *ftp_state = f.alstate;
+    if (ftp_state == NULL) {
+        printf("no ftp state: ");
+        goto end;
+    }
+
+    if (ftp_state->command != FTP_COMMAND_PORT ||
+        ftp_state->port_line_len != 21 ||
+        memcmp(ftp_state->port_line, "PORT 192,168,1,1,0,80", 21) != 0) {
+        printf("bouncing port line not kept: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    return result;
+}
 #endif /* UNITTESTS */
 
 void FTPParserRegisterTests(void) {
@@ -545,6 +747,8 @@ void FTPParserRegisterTests(void) {
     UtRegisterTest("FTPParserTest06", FTPParserTest06, 1);
     UtRegisterTest("FTPParserTest07", FTPParserTest07, 1);
     UtRegisterTest("FTPParserTest10", FTPParserTest10, 1);
+    UtRegisterTest("FTPParserTest11", FTPParserTest11, 1);
+    UtRegisterTest("FTPParserTest12", FTPParserTest12, 1);
 #endif /* UNITTESTS */
 }
 
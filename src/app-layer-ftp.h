@@ -24,6 +24,13 @@
 #ifndef __APP_LAYER_FTP_H__
 #define __APP_LAYER_FTP_H__
 
+#include "decode-events.h"
+#include "util-line.h"
+
+enum {
+    FTP_DECODER_EVENT_MAX_LINE_LEN_EXCEEDED,
+};
+
 typedef enum {
     FTP_COMMAND_UNKNOWN = 0,
     FTP_COMMAND_ABOR,
@@ -98,6 +105,8 @@ typedef struct FtpState_ {
     FtpResponseCode response_code;
     uint32_t port_line_len;
     uint8_t *port_line;
+    /** storage for a request line fragmented over multiple chunks */
+    LineBuffer request_lb;
 } FtpState;
 
 void RegisterFTPParsers(void);
@@ -63,9 +63,82 @@
 
 #include "util-memcmp.h"
 
+/** initial size of the body arena */
+#define HTP_BODY_ARENA_MIN_SIZE 4096
+
+/**
+ * \internal
+ * \brief Point the chunks at their data in the arena again, after it
+ *        moved or was compacted. Chunks are stored back to back in
+ *        stream order, starting at buf_start.
+ */
+static void HtpBodyArenaRebase(HtpBody *body)
+{
+    uint32_t offset = body->buf_start;
+    HtpBodyChunk *cur;
+
+    for (cur = body->first; cur != NULL; cur = cur->next) {
+        cur->data = body->buf + offset;
+        offset += cur->len;
+    }
+}
+
+/**
+ * \internal
+ * \brief Make room for len more bytes at the end of the arena. The
+ *        space of pruned chunks is reused first, the arena only grows
+ *        if the live data doesn't leave enough room.
+ *
+ * \retval 0 ok
+ * \retval -1 error
+ */
+static int HtpBodyArenaReserve(HtpBody *body, uint32_t len)
+{
+    if (body->buf_size - body->buf_end >= len)
+        return 0;
+
+    uint32_t used = body->buf_end - body->buf_start;
+
+    /* move the live data to the start if that gives us enough room */
+    if (body->buf_start > 0 && body->buf_size - used >= len) {
+        memmove(body->buf, body->buf + body->buf_start, used);
+        body->buf_start = 0;
+        body->buf_end = used;
+        HtpBodyArenaRebase(body);
+        return 0;
+    }
+
+    uint64_t size = body->buf_size ? body->buf_size : HTP_BODY_ARENA_MIN_SIZE;
+    while (size < (uint64_t)used + len)
+        size *= 2;
+    if (size > UINT32_MAX)
+        return -1;
+
+    if (body->buf_start > 0) {
+        memmove(body->buf, body->buf + body->buf_start, used);
+        body->buf_start = 0;
+        body->buf_end = used;
+    }
+
+    uint8_t *buf = SCRealloc(body->buf, (size_t)size);
+    if (buf == NULL) {
+        HtpBodyArenaRebase(body);
+        return -1;
+    }
+
+    body->buf = buf;
+    body->buf_size = (uint32_t)size;
+    HtpBodyArenaRebase(body);
+    return 0;
+}
+
 /**
  * \brief Append a chunk of body to the HtpBody struct
  *
+ * The data is copied into the body arena, a buffer that holds the data
+ * of all chunks back to back, so that the body can be inspected without
+ * reassembling it.
+ *
  * \param body pointer to the HtpBody holding the list
  * \param data pointer to the data of the chunk
  * \param len length of the chunk pointed by data
@@ -83,59 +156,63 @@ int HtpBodyAppendChunk(HtpTxUserData *htud, HtpBody *body, uint8_t *data, uint32
         SCReturnInt(0);
     }
 
-    if (body->first == NULL) {
-        /* New chunk */
-        bd = (HtpBodyChunk *)SCMalloc(sizeof(HtpBodyChunk));
-        if (bd == NULL)
-            goto error;
-
-        bd->len = len;
-        bd->stream_offset = 0;
-        bd->next = NULL;
-
-        bd->data = SCMalloc(len);
-        if (bd->data == NULL) {
-            goto error;
-        }
-        memcpy(bd->data, data, len);
-
-        body->first = body->last = bd;
-
-        body->content_len_so_far = len;
-    } else {
-        bd = (HtpBodyChunk *)SCMalloc(sizeof(HtpBodyChunk));
-        if (bd == NULL)
-            goto error;
+    bd = (HtpBodyChunk *)SCMalloc(sizeof(HtpBodyChunk));
+    if (bd == NULL)
+        goto error;
 
-        bd->len = len;
-        bd->stream_offset = body->content_len_so_far;
-        bd->next = NULL;
+    if (HtpBodyArenaReserve(body, len) < 0)
+        goto error;
 
-        bd->data = SCMalloc(len);
-        if (bd->data == NULL) {
-            goto error;
-        }
-        memcpy(bd->data, data, len);
+    bd->len = len;
+    bd->stream_offset = body->content_len_so_far;
+    bd->next = NULL;
+    bd->data = body->buf + body->buf_end;
+    memcpy(bd->data, data, len);
+    body->buf_end += len;
 
+    if (body->first == NULL) {
+        body->first = body->last = bd;
+    } else {
         body->last->next = bd;
         body->last = bd;
-
-        body->content_len_so_far += len;
     }
+    body->content_len_so_far += len;
+
     SCLogDebug("Body %p; data %p, len %"PRIu32, body, bd->data, (uint32_t)bd->len);
 
     SCReturnInt(0);
 
 error:
     if (bd != NULL) {
-        if (bd->data != NULL) {
-            SCFree(bd->data);
-        }
         SCFree(bd);
     }
     SCReturnInt(-1);
 }
 
+/**
+ * \brief Get the body data from a chunk up to the end of the body.
+ *
+ * As the chunks are stored back to back in the body arena, this is a
+ * window into the arena and not a copy. It's valid until the next
+ * append or prune of the body.
+ *
+ * \param body pointer to the HtpBody holding the list
+ * \param from first chunk of the window
+ * \param len pointer to pass back the length of the window
+ *
+ * \retval data pointer to the data of the first chunk
+ */
+uint8_t *HtpBodyGetWindow(HtpBody *body, HtpBodyChunk *from, uint32_t *len)
+{
+    if (from == NULL || body->last == NULL) {
+        *len = 0;
+        return NULL;
+    }
+
+    *len = (uint32_t)((body->last->data + body->last->len) - from->data);
+    return from->data;
+}
+
 /**
  * \brief Print the information and chunks of a Body
  * \param body pointer to the HtpBody holding the list
@@ -182,17 +259,23 @@ void HtpBodyFree(HtpBody *body)
     prev = body->first;
     while (prev != NULL) {
         cur = prev->next;
-        if (prev->data != NULL)
-            SCFree(prev->data);
         SCFree(prev);
         prev = cur;
     }
     body->first = body->last = NULL;
+
+    if (body->buf != NULL)
+        SCFree(body->buf);
+    body->buf = NULL;
+    body->buf_size = body->buf_start = body->buf_end = 0;
 }
 
 /**
  * \brief Free request body chunks that are already fully parsed.
  *
+ * Only the chunk list is updated, the arena space of the pruned chunks
+ * is reclaimed by the next append that needs it.
+ *
  * \param htud pointer to the HtpTxUserData holding the body
  *
  * \retval none
@@ -229,13 +312,17 @@ void HtpBodyPrune(HtpBody *body)
             body->last = next;
         }
 
-        if (cur->data != NULL) {
-            SCFree(cur->data);
-        }
+        /* the data stays in the arena, its space is reused once the
+         * arena needs room */
+        body->buf_start += cur->len;
         SCFree(cur);
 
         cur = next;
     }
 
+    if (body->first == NULL) {
+        body->buf_start = body->buf_end = 0;
+    }
+
     SCReturn;
 }
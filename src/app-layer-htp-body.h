@@ -32,5 +32,6 @@ int HtpBodyAppendChunk(HtpTxUserData *, HtpBody *, uint8_t *, uint32_t);
 void HtpBodyPrint(HtpBody *);
 void HtpBodyFree(HtpBody *);
 void HtpBodyPrune(HtpBody *);
+uint8_t *HtpBodyGetWindow(HtpBody *, HtpBodyChunk *, uint32_t *);
 
 #endif /* __APP_LAYER_HTP_BODY_H__ */
@@ -238,6 +238,209 @@ error:
     SCReturnPtr(NULL, "void");
 }
 
+/**
+ * \brief Get the user data of a transaction, allocating it if the tx
+ *        has none yet.
+ *
+ * \retval htud user data or NULL on allocation failure
+ */
+HtpTxUserData *HtpTxUserDataGet(htp_tx_t *tx)
+{
+    HtpTxUserData *htud = (HtpTxUserData *) htp_tx_get_user_data(tx);
+    if (htud == NULL) {
+        htud = SCMalloc(sizeof(HtpTxUserData));
+        if (unlikely(htud == NULL))
+            return NULL;
+        memset(htud, 0, sizeof(HtpTxUserData));
+
+        htp_tx_set_user_data(tx, htud);
+    }
+    return htud;
+}
+
+/**
+ * \brief Free the user data of a transaction: body chunks, multipart
+ *        boundary and the inspection buffers.
+ */
+void HtpTxUserDataFree(HtpTxUserData *htud)
+{
+    HtpBodyFree(&htud->request_body);
+    HtpBodyFree(&htud->response_body);
+
+    if (htud->boundary != NULL)
+        SCFree(htud->boundary);
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        if (htud->inspect[i].headers != NULL)
+            SCFree(htud->inspect[i].headers);
+    }
+    SCFree(htud);
+}
+
+/** \internal
+ *  \brief cookies are inspected by http_cookie, not by http_header */
+static int HtpHeaderIsCookie(htp_header_t *h, uint8_t flags)
+{
+    size_t len = bstr_size(h->name);
+
+    if (flags & STREAM_TOSERVER) {
+        return (len == 6 &&
+                SCMemcmpLowercase("cookie", bstr_ptr(h->name), 6) == 0);
+    } else {
+        return (len == 10 &&
+                SCMemcmpLowercase("set-cookie", bstr_ptr(h->name), 10) == 0);
+    }
+}
+
+/** \internal
+ *  \brief Get the inspection cache of one direction of a tx, (re)building
+ *         it if the headers changed since it was last built.
+ *
+ *  Once the tx progressed past the headers of the direction the cache is
+ *  final and returned as is.
+ *
+ *  \retval c cache or NULL on allocation failure
+ */
+static HtpTxInspectCache *HtpTxInspectCacheGet(htp_tx_t *tx, uint8_t flags)
+{
+    HtpTxUserData *htud = HtpTxUserDataGet(tx);
+    if (htud == NULL)
+        return NULL;
+
+    HtpTxInspectCache *c = &htud->inspect[(flags & STREAM_TOSERVER) ? 0 : 1];
+    if (c->flags & HTP_INSPECT_CACHE_FINAL)
+        return c;
+
+    table_t *headers;
+    int complete;
+    if (flags & STREAM_TOSERVER) {
+        headers = tx->request_headers;
+        complete = (tx->progress > TX_PROGRESS_REQ_HEADERS);
+    } else {
+        headers = tx->response_headers;
+        complete = (tx->progress > TX_PROGRESS_RES_HEADERS);
+    }
+    if (headers == NULL)
+        return c;
+
+    /* size the buffer first. Headers are only added or extended while
+     * they are parsed, so if neither the count nor the size changed the
+     * buffer is still current. */
+    htp_header_t *h = NULL;
+    uint32_t cnt = 0;
+    uint64_t len = 0;
+
+    table_iterator_reset(headers);
+    while (table_iterator_next(headers, (void **)&h) != NULL) {
+        cnt++;
+        if (HtpHeaderIsCookie(h, flags))
+            continue;
+
+        /* the extra 4 bytes if for ": " and "\r\n" */
+        len += bstr_size(h->name) + bstr_size(h->value) + 4;
+    }
+    if (len > UINT32_MAX)
+        return NULL;
+
+    if (cnt != c->headers_cnt || len != c->headers_len) {
+        if (len > c->headers_size) {
+            uint8_t *buf = SCRealloc(c->headers, (size_t)len);
+            if (buf == NULL) {
+                c->headers_len = 0;
+                c->headers_cnt = 0;
+                return NULL;
+            }
+            c->headers = buf;
+            c->headers_size = (uint32_t)len;
+        }
+
+        uint32_t off = 0;
+        table_iterator_reset(headers);
+        while (table_iterator_next(headers, (void **)&h) != NULL) {
+            if (HtpHeaderIsCookie(h, flags))
+                continue;
+
+            size_t size1 = bstr_size(h->name);
+            size_t size2 = bstr_size(h->value);
+
+            memcpy(c->headers + off, bstr_ptr(h->name), size1);
+            off += size1;
+            c->headers[off++] = ':';
+            c->headers[off++] = ' ';
+            memcpy(c->headers + off, bstr_ptr(h->value), size2);
+            off += size2;
+            c->headers[off++] = '\r';
+            c->headers[off++] = '\n';
+        }
+        c->headers_len = off;
+        c->headers_cnt = cnt;
+    }
+
+    if (flags & STREAM_TOSERVER) {
+        c->cookie = (htp_header_t *)table_getc(headers, "Cookie");
+        c->user_agent = (htp_header_t *)table_getc(headers, "User-Agent");
+    } else {
+        c->cookie = (htp_header_t *)table_getc(headers, "Set-Cookie");
+    }
+
+    if (complete)
+        c->flags |= HTP_INSPECT_CACHE_FINAL;
+    return c;
+}
+
+/**
+ * \brief Get the normalized header buffer of a tx for http_header
+ *        inspection: all headers except the cookies as "name: value\r\n".
+ *
+ * The buffer is owned by the tx and shared by all detection threads and
+ * engines, the flow needs to be locked.
+ *
+ * \param tx transaction
+ * \param flags STREAM_TOSERVER or STREAM_TOCLIENT
+ * \param buffer_len set to the length of the buffer, 0 if there is none
+ *
+ * \retval buffer or NULL
+ */
+uint8_t *HtpTxGetHeadersBuffer(htp_tx_t *tx, uint8_t flags,
+                               uint32_t *buffer_len)
+{
+    *buffer_len = 0;
+
+    HtpTxInspectCache *c = HtpTxInspectCacheGet(tx, flags);
+    if (c == NULL || c->headers_len == 0)
+        return NULL;
+
+    *buffer_len = c->headers_len;
+    return c->headers;
+}
+
+/**
+ * \brief Get the Cookie (request) or Set-Cookie (response) header of a tx
+ *
+ * \retval h header or NULL if the tx doesn't have it
+ */
+htp_header_t *HtpTxGetCookieHeader(htp_tx_t *tx, uint8_t flags)
+{
+    HtpTxInspectCache *c = HtpTxInspectCacheGet(tx, flags);
+    if (c == NULL)
+        return NULL;
+    return c->cookie;
+}
+
+/**
+ * \brief Get the User-Agent header of the request of a tx
+ *
+ * \retval h header or NULL if the tx doesn't have it
+ */
+htp_header_t *HtpTxGetUserAgentHeader(htp_tx_t *tx)
+{
+    HtpTxInspectCache *c = HtpTxInspectCacheGet(tx, STREAM_TOSERVER);
+    if (c == NULL)
+        return NULL;
+    return c->user_agent;
+}
+
 /** \brief Function to frees the HTTP state memory and also frees the HTTP
  *         connection parser memory which was used by the HTP library
  */
@@ -265,9 +468,7 @@ void HTPStateFree(void *state)
                 if (tx != NULL) {
                     HtpTxUserData *htud = (HtpTxUserData *) htp_tx_get_user_data(tx);
                     if (htud != NULL) {
-                        HtpBodyFree(&htud->request_body);
-                        HtpBodyFree(&htud->response_body);
-                        SCFree(htud);
+                        HtpTxUserDataFree(htud);
                         htp_tx_set_user_data(tx, NULL);
                     }
                 }
@@ -1230,7 +1431,10 @@ static void HtpRequestBodyMultipartParseHeader(HtpState *hstate,
 }
 
 /**
- *  \brief Create a single buffer from the HtpBodyChunks in our list
+ *  \brief Get a single buffer of the body data not parsed yet
+ *
+ *  The chunks are stored back to back in the body arena, so the buffer
+ *  points into it. It's valid until the next append or prune.
  *
  *  \param htud transaction user data
  *  \param chunks_buffers pointer to pass back the buffer to the caller
@@ -1243,41 +1447,21 @@ static void HtpRequestBodyReassemble(HtpTxUserData *htud,
     uint32_t buf_len = 0;
     HtpBodyChunk *cur = htud->request_body.first;
 
-    for ( ; cur != NULL; cur = cur->next) {
-        SCLogDebug("chunk %p", cur);
-
-        /* skip body chunks entirely before what we parsed already */
-        if (cur->stream_offset + cur->len <= htud->request_body.body_parsed) {
-            SCLogDebug("skipping chunk");
-            continue;
-        }
-
-        SCLogDebug("cur->stream_offset %"PRIu64", cur->len %"PRIu32", body_parsed %"PRIu64,
-            cur->stream_offset, cur->len, htud->request_body.body_parsed);
+    /* skip body chunks entirely before what we parsed already */
+    while (cur != NULL &&
+            cur->stream_offset + cur->len <= htud->request_body.body_parsed) {
+        SCLogDebug("skipping chunk");
+        cur = cur->next;
+    }
 
-        if (cur->stream_offset < htud->request_body.body_parsed &&
-                cur->stream_offset + cur->len >= htud->request_body.body_parsed) {
-            SCLogDebug("use part");
+    if (cur != NULL) {
+        buf = HtpBodyGetWindow(&htud->request_body, cur, &buf_len);
 
+        /* use part of the first chunk */
+        if (cur->stream_offset < htud->request_body.body_parsed) {
             uint32_t toff = htud->request_body.body_parsed - cur->stream_offset;
-            uint32_t tlen = (cur->stream_offset + cur->len) - htud->request_body.body_parsed;
-
-            buf_len += tlen;
-            if ((buf = SCRealloc(buf, buf_len)) == NULL) {
-                buf_len = 0;
-                break;
-            }
-            memcpy(buf + buf_len - tlen, cur->data + toff, tlen);
-
-        } else {
-            SCLogDebug("use entire chunk");
-
-            buf_len += cur->len;
-            if ((buf = SCRealloc(buf, buf_len)) == NULL) {
-                buf_len = 0;
-                break;
-            }
-            memcpy(buf + buf_len - cur->len, cur->data, cur->len);
+            buf += toff;
+            buf_len -= toff;
         }
     }
 
@@ -1782,13 +1966,12 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *d)
     SCLogDebug("New request body data available at %p -> %p -> %p, bodylen "
                "%"PRIu32"", hstate, d, d->data, (uint32_t)d->len);
 
-    HtpTxUserData *htud = (HtpTxUserData *) htp_tx_get_user_data(d->tx);
-    if (htud == NULL) {
-        htud = SCMalloc(sizeof(HtpTxUserData));
-        if (unlikely(htud == NULL)) {
-            SCReturnInt(HOOK_OK);
-        }
-        memset(htud, 0, sizeof(HtpTxUserData));
+    HtpTxUserData *htud = HtpTxUserDataGet(d->tx);
+    if (unlikely(htud == NULL)) {
+        SCReturnInt(HOOK_OK);
+    }
+    if (!(htud->tsflags & HTP_BODY_SETUP)) {
+        htud->tsflags |= HTP_BODY_SETUP;
         htud->operation = HTP_BODY_REQUEST;
 
         if (d->tx->request_method_number == M_POST) {
@@ -1805,9 +1988,6 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *d)
                 htud->request_body_type = HTP_BODY_REQUEST_PUT;
             }
         }
-
-        /* Set the user data for handling body chunks on this transaction */
-        htp_tx_set_user_data(d->tx, htud);
     }
 
     SCLogDebug("htud->request_body.content_len_so_far %"PRIu64, htud->request_body.content_len_so_far);
@@ -1857,10 +2037,6 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *d)
 #endif
 
             HtpRequestBodyHandleMultipart(hstate, htud, chunks_buffer, chunks_buffer_len);
-
-            if (chunks_buffer != NULL) {
-                SCFree(chunks_buffer);
-            }
         } else if (htud->request_body_type == HTP_BODY_REQUEST_POST) {
             HtpRequestBodyHandlePOST(hstate, htud, d->tx, (uint8_t *)d->data, (uint32_t)d->len);
         } else if (htud->request_body_type == HTP_BODY_REQUEST_PUT) {
@@ -1899,21 +2075,17 @@ int HTPCallbackResponseBodyData(htp_tx_data_t *d)
     SCLogDebug("New response body data available at %p -> %p -> %p, bodylen "
                "%"PRIu32"", hstate, d, d->data, (uint32_t)d->len);
 
-    HtpTxUserData *htud = (HtpTxUserData *) htp_tx_get_user_data(d->tx);
-    if (htud == NULL) {
-        htud = SCMalloc(sizeof(HtpTxUserData));
-        if (unlikely(htud == NULL)) {
-            SCReturnInt(HOOK_OK);
-        }
-        memset(htud, 0, sizeof(HtpTxUserData));
+    HtpTxUserData *htud = HtpTxUserDataGet(d->tx);
+    if (unlikely(htud == NULL)) {
+        SCReturnInt(HOOK_OK);
+    }
+    if (!(htud->tcflags & HTP_BODY_SETUP)) {
+        htud->tcflags |= HTP_BODY_SETUP;
         htud->operation = HTP_BODY_RESPONSE;
 
         htp_header_t *cl = table_getc(d->tx->response_headers, "content-length");
         if (cl != NULL)
             htud->response_body.content_len = htp_parse_content_length(cl->value);
-
-        /* Set the user data for handling body chunks on this transaction */
-        htp_tx_set_user_data(d->tx, htud);
     }
 
     SCLogDebug("htud->response_body.content_len_so_far %"PRIu64, htud->response_body.content_len_so_far);
@@ -2068,9 +2240,7 @@ static int HTPCallbackResponse(htp_connp_t *connp) {
         /* This will remove obsolete body chunks */
         HtpTxUserData *htud = (HtpTxUserData *) htp_tx_get_user_data(tx);
         if (htud != NULL) {
-            HtpBodyFree(&htud->request_body);
-            HtpBodyFree(&htud->response_body);
-            SCFree(htud);
+            HtpTxUserDataFree(htud);
             htp_tx_set_user_data(tx, NULL);
         }
 
@@ -2587,6 +2757,97 @@ end:
     return result;
 }
 
+/** \test the inspection cache is rebuilt while the request headers come
+ *        in and is final once they are complete */
+static int HTPInspectCacheTest01(void)
+{
+    int result = 0;
+    Flow *f = NULL;
+    uint8_t httpbuf1[] = "GET / HTTP/1.1\r\nHost: www.a.com\r\nCookie: x=1\r\n";
+    uint32_t httplen1 = sizeof(httpbuf1) - 1; /* minus the \0 */
+    uint8_t httpbuf2[] = "User-Agent: UA\r\n\r\n";
+    uint32_t httplen2 = sizeof(httpbuf2) - 1; /* minus the \0 */
+    uint8_t expected[] = "Host: www.a.com\r\nUser-Agent: UA\r\n";
+    TcpSession ssn;
+    HtpState *htp_state =  NULL;
+    uint32_t len = 0;
+    uint8_t *buf;
+
+    memset(&ssn, 0, sizeof(ssn));
+
+    f = UTHBuildFlow(AF_INET, "1.2.3.4", "1.2.3.5", 1024, 80);
+    if (f == NULL)
+        goto end;
+    f->protoctx = &ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    if (AppLayerParse(NULL, f, ALPROTO_HTTP, STREAM_TOSERVER|STREAM_START,
+                      httpbuf1, httplen1) != 0) {
+        printf("toserver chunk 1 returned error: ");
+        goto end;
+    }
+
+    htp_state = f->alstate;
+    if (htp_state == NULL) {
+        printf("no http state: ");
+        goto end;
+    }
+
+    htp_tx_t *tx = list_get(htp_state->connp->conn->transactions, 0);
+    if (tx == NULL) {
+        printf("no tx: ");
+        goto end;
+    }
+
+    buf = HtpTxGetHeadersBuffer(tx, STREAM_TOSERVER, &len);
+    HtpTxUserData *htud = (HtpTxUserData *)htp_tx_get_user_data(tx);
+    if (htud == NULL || (htud->inspect[0].flags & HTP_INSPECT_CACHE_FINAL)) {
+        printf("cache missing or final before the headers are complete: ");
+        goto end;
+    }
+
+    if (AppLayerParse(NULL, f, ALPROTO_HTTP, STREAM_TOSERVER,
+                      httpbuf2, httplen2) != 0) {
+        printf("toserver chunk 2 returned error: ");
+        goto end;
+    }
+
+    buf = HtpTxGetHeadersBuffer(tx, STREAM_TOSERVER, &len);
+    if (buf == NULL || len != sizeof(expected) - 1 ||
+        memcmp(buf, expected, len) != 0) {
+        printf("unexpected header buffer: ");
+        goto end;
+    }
+    if (!(htud->inspect[0].flags & HTP_INSPECT_CACHE_FINAL)) {
+        printf("cache not final: ");
+        goto end;
+    }
+
+    htp_header_t *h = HtpTxGetCookieHeader(tx, STREAM_TOSERVER);
+    if (h == NULL || bstr_cmpc(h->value, "x=1") != 0) {
+        printf("cookie header not found: ");
+        goto end;
+    }
+    h = HtpTxGetUserAgentHeader(tx);
+    if (h == NULL || bstr_cmpc(h->value, "UA") != 0) {
+        printf("user agent header not found: ");
+        goto end;
+    }
+    if (HtpTxGetCookieHeader(tx, STREAM_TOCLIENT) != NULL) {
+        printf("response has no headers yet: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    if (htp_state != NULL)
+        HTPStateFree(htp_state);
+    UTHFreeFlow(f);
+    return result;
+}
+
 /** \test See how it deals with an incomplete request. */
 int HTPParserTest02(void) {
     int result = 1;
@@ -4710,6 +4971,82 @@ end:
     return result;
 }
 
+/** \test body arena: chunks are stored back to back, survive the arena
+ *        growing and the compaction after pruning */
+static int HTPBodyArenaTest01(void)
+{
+    int result = 0;
+    HtpTxUserData htud;
+    memset(&htud, 0x00, sizeof(htud));
+    HtpBody *body = &htud.request_body;
+    uint8_t chunk[1000];
+    uint32_t i, len;
+
+    /* 10 chunks of 1000 bytes, each filled with its index, grows the
+     * arena past its initial size */
+    for (i = 0; i < 10; i++) {
+        memset(chunk, 'a' + i, sizeof(chunk));
+        if (HtpBodyAppendChunk(&htud, body, chunk, sizeof(chunk)) != 0)
+            goto end;
+    }
+
+    uint8_t *buf = HtpBodyGetWindow(body, body->first, &len);
+    if (buf == NULL || len != 10000) {
+        printf("window len %u, expected 10000: ", len);
+        goto end;
+    }
+    for (i = 0; i < len; i++) {
+        if (buf[i] != 'a' + i / 1000) {
+            printf("byte %u is %c: ", i, buf[i]);
+            goto end;
+        }
+    }
+
+    /* prune the first 8 chunks */
+    body->body_parsed = 8000;
+    body->body_inspected = 8000;
+    HtpBodyPrune(body);
+    if (body->first == NULL || body->first->stream_offset != 8000 ||
+        body->buf_start != 8000) {
+        printf("prune failed: ");
+        goto end;
+    }
+    uint32_t size = body->buf_size;
+
+    /* appending reuses the pruned space instead of growing the arena */
+    for (i = 10; i < 17; i++) {
+        memset(chunk, 'a' + i, sizeof(chunk));
+        if (HtpBodyAppendChunk(&htud, body, chunk, sizeof(chunk)) != 0)
+            goto end;
+    }
+    if (body->buf_size != size || body->buf_start != 0) {
+        printf("arena not compacted: size %u (was %u), start %u: ",
+               body->buf_size, size, body->buf_start);
+        goto end;
+    }
+
+    HtpBodyChunk *cur;
+    uint64_t offset = 8000;
+    for (cur = body->first; cur != NULL; cur = cur->next) {
+        if (cur->stream_offset != offset || cur->data[0] != 'a' + offset / 1000 ||
+            cur->data[cur->len - 1] != 'a' + offset / 1000) {
+            printf("chunk at %"PRIu64" wrong: ", offset);
+            goto end;
+        }
+        offset += cur->len;
+    }
+    buf = HtpBodyGetWindow(body, body->first, &len);
+    if (len != 9000 || buf != body->buf) {
+        printf("window len %u, expected 9000: ", len);
+        goto end;
+    }
+
+    result = 1;
+end:
+    HtpBodyFree(body);
+    return result;
+}
+
 /** \test BG crash */
 static int HTPSegvTest01(void) {
     int result = 0;
@@ -4795,6 +5132,7 @@ end:
 void HTPParserRegisterTests(void) {
 #ifdef UNITTESTS
     UtRegisterTest("HTPParserTest01", HTPParserTest01, 1);
+    UtRegisterTest("HTPInspectCacheTest01", HTPInspectCacheTest01, 1);
     UtRegisterTest("HTPParserTest02", HTPParserTest02, 1);
     UtRegisterTest("HTPParserTest03", HTPParserTest03, 1);
     UtRegisterTest("HTPParserTest04", HTPParserTest04, 1);
@@ -4819,6 +5157,7 @@ void HTPParserRegisterTests(void) {
     UtRegisterTest("HTPParserDecodingTest05", HTPParserDecodingTest05, 1);
 
     UtRegisterTest("HTPBodyReassemblyTest01", HTPBodyReassemblyTest01, 1);
+    UtRegisterTest("HTPBodyArenaTest01", HTPBodyArenaTest01, 1);
 
     UtRegisterTest("HTPSegvTest01", HTPSegvTest01, 1);
 
@@ -145,7 +145,8 @@ typedef struct HTPCfgRec_ {
 
 /** Struct used to hold chunks of a body on a request */
 struct HtpBodyChunk_ {
-    uint8_t *data;              /**< Pointer to the data of the chunk */
+    uint8_t *data;              /**< Pointer to the data of the chunk, in
+                                     the body arena */
     struct HtpBodyChunk_ *next; /**< Pointer to the next chunk */
     uint64_t stream_offset;
     uint32_t len;               /**< Length of the chunk */
@@ -157,6 +158,14 @@ typedef struct HtpBody_ {
     HtpBodyChunk *first; /**< Pointer to the first chunk */
     HtpBodyChunk *last;  /**< Pointer to the last chunk */
 
+    /* arena holding the data of the chunks back to back, in stream order */
+    uint8_t *buf;
+    uint32_t buf_size;
+    /* start of the data of the first chunk, space before it is pruned */
+    uint32_t buf_start;
+    /* end of the data of the last chunk */
+    uint32_t buf_end;
+
     /* Holds the length of the htp request body */
     uint64_t content_len;
     /* Holds the length of the htp request body seen so far */
@@ -175,6 +184,7 @@ typedef struct HtpBody_ {
 #define HTP_BOUNDARY_OPEN       0x10    /**< We have a boundary string */
 #define HTP_FILENAME_SET        0x20    /**< filename is registered in the flow */
 #define HTP_DONTSTORE           0x40    /**< not storing this file */
+#define HTP_BODY_SETUP          0x80    /**< body type and length are set up */
 
 #define HTP_TX_HAS_FILE             0x01
 #define HTP_TX_HAS_FILENAME         0x02    /**< filename is known at this time */
@@ -186,6 +196,25 @@ typedef struct HtpBody_ {
 #define HTP_RULE_NEED_TYPE          HTP_TX_HAS_TYPE
 #define HTP_RULE_NEED_FILECONTENT   HTP_TX_HAS_FILECONTENT
 
+#define HTP_INSPECT_CACHE_FINAL     0x01    /**< headers are complete, the
+                                                 cache won't change anymore */
+
+/** Inspection buffers of one direction of a transaction, shared by the
+ *  detection engines. Until the headers are complete the buffers are
+ *  rebuilt whenever a new header was added. */
+typedef struct HtpTxInspectCache_ {
+    uint8_t *headers;           /**< normalized headers for http_header */
+    uint32_t headers_len;
+    uint32_t headers_size;
+    /** number of headers the cache was built from */
+    uint32_t headers_cnt;
+
+    htp_header_t *cookie;       /**< Cookie or Set-Cookie header */
+    htp_header_t *user_agent;   /**< User-Agent header, request only */
+
+    uint8_t flags;
+} HtpTxInspectCache;
+
 /** Now the Body Chunks will be stored per transaction, at
   * the tx user data */
 typedef struct HtpTxUserData_ {
@@ -207,6 +236,8 @@ typedef struct HtpTxUserData_ {
     uint8_t request_body_type;
     uint8_t response_body_type;
 
+    /** inspection buffers, 0 is the request, 1 the response */
+    HtpTxInspectCache inspect[2];
 } HtpTxUserData;
 
 typedef struct HtpState_ {
@@ -246,6 +277,11 @@ int HTPCallbackRequestBodyData(htp_tx_data_t *);
 int HtpTransactionGetLoggableId(Flow *);
 void HtpBodyPrint(HtpBody *);
 void HtpBodyFree(HtpBody *);
+HtpTxUserData *HtpTxUserDataGet(htp_tx_t *);
+void HtpTxUserDataFree(HtpTxUserData *);
+uint8_t *HtpTxGetHeadersBuffer(htp_tx_t *, uint8_t, uint32_t *);
+htp_header_t *HtpTxGetCookieHeader(htp_tx_t *, uint8_t);
+htp_header_t *HtpTxGetUserAgentHeader(htp_tx_t *);
 /* To free the state from unittests using app-layer-htp */
 void HTPStateFree(void *);
 void AppLayerHtpEnableRequestBodyCallback(void);
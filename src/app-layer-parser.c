@@ -687,6 +687,13 @@ void AppLayerRegisterLogger(uint16_t proto) {
     al_proto_table[proto].logger = TRUE;
 }
 
+/** \brief Indicate to the app layer parser that the eve-log output logs
+ *         transactions of this protocol.
+ */
+void AppLayerRegisterEveLogger(uint16_t proto) {
+    al_proto_table[proto].eve_logger = TRUE;
+}
+
 
 AppLayerParserStateStore *AppLayerParserStateStoreAlloc(void)
 {
@@ -830,14 +837,17 @@ static int AppLayerTransactionsCleanup(AppLayerProto *p, AppLayerParserStateStor
         goto end;
     }
 
-    if (p->logger == TRUE) {
-        uint16_t low = (parser_state_store->logged_id < parser_state_store->inspect_id) ?
-            parser_state_store->logged_id : parser_state_store->inspect_id;
+    if (p->logger == TRUE || p->eve_logger == TRUE) {
+        uint16_t low = parser_state_store->inspect_id;
+        if (p->logger == TRUE && parser_state_store->logged_id < low)
+            low = parser_state_store->logged_id;
+        if (p->eve_logger == TRUE && parser_state_store->eve_logged_id < low)
+            low = parser_state_store->eve_logged_id;
 
         obsolete = low - parser_state_store->base_id;
 
-        SCLogDebug("low %"PRIu16" (logged %"PRIu16", inspect %"PRIu16"), base_id %"PRIu16", obsolete %"PRIu16", avail_id %"PRIu16,
-                low, parser_state_store->logged_id, parser_state_store->inspect_id, parser_state_store->base_id, obsolete, parser_state_store->avail_id);
+        SCLogDebug("low %"PRIu16" (logged %"PRIu16", eve logged %"PRIu16", inspect %"PRIu16"), base_id %"PRIu16", obsolete %"PRIu16", avail_id %"PRIu16,
+                low, parser_state_store->logged_id, parser_state_store->eve_logged_id, parser_state_store->inspect_id, parser_state_store->base_id, obsolete, parser_state_store->avail_id);
     } else {
         obsolete = parser_state_store->inspect_id - parser_state_store->base_id;
     }
@@ -1183,6 +1193,42 @@ error:
     SCReturnInt(-1);
 }
 
+/** \brief mark the next transaction as logged by the eve-log output */
+void AppLayerTransactionUpdateEveLoggedId(Flow *f) {
+    SCEnter();
+
+    DEBUG_ASSERT_FLOW_LOCKED(f);
+
+    AppLayerParserStateStore *parser_state_store =
+        (AppLayerParserStateStore *)f->alparser;
+
+    if (parser_state_store == NULL) {
+        SCLogDebug("no state store");
+        SCReturn;
+    }
+
+    parser_state_store->eve_logged_id++;
+    SCReturn;
+}
+
+/** \brief get the number of transactions logged by the eve-log output
+ *  \retval -1 no state store */
+int AppLayerTransactionGetEveLoggedId(Flow *f) {
+    SCEnter();
+
+    DEBUG_ASSERT_FLOW_LOCKED(f);
+
+    AppLayerParserStateStore *parser_state_store =
+        (AppLayerParserStateStore *)f->alparser;
+
+    if (parser_state_store == NULL) {
+        SCLogDebug("no state store");
+        SCReturnInt(-1);
+    }
+
+    SCReturnInt((int)parser_state_store->eve_logged_id);
+}
+
 /**
  *  \brief get the version of the state in a direction
  *
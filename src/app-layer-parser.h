@@ -45,6 +45,7 @@ typedef struct AppLayerProto_ {
     uint16_t to_client;
     uint16_t map_size;
     char logger; /**< does this proto have a logger enabled? */
+    char eve_logger; /**< is this proto logged by the eve-log output? */
 
     AppLayerLocalMap **map;
 
@@ -120,6 +121,9 @@ typedef struct AppLayerParserStateStore_ {
     /** the highest id of logged state's (i.e. http transactions), updated by
      *  a logging module throught the app layer API */
     uint16_t logged_id;
+    /** the highest id of state's logged by the eve-log output, which keeps
+     *  its own position so it can run next to the text loggers */
+    uint16_t eve_logged_id;
     /** the higest id of available state's, updated by the app layer parser */
     uint16_t avail_id;
     /** the base id signifies the id number of the oldest id we have in our
@@ -261,6 +265,7 @@ void *AppLayerGetProtocolParserLocalStorage(ThreadVars *, uint16_t);
 void AppLayerRegisterGetFilesFunc(uint16_t proto,
         FileContainer *(*StateGetFile)(void *, uint8_t));
 void AppLayerRegisterLogger(uint16_t proto);
+void AppLayerRegisterEveLogger(uint16_t proto);
 uint16_t AppLayerGetProtoByName(const char *);
 const char *AppLayerGetProtoString(int proto);
 void AppLayerRegisterTruncateFunc(uint16_t proto, void (*Truncate)(void *, uint8_t));
@@ -282,6 +287,8 @@ int AppLayerTransactionUpdateInspectId(Flow *, char);
 void AppLayerTransactionUpdateLoggedId(Flow *);
 int AppLayerTransactionGetLoggableId(Flow *f);
 int AppLayerTransactionGetLoggedId(Flow *f);
+void AppLayerTransactionUpdateEveLoggedId(Flow *);
+int AppLayerTransactionGetEveLoggedId(Flow *f);
 int AppLayerTransactionGetBaseId(Flow *f);
 int AppLayerTransactionGetInspectId(Flow *f);
 uint16_t AppLayerTransactionGetAvailId(Flow *f);
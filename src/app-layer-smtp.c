@@ -42,6 +42,7 @@
 #include "util-byte.h"
 #include "util-unittest-helper.h"
 #include "util-memcmp.h"
+#include "util-line.h"
 #include "flow-util.h"
 
 #include "detect-engine.h"
@@ -113,11 +114,6 @@ SCEnumCharMap smtp_decoder_event_table[ ] = {
     { NULL,                      -1 },
 };
 
-#define SMTP_MPM MPM_AC
-
-static MpmCtx *smtp_mpm_ctx = NULL;
-MpmThreadCtx *smtp_mpm_thread_ctx;
-
 /* smtp reply codes.  If an entry is made here, please make a simultaneous
  * entry in smtp_reply_map */
 enum {
@@ -180,6 +176,14 @@ SCEnumCharMap smtp_reply_map[ ] = {
     { "555", SMTP_REPLY_555 },
     {  NULL,  -1 },
 };
+
+/** reply code lookup, indexed by the numeric value of the 3 digit code.
+ *  Holds the SMTP_REPLY_* value + 1, 0 for codes not in smtp_reply_map. */
+static uint8_t smtp_reply_code_table[1000];
+
+/** max length of a command, reply or data line, excluding the CRLF */
+static uint32_t smtp_max_line_len = LINE_BUFFER_DEFAULT_MAX_LEN;
+
 //static void SMTPParserReset(void)
 //{
 //    return;
@@ -187,209 +191,43 @@ SCEnumCharMap smtp_reply_map[ ] = {
 
 /**
  * \internal
- * \brief Get the next line from input.  It doesn't do any length validation.
+ * \brief Get the next line from input. Lines longer than
+ *        app-layer.smtp.max-line-length are truncated and set an event.
  *
  * \param state The smtp state.
+ * \param f flow to set the event on.
  *
  * \retval  0 On suceess.
  * \retval -1 Either when we don't have any new lines to supply anymore or
  *            on failure.
  */
-static int SMTPGetLine(SMTPState *state)
+static int SMTPGetLine(SMTPState *state, Flow *f)
 {
     SCEnter();
 
-    /* we have run out of input */
-    if (state->input_len <= 0)
+    /* fragmented lines.  Decoder event for special cases.  Not all
+     * fragmented lines should be treated as a possible evasion
+     * attempt.  With multi payload smtp chunks we can have valid
+     * cases of fragmentation.  But within the same segment chunk
+     * if we see fragmentation then it's definitely something you
+     * should alert about */
+    LineBuffer *lb = (state->direction == 0) ? &state->ts_lb : &state->tc_lb;
+    LineSpan span;
+
+    if (LineBufferGetLine(lb, smtp_max_line_len, &state->input,
+                          &state->input_len, &span) < 0)
         return -1;
 
-    /* toserver */
-    if (state->direction == 0) {
-        if (state->ts_current_line_lf_seen == 1) {
-            /* we have seen the lf for the previous line.  Clear the parser
-             * details to parse new line */
-            state->ts_current_line_lf_seen = 0;
-            if (state->ts_current_line_db == 1) {
-                state->ts_current_line_db = 0;
-                SCFree(state->ts_db);
-                state->ts_db = NULL;
-                state->ts_db_len = 0;
-                state->current_line = NULL;
-                state->current_line_len = 0;
-            }
-        }
-
-        uint8_t *lf_idx = memchr(state->input, 0x0a, state->input_len);
-
-        if (lf_idx == NULL) {
-            /* fragmented lines.  Decoder event for special cases.  Not all
-             * fragmented lines should be treated as a possible evasion
-             * attempt.  With multi payload smtp chunks we can have valid
-             * cases of fragmentation.  But within the same segment chunk
-             * if we see fragmentation then it's definitely something you
-             * should alert about */
-            if (state->ts_current_line_db == 0) {
-                state->ts_db = SCMalloc(state->input_len);
-                if (state->ts_db == NULL) {
-                    return -1;
-                }
-                state->ts_current_line_db = 1;
-                memcpy(state->ts_db, state->input, state->input_len);
-                state->ts_db_len = state->input_len;
-            } else {
-                state->ts_db = SCRealloc(state->ts_db, (state->ts_db_len +
-                                                        state->input_len));
-                if (state->ts_db == NULL) {
-                    return -1;
-                }
-                memcpy(state->ts_db + state->ts_db_len,
-                       state->input, state->input_len);
-                state->ts_db_len += state->input_len;
-            } /* else */
-            state->input += state->input_len;
-            state->input_len = 0;
-
-            return -1;
-
-        } else {
-            state->ts_current_line_lf_seen = 1;
-
-            if (state->ts_current_line_db == 1) {
-                state->ts_db = SCRealloc(state->ts_db,
-                                         (state->ts_db_len +
-                                          (lf_idx + 1 - state->input)));
-                if (state->ts_db == NULL) {
-                    return -1;
-                }
-                memcpy(state->ts_db + state->ts_db_len,
-                       state->input, (lf_idx + 1 - state->input));
-                state->ts_db_len += (lf_idx + 1 - state->input);
-
-                if (state->ts_db_len > 1 &&
-                    state->ts_db[state->ts_db_len - 2] == 0x0D) {
-                    state->ts_db_len -= 2;
-                    state->current_line_delimiter_len = 2;
-                } else {
-                    state->ts_db_len -= 1;
-                    state->current_line_delimiter_len = 1;
-                }
-
-                state->current_line = state->ts_db;
-                state->current_line_len = state->ts_db_len;
-
-            } else {
-                state->current_line = state->input;
-                state->current_line_len = lf_idx - state->input;
-
-                if (state->input != lf_idx &&
-                    *(lf_idx - 1) == 0x0D) {
-                    state->current_line_len--;
-                    state->current_line_delimiter_len = 2;
-                } else {
-                    state->current_line_delimiter_len = 1;
-                }
-            }
-
-            state->input_len -= (lf_idx - state->input) + 1;
-            state->input = (lf_idx + 1);
-
-            return 0;
-        }
-
-        /* toclient */
-    } else {
-        if (state->tc_current_line_lf_seen == 1) {
-            /* we have seen the lf for the previous line.  Clear the parser
-             * details to parse new line */
-            state->tc_current_line_lf_seen = 0;
-            if (state->tc_current_line_db == 1) {
-                state->tc_current_line_db = 0;
-                SCFree(state->tc_db);
-                state->tc_db = NULL;
-                state->tc_db_len = 0;
-                state->current_line = NULL;
-                state->current_line_len = 0;
-            }
-        }
-
-        uint8_t *lf_idx = memchr(state->input, 0x0a, state->input_len);
-
-        if (lf_idx == NULL) {
-            /* fragmented lines.  Decoder event for special cases.  Not all
-             * fragmented lines should be treated as a possible evasion
-             * attempt.  With multi payload smtp chunks we can have valid
-             * cases of fragmentation.  But within the same segment chunk
-             * if we see fragmentation then it's definitely something you
-             * should alert about */
-            if (state->tc_current_line_db == 0) {
-                state->tc_db = SCMalloc(state->input_len);
-                if (state->tc_db == NULL) {
-                    return -1;
-                }
-                state->tc_current_line_db = 1;
-                memcpy(state->tc_db, state->input, state->input_len);
-                state->tc_db_len = state->input_len;
-            } else {
-                state->tc_db = SCRealloc(state->tc_db, (state->tc_db_len +
-                                                        state->input_len));
-                if (state->tc_db == NULL) {
-                    return -1;
-                }
-                memcpy(state->tc_db + state->tc_db_len,
-                       state->input, state->input_len);
-                state->tc_db_len += state->input_len;
-            } /* else */
-            state->input += state->input_len;
-            state->input_len = 0;
-
-            return -1;
-
-        } else {
-            state->tc_current_line_lf_seen = 1;
-
-            if (state->tc_current_line_db == 1) {
-                state->tc_db = SCRealloc(state->tc_db,
-                                         (state->tc_db_len +
-                                          (lf_idx + 1 - state->input)));
-                if (state->tc_db == NULL) {
-                    return -1;
-                }
-                memcpy(state->tc_db + state->tc_db_len,
-                       state->input, (lf_idx + 1 - state->input));
-                state->tc_db_len += (lf_idx + 1 - state->input);
-
-                if (state->tc_db_len > 1 &&
-                    state->tc_db[state->tc_db_len - 2] == 0x0D) {
-                    state->tc_db_len -= 2;
-                    state->current_line_delimiter_len = 2;
-                } else {
-                    state->tc_db_len -= 1;
-                    state->current_line_delimiter_len = 1;
-                }
-
-                state->current_line = state->tc_db;
-                state->current_line_len = state->tc_db_len;
-
-            } else {
-                state->current_line = state->input;
-                state->current_line_len = lf_idx - state->input;
-
-                if (state->input != lf_idx &&
-                    *(lf_idx - 1) == 0x0D) {
-                    state->current_line_len--;
-                    state->current_line_delimiter_len = 2;
-                } else {
-                    state->current_line_delimiter_len = 1;
-                }
-            }
-
-            state->input_len -= (lf_idx - state->input) + 1;
-            state->input = (lf_idx + 1);
-
-            return 0;
-        } /* else - if (lf_idx == NULL) */
+    if (span.truncated) {
+        AppLayerDecoderEventsSetEvent(f, (state->direction == 0) ?
+                SMTP_DECODER_EVENT_MAX_COMMAND_LINE_LEN_EXCEEDED :
+                SMTP_DECODER_EVENT_MAX_REPLY_LINE_LEN_EXCEEDED);
     }
 
+    state->current_line = span.line;
+    state->current_line_len = (int32_t)span.len;
+    state->current_line_delimiter_len = span.delim_len;
+    return 0;
 }
 
 static int SMTPInsertCommandIntoCommandBuffer(uint8_t command, SMTPState *state, Flow *f)
@@ -488,7 +326,6 @@ static int SMTPProcessReply(SMTPState *state, Flow *f,
     SCEnter();
 
     uint64_t reply_code = 0;
-    PatternMatcherQueue *pmq = state->thread_local_data;
 
     /* the reply code has to contain at least 3 bytes, to hold the 3 digit
      * reply code */
@@ -515,13 +352,14 @@ static int SMTPProcessReply(SMTPState *state, Flow *f,
         }
     }
 
-    /* I don't like this pmq reset here.  We'll devise a method later, that
-     * should make the use of the mpm very efficient */
-    PmqReset(pmq);
-    int mpm_cnt = mpm_table[SMTP_MPM].Search(smtp_mpm_ctx, smtp_mpm_thread_ctx,
-                                             pmq, state->current_line,
-                                             3);
-    if (mpm_cnt == 0) {
+    uint8_t reply_idx = 0;
+    if (isdigit(state->current_line[0]) && isdigit(state->current_line[1]) &&
+        isdigit(state->current_line[2])) {
+        reply_idx = smtp_reply_code_table[(state->current_line[0] - '0') * 100 +
+                                          (state->current_line[1] - '0') * 10 +
+                                          (state->current_line[2] - '0')];
+    }
+    if (reply_idx == 0) {
         /* set decoder event - reply code invalid */
         AppLayerDecoderEventsSetEvent(f,
                                       SMTP_DECODER_EVENT_INVALID_REPLY);
@@ -529,7 +367,7 @@ static int SMTPProcessReply(SMTPState *state, Flow *f,
                 state->current_line[0], state->current_line[1], state->current_line[2]);
         SCReturnInt(-1);
     }
-    reply_code = smtp_reply_map[pmq->pattern_id_array[0]].enum_value;
+    reply_code = reply_idx - 1;
 
     if (state->cmds_idx == state->cmds_cnt) {
         /* decoder event - unable to match reply with request */
@@ -628,6 +466,35 @@ static int SMTPParseCommandBDAT(SMTPState *state)
     return 0;
 }
 
+/**
+ * \internal
+ * \brief Get the command of a request line.  Only the commands needed for
+ *        state transitions are recognized.  The first letter selects the
+ *        only candidate, so at most one compare is done per line.
+ */
+static uint8_t SMTPGetCommand(uint8_t *line, int32_t line_len)
+{
+    if (line_len < 4)
+        return SMTP_COMMAND_OTHER_CMD;
+
+    switch (u8_tolower(line[0])) {
+        case 's':
+            if (line_len >= 8 && SCMemcmpLowercase("starttls", line, 8) == 0)
+                return SMTP_COMMAND_STARTTLS;
+            break;
+        case 'd':
+            if (SCMemcmpLowercase("data", line, 4) == 0)
+                return SMTP_COMMAND_DATA;
+            break;
+        case 'b':
+            if (SCMemcmpLowercase("bdat", line, 4) == 0)
+                return SMTP_COMMAND_BDAT;
+            break;
+    }
+
+    return SMTP_COMMAND_OTHER_CMD;
+}
+
 static int SMTPProcessRequest(SMTPState *state, Flow *f,
                               AppLayerParserState *pstate)
 {
@@ -638,22 +505,14 @@ static int SMTPProcessRequest(SMTPState *state, Flow *f,
     if (!(state->parser_state & SMTP_PARSER_STATE_COMMAND_DATA_MODE)) {
         int r = 0;
 
-        if (state->current_line_len >= 8 &&
-            SCMemcmpLowercase("starttls", state->current_line, 8) == 0) {
-            state->current_command = SMTP_COMMAND_STARTTLS;
-        } else if (state->current_line_len >= 4 &&
-                   SCMemcmpLowercase("data", state->current_line, 4) == 0) {
-            state->current_command = SMTP_COMMAND_DATA;
-        } else if (state->current_line_len >= 4 &&
-                   SCMemcmpLowercase("bdat", state->current_line, 4) == 0) {
+        state->current_command = SMTPGetCommand(state->current_line,
+                                                state->current_line_len);
+        if (state->current_command == SMTP_COMMAND_BDAT) {
             r = SMTPParseCommandBDAT(state);
             if (r == -1) {
                 SCReturnInt(-1);
             }
-            state->current_command = SMTP_COMMAND_BDAT;
             state->parser_state |= SMTP_PARSER_STATE_COMMAND_DATA_MODE;
-        } else {
-            state->current_command = SMTP_COMMAND_OTHER_CMD;
         }
 
         /* Every command is inserted into a command buffer, to be matched
@@ -686,25 +545,24 @@ static int SMTPProcessRequest(SMTPState *state, Flow *f,
 static int SMTPParse(int direction, Flow *f, SMTPState *state,
                      AppLayerParserState *pstate, uint8_t *input,
                      uint32_t input_len,
-                     PatternMatcherQueue *local_data, AppLayerParserResult *output)
+                     void *local_data, AppLayerParserResult *output)
 {
     SCEnter();
 
     state->input = input;
     state->input_len = input_len;
     state->direction = direction;
-    state->thread_local_data = local_data;
 
     /* toserver */
     if (direction == 0) {
-        while (SMTPGetLine(state) >= 0) {
+        while (SMTPGetLine(state, f) >= 0) {
             if (SMTPProcessRequest(state, f, pstate) == -1)
                 SCReturnInt(-1);
         }
 
         /* toclient */
     } else {
-        while (SMTPGetLine(state) >= 0) {
+        while (SMTPGetLine(state, f) >= 0) {
             if (SMTPProcessReply(state, f, pstate) == -1)
                 SCReturnInt(-1);
         }
@@ -761,29 +619,6 @@ static void *SMTPStateAlloc(void)
     return smtp_state;
 }
 
-static void *SMTPLocalStorageAlloc(ThreadVars *tv)
-{
-    /* needed by the mpm */
-    PatternMatcherQueue *pmq = SCMalloc(sizeof(PatternMatcherQueue));
-    if (unlikely(pmq == NULL)) {
-        exit(EXIT_FAILURE);
-    }
-    PmqSetup(tv, pmq, 0,
-             sizeof(smtp_reply_map)/sizeof(SCEnumCharMap) - 2);
-
-    return pmq;
-}
-
-static void SMTPLocalStorageFree(void *pmq)
-{
-    if (pmq != NULL) {
-        PmqFree(pmq);
-        SCFree(pmq);
-    }
-
-    return;
-}
-
 /**
  * \internal
  * \brief Function to free SMTP state memory.
@@ -795,51 +630,29 @@ static void SMTPStateFree(void *p)
     if (smtp_state->cmds != NULL) {
         SCFree(smtp_state->cmds);
     }
-    if (smtp_state->ts_current_line_db) {
-        SCFree(smtp_state->ts_db);
-    }
-    if (smtp_state->tc_current_line_db) {
-        SCFree(smtp_state->tc_db);
-    }
+    LineBufferFree(&smtp_state->ts_lb);
+    LineBufferFree(&smtp_state->tc_lb);
 
     SCFree(smtp_state);
 
     return;
 }
 
-static void SMTPSetMpmState(void)
+/**
+ * \internal
+ * \brief Fill the reply code lookup table from smtp_reply_map.
+ */
+static void SMTPSetReplyCodeTable(void)
 {
-    ThreadVars *tv = NULL;
-
-    smtp_mpm_ctx = SCMalloc(sizeof(MpmCtx));
-    if (unlikely(smtp_mpm_ctx == NULL)) {
-        exit(EXIT_FAILURE);
-    }
-    memset(smtp_mpm_ctx, 0, sizeof(MpmCtx));
-
-    smtp_mpm_thread_ctx = SCMalloc(sizeof(MpmThreadCtx));
-    if (unlikely(smtp_mpm_thread_ctx == NULL)) {
-        exit(EXIT_FAILURE);
-    }
-    memset(smtp_mpm_thread_ctx, 0, sizeof(MpmThreadCtx));
-
-    mpm_table[SMTP_MPM].InitCtx(smtp_mpm_ctx, -1);
-    mpm_table[SMTP_MPM].InitThreadCtx(tv, smtp_mpm_ctx, smtp_mpm_thread_ctx, 0);
-
     uint32_t i = 0;
     for (i = 0; i < sizeof(smtp_reply_map)/sizeof(SCEnumCharMap) - 1; i++) {
         SCEnumCharMap *map = &smtp_reply_map[i];
-        mpm_table[SMTP_MPM].AddPatternNocase(smtp_mpm_ctx,
-                                             (uint8_t *)map->enum_name,
-                                             3 /* reply codes always 3 bytes */,
-                                             0 /* now defunct option */,
-                                             0 /* now defunct option */,
-                                             i /* pattern id */,
-                                             0 /* no sid */,
-                                             0 /* no flags */);
+        /* reply codes always 3 digits */
+        int code = (map->enum_name[0] - '0') * 100 +
+                   (map->enum_name[1] - '0') * 10 +
+                   (map->enum_name[2] - '0');
+        smtp_reply_code_table[code] = (uint8_t)(map->enum_value + 1);
     }
-
-    mpm_table[SMTP_MPM].Prepare(smtp_mpm_ctx);
 }
 
 /**
@@ -849,6 +662,8 @@ void RegisterSMTPParsers(void)
 {
     char *proto_name = "smtp";
 
+    smtp_max_line_len = LineBufferConfGetMaxLen("app-layer.smtp.max-line-length");
+
     AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_SMTP, "EHLO", 4, 0,
                 STREAM_TOSERVER);
     AlpProtoAdd(&alp_proto_ctx, proto_name, IPPROTO_TCP, ALPROTO_SMTP, "HELO", 4, 0,
@@ -862,10 +677,7 @@ void RegisterSMTPParsers(void)
                           SMTPParseServerRecord);
     AppLayerDecoderEventsModuleRegister(ALPROTO_SMTP, smtp_decoder_event_table);
 
-    AppLayerRegisterLocalStorageFunc(ALPROTO_SMTP, SMTPLocalStorageAlloc,
-                                     SMTPLocalStorageFree);
-
-    SMTPSetMpmState();
+    SMTPSetReplyCodeTable();
 
     return;
 }
@@ -958,9 +770,8 @@ int SMTPParserTest01(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -980,7 +791,7 @@ int SMTPParserTest01(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -995,7 +806,7 @@ int SMTPParserTest01(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1009,7 +820,7 @@ int SMTPParserTest01(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1024,7 +835,7 @@ int SMTPParserTest01(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply2, reply2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1050,7 +861,6 @@ int SMTPParserTest01(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -1300,9 +1110,8 @@ int SMTPParserTest02(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1322,7 +1131,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1337,7 +1146,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1351,7 +1160,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1366,7 +1175,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply2, reply2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1380,7 +1189,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request3, request3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1395,7 +1204,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply3, reply3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1409,7 +1218,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request4, request4_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1424,7 +1233,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply4, reply4_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1439,7 +1248,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5_1, request5_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1455,7 +1264,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5_2, request5_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1471,7 +1280,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5_3, request5_3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1487,7 +1296,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5_4, request5_4_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1503,7 +1312,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5_5, request5_5_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1518,7 +1327,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply5, reply5_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1532,7 +1341,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request6, request6_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1547,7 +1356,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply6, reply6_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1561,7 +1370,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request7, request7_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1576,7 +1385,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply7, reply7_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1590,7 +1399,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request8, request8_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1605,7 +1414,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply8, reply8_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1620,7 +1429,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request9_1, request9_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1636,7 +1445,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request9_2, request9_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1652,7 +1461,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request9_3, request9_3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1668,7 +1477,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request9_4, request9_4_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1684,7 +1493,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request9_5, request9_5_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1699,7 +1508,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply9, reply9_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1713,7 +1522,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request10, request10_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1728,7 +1537,7 @@ int SMTPParserTest02(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply10, reply10_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1746,7 +1555,6 @@ int SMTPParserTest02(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -1846,9 +1654,8 @@ int SMTPParserTest03(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1868,7 +1675,7 @@ int SMTPParserTest03(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1883,7 +1690,7 @@ int SMTPParserTest03(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1897,7 +1704,7 @@ int SMTPParserTest03(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1914,7 +1721,7 @@ int SMTPParserTest03(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply2, reply2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1933,7 +1740,6 @@ int SMTPParserTest03(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -1977,9 +1783,8 @@ int SMTPParserTest04(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -1999,7 +1804,7 @@ int SMTPParserTest04(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2018,7 +1823,6 @@ int SMTPParserTest04(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2117,9 +1921,8 @@ int SMTPParserTest05(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2139,7 +1942,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2154,7 +1957,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2168,7 +1971,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2183,7 +1986,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply2, reply2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2204,7 +2007,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request3, request3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2219,7 +2022,7 @@ int SMTPParserTest05(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply3, reply3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2237,7 +2040,6 @@ int SMTPParserTest05(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2391,9 +2193,8 @@ int SMTPParserTest06(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2413,7 +2214,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       welcome_reply, welcome_reply_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2428,7 +2229,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2442,7 +2243,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2457,7 +2258,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply2, reply2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2471,7 +2272,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request3, request3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2486,7 +2287,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply3, reply3_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2500,7 +2301,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request4, request4_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2518,7 +2319,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request5, request5_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2535,7 +2336,7 @@ int SMTPParserTest06(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request6, request6_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2555,7 +2356,6 @@ int SMTPParserTest06(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2598,9 +2398,8 @@ int SMTPParserTest07(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_1, request1_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2613,39 +2412,35 @@ int SMTPParserTest07(void)
     }
     if (smtp_state->current_line != NULL ||
         smtp_state->current_line_len != 0 ||
-        smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != request1_1_len ||
-        memcmp(smtp_state->ts_db, request1_1, request1_1_len) != 0) {
+        smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != request1_1_len ||
+        memcmp(smtp_state->ts_lb.buf, request1_1, request1_1_len) != 0) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_2, request1_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != (int32_t)strlen(request1_str) ||
-        memcmp(smtp_state->ts_db, request1_str, strlen(request1_str)) != 0 ||
-        smtp_state->current_line != smtp_state->ts_db ||
-        smtp_state->current_line_len != smtp_state->ts_db_len) {
+    if (smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != (int32_t)strlen(request1_str) ||
+        memcmp(smtp_state->ts_lb.buf, request1_str, strlen(request1_str)) != 0 ||
+        smtp_state->current_line != smtp_state->ts_lb.buf ||
+        smtp_state->current_line_len != (int32_t)smtp_state->ts_lb.len) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 0 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+    if (smtp_state->ts_lb.len != 0 ||
         smtp_state->current_line == NULL ||
         smtp_state->current_line_len != (int32_t)strlen(request1_str) ||
         memcmp(smtp_state->current_line, request1_str, strlen(request1_str)) != 0) {
@@ -2657,7 +2452,6 @@ int SMTPParserTest07(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2700,9 +2494,8 @@ int SMTPParserTest08(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_1, request1_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2715,39 +2508,35 @@ int SMTPParserTest08(void)
     }
     if (smtp_state->current_line != NULL ||
         smtp_state->current_line_len != 0 ||
-        smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != request1_1_len ||
-        memcmp(smtp_state->ts_db, request1_1, request1_1_len) != 0) {
+        smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != request1_1_len ||
+        memcmp(smtp_state->ts_lb.buf, request1_1, request1_1_len) != 0) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_2, request1_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != (int32_t)strlen(request1_str) ||
-        memcmp(smtp_state->ts_db, request1_str, strlen(request1_str)) != 0 ||
-        smtp_state->current_line != smtp_state->ts_db ||
-        smtp_state->current_line_len != smtp_state->ts_db_len) {
+    if (smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != (int32_t)strlen(request1_str) ||
+        memcmp(smtp_state->ts_lb.buf, request1_str, strlen(request1_str)) != 0 ||
+        smtp_state->current_line != smtp_state->ts_lb.buf ||
+        smtp_state->current_line_len != (int32_t)smtp_state->ts_lb.len) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 0 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+    if (smtp_state->ts_lb.len != 0 ||
         smtp_state->current_line == NULL ||
         smtp_state->current_line_len != (int32_t)strlen(request1_str) ||
         memcmp(smtp_state->current_line, request1_str, strlen(request1_str)) != 0) {
@@ -2759,7 +2548,6 @@ int SMTPParserTest08(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2802,9 +2590,8 @@ int SMTPParserTest09(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_1, request1_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2817,39 +2604,35 @@ int SMTPParserTest09(void)
     }
     if (smtp_state->current_line != NULL ||
         smtp_state->current_line_len != 0 ||
-        smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != request1_1_len ||
-        memcmp(smtp_state->ts_db, request1_1, request1_1_len) != 0) {
+        smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != request1_1_len ||
+        memcmp(smtp_state->ts_lb.buf, request1_1, request1_1_len) != 0) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_2, request1_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != (int32_t)strlen(request1_str) ||
-        memcmp(smtp_state->ts_db, request1_str, strlen(request1_str)) != 0 ||
-        smtp_state->current_line != smtp_state->ts_db ||
-        smtp_state->current_line_len != smtp_state->ts_db_len) {
+    if (smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != (int32_t)strlen(request1_str) ||
+        memcmp(smtp_state->ts_lb.buf, request1_str, strlen(request1_str)) != 0 ||
+        smtp_state->current_line != smtp_state->ts_lb.buf ||
+        smtp_state->current_line_len != (int32_t)smtp_state->ts_lb.len) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 0 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+    if (smtp_state->ts_lb.len != 0 ||
         smtp_state->current_line == NULL ||
         smtp_state->current_line_len != (int32_t)strlen(request1_str) ||
         memcmp(smtp_state->current_line, request1_str, strlen(request1_str)) != 0) {
@@ -2861,7 +2644,6 @@ int SMTPParserTest09(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -2904,9 +2686,8 @@ int SMTPParserTest10(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_1, request1_1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -2919,39 +2700,35 @@ int SMTPParserTest10(void)
     }
     if (smtp_state->current_line != NULL ||
         smtp_state->current_line_len != 0 ||
-        smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != request1_1_len ||
-        memcmp(smtp_state->ts_db, request1_1, request1_1_len) != 0) {
+        smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != request1_1_len ||
+        memcmp(smtp_state->ts_lb.buf, request1_1, request1_1_len) != 0) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1_2, request1_2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 1 ||
-        smtp_state->ts_db == NULL ||
-        smtp_state->ts_db_len != (int32_t)strlen(request1_str) ||
-        memcmp(smtp_state->ts_db, request1_str, strlen(request1_str)) != 0 ||
-        smtp_state->current_line != smtp_state->ts_db ||
-        smtp_state->current_line_len != smtp_state->ts_db_len) {
+    if (smtp_state->ts_lb.buf == NULL ||
+        (int32_t)smtp_state->ts_lb.len != (int32_t)strlen(request1_str) ||
+        memcmp(smtp_state->ts_lb.buf, request1_str, strlen(request1_str)) != 0 ||
+        smtp_state->current_line != smtp_state->ts_lb.buf ||
+        smtp_state->current_line_len != (int32_t)smtp_state->ts_lb.len) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 0 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+    if (smtp_state->ts_lb.len != 0 ||
         smtp_state->current_line == NULL ||
         smtp_state->current_line_len != (int32_t)strlen(request2_str) ||
         memcmp(smtp_state->current_line, request2_str, strlen(request2_str)) != 0) {
@@ -2963,7 +2740,6 @@ int SMTPParserTest10(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -3000,9 +2776,8 @@ int SMTPParserTest11(void)
     f.protoctx = (void *)&ssn;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request1, request1_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
@@ -3015,23 +2790,19 @@ int SMTPParserTest11(void)
     }
     if (smtp_state->current_line == NULL ||
         smtp_state->current_line_len != 0 ||
-        smtp_state->ts_current_line_db == 1 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+        smtp_state->ts_lb.len != 0 ||
         memcmp(smtp_state->current_line, request1_str, strlen(request1_str)) != 0) {
         printf("smtp parser in inconsistent state\n");
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("smtp check returned %" PRId32 ", expected 0: ", r);
         goto end;
     }
-    if (smtp_state->ts_current_line_db != 0 ||
-        smtp_state->ts_db != NULL ||
-        smtp_state->ts_db_len != 0 ||
+    if (smtp_state->ts_lb.len != 0 ||
         smtp_state->current_line == NULL ||
         smtp_state->current_line_len != (int32_t)strlen(request2_str) ||
         memcmp(smtp_state->current_line, request2_str, strlen(request2_str)) != 0) {
@@ -3043,7 +2814,6 @@ int SMTPParserTest11(void)
 end:
     StreamTcpFreeConfig(TRUE);
     FLOW_DESTROY(&f);
-    SMTPLocalStorageFree(thread_local_data);
     return result;
 }
 
@@ -3089,7 +2859,6 @@ int SMTPParserTest12(void)
     f.alproto = ALPROTO_SMTP;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
     de_ctx = DetectEngineCtxInit();
     if (de_ctx == NULL)
@@ -3107,7 +2876,7 @@ int SMTPParserTest12(void)
     SigGroupBuild(de_ctx);
     DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER | STREAM_START,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER | STREAM_START,
                       request1, request1_len);
     if (r != 0) {
         printf("AppLayerParse for smtp failed.  Returned %" PRId32, r);
@@ -3128,7 +2897,7 @@ int SMTPParserTest12(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT | STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT | STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r == 0) {
         printf("AppLayerParse for smtp failed.  Returned %" PRId32, r);
@@ -3153,7 +2922,6 @@ end:
     DetectEngineCtxFree(de_ctx);
 
     StreamTcpFreeConfig(TRUE);
-    SMTPLocalStorageFree(thread_local_data);
     FLOW_DESTROY(&f);
     UTHFreePackets(&p, 1);
     return result;
@@ -3219,7 +2987,6 @@ int SMTPParserTest13(void)
     f.alproto = ALPROTO_SMTP;
 
     StreamTcpInitConfig(TRUE);
-    void *thread_local_data = SMTPLocalStorageAlloc();
 
     de_ctx = DetectEngineCtxInit();
     if (de_ctx == NULL)
@@ -3238,7 +3005,7 @@ int SMTPParserTest13(void)
     SigGroupBuild(de_ctx);
     DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER | STREAM_START,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER | STREAM_START,
                       request1, request1_len);
     if (r != 0) {
         printf("AppLayerParse for smtp failed.  Returned %" PRId32, r);
@@ -3259,7 +3026,7 @@ int SMTPParserTest13(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOCLIENT,
                       reply1, reply1_len);
     if (r != 0) {
         printf("AppLayerParse for smtp failed.  Returned %" PRId32, r);
@@ -3274,7 +3041,7 @@ int SMTPParserTest13(void)
         goto end;
     }
 
-    r = AppLayerParse(thread_local_data, &f, ALPROTO_SMTP, STREAM_TOSERVER,
+    r = AppLayerParse(NULL, &f, ALPROTO_SMTP, STREAM_TOSERVER,
                       request2, request2_len);
     if (r != 0) {
         printf("AppLayerParse for smtp failed.  Returned %" PRId32, r);
@@ -3299,7 +3066,6 @@ end:
     DetectEngineCtxFree(de_ctx);
 
     StreamTcpFreeConfig(TRUE);
-    SMTPLocalStorageFree(thread_local_data);
     FLOW_DESTROY(&f);
     UTHFreePackets(&p, 1);
     return result;
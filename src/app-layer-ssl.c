@@ -394,6 +394,23 @@ static int SSLv2ParseRecord(uint8_t direction, SSLState *ssl_state,
     return (input - initial_input);
 }
 
+/**
+ * \internal
+ * \brief Stop parsing and inspecting a session once both sides encrypt.
+ *
+ *        Everything the tls keywords and the tls log use comes from the
+ *        handshake, so there is nothing left to do for the app layer.
+ *        Reassembly is disabled as well, unless tls.no-reassemble is set
+ *        to no to keep raw stream inspection of the encrypted data.
+ */
+static void SSLSetEncrypted(AppLayerParserState *pstate)
+{
+    pstate->flags |= APP_LAYER_PARSER_DONE;
+    pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
+    if (ssl_config.no_reassemble == 1)
+        pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+}
+
 static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
                        AppLayerParserState *pstate, uint8_t *input,
                        uint32_t input_len)
@@ -579,10 +596,7 @@ static int SSLv2Decode(uint8_t direction, SSLState *ssl_state,
 
                 if ((ssl_state->flags & SSL_AL_FLAG_SSL_CLIENT_SSN_ENCRYPTED) &&
                     (ssl_state->flags & SSL_AL_FLAG_SSL_SERVER_SSN_ENCRYPTED)) {
-                    pstate->flags |= APP_LAYER_PARSER_DONE;
-                    pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
-                    if (ssl_config.no_reassemble == 1)
-                        pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+                    SSLSetEncrypted(pstate);
                     SCLogDebug("SSLv2 No reassembly & inspection has been set");
                 }
             }
@@ -646,6 +660,14 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
             else
                 ssl_state->flags |= SSL_AL_FLAG_CLIENT_CHANGE_CIPHER_SPEC;
 
+            /* the handshake is done, don't wait for the first application
+             * data record to stop parsing */
+            if ((ssl_state->flags & SSL_AL_FLAG_CLIENT_CHANGE_CIPHER_SPEC) &&
+                (ssl_state->flags & SSL_AL_FLAG_SERVER_CHANGE_CIPHER_SPEC)) {
+                SSLSetEncrypted(pstate);
+                SCLogDebug("SSLv3 No reassembly & inspection has been set");
+            }
+
             break;
 
         case SSLV3_ALERT_PROTOCOL:
@@ -653,11 +675,7 @@ static int SSLv3Decode(uint8_t direction, SSLState *ssl_state,
         case SSLV3_APPLICATION_PROTOCOL:
             if ((ssl_state->flags & SSL_AL_FLAG_CLIENT_CHANGE_CIPHER_SPEC) &&
                 (ssl_state->flags & SSL_AL_FLAG_SERVER_CHANGE_CIPHER_SPEC)) {
-                /* set flags */
-                pstate->flags |= APP_LAYER_PARSER_DONE;
-                pstate->flags |= APP_LAYER_PARSER_NO_INSPECTION;
-                if (ssl_config.no_reassemble == 1)
-                    pstate->flags |= APP_LAYER_PARSER_NO_REASSEMBLY;
+                SSLSetEncrypted(pstate);
             }
 
             break;
@@ -3144,6 +3162,70 @@ end:
     return result;
 }
 
+/**
+ * \test Parsing and reassembly stop once both sides sent their change
+ *       cipher spec, without waiting for application data.
+ */
+static int SSLParserTest25(void)
+{
+    int result = 0;
+    Flow f;
+    uint8_t ccsbuf[] = { 0x14, 0x03, 0x01, 0x00, 0x01, 0x01 };
+    uint32_t ccslen = sizeof(ccsbuf);
+    TcpSession ssn;
+
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+
+    StreamTcpInitConfig(TRUE);
+
+    int r = AppLayerParse(NULL, &f, ALPROTO_TLS, STREAM_TOSERVER, ccsbuf, ccslen);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+
+    if (f.flags & FLOW_NOPAYLOAD_INSPECTION) {
+        printf("inspection disabled after the client ccs: ");
+        goto end;
+    }
+
+    r = AppLayerParse(NULL, &f, ALPROTO_TLS, STREAM_TOCLIENT, ccsbuf, ccslen);
+    if (r != 0) {
+        printf("toclient chunk 1 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+
+    AppLayerParserStateStore *parser_state_store =
+        (AppLayerParserStateStore *)f.alparser;
+    AppLayerParserState *parser_state = &parser_state_store->to_client;
+    if (!(parser_state->flags & APP_LAYER_PARSER_DONE) ||
+        !(parser_state->flags & APP_LAYER_PARSER_NO_INSPECTION) ||
+        !(parser_state->flags & APP_LAYER_PARSER_NO_REASSEMBLY)) {
+        printf("parser flags not set: ");
+        goto end;
+    }
+
+    if (!(ssn.client.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY) ||
+        !(ssn.server.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY)) {
+        printf("reassembly not disabled: ");
+        goto end;
+    }
+
+    if (!(f.flags & FLOW_NOPAYLOAD_INSPECTION)) {
+        printf("payload inspection not disabled: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void SSLParserRegisterTests(void)
@@ -3175,6 +3257,7 @@ void SSLParserRegisterTests(void)
     UtRegisterTest("SSLParserTest22", SSLParserTest22, 1);
     UtRegisterTest("SSLParserTest23", SSLParserTest23, 1);
     UtRegisterTest("SSLParserTest24", SSLParserTest24, 1);
+    UtRegisterTest("SSLParserTest25", SSLParserTest25, 1);
 
     UtRegisterTest("SSLParserMultimsgTest01", SSLParserMultimsgTest01, 1);
     UtRegisterTest("SSLParserMultimsgTest02", SSLParserMultimsgTest02, 1);
@@ -29,6 +29,7 @@
 #include "app-layer-detect-proto.h"
 #include "stream-tcp-reassemble.h"
 #include "stream-tcp-private.h"
+#include "stream-tcp-inline.h"
 #include "flow.h"
 #include "flow-util.h"
 
@@ -98,6 +99,29 @@ void *AppLayerGetProtoStateFromFlow(Flow *f) {
 /** global app layer detection context */
 extern AlpProtoDetectCtx alp_proto_ctx;
 
+/**
+ *  \brief Get the number of bytes of a direction that have been handed to
+ *         proto detection so far.
+ *
+ *  While detection runs ra_app_base_seq is not moved, so the bytes up to
+ *  the end of what the reassembly can pass on (last_ack in IDS mode,
+ *  next_seq inline) are what detection has inspected.
+ *
+ *  \param ssn TCP Session
+ *  \param flags STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ *  \retval bytes number of bytes
+ */
+static uint32_t AppLayerDetectProtoBytes(TcpSession *ssn, uint8_t flags)
+{
+    TcpStream *stream = (flags & STREAM_TOSERVER) ? &ssn->client : &ssn->server;
+    uint32_t end = StreamTcpInlineMode() ? stream->next_seq : stream->last_ack;
+
+    if (SEQ_LEQ(end, stream->ra_app_base_seq + 1))
+        return 0;
+    return end - (stream->ra_app_base_seq + 1);
+}
+
 /**
  *  \brief Handle a chunk of TCP data
  *
@@ -154,6 +178,11 @@ int AppLayerHandleTCPData(AlpProtoDetectThreadCtx *dp_ctx, Flow *f,
                     data, data_len, flags, IPPROTO_TCP);
             PACKET_PROFILING_APP_PD_END(dp_ctx);
 
+            uint16_t *detect_cnt = (flags & STREAM_TOSERVER) ?
+                &ssn->alproto_detect_ts_cnt : &ssn->alproto_detect_tc_cnt;
+            if (*detect_cnt < UINT16_MAX)
+                (*detect_cnt)++;
+
             if (f->alproto != ALPROTO_UNKNOWN) {
                 ssn->flags |= STREAMTCP_FLAG_APPPROTO_DETECTION_COMPLETED;
 
@@ -165,6 +194,16 @@ int AppLayerHandleTCPData(AlpProtoDetectThreadCtx *dp_ctx, Flow *f,
                     (f->flags & FLOW_TC_PM_PP_ALPROTO_DETECT_DONE)) {
                     FlowSetSessionNoApplayerInspectionFlag(f);
                     ssn->flags |= STREAMTCP_FLAG_APPPROTO_DETECTION_COMPLETED;
+                    AlpProtoDetectCounterIncr(dp_ctx, counter_alproto_unknown);
+                } else if (AlpProtoDetectBudgetExceeded(&alp_proto_ctx,
+                            *detect_cnt, AppLayerDetectProtoBytes(ssn, flags))) {
+                    /* don't keep retrying on ever growing data for a
+                     * protocol we don't know */
+                    SCLogDebug("ALPROTO_UNKNOWN flow %p, detection budget "
+                            "exceeded", f);
+                    FlowSetSessionNoApplayerInspectionFlag(f);
+                    ssn->flags |= STREAMTCP_FLAG_APPPROTO_DETECTION_COMPLETED;
+                    AlpProtoDetectCounterIncr(dp_ctx, counter_alproto_budget);
                 }
             }
         } else {
@@ -328,6 +367,7 @@ int AppLayerHandleUdp(AlpProtoDetectThreadCtx *dp_ctx, Flow *f, Packet *p)
         } else {
             f->flags |= FLOW_ALPROTO_DETECT_DONE;
             SCLogDebug("ALPROTO_UNKNOWN flow %p", f);
+            AlpProtoDetectCounterIncr(dp_ctx, counter_alproto_unknown);
         }
     } else {
         SCLogDebug("stream data (len %" PRIu32 " ), alproto "
@@ -34,6 +34,7 @@
 #include "util-debug.h"
 #include "util-privs.h"
 #include "util-signal.h"
+#include "util-latency.h"
 #include "unix-manager.h"
 
 /** \todo Get the default log directory from some global resource. */
@@ -50,6 +51,29 @@ static uint32_t sc_counter_tts = SC_PERF_MGMTT_TTS;
 static char sc_counter_enabled = TRUE;
 /** append or overwrite? 1: append, 0: overwrite */
 static char sc_counter_append = TRUE;
+/** lockless mode: packet threads never sync their counters, the outputs
+ *  read the thread local values directly */
+static char sc_counter_lockless = FALSE;
+
+/* A local counter has a single writer, its own thread. Readers outside of
+ * that thread only need a value that isn't torn, so a relaxed load does. */
+#ifdef __ATOMIC_RELAXED
+#define SC_PERF_LOAD_RELAXED(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#else
+#define SC_PERF_LOAD_RELAXED(ptr) (*(volatile typeof(*(ptr)) *)(ptr))
+#endif
+
+/**
+ * \brief A counter value read from a thread's local counter array
+ */
+typedef struct SCPerfSnapshotEntry_ {
+    const char *cname;
+    const char *tm_name;
+    const char *tv_name;
+    uint32_t type;
+    uint64_t ui64;
+    double d;
+} SCPerfSnapshotEntry;
 
 /**
  * \brief Adds a value of type uint64_t to the local counter.
@@ -160,6 +184,46 @@ void SCPerfCounterIncr(uint16_t id, SCPerfCounterArray *pca)
     return;
 }
 
+/**
+ * \brief Increments a set of local uint64 counters in one call. Meant for
+ *        hot paths that know upfront which counters a packet touches, so
+ *        that the NULL and type checks of SCPerfCounterIncr() are done
+ *        once instead of once per counter.
+ *
+ * \param ids Array of counter ids. Ids that are not registered are skipped.
+ * \param cnt Number of ids in the array
+ * \param pca Counter array that holds the local counters for this TM
+ */
+void SCPerfCounterIncrMulti(const uint16_t *ids, uint16_t cnt,
+                            SCPerfCounterArray *pca)
+{
+    uint16_t i;
+
+    if (pca == NULL) {
+        SCLogDebug("counterarray is NULL");
+        return;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        uint16_t id = ids[i];
+        if ((id < 1) || (id > pca->size))
+            continue;
+
+        if (likely(pca->head[id].pc->value->type == SC_PERF_TYPE_UINT64))
+            pca->head[id].ui64_cnt++;
+        else
+            pca->head[id].d_cnt++;
+
+        if (pca->head[id].syncs == ULONG_MAX) {
+            pca->head[id].syncs = 0;
+            pca->head[id].wrapped_syncs++;
+        }
+        pca->head[id].syncs++;
+    }
+
+    return;
+}
+
 /**
  * \brief Sets a value of type double to the local counter
  *
@@ -337,6 +401,10 @@ static void SCPerfInitOPCtx(void)
         const char *append = ConfNodeLookupChildValue(stats, "append");
         if (append != NULL)
             sc_counter_append = ConfValIsTrue(append);
+
+        const char *lockless = ConfNodeLookupChildValue(stats, "lockless");
+        if (lockless != NULL)
+            sc_counter_lockless = ConfValIsTrue(lockless);
     }
 
     /* Store the engine start time */
@@ -1025,6 +1093,332 @@ static void SCPerfOutputCalculateCounterValue(SCPerfCounter *pc, void *cvalue_op
     return;
 }
 
+/**
+ * \brief Reads the current value of a thread's local counter without
+ *        involving the thread. Timebased counters are skipped, they only
+ *        have a meaning after a sync.
+ *
+ * \param pcae Local counter
+ * \param e    Entry to fill in
+ *
+ * \retval 1 value read
+ * \retval 0 counter skipped
+ */
+static int SCPerfReadLocalCounter(SCPCAElem *pcae, SCPerfSnapshotEntry *e)
+{
+    SCPerfCounter *pc = pcae->pc;
+    uint64_t raw = 0;
+    uint64_t syncs = 1;
+
+    if (pc == NULL || pc->disp == 0 || pc->value == NULL ||
+        (pc->type_q->type & SC_PERF_TYPE_Q_TIMEBASED))
+        return 0;
+
+    /* ui64_cnt and d_cnt share storage, load the bits once */
+    raw = SC_PERF_LOAD_RELAXED(&pcae->ui64_cnt);
+    if (pc->type_q->type & SC_PERF_TYPE_Q_AVERAGE) {
+        syncs = SC_PERF_LOAD_RELAXED(&pcae->syncs);
+        if (syncs == 0)
+            syncs = 1;
+    }
+
+    switch (pc->value->type) {
+        case SC_PERF_TYPE_UINT64:
+            e->ui64 = raw / syncs;
+            break;
+        case SC_PERF_TYPE_DOUBLE:
+            memcpy(&e->d, &raw, sizeof(e->d));
+            e->d /= syncs;
+            break;
+        default:
+            return 0;
+    }
+
+    e->cname = pc->name->cname;
+    e->tm_name = pc->name->tm_name;
+    e->type = pc->value->type;
+    return 1;
+}
+
+/**
+ * \brief Adds the local counters of one thread to a snapshot
+ *
+ * \retval the number of entries in use after adding
+ */
+static uint32_t SCPerfSnapshotThread(ThreadVars *tv,
+                                     SCPerfSnapshotEntry *entries,
+                                     uint32_t cnt, uint32_t size)
+{
+    SCPerfCounterArray *pca = tv->sc_perf_pca;
+    uint32_t i;
+
+    if (pca == NULL)
+        return cnt;
+
+    for (i = 1; i <= pca->size && cnt < size; i++) {
+        if (SCPerfReadLocalCounter(&pca->head[i], &entries[cnt])) {
+            entries[cnt].tv_name = tv->name;
+            cnt++;
+        }
+    }
+    return cnt;
+}
+
+/**
+ * \brief Reads the local counters of all threads. Only tv_root_lock is
+ *        taken, the threads owning the counters are not involved.
+ *
+ * \param cnt Set to the number of entries returned
+ *
+ * \retval entries array to be freed by the caller, NULL if there are no
+ *         counters or on allocation failure
+ */
+static SCPerfSnapshotEntry *SCPerfSnapshot(uint32_t *cnt)
+{
+    SCPerfSnapshotEntry *entries = NULL;
+    ThreadVars *tv = NULL;
+    uint32_t size = 0;
+    uint32_t u = 0;
+
+    *cnt = 0;
+
+    SCMutexLock(&tv_root_lock);
+    for (u = 0; u < TVT_MAX; u++) {
+        for (tv = tv_root[u]; tv != NULL; tv = tv->next) {
+            if (tv->sc_perf_pca != NULL)
+                size += tv->sc_perf_pca->size;
+        }
+    }
+
+    if (size > 0)
+        entries = SCMalloc(size * sizeof(SCPerfSnapshotEntry));
+
+    if (entries != NULL) {
+        for (u = 0; u < TVT_MAX; u++) {
+            for (tv = tv_root[u]; tv != NULL; tv = tv->next) {
+                *cnt = SCPerfSnapshotThread(tv, entries, *cnt, size);
+            }
+        }
+    }
+    SCMutexUnlock(&tv_root_lock);
+
+    return entries;
+}
+
+static int SCPerfSnapshotCmpTm(const void *a, const void *b)
+{
+    const SCPerfSnapshotEntry *ea = a;
+    const SCPerfSnapshotEntry *eb = b;
+    int r = strcmp(ea->tm_name, eb->tm_name);
+    return r ? r : strcmp(ea->cname, eb->cname);
+}
+
+static int SCPerfSnapshotCmpName(const void *a, const void *b)
+{
+    const SCPerfSnapshotEntry *ea = a;
+    const SCPerfSnapshotEntry *eb = b;
+    int r = strcmp(ea->cname, eb->cname);
+    return r ? r : strcmp(ea->tv_name, eb->tv_name);
+}
+
+/**
+ * \brief File output for lockless mode. Values come straight from the
+ *        thread local counters, clubbed per TM name if configured.
+ */
+static int SCPerfOutputCounterFileIfaceLockless(void)
+{
+    SCPerfSnapshotEntry *entries = NULL;
+    uint32_t cnt = 0;
+    uint32_t u = 0;
+
+    if ((entries = SCPerfSnapshot(&cnt)) == NULL)
+        return 0;
+
+    if (sc_perf_op_ctx->club_tm == 0) {
+        for (u = 0; u < cnt; u++) {
+            if (entries[u].type == SC_PERF_TYPE_UINT64) {
+                fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-" PRIu64 "\n",
+                        entries[u].cname, entries[u].tm_name, entries[u].ui64);
+            } else {
+                fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-lf\n",
+                        entries[u].cname, entries[u].tm_name, entries[u].d);
+            }
+        }
+    } else {
+        qsort(entries, cnt, sizeof(SCPerfSnapshotEntry), SCPerfSnapshotCmpTm);
+
+        u = 0;
+        while (u < cnt) {
+            SCPerfSnapshotEntry *e = &entries[u];
+            uint64_t ui64_result = 0;
+            double double_result = 0;
+
+            for ( ; u < cnt && SCPerfSnapshotCmpTm(e, &entries[u]) == 0; u++) {
+                ui64_result += entries[u].ui64;
+                double_result += entries[u].d;
+            }
+
+            if (e->type == SC_PERF_TYPE_UINT64) {
+                fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %-" PRIu64 "\n",
+                        e->cname, e->tm_name, ui64_result);
+            } else {
+                fprintf(sc_perf_op_ctx->fp, "%-25s | %-25s | %0.0lf\n",
+                        e->cname, e->tm_name, double_result);
+            }
+        }
+    }
+
+    fflush(sc_perf_op_ctx->fp);
+    SCFree(entries);
+    return 1;
+}
+
+/**
+ * \brief Growable text buffer used for the Prometheus output
+ */
+typedef struct SCPerfText_ {
+    char *buf;
+    size_t size;
+    size_t len;
+} SCPerfText;
+
+static int SCPerfTextAppend(SCPerfText *t, const char *fmt, ...)
+{
+    va_list ap;
+    int r;
+
+    while (1) {
+        if (t->size - t->len > 0) {
+            va_start(ap, fmt);
+            r = vsnprintf(t->buf + t->len, t->size - t->len, fmt, ap);
+            va_end(ap);
+            if (r < 0)
+                return -1;
+            if ((size_t)r < t->size - t->len) {
+                t->len += r;
+                return 0;
+            }
+        }
+
+        size_t size = t->size ? t->size * 2 : 4096;
+        char *buf = SCRealloc(t->buf, size);
+        if (buf == NULL)
+            return -1;
+        t->buf = buf;
+        t->size = size;
+    }
+}
+
+/**
+ * \brief Appends a counter name as a Prometheus metric name, characters
+ *        outside of [a-zA-Z0-9_] become '_'.
+ */
+static int SCPerfTextAppendMetricName(SCPerfText *t, const char *cname)
+{
+    char name[256];
+    size_t u = 0;
+
+    for (u = 0; cname[u] != '\0' && u < sizeof(name) - 1; u++) {
+        name[u] = isalnum((unsigned char)cname[u]) ? cname[u] : '_';
+    }
+    name[u] = '\0';
+
+    return SCPerfTextAppend(t, "suricata_%s", name);
+}
+
+/**
+ * \brief Appends a label value, escaping as the text format requires
+ */
+static int SCPerfTextAppendLabel(SCPerfText *t, const char *label,
+                                 const char *value)
+{
+    if (SCPerfTextAppend(t, "%s=\"", label) < 0)
+        return -1;
+
+    for ( ; *value != '\0'; value++) {
+        int r;
+        if (*value == '\\' || *value == '"')
+            r = SCPerfTextAppend(t, "\\%c", *value);
+        else if (*value == '\n')
+            r = SCPerfTextAppend(t, "\\n");
+        else
+            r = SCPerfTextAppend(t, "%c", *value);
+        if (r < 0)
+            return -1;
+    }
+
+    return SCPerfTextAppend(t, "\"");
+}
+
+/**
+ * \brief Formats a snapshot in the Prometheus text exposition format. One
+ *        sample per counter per thread, grouped per metric.
+ */
+static int SCPerfFormatPrometheus(SCPerfSnapshotEntry *entries, uint32_t cnt,
+                                  SCPerfText *t)
+{
+    uint32_t u = 0;
+
+    qsort(entries, cnt, sizeof(SCPerfSnapshotEntry), SCPerfSnapshotCmpName);
+
+    for (u = 0; u < cnt; u++) {
+        SCPerfSnapshotEntry *e = &entries[u];
+
+        if (u == 0 || strcmp(entries[u - 1].cname, e->cname) != 0) {
+            if (SCPerfTextAppend(t, "# TYPE ") < 0 ||
+                SCPerfTextAppendMetricName(t, e->cname) < 0 ||
+                SCPerfTextAppend(t, " untyped\n") < 0)
+                return -1;
+        }
+
+        if (SCPerfTextAppendMetricName(t, e->cname) < 0 ||
+            SCPerfTextAppend(t, "{") < 0 ||
+            SCPerfTextAppendLabel(t, "thread", e->tv_name) < 0 ||
+            SCPerfTextAppend(t, ",") < 0 ||
+            SCPerfTextAppendLabel(t, "module", e->tm_name) < 0)
+            return -1;
+
+        int r;
+        if (e->type == SC_PERF_TYPE_UINT64)
+            r = SCPerfTextAppend(t, "} %" PRIu64 "\n", e->ui64);
+        else
+            r = SCPerfTextAppend(t, "} %f\n", e->d);
+        if (r < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Returns the current value of all counters in the Prometheus text
+ *        format. The thread local counters are read directly, so the values
+ *        are current at the time of the call regardless of the sync
+ *        interval.
+ *
+ * \retval text to be freed by the caller, NULL on error
+ */
+char *SCPerfOutputPrometheus(void)
+{
+    SCPerfSnapshotEntry *entries = NULL;
+    SCPerfText t = { NULL, 0, 0 };
+    uint32_t cnt = 0;
+
+    entries = SCPerfSnapshot(&cnt);
+
+    /* make sure an empty snapshot still gives an empty string */
+    if (SCPerfTextAppend(&t, "") < 0 ||
+        (entries != NULL && SCPerfFormatPrometheus(entries, cnt, &t) < 0)) {
+        if (t.buf != NULL)
+            SCFree(t.buf);
+        t.buf = NULL;
+    }
+
+    if (entries != NULL)
+        SCFree(entries);
+    return t.buf;
+}
+
 /**
  * \brief The file output interface for the Perf Counter api
  */
@@ -1080,6 +1474,9 @@ static int SCPerfOutputCounterFileIface()
     fprintf(sc_perf_op_ctx->fp, "----------------------------------------------"
             "---------------------\n");
 
+    if (sc_counter_lockless)
+        return SCPerfOutputCounterFileIfaceLockless();
+
     if (sc_perf_op_ctx->club_tm == 0) {
         for (u = 0; u < TVT_MAX; u++) {
             tv = tv_root[u];
@@ -1204,6 +1601,115 @@ static int SCPerfOutputCounterFileIface()
 }
 
 #ifdef BUILD_UNIX_SOCKET
+/**
+ * \brief Adds snapshot entries to a json object, keyed by counter name
+ */
+static void SCPerfSnapshotToJson(json_t *jdata, SCPerfSnapshotEntry *e,
+                                 uint64_t ui64, double d)
+{
+    if (e->type == SC_PERF_TYPE_UINT64)
+        json_object_set_new(jdata, e->cname, json_integer(ui64));
+    else
+        json_object_set_new(jdata, e->cname, json_real(d));
+}
+
+/**
+ * \brief Socket output for lockless mode. The globals are not synced in
+ *        this mode, so the values come from the thread local counters.
+ */
+static TmEcode SCPerfOutputCounterSocketLockless(json_t *answer)
+{
+    SCPerfSnapshotEntry *entries = NULL;
+    json_t *tm_array = NULL;
+    json_t *jdata = NULL;
+    ThreadVars *tv = NULL;
+    uint32_t cnt = 0;
+    uint32_t u = 0;
+
+    tm_array = json_object();
+    if (tm_array == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal error at json object creation"));
+        return TM_ECODE_FAILED;
+    }
+
+    if (sc_perf_op_ctx->club_tm == 0) {
+        SCMutexLock(&tv_root_lock);
+        for (u = 0; u < TVT_MAX; u++) {
+            for (tv = tv_root[u]; tv != NULL; tv = tv->next) {
+                if (tv->sc_perf_pca == NULL || tv->sc_perf_pca->size == 0)
+                    continue;
+
+                entries = SCMalloc(tv->sc_perf_pca->size * sizeof(SCPerfSnapshotEntry));
+                if (entries == NULL) {
+                    SCMutexUnlock(&tv_root_lock);
+                    json_decref(tm_array);
+                    json_object_set_new(answer, "message",
+                            json_string("internal memory error"));
+                    return TM_ECODE_FAILED;
+                }
+                cnt = SCPerfSnapshotThread(tv, entries, 0, tv->sc_perf_pca->size);
+                if (cnt > 0) {
+                    jdata = json_object();
+                    if (jdata == NULL) {
+                        SCMutexUnlock(&tv_root_lock);
+                        SCFree(entries);
+                        json_decref(tm_array);
+                        json_object_set_new(answer, "message",
+                                json_string("internal error at json object creation"));
+                        return TM_ECODE_FAILED;
+                    }
+                    uint32_t i;
+                    for (i = 0; i < cnt; i++)
+                        SCPerfSnapshotToJson(jdata, &entries[i], entries[i].ui64,
+                                             entries[i].d);
+                    json_object_set_new(tm_array, tv->name, jdata);
+                }
+                SCFree(entries);
+            }
+        }
+        SCMutexUnlock(&tv_root_lock);
+
+        json_object_set_new(answer, "message", tm_array);
+        return TM_ECODE_OK;
+    }
+
+    entries = SCPerfSnapshot(&cnt);
+    if (entries != NULL)
+        qsort(entries, cnt, sizeof(SCPerfSnapshotEntry), SCPerfSnapshotCmpTm);
+
+    u = 0;
+    while (u < cnt) {
+        SCPerfSnapshotEntry *e = &entries[u];
+        uint64_t ui64_result = 0;
+        double double_result = 0;
+
+        for ( ; u < cnt && SCPerfSnapshotCmpTm(e, &entries[u]) == 0; u++) {
+            ui64_result += entries[u].ui64;
+            double_result += entries[u].d;
+        }
+
+        jdata = json_object_get(tm_array, e->tm_name);
+        if (jdata == NULL) {
+            jdata = json_object();
+            if (jdata == NULL) {
+                SCFree(entries);
+                json_decref(tm_array);
+                json_object_set_new(answer, "message",
+                        json_string("internal error at json object creation"));
+                return TM_ECODE_FAILED;
+            }
+            json_object_set_new(tm_array, e->tm_name, jdata);
+        }
+        SCPerfSnapshotToJson(jdata, e, ui64_result, double_result);
+    }
+
+    if (entries != NULL)
+        SCFree(entries);
+    json_object_set_new(answer, "message", tm_array);
+    return TM_ECODE_OK;
+}
+
 /**
  * \brief The file output interface for the Perf Counter api
  */
@@ -1230,6 +1736,9 @@ TmEcode SCPerfOutputCounterSocket(json_t *cmd,
         return TM_ECODE_FAILED;
     }
 
+    if (sc_counter_lockless)
+        return SCPerfOutputCounterSocketLockless(answer);
+
     if (sc_perf_op_ctx->club_tm == 0) {
         json_t *tm_array;
 
@@ -1397,6 +1906,25 @@ TmEcode SCPerfOutputCounterSocket(json_t *cmd,
     return TM_ECODE_OK;
 }
 
+/**
+ * \brief Unix socket command returning the counters in the Prometheus text
+ *        format as the message string
+ */
+TmEcode SCPerfOutputCounterSocketPrometheus(json_t *cmd,
+                               json_t *answer, void *data)
+{
+    char *text = SCPerfOutputPrometheus();
+    if (text == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal memory error"));
+        return TM_ECODE_FAILED;
+    }
+
+    json_object_set_new(answer, "message", json_string(text));
+    SCFree(text);
+    return TM_ECODE_OK;
+}
+
 #endif /* BUILD_UNIX_SOCKET */
 
 /**
@@ -1425,22 +1953,27 @@ void SCPerfSpawnThreads(void)
     ThreadVars *tv_wakeup = NULL;
     ThreadVars *tv_mgmt = NULL;
 
-    /* spawn the stats wakeup thread */
-    tv_wakeup = TmThreadCreateMgmtThread("SCPerfWakeupThread",
-                                         SCPerfWakeupThread, 1);
-    if (tv_wakeup == NULL) {
-        SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread "
-                   "failed");
-        exit(EXIT_FAILURE);
-    }
+    /* in lockless mode nobody needs the threads to sync */
+    if (!sc_counter_lockless) {
+        /* spawn the stats wakeup thread */
+        tv_wakeup = TmThreadCreateMgmtThread("SCPerfWakeupThread",
+                                             SCPerfWakeupThread, 1);
+        if (tv_wakeup == NULL) {
+            SCLogError(SC_ERR_THREAD_CREATE, "TmThreadCreateMgmtThread "
+                       "failed");
+            exit(EXIT_FAILURE);
+        }
 #ifdef __tile__
-    TmThreadSetCPUAffinity(tv_wakeup, 0);
+        TmThreadSetCPUAffinity(tv_wakeup, 0);
 #endif
 
-    if (TmThreadSpawn(tv_wakeup) != 0) {
-        SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
-                   "SCPerfWakeupThread");
-        exit(EXIT_FAILURE);
+        if (TmThreadSpawn(tv_wakeup) != 0) {
+            SCLogError(SC_ERR_THREAD_SPAWN, "TmThreadSpawn failed for "
+                       "SCPerfWakeupThread");
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        SCLogInfo("stats: lockless counters, threads are not signalled to sync");
     }
 
     /* spawn the stats mgmt thread */
@@ -1813,8 +2346,14 @@ SCPerfCounterArray *SCPerfGetCounterArrayRange(ThreadVars *tv, uint16_t s_id, ui
         return NULL;
     memset(pca, 0, sizeof(SCPerfCounterArray));
 
-    if ( (pca->head = SCThreadMalloc(tv, sizeof(SCPCAElem) * (e_id - s_id  + 2))) == NULL)
+    /* over allocate by one slot so the array can start on a cache line, a
+     * thread's counters then don't share lines with anything else */
+    if ( (pca->mem = SCThreadMalloc(tv, sizeof(SCPCAElem) * (e_id - s_id  + 3))) == NULL) {
+        SCFree(pca);
         return NULL;
+    }
+    pca->head = (SCPCAElem *)(((uintptr_t)pca->mem + sizeof(SCPCAElem) - 1) &
+                              ~((uintptr_t)sizeof(SCPCAElem) - 1));
     memset(pca->head, 0, sizeof(SCPCAElem) * (e_id - s_id  + 2));
 
     pc = pctx->head;
@@ -1983,6 +2522,8 @@ void SCPerfOutputCounters()
     switch (sc_perf_op_ctx->iface) {
         case SC_PERF_IFACE_FILE:
             SCPerfOutputCounterFileIface();
+            if (sc_perf_op_ctx->fp != NULL)
+                SCLatencyOutputFile(sc_perf_op_ctx->fp);
 
             break;
         case SC_PERF_IFACE_CONSOLE:
@@ -2036,8 +2577,8 @@ void SCPerfReleasePerfCounterS(SCPerfCounter *head)
 void SCPerfReleasePCA(SCPerfCounterArray *pca)
 {
     if (pca != NULL) {
-        if (pca->head != NULL)
-            SCFree(pca->head);
+        if (pca->mem != NULL)
+            SCFree(pca->mem);
 
         SCFree(pca);
     }
@@ -2652,6 +3193,63 @@ static int SCPerfTestIntervalQual18()
 
     return result;
 }
+
+/**
+ * \test Counters are read from the thread local array without a sync and
+ *       formatted for Prometheus, grouped per metric.
+ */
+static int SCPerfTestPrometheus19()
+{
+    ThreadVars tv;
+    SCPerfCounterArray *pca = NULL;
+    SCPerfSnapshotEntry entries[4];
+    SCPerfText t = { NULL, 0, 0 };
+    uint32_t cnt = 0;
+    int result = 0;
+    uint16_t id1, id2;
+
+    memset(&tv, 0, sizeof(ThreadVars));
+    tv.name = "W#01";
+
+    id1 = SCPerfRegisterCounter("decoder.pkts", "c1", SC_PERF_TYPE_UINT64,
+                                NULL, &tv.sc_perf_pctx);
+    id2 = SCPerfRegisterAvgCounter("decoder.avg", "c1", SC_PERF_TYPE_UINT64,
+                                   NULL, &tv.sc_perf_pctx);
+
+    pca = SCPerfGetAllCountersArray(&tv, &tv.sc_perf_pctx);
+    tv.sc_perf_pca = pca;
+
+    SCPerfCounterIncr(id1, pca);
+    SCPerfCounterIncr(id1, pca);
+    SCPerfCounterIncr(id1, pca);
+    SCPerfCounterAddUI64(id2, pca, 10);
+    SCPerfCounterAddUI64(id2, pca, 20);
+
+    cnt = SCPerfSnapshotThread(&tv, entries, 0, 4);
+    if (cnt != 2)
+        goto end;
+
+    if (SCPerfFormatPrometheus(entries, cnt, &t) < 0)
+        goto end;
+
+    const char *expect =
+        "# TYPE suricata_decoder_avg untyped\n"
+        "suricata_decoder_avg{thread=\"W#01\",module=\"c1\"} 15\n"
+        "# TYPE suricata_decoder_pkts untyped\n"
+        "suricata_decoder_pkts{thread=\"W#01\",module=\"c1\"} 3\n";
+    if (t.buf == NULL || strcmp(t.buf, expect) != 0) {
+        printf("unexpected output \"%s\": ", t.buf ? t.buf : "(null)");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (t.buf != NULL)
+        SCFree(t.buf);
+    SCPerfReleasePerfCounterS(tv.sc_perf_pctx.head);
+    SCPerfReleasePCA(pca);
+    return result;
+}
 #endif
 
 void SCPerfRegisterTests()
@@ -2676,5 +3274,6 @@ void SCPerfRegisterTests()
     UtRegisterTest("SCPerfTestIntervalQual16", SCPerfTestIntervalQual16, 1);
     UtRegisterTest("SCPerfTestIntervalQual17", SCPerfTestIntervalQual17, 1);
     UtRegisterTest("SCPerfTestIntervalQual18", SCPerfTestIntervalQual18, 1);
+    UtRegisterTest("SCPerfTestPrometheus19", SCPerfTestPrometheus19, 1);
 #endif
 }
@@ -167,7 +167,7 @@ typedef struct SCPCAElem_ {
     /* timestamp to indicate the time, when the counter was last used to update
      * the global counter.  It is used for timebased counter calculations */
     struct timeval ts;
-} SCPCAElem;
+} __attribute__((aligned(64))) SCPCAElem;
 
 /**
  * \brief The SCPerfCounterArray used to hold the local version of the counters
@@ -177,6 +177,9 @@ typedef struct SCPerfCounterArray_ {
     /* points to the array holding PCAElems */
     SCPCAElem *head;
 
+    /* allocation head lives in, head is aligned to a cache line within it */
+    void *mem;
+
     /* no of PCAElems in head */
     uint32_t size;
 } SCPerfCounterArray;
@@ -252,6 +255,7 @@ void SCPerfReleasePCA(SCPerfCounterArray *);
 void SCPerfCounterSetUI64(uint16_t, SCPerfCounterArray *, uint64_t);
 void SCPerfCounterSetDouble(uint16_t, SCPerfCounterArray *, double);
 void SCPerfCounterIncr(uint16_t, SCPerfCounterArray *);
+void SCPerfCounterIncrMulti(const uint16_t *, uint16_t, SCPerfCounterArray *);
 
 void SCPerfRegisterTests(void);
 
@@ -269,10 +273,14 @@ void SCPerfCounterAddDouble(uint16_t, SCPerfCounterArray *, double);
         }                                                               \
     } while (0)
 
+char *SCPerfOutputPrometheus(void);
+
 #ifdef BUILD_UNIX_SOCKET
 #include <jansson.h>
 TmEcode SCPerfOutputCounterSocket(json_t *cmd,
                                json_t *answer, void *data);
+TmEcode SCPerfOutputCounterSocketPrometheus(json_t *cmd,
+                               json_t *answer, void *data);
 #endif
 
 #endif /* __COUNTERS_H__ */
@@ -34,12 +34,159 @@
 #include "decode.h"
 #include "decode-ethernet.h"
 #include "decode-events.h"
+#include "decode-teredo.h"
+
+#include "flow.h"
+#include "app-layer.h"
 
 #include "util-unittest.h"
 #include "util-debug.h"
+#include "util-optimize.h"
+
+/** max number of counters the fast path updates per packet:
+ *  ethernet, vlan, ipv4, tcp/udp and the fast path counter itself */
+#define ETHERNET_FAST_MAX_COUNTERS 5
+
+/**
+ * \brief Single pass decoder for the dominant frame layouts: Ethernet,
+ *        optionally a single 802.1Q tag, IPv4 without options and TCP
+ *        or UDP on top of it.
+ *
+ *  All length and header checks are done on the raw frame before the
+ *  Packet is touched, so a frame that doesn't fit one of these shapes is
+ *  left as is and can be handed to the regular decoder chain. Frames that
+ *  would raise a decoder event, fragments and Teredo are left to the
+ *  regular chain as well.
+ *
+ *  \retval 1 frame was fully decoded
+ *  \retval 0 frame needs the regular decoder chain
+ */
+static inline int DecodeEthernetFast(ThreadVars *tv, DecodeThreadVars *dtv,
+        Packet *p, uint8_t *pkt, uint16_t len, PacketQueue *pq)
+{
+    uint16_t counters[ETHERNET_FAST_MAX_COUNTERS];
+    uint16_t ncounters = 0;
+    uint16_t l2_len = ETHERNET_HEADER_LEN;
+    VLANHdr *vlanh = NULL;
+
+    if (unlikely(len < ETHERNET_HEADER_LEN + IPV4_HEADER_LEN))
+        return 0;
+
+    uint16_t ether_type = ntohs(((EthernetHdr *)pkt)->eth_type);
+    if (ether_type == ETHERNET_TYPE_VLAN) {
+        if (unlikely(len < ETHERNET_HEADER_LEN + VLAN_HEADER_LEN + IPV4_HEADER_LEN))
+            return 0;
+
+        vlanh = (VLANHdr *)(pkt + ETHERNET_HEADER_LEN);
+        ether_type = GET_VLAN_PROTO(vlanh);
+        l2_len += VLAN_HEADER_LEN;
+    }
+    if (ether_type != ETHERNET_TYPE_IP)
+        return 0;
+
+    /* IPv4 with a 20 byte header, not a fragment, not truncated */
+    IPV4Hdr *ip4h = (IPV4Hdr *)(pkt + l2_len);
+    if (IPV4_GET_RAW_VER(ip4h) != 4 ||
+        (IPV4_GET_RAW_HLEN(ip4h) << 2) != IPV4_HEADER_LEN)
+        return 0;
+
+    uint16_t ip_len = ntohs(IPV4_GET_RAW_IPLEN(ip4h));
+    if (unlikely(ip_len < IPV4_HEADER_LEN || ip_len > len - l2_len))
+        return 0;
+    /* fragment offset or MF set: needs defrag */
+    if (ntohs(IPV4_GET_RAW_IPOFFSET(ip4h)) & 0x3fff)
+        return 0;
+
+    uint8_t *l4 = (uint8_t *)ip4h + IPV4_HEADER_LEN;
+    uint16_t l4_len = ip_len - IPV4_HEADER_LEN;
+    uint8_t tcp_hlen = 0;
+
+    switch (IPV4_GET_RAW_IPPROTO(ip4h)) {
+        case IPPROTO_TCP:
+        {
+            if (unlikely(l4_len < TCP_HEADER_LEN))
+                return 0;
+
+            tcp_hlen = TCP_GET_RAW_OFFSET((TCPHdr *)l4) << 2;
+            if (unlikely(tcp_hlen < TCP_HEADER_LEN || tcp_hlen > l4_len))
+                return 0;
+            break;
+        }
+        case IPPROTO_UDP:
+        {
+            if (unlikely(l4_len < UDP_HEADER_LEN))
+                return 0;
+            if (unlikely(UDP_GET_RAW_LEN((UDPHdr *)l4) != l4_len))
+                return 0;
+            /* leave anything that may be Teredo to the full decoder, see
+             * DecodeTeredo() for the checks done there */
+            uint8_t *udp_payload = l4 + UDP_HEADER_LEN;
+            if (l4_len - UDP_HEADER_LEN >= IPV6_HEADER_LEN &&
+                (udp_payload[0] == 0x00 || IP_GET_RAW_VER(udp_payload) == 6))
+                return 0;
+            break;
+        }
+        default:
+            return 0;
+    }
+
+    /* frame is good, fill the packet in one go */
+    counters[ncounters++] = dtv->counter_eth;
+    p->ethh = (EthernetHdr *)pkt;
+    if (vlanh != NULL) {
+        counters[ncounters++] = dtv->counter_vlan;
+        p->vlanh = vlanh;
+    }
+
+    counters[ncounters++] = dtv->counter_ipv4;
+    p->ip4h = ip4h;
+    SET_IPV4_SRC_ADDR(p,&p->src);
+    SET_IPV4_DST_ADDR(p,&p->dst);
+
+    if (tcp_hlen > 0) {
+        counters[ncounters++] = dtv->counter_tcp;
+        p->tcph = (TCPHdr *)l4;
+        if (tcp_hlen > TCP_HEADER_LEN) {
+            DecodeTCPOptions(p, l4 + TCP_HEADER_LEN, tcp_hlen - TCP_HEADER_LEN);
+        }
+        SET_TCP_SRC_PORT(p,&p->sp);
+        SET_TCP_DST_PORT(p,&p->dp);
+        p->proto = IPPROTO_TCP;
+        p->payload = l4 + tcp_hlen;
+        p->payload_len = l4_len - tcp_hlen;
+    } else {
+        counters[ncounters++] = dtv->counter_udp;
+        p->udph = (UDPHdr *)l4;
+        SET_UDP_SRC_PORT(p,&p->sp);
+        SET_UDP_DST_PORT(p,&p->dp);
+        p->proto = IPPROTO_UDP;
+        p->payload = l4 + UDP_HEADER_LEN;
+        p->payload_len = l4_len - UDP_HEADER_LEN;
+    }
+
+    counters[ncounters++] = dtv->counter_fastpath;
+    SCPerfCounterIncrMulti(counters, ncounters, tv->sc_perf_pca);
+
+    SCLogDebug("p %p pkt %p fast path: vlan %s proto %"PRIu8" sp %"PRIu16
+            " dp %"PRIu16" payload_len %"PRIu16, p, pkt,
+            vlanh ? "yes" : "no", p->proto, p->sp, p->dp, p->payload_len);
+
+    /* Flow is an integral part of us */
+    FlowHandlePacket(tv, p);
+
+    /* handle the app layer part of the UDP packet payload */
+    if (p->udph != NULL && p->flow != NULL) {
+        AppLayerHandleUdp(&dtv->udp_dp_ctx, p->flow, p);
+    }
+
+    return 1;
+}
 
 void DecodeEthernet(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p, uint8_t *pkt, uint16_t len, PacketQueue *pq)
 {
+    if (likely(DecodeEthernetFast(tv, dtv, p, pkt, len, pq) == 1))
+        return;
+
     SCPerfCounterIncr(dtv->counter_eth, tv->sc_perf_pca);
 
     if (len < ETHERNET_HEADER_LEN) {
@@ -128,6 +275,121 @@ static int DecodeEthernetTest01 (void)   {
     SCFree(p);
     return 0;
 }
+/**
+ * \test DecodeEthernetTest02 VLAN tagged IPv4/TCP frame with TCP options,
+ *       handled by the fast path.
+ *
+ *  \retval 1 on success
+ *  \retval 0 on failure
+ */
+static int DecodeEthernetTest02 (void)   {
+    uint8_t raw_eth[] = {
+        0x00, 0x10, 0x94, 0x55, 0x00, 0x01, 0x00, 0x10,
+        0x94, 0x56, 0x00, 0x01, 0x81, 0x00, 0x00, 0x20,
+        0x08, 0x00, 0x45, 0x00, 0x00, 0x34, 0x3b, 0x36,
+        0x40, 0x00, 0x40, 0x06, 0xb7, 0xc9, 0x83, 0x97,
+        0x20, 0x81, 0x83, 0x97, 0x20, 0x15, 0x04, 0x8a,
+        0x17, 0x70, 0x4e, 0x14, 0xdf, 0x55, 0x4d, 0x3d,
+        0x5a, 0x61, 0x80, 0x10, 0x6b, 0x50, 0x3c, 0x4c,
+        0x00, 0x00, 0x01, 0x01, 0x08, 0x0a, 0x00, 0x04,
+        0xf0, 0xc8, 0x01, 0x99, 0xa3, 0xf3 };
+    int result = 0;
+
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    if (unlikely(p == NULL))
+        return 0;
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+    memset(&tv,  0, sizeof(ThreadVars));
+    memset(p, 0, SIZE_OF_PACKET);
+    p->pkt = (uint8_t *)(p + 1);
+
+    FlowInitConfig(FLOW_QUIET);
+
+    DecodeEthernet(&tv, &dtv, p, raw_eth, sizeof(raw_eth), NULL);
+
+    if (p->ethh == NULL || p->vlanh == NULL || p->ip4h == NULL ||
+        p->tcph == NULL) {
+        printf("headers not set: ");
+        goto end;
+    }
+    if (GET_VLAN_ID(p->vlanh) != 32) {
+        printf("vlan id %u, expected 32: ", GET_VLAN_ID(p->vlanh));
+        goto end;
+    }
+    if (p->proto != IPPROTO_TCP || p->sp != 1162 || p->dp != 6000) {
+        printf("proto %u sp %u dp %u: ", p->proto, p->sp, p->dp);
+        goto end;
+    }
+    if (p->payload_len != 0 || p->tcpvars.ts == NULL) {
+        printf("payload_len %u or no timestamp option: ", p->payload_len);
+        goto end;
+    }
+    if (p->flow == NULL) {
+        printf("no flow: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    FlowShutdown();
+    SCFree(p);
+    return result;
+}
+
+/**
+ * \test DecodeEthernetTest03 IPv4 frame with IP options, not handled by
+ *       the fast path but decoded by the regular decoders.
+ *
+ *  \retval 1 on success
+ *  \retval 0 on failure
+ */
+static int DecodeEthernetTest03 (void)   {
+    uint8_t raw_eth[] = {
+        0x00, 0x10, 0x94, 0x55, 0x00, 0x01, 0x00, 0x10,
+        0x94, 0x56, 0x00, 0x01, 0x08, 0x00, 0x46, 0x00,
+        0x00, 0x20, 0x00, 0x01, 0x00, 0x00, 0x40, 0x11,
+        0x00, 0x00, 0x0a, 0x00, 0x00, 0x01, 0x0a, 0x00,
+        0x00, 0x02, 0x01, 0x01, 0x01, 0x00, 0x04, 0x00,
+        0x00, 0x35, 0x00, 0x08, 0x00, 0x00 };
+    int result = 0;
+
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    if (unlikely(p == NULL))
+        return 0;
+    ThreadVars tv;
+    DecodeThreadVars dtv;
+
+    memset(&dtv, 0, sizeof(DecodeThreadVars));
+    memset(&tv,  0, sizeof(ThreadVars));
+    memset(p, 0, SIZE_OF_PACKET);
+    p->pkt = (uint8_t *)(p + 1);
+
+    FlowInitConfig(FLOW_QUIET);
+
+    DecodeEthernet(&tv, &dtv, p, raw_eth, sizeof(raw_eth), NULL);
+
+    if (p->ip4h == NULL || p->udph == NULL) {
+        printf("headers not set: ");
+        goto end;
+    }
+    if (IPV4_GET_HLEN(p) != 24) {
+        printf("hlen %u, expected 24: ", IPV4_GET_HLEN(p));
+        goto end;
+    }
+    if (p->proto != IPPROTO_UDP || p->sp != 1024 || p->dp != 53) {
+        printf("proto %u sp %u dp %u: ", p->proto, p->sp, p->dp);
+        goto end;
+    }
+
+    result = 1;
+end:
+    FlowShutdown();
+    SCFree(p);
+    return result;
+}
 #endif /* UNITTESTS */
 
 
@@ -138,6 +400,8 @@ static int DecodeEthernetTest01 (void)   {
 void DecodeEthernetRegisterTests(void) {
 #ifdef UNITTESTS
     UtRegisterTest("DecodeEthernetTest01", DecodeEthernetTest01, 0);
+    UtRegisterTest("DecodeEthernetTest02", DecodeEthernetTest02, 1);
+    UtRegisterTest("DecodeEthernetTest03", DecodeEthernetTest03, 1);
 #endif /* UNITTESTS */
 }
 /**
@@ -39,7 +39,7 @@
 #include "util-optimize.h"
 #include "flow.h"
 
-static int DecodeTCPOptions(Packet *p, uint8_t *pkt, uint16_t len)
+int DecodeTCPOptions(Packet *p, uint8_t *pkt, uint16_t len)
 {
     uint16_t plen = len;
     while (plen)
@@ -252,6 +252,9 @@ typedef struct PacketAlert_ {
     SigIntId order_id; /* Internal num, used for sorting */
     uint8_t action; /* Internal num, used for sorting */
     uint8_t flags;
+    /** alerts this one stands for, > 1 if identical alerts were
+     *  coalesced by alert aggregation */
+    uint32_t count;
     struct Signature_ *s;
 } PacketAlert;
 
@@ -517,6 +520,12 @@ typedef struct Packet_
     uint16_t mpm_offsets[CUDA_MAX_PAYLOAD_SIZE + 1];
 #endif
 
+    /** latency sampling: monotonic nsec the packet entered the engine,
+     *  0 if the packet isn't sampled */
+    uint64_t lat_start;
+    /** latency sampling: monotonic nsec the packet was queued */
+    uint64_t lat_queued;
+
 #ifdef PROFILING
     PktProfiling profile;
 #endif
@@ -683,6 +692,12 @@ typedef struct Packet_
     uint16_t mpm_offsets[CUDA_MAX_PAYLOAD_SIZE + 1];
 #endif
 
+    /** latency sampling: monotonic nsec the packet entered the engine,
+     *  0 if the packet isn't sampled */
+    uint64_t lat_start;
+    /** latency sampling: monotonic nsec the packet was queued */
+    uint64_t lat_queued;
+
 #ifdef PROFILING
     PktProfiling profile;
 #endif
@@ -752,6 +767,13 @@ typedef struct AlpProtoDetectThreadCtx_ {
 
     void *alproto_local_storage[ALPROTO_MAX];
 
+    /** thread owning this ctx, for the counters. NULL in unittests */
+    ThreadVars *tv;
+    uint16_t counter_alproto_pm;        /**< detected by pattern */
+    uint16_t counter_alproto_pp;        /**< detected by probing parser */
+    uint16_t counter_alproto_unknown;   /**< all detection methods failed */
+    uint16_t counter_alproto_budget;    /**< budget ran out */
+
 #ifdef PROFILING
     uint64_t ticks_start;
     uint64_t ticks_end;
@@ -763,6 +785,11 @@ typedef struct AlpProtoDetectThreadCtx_ {
 #endif
 } AlpProtoDetectThreadCtx;
 
+/** number of slots in the per thread defrag tracker cache, must be a
+ *  power of 2 */
+#define DEFRAG_THREAD_CACHE_BITS    4
+#define DEFRAG_THREAD_CACHE_SIZE    (1 << DEFRAG_THREAD_CACHE_BITS)
+
 /** \brief Structure to hold thread specific data for all decode modules */
 typedef struct DecodeThreadVars_
 {
@@ -794,6 +821,7 @@ typedef struct DecodeThreadVars_
     uint16_t counter_ipv6inipv6;
     uint16_t counter_avg_pkt_size;
     uint16_t counter_max_pkt_size;
+    uint16_t counter_fastpath;
 
     /** frag stats - defrag runs in the context of the decoder. */
     uint16_t counter_defrag_ipv4_fragments;
@@ -803,6 +831,12 @@ typedef struct DecodeThreadVars_
     uint16_t counter_defrag_ipv6_reassembled;
     uint16_t counter_defrag_ipv6_timeouts;
     uint16_t counter_defrag_max_hit;
+
+    /** lookaside cache of the defrag trackers this thread used last. The
+     *  fragments of a datagram are normally all decoded by the same
+     *  thread, so this saves the hash row lock for most of them. */
+    uint32_t defrag_cache_epoch;
+    struct DefragTracker_ *defrag_cache[DEFRAG_THREAD_CACHE_SIZE];
 } DecodeThreadVars;
 
 /**
@@ -931,6 +965,8 @@ typedef struct DecodeThreadVars_
         (p)->livedev = NULL;                    \
         (p)->ReleaseData = NULL;                \
         PACKET_RESET_CHECKSUMS((p));            \
+        (p)->lat_start = 0;                     \
+        (p)->lat_queued = 0;                    \
         PACKET_PROFILING_RESET((p));            \
     } while (0)
 
@@ -1023,6 +1059,8 @@ typedef struct DecodeThreadVars_
         (p)->root = NULL;                       \
         (p)->livedev = NULL;                    \
         PACKET_RESET_CHECKSUMS((p));            \
+        (p)->lat_start = 0;                     \
+        (p)->lat_queued = 0;                    \
         PACKET_PROFILING_RESET((p));            \
     } while (0)
 
@@ -1174,6 +1212,8 @@ void DecodeSCTP(ThreadVars *, DecodeThreadVars *, Packet *, uint8_t *, uint16_t,
 void DecodeGRE(ThreadVars *, DecodeThreadVars *, Packet *, uint8_t *, uint16_t, PacketQueue *);
 void DecodeVLAN(ThreadVars *, DecodeThreadVars *, Packet *, uint8_t *, uint16_t, PacketQueue *);
 
+int DecodeTCPOptions(Packet *, uint8_t *, uint16_t);
+
 void AddressDebugPrint(Address *);
 
 /** \brief Set the No payload inspection Flag for the packet.
@@ -1277,6 +1317,8 @@ void AddressDebugPrint(Address *);
 #define PKT_HOST_SRC_LOOKED_UP          (1<<19)
 #define PKT_HOST_DST_LOOKED_UP          (1<<20)
 
+#define PKT_FLOW_BYPASSED               (1<<21)     /**< Packet belongs to a bypassed flow, skip stream tracking and detection */
+
 /** \brief return 1 if the packet is a pseudo packet */
 #define PKT_IS_PSEUDOPKT(p) ((p)->flags & PKT_PSEUDO_STREAM_END)
 
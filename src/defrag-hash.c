@@ -29,6 +29,11 @@ static DefragTracker *DefragTrackerGetUsedDefragTracker(void);
 /** queue with spare tracker */
 static DefragTrackerQueue defragtracker_spare_q;
 
+/** bumped each time the defrag engine is (re)initialized or shut down, so
+ *  that per thread caches holding trackers of a previous instance are
+ *  reset */
+static uint32_t defrag_cache_epoch = 0;
+
 uint32_t DefragTrackerSpareQueueGetSize(void) {
     return DefragTrackerQueueLen(&defragtracker_spare_q);
 }
@@ -63,6 +68,11 @@ void DefragTrackerFree(DefragTracker *dt) {
     if (dt != NULL) {
         DefragTrackerClearMemory(dt);
 
+        if (dt->buf != NULL) {
+            SCFree(dt->buf);
+            (void) SC_ATOMIC_SUB(defrag_memuse, dt->buf_size);
+        }
+
         SCMutexDestroy(&dt->lock);
         SCFree(dt);
         (void) SC_ATOMIC_SUB(defrag_memuse, sizeof(DefragTracker));
@@ -129,6 +139,7 @@ void DefragInitConfig(char quiet)
     SC_ATOMIC_INIT(defrag_memuse);
     SC_ATOMIC_INIT(defragtracker_prune_idx);
     DefragTrackerQueueInit(&defragtracker_spare_q);
+    defrag_cache_epoch++;
 
     unsigned int seed = RandomTimePreseed();
     /* set defaults */
@@ -277,6 +288,7 @@ void DefragHashShutdown(void)
     }
     (void) SC_ATOMIC_SUB(defrag_memuse, defrag_config.hash_size * sizeof(DefragTrackerHashRow));
     DefragTrackerQueueDestroy(&defragtracker_spare_q);
+    defrag_cache_epoch++;
 
     SC_ATOMIC_DESTROY(defragtracker_prune_idx);
     SC_ATOMIC_DESTROY(defrag_memuse);
@@ -488,6 +500,7 @@ DefragTracker *DefragGetTrackerFromHash (Packet *p)
 
         /* got one, now lock, initialize and return */
         DefragTrackerInit(dt,p);
+        dt->flags |= DEFRAG_TRACKER_FLAG_IN_HASH;
 
         DRLOCK_UNLOCK(hb);
         return dt;
@@ -518,6 +531,7 @@ DefragTracker *DefragGetTrackerFromHash (Packet *p)
 
                 /* initialize and return */
                 DefragTrackerInit(dt,p);
+                dt->flags |= DEFRAG_TRACKER_FLAG_IN_HASH;
 
                 DRLOCK_UNLOCK(hb);
                 return dt;
@@ -626,6 +640,64 @@ DefragTracker *DefragLookupTrackerFromHash (Packet *p)
     return dt;
 }
 
+/** \internal
+ *  \brief get the per thread cache slot for a fragment */
+static inline uint32_t DefragThreadCacheIdx(Packet *p) {
+    uint32_t v;
+
+    if (PKT_IS_IPV4(p)) {
+        v = (uint32_t)IPV4_GET_IPID(p) ^
+            p->src.addr_data32[0] ^ p->dst.addr_data32[0];
+    } else {
+        v = IPV6_EXTHDR_GET_FH_ID(p) ^
+            p->src.addr_data32[3] ^ p->dst.addr_data32[3];
+    }
+    return (v * 2654435761U) >> (32 - DEFRAG_THREAD_CACHE_BITS);
+}
+
+/** \brief get a tracker, checking the per thread cache first
+ *
+ *  Same as DefragGetTrackerFromHash(), but the hash row lock is only taken
+ *  if the tracker is not in the callers cache. A cache entry is validated
+ *  by locking the tracker and checking it is still in the hash with the
+ *  same key. Removing a tracker from the hash requires the tracker lock,
+ *  so if the checks pass it can't go away until we release it.
+ *
+ *  \param dtv decode thread vars holding the cache
+ *  \param p fragment
+ *
+ *  \retval dt *LOCKED* tracker or NULL
+ */
+DefragTracker *DefragGetTrackerFromCache (DecodeThreadVars *dtv, Packet *p)
+{
+    uint32_t idx = DefragThreadCacheIdx(p);
+
+    if (unlikely(dtv->defrag_cache_epoch != defrag_cache_epoch)) {
+        memset(dtv->defrag_cache, 0x00, sizeof(dtv->defrag_cache));
+        dtv->defrag_cache_epoch = defrag_cache_epoch;
+    }
+
+    DefragTracker *dt = dtv->defrag_cache[idx];
+    if (dt != NULL) {
+        SCMutexLock(&dt->lock);
+        if ((dt->flags & DEFRAG_TRACKER_FLAG_IN_HASH) &&
+            DefragTrackerCompare(dt, p) != 0)
+        {
+            (void) DefragTrackerIncrUsecnt(dt);
+            return dt;
+        }
+        SCMutexUnlock(&dt->lock);
+
+        /* tracker was recycled, forget it */
+        dtv->defrag_cache[idx] = NULL;
+    }
+
+    dt = DefragGetTrackerFromHash(p);
+    if (dt != NULL)
+        dtv->defrag_cache[idx] = dt;
+    return dt;
+}
+
 /** \internal
  *  \brief Get a tracker from the hash directly.
  *
@@ -683,6 +755,7 @@ static DefragTracker *DefragTrackerGetUsedDefragTracker(void) {
 
         dt->hnext = NULL;
         dt->hprev = NULL;
+        dt->flags &= ~DEFRAG_TRACKER_FLAG_IN_HASH;
         DRLOCK_UNLOCK(hb);
 
         DefragTrackerClearMemory(dt);
@@ -94,6 +94,7 @@ static uint32_t DefragTrackerHashRowTimeout(DefragTrackerHashRow *hb, DefragTrac
 
             dt->hnext = NULL;
             dt->hprev = NULL;
+            dt->flags &= ~DEFRAG_TRACKER_FLAG_IN_HASH;
 
             DefragTrackerClearMemory(dt);
 
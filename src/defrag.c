@@ -77,6 +77,17 @@
  */
 #define TIMEOUT_MIN 1
 
+/**
+ * Initial size of a trackers fragment data buffer, large enough for
+ * the common case of a datagram split in 2 ethernet sized fragments.
+ */
+#define DEFRAG_TRACKER_BUF_MIN 4096
+
+/**
+ * Trackers are recycled with their buffer unless it grew past this size.
+ */
+#define DEFRAG_TRACKER_BUF_KEEP 16384
+
 /** Fragment reassembly policies. */
 enum defrag_policies {
     DEFRAG_POLICY_FIRST = 1,
@@ -110,7 +121,7 @@ DumpFrags(DefragTracker *tracker)
     printf("Dumping frags for packet: ID=%d\n", tracker->id);
     TAILQ_FOREACH(frag, &tracker->frags, next) {
         printf("-> Frag: frag_offset=%d, frag_len=%d, data_len=%d, ltrim=%d, skip=%d\n", frag->offset, frag->len, frag->data_len, frag->ltrim, frag->skip);
-        PrintRawDataFp(stdout, frag->pkt, frag->len);
+        PrintRawDataFp(stdout, DEFRAG_FRAG_PKT(tracker, frag), frag->len);
     }
 }
 #endif /* UNITTESTS */
@@ -122,8 +133,6 @@ DumpFrags(DefragTracker *tracker)
 static void
 DefragFragReset(Frag *frag)
 {
-    if (frag->pkt != NULL)
-        SCFree(frag->pkt);
     memset(frag, 0, sizeof(*frag));
 }
 
@@ -159,6 +168,120 @@ DefragTrackerFreeFrags(DefragTracker *tracker)
     }
 
     SCMutexUnlock(&defrag_context->frag_pool_lock);
+
+    tracker->data_start = 0;
+    tracker->data_end = 0;
+    tracker->ranges_cnt = 0;
+    tracker->flags &= ~DEFRAG_TRACKER_FLAG_RANGES_FULL;
+
+    tracker->buf_len = 0;
+    if (tracker->buf_size > DEFRAG_TRACKER_BUF_KEEP) {
+        SCFree(tracker->buf);
+        (void) SC_ATOMIC_SUB(defrag_memuse, tracker->buf_size);
+        tracker->buf = NULL;
+        tracker->buf_size = 0;
+    }
+}
+
+/**
+ * \brief Make room for len bytes in the data buffer of a tracker.
+ *
+ * The buffer is grown by doubling its size. Fragments reference their
+ * data by offset, so the buffer can be moved.
+ *
+ * \retval 0 on success, -1 if the memcap was reached or the allocation
+ *     failed.
+ */
+static int
+DefragTrackerBufReserve(DefragTracker *tracker, uint32_t len)
+{
+    if (tracker->buf_len + len <= tracker->buf_size)
+        return 0;
+
+    uint32_t size = tracker->buf_size ? tracker->buf_size : DEFRAG_TRACKER_BUF_MIN;
+    while (size < tracker->buf_len + len) {
+        if (size > UINT32_MAX / 2)
+            return -1;
+        size *= 2;
+    }
+
+    if (!(DEFRAG_CHECK_MEMCAP(size - tracker->buf_size)))
+        return -1;
+
+    uint8_t *buf = SCRealloc(tracker->buf, size);
+    if (buf == NULL)
+        return -1;
+
+    (void) SC_ATOMIC_ADD(defrag_memuse, size - tracker->buf_size);
+    tracker->buf = buf;
+    tracker->buf_size = size;
+    return 0;
+}
+
+/**
+ * \brief Add a range of received data to a tracker.
+ *
+ * The ranges are kept sorted and merged, so for a datagram without holes
+ * there is a single range no matter how many fragments it consists of.
+ */
+static void
+DefragTrackerAddRange(DefragTracker *tracker, uint16_t start, uint16_t end)
+{
+    DefragRange *r = tracker->ranges;
+    int cnt = tracker->ranges_cnt;
+    int i, j;
+
+    if (tracker->flags & DEFRAG_TRACKER_FLAG_RANGES_FULL)
+        return;
+
+    /* find the first range that ends at or after our start */
+    for (i = 0; i < cnt; i++) {
+        if (r[i].end >= start)
+            break;
+    }
+
+    if (i == cnt || r[i].start > end) {
+        /* no overlap and not adjacent, insert a new range */
+        if (cnt == DEFRAG_MAX_RANGES) {
+            tracker->flags |= DEFRAG_TRACKER_FLAG_RANGES_FULL;
+            return;
+        }
+        memmove(&r[i + 1], &r[i], (cnt - i) * sizeof(DefragRange));
+        r[i].start = start;
+        r[i].end = end;
+        tracker->ranges_cnt++;
+        return;
+    }
+
+    /* merge with range i and any following ranges we reach */
+    if (start < r[i].start)
+        r[i].start = start;
+    if (end > r[i].end)
+        r[i].end = end;
+    for (j = i + 1; j < cnt && r[j].start <= r[i].end; j++) {
+        if (r[j].end > r[i].end)
+            r[i].end = r[j].end;
+    }
+    if (j > i + 1) {
+        memmove(&r[i + 1], &r[j], (cnt - j) * sizeof(DefragRange));
+        tracker->ranges_cnt -= (j - i - 1);
+    }
+}
+
+/**
+ * \brief Check if a tracker may have all data of its datagram.
+ *
+ * \retval 1 if the data received so far has no holes, or if we can't
+ *     tell because the range list overflowed. In the latter case the
+ *     reassembler checks the fragment list for holes.
+ */
+static int
+DefragTrackerHasAllData(DefragTracker *tracker)
+{
+    if (tracker->flags & DEFRAG_TRACKER_FLAG_RANGES_FULL)
+        return 1;
+
+    return (tracker->ranges_cnt == 1 && tracker->ranges[0].start == 0);
 }
 
 /**
@@ -306,7 +429,7 @@ Defrag4Reassemble(ThreadVars *tv, DefragTracker *tracker, Packet *p)
             continue;
         if (frag->offset == 0) {
 
-            if (PacketCopyData(rp, frag->pkt, frag->len) == -1)
+            if (PacketCopyData(rp, DEFRAG_FRAG_PKT(tracker, frag), frag->len) == -1)
                 goto remove_tracker;
 
             hlen = frag->hlen;
@@ -326,7 +449,7 @@ Defrag4Reassemble(ThreadVars *tv, DefragTracker *tracker, Packet *p)
                 goto remove_tracker;
             }
             if (PacketCopyDataOffset(rp, fragmentable_offset + frag->offset + frag->ltrim,
-                frag->pkt + frag->data_offset + frag->ltrim,
+                DEFRAG_FRAG_PKT(tracker, frag) + frag->data_offset + frag->ltrim,
                 frag->data_len - frag->ltrim) == -1) {
                 goto remove_tracker;
             }
@@ -415,17 +538,18 @@ Defrag6Reassemble(ThreadVars *tv, DefragTracker *tracker, Packet *p)
         if (frag->data_len - frag->ltrim <= 0)
             continue;
         if (frag->offset == 0) {
-            IPV6FragHdr *frag_hdr = (IPV6FragHdr *)(frag->pkt +
+            IPV6FragHdr *frag_hdr = (IPV6FragHdr *)(DEFRAG_FRAG_PKT(tracker, frag) +
                 frag->frag_hdr_offset);
             next_hdr = frag_hdr->ip6fh_nxt;
 
             /* This is the first packet, we use this packets link and
              * IPv6 headers. We also copy in its data, but remove the
              * fragmentation header. */
-            if (PacketCopyData(rp, frag->pkt, frag->frag_hdr_offset) == -1)
+            if (PacketCopyData(rp, DEFRAG_FRAG_PKT(tracker, frag),
+                frag->frag_hdr_offset) == -1)
                 goto remove_tracker;
             if (PacketCopyDataOffset(rp, frag->frag_hdr_offset,
-                frag->pkt + frag->frag_hdr_offset + sizeof(IPV6FragHdr),
+                DEFRAG_FRAG_PKT(tracker, frag) + frag->frag_hdr_offset + sizeof(IPV6FragHdr),
                 frag->data_len) == -1)
                 goto remove_tracker;
             ip_hdr_offset = frag->ip_hdr_offset;
@@ -438,7 +562,7 @@ Defrag6Reassemble(ThreadVars *tv, DefragTracker *tracker, Packet *p)
         }
         else {
             if (PacketCopyDataOffset(rp, fragmentable_offset + frag->offset + frag->ltrim,
-                frag->pkt + frag->data_offset + frag->ltrim,
+                DEFRAG_FRAG_PKT(tracker, frag) + frag->data_offset + frag->ltrim,
                 frag->data_len - frag->ltrim) == -1)
                 goto remove_tracker;
             if (frag->offset + frag->data_len > fragmentable_len)
@@ -461,8 +585,6 @@ done:
 
 /**
  * Insert a new IPv4/IPv6 fragment into a tracker.
- *
- * \todo Allocate packet buffers from a pool.
  */
 static Packet *
 DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker, Packet *p)
@@ -545,7 +667,22 @@ DefragInsertFrag(ThreadVars *tv, DecodeThreadVars *dtv, DefragTracker *tracker,
 
     Frag *prev = NULL, *next;
     int overlap = 0;
-    if (!TAILQ_EMPTY(&tracker->frags)) {
+
+    /* A fragment that starts at or after the end of all data we have, or
+     * ends before the start of it, can't overlap any fragment under any
+     * of the policies. Such fragments go straight to the tail or head of
+     * the list, so in order and reverse order fragments don't require a
+     * walk of the list. */
+    int empty = TAILQ_EMPTY(&tracker->frags);
+    int append = 0, prepend = 0;
+    if (!empty && data_len > 0) {
+        if (frag_offset >= tracker->data_end)
+            append = 1;
+        else if (frag_end <= tracker->data_start)
+            prepend = 1;
+    }
+
+    if (!empty && !append && !prepend) {
         TAILQ_FOREACH(prev, &tracker->frags, next) {
             ltrim = 0;
             next = TAILQ_NEXT(prev, next);
@@ -667,8 +804,7 @@ insert:
         }
         goto done;
     }
-    new->pkt = SCMalloc(GET_PKT_LEN(p));
-    if (new->pkt == NULL) {
+    if (DefragTrackerBufReserve(tracker, GET_PKT_LEN(p) - ltrim) != 0) {
         SCMutexLock(&defrag_context->frag_pool_lock);
         PoolReturn(defrag_context->frag_pool, new);
         SCMutexUnlock(&defrag_context->frag_pool_lock);
@@ -679,7 +815,10 @@ insert:
         }
         goto done;
     }
-    memcpy(new->pkt, GET_PKT_DATA(p) + ltrim, GET_PKT_LEN(p) - ltrim);
+    new->pkt_offset = tracker->buf_len;
+    memcpy(DEFRAG_FRAG_PKT(tracker, new), GET_PKT_DATA(p) + ltrim,
+        GET_PKT_LEN(p) - ltrim);
+    tracker->buf_len += GET_PKT_LEN(p) - ltrim;
     new->len = GET_PKT_LEN(p) - ltrim;
     new->hlen = hlen;
     new->offset = frag_offset + ltrim;
@@ -691,23 +830,37 @@ insert:
     new->pcap_cnt = pcap_cnt;
 #endif
 
-    Frag *frag;
-    TAILQ_FOREACH(frag, &tracker->frags, next) {
-        if (frag_offset < frag->offset)
-            break;
-    }
-    if (frag == NULL) {
+    if (empty || append) {
         TAILQ_INSERT_TAIL(&tracker->frags, new, next);
     }
+    else if (prepend) {
+        TAILQ_INSERT_HEAD(&tracker->frags, new, next);
+    }
     else {
-        TAILQ_INSERT_BEFORE(frag, new, next);
+        Frag *frag;
+        TAILQ_FOREACH(frag, &tracker->frags, next) {
+            if (frag_offset < frag->offset)
+                break;
+        }
+        if (frag == NULL) {
+            TAILQ_INSERT_TAIL(&tracker->frags, new, next);
+        }
+        else {
+            TAILQ_INSERT_BEFORE(frag, new, next);
+        }
     }
 
+    if (empty || new->offset < tracker->data_start)
+        tracker->data_start = new->offset;
+    if (empty || frag_end > tracker->data_end)
+        tracker->data_end = frag_end;
+    DefragTrackerAddRange(tracker, new->offset, frag_end);
+
     if (!more_frags) {
         tracker->seen_last = 1;
     }
 
-    if (tracker->seen_last) {
+    if (tracker->seen_last && DefragTrackerHasAllData(tracker)) {
         if (tracker->af == AF_INET) {
             r = Defrag4Reassemble(tv, tracker, p);
             if (r != NULL && tv != NULL && dtv != NULL) {
@@ -810,6 +963,8 @@ DefragGetOsPolicy(Packet *p)
 static DefragTracker *
 DefragGetTracker(ThreadVars *tv, DecodeThreadVars *dtv, Packet *p)
 {
+    if (dtv != NULL)
+        return DefragGetTrackerFromCache(dtv, p);
     return DefragGetTrackerFromHash(p);
 }
 
@@ -2156,6 +2311,106 @@ end:
     return ret;
 }
 
+/**
+ * Test the merging of the received data ranges of a tracker.
+ */
+static int
+DefragTrackerRangesTest(void)
+{
+    DefragTracker tracker;
+    int i;
+
+    memset(&tracker, 0, sizeof(tracker));
+
+    DefragTrackerAddRange(&tracker, 16, 24);
+    DefragTrackerAddRange(&tracker, 0, 8);
+    DefragTrackerAddRange(&tracker, 40, 48);
+    if (tracker.ranges_cnt != 3 || DefragTrackerHasAllData(&tracker))
+        return 0;
+
+    /* Adjacent to the first range. */
+    DefragTrackerAddRange(&tracker, 8, 12);
+    if (tracker.ranges_cnt != 3 || tracker.ranges[0].end != 12)
+        return 0;
+
+    /* Bridges the first two ranges and overlaps the third. */
+    DefragTrackerAddRange(&tracker, 10, 44);
+    if (tracker.ranges_cnt != 1 || !DefragTrackerHasAllData(&tracker))
+        return 0;
+    if (tracker.ranges[0].start != 0 || tracker.ranges[0].end != 48)
+        return 0;
+
+    /* Overflow the range list. */
+    for (i = 0; i < DEFRAG_MAX_RANGES; i++) {
+        DefragTrackerAddRange(&tracker, 64 + i * 16, 72 + i * 16);
+    }
+    if (!(tracker.flags & DEFRAG_TRACKER_FLAG_RANGES_FULL))
+        return 0;
+
+    return 1;
+}
+
+/**
+ * Re-assemble a datagram from a large number of fragments: the even
+ * fragments in order followed by the odd fragments in reverse order.
+ * This overflows the range list and goes through the per thread
+ * tracker cache.
+ */
+static int
+DefragManyFragsTest(void)
+{
+    DecodeThreadVars dtv;
+    Packet *p = NULL;
+    Packet *reassembled = NULL;
+    int nfrags = 1024;
+    int id = 14;
+    int i;
+    int ret = 0;
+
+    memset(&dtv, 0, sizeof(dtv));
+
+    DefragInit();
+
+    for (i = 0; i < nfrags; i += 2) {
+        p = BuildTestPacket(id, i, i + 1 < nfrags, 'A' + (i % 26), 8);
+        if (p == NULL)
+            goto end;
+        reassembled = Defrag(NULL, &dtv, p);
+        SCFree(p);
+        if (reassembled != NULL)
+            goto end;
+    }
+    for (i = nfrags - 1; i > 0; i -= 2) {
+        p = BuildTestPacket(id, i, i + 1 < nfrags, 'A' + (i % 26), 8);
+        if (p == NULL)
+            goto end;
+        reassembled = Defrag(NULL, &dtv, p);
+        SCFree(p);
+        if (i > 1 && reassembled != NULL)
+            goto end;
+    }
+    if (reassembled == NULL)
+        goto end;
+
+    if (IPV4_GET_IPLEN(reassembled) != 20 + nfrags * 8)
+        goto end;
+    for (i = 0; i < nfrags * 8; i++) {
+        if (GET_PKT_DATA(reassembled)[20 + i] != 'A' + ((i / 8) % 26))
+            goto end;
+    }
+
+    /* Make sure all frags were returned back to the pool. */
+    if (defrag_context->frag_pool->outstanding != 0)
+        goto end;
+
+    ret = 1;
+end:
+    if (reassembled != NULL)
+        SCFree(reassembled);
+    DefragDestroy();
+    return ret;
+}
+
 #endif /* UNITTESTS */
 
 void
@@ -2181,6 +2436,8 @@ DefragRegisterTests(void)
 
     UtRegisterTest("DefragIPv4NoDataTest", DefragIPv4NoDataTest, 1);
     UtRegisterTest("DefragIPv4TooLargeTest", DefragIPv4TooLargeTest, 1);
+    UtRegisterTest("DefragTrackerRangesTest", DefragTrackerRangesTest, 1);
+    UtRegisterTest("DefragManyFragsTest", DefragManyFragsTest, 1);
 
     UtRegisterTest("IPV6DefragInOrderSimpleTest",
         IPV6DefragInOrderSimpleTest, 1);
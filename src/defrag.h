@@ -62,7 +62,8 @@ typedef struct Frag_ {
     uint16_t ltrim;             /**< Number of leading bytes to trim when
                                  * re-assembling the packet. */
 
-    uint8_t *pkt;               /**< The actual packet. */
+    uint32_t pkt_offset;        /**< Offset of the packet copy in the
+                                 * trackers data buffer. */
 
 #ifdef DEBUG
     uint64_t pcap_cnt;          /**< pcap_cnt of original packet */
@@ -83,8 +84,37 @@ typedef struct Frag_ {
     CLEAR_ADDR(&(t)->dst_addr); \
     (t)->frags.tqh_first = NULL; \
     (t)->frags.tqh_last = NULL; \
+    (t)->flags = 0; \
+    (t)->data_start = 0; \
+    (t)->data_end = 0; \
+    (t)->ranges_cnt = 0; \
+    (t)->buf_len = 0; \
 }
 
+/** Returns a pointer to the packet copy of a fragment. */
+#define DEFRAG_FRAG_PKT(t, f) ((t)->buf + (f)->pkt_offset)
+
+/** max number of disjoint ranges of data tracked per tracker. If a
+ *  datagram has more holes than this we fall back to checking the frag
+ *  list for holes on every fragment. */
+#define DEFRAG_MAX_RANGES 16
+
+/**
+ * A range of fragment data that has been received, relative to the
+ * start of the fragmentable part.
+ */
+typedef struct DefragRange_ {
+    uint16_t start;
+    uint16_t end;               /**< Exclusive. */
+} DefragRange;
+
+/** tracker is in the hash, set on insert and cleared when the tracker is
+ *  removed from its hash row. Used to validate per thread cache entries. */
+#define DEFRAG_TRACKER_FLAG_IN_HASH         0x01
+/** the range list overflowed, it can no longer be used to see if all
+ *  data has been received */
+#define DEFRAG_TRACKER_FLAG_RANGES_FULL     0x02
+
 /**
  * A defragmentation tracker.  Used to track fragments that make up a
  * single packet.
@@ -105,6 +135,8 @@ typedef struct DefragTracker_ {
 
     uint8_t remove; /**< remove */
 
+    uint8_t flags; /**< DEFRAG_TRACKER_FLAG_* flags, protected by lock */
+
     Address src_addr; /**< Source address for this tracker. */
     Address dst_addr; /**< Destination address for this tracker. */
 
@@ -119,6 +151,21 @@ typedef struct DefragTracker_ {
 
     TAILQ_HEAD(frag_tailq, Frag_) frags; /**< Head of list of fragments. */
 
+    uint16_t data_start; /**< Lowest offset of any fragment in the list. */
+    uint16_t data_end; /**< Highest end of any fragment in the list. */
+
+    /** Sorted, merged ranges of data received so far. The datagram is
+     *  complete once this is a single range starting at 0 and the last
+     *  fragment has been seen. */
+    DefragRange ranges[DEFRAG_MAX_RANGES];
+    uint8_t ranges_cnt;
+
+    /** Buffer holding the packet copies of all fragments of this
+     *  tracker. Kept when the tracker is recycled, unless it grew large. */
+    uint8_t *buf;
+    uint32_t buf_len;
+    uint32_t buf_size;
+
     /** hash pointers, protected by hash row mutex/spin */
     struct DefragTracker_ *hnext;
     struct DefragTracker_ *hprev;
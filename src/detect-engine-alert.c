@@ -18,6 +18,8 @@
 #include "suricata-common.h"
 
 #include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
 #include "detect-engine-alert.h"
 #include "detect-engine-threshold.h"
 #include "detect-engine-tag.h"
@@ -26,6 +28,13 @@
 
 #include "flow.h"
 #include "flow-private.h"
+#include "packet-queue.h"
+#include "pkt-var.h"
+
+#include "conf.h"
+#include "util-hash-lookup3.h"
+#include "util-unittest.h"
+#include "util-unittest-helper.h"
 
 /** tag signature we use for tag alerts */
 static Signature g_tag_signature;
@@ -94,6 +103,305 @@ static int PacketAlertHandle(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det
 }
 
 
+/** default aggregation window in seconds */
+#define ALERT_AGG_DEFAULT_WINDOW        60
+/** default max number of tuples tracked per thread */
+#define ALERT_AGG_DEFAULT_MAX_ENTRIES   16384
+
+/** words in the aggregation key: gid, sid, dport, family, src, dst */
+#define ALERT_AGG_KEY_LEN               12
+
+/** \brief aggregation state of a (sig, src, dst, dport) tuple */
+typedef struct AlertAggEntry_ {
+    uint32_t key[ALERT_AGG_KEY_LEN];
+    /** packet time (sec) of the alert that was last logged */
+    uint32_t window_start;
+    /** alerts suppressed since then */
+    uint32_t suppressed;
+    /** signature, proto and source port of the last suppressed alert,
+     *  for the count record on expiry */
+    Signature *s;
+    uint16_t sp;
+    uint8_t proto;
+    struct AlertAggEntry_ *next;
+} AlertAggEntry;
+
+/** \brief per detect thread aggregation table */
+typedef struct AlertAggThreadCtx_ {
+    AlertAggEntry **hash;
+    uint32_t hash_size;
+
+    /** preallocated entries, unused ones are on the free list */
+    AlertAggEntry *entries;
+    AlertAggEntry *free_list;
+
+    /** packet time (sec) of the last flush of expired entries */
+    uint32_t last_flush;
+} AlertAggThreadCtx;
+
+/**
+ * \brief Load the alert-aggregation config into the detection engine.
+ *
+ * \param de_ctx Detection Context
+ */
+void PacketAlertAggregationLoadConf(DetectEngineCtx *de_ctx) {
+    ConfNode *node = ConfGetNode("alert-aggregation");
+    intmax_t value;
+
+    de_ctx->alert_agg_window = 0;
+    de_ctx->alert_agg_max_entries = ALERT_AGG_DEFAULT_MAX_ENTRIES;
+
+    if (node == NULL || !ConfNodeChildValueIsTrue(node, "enabled"))
+        return;
+
+    de_ctx->alert_agg_window = ALERT_AGG_DEFAULT_WINDOW;
+    if (ConfGetChildValueInt(node, "window", &value) == 1) {
+        if (value <= 0) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "alert-aggregation.window "
+                    "must be a positive number of seconds, using %d",
+                    ALERT_AGG_DEFAULT_WINDOW);
+        } else {
+            de_ctx->alert_agg_window = (uint32_t)value;
+        }
+    }
+    if (ConfGetChildValueInt(node, "max-entries", &value) == 1) {
+        if (value <= 0 || value > UINT32_MAX) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "alert-aggregation.max-entries "
+                    "invalid, using %d", ALERT_AGG_DEFAULT_MAX_ENTRIES);
+        } else {
+            de_ctx->alert_agg_max_entries = (uint32_t)value;
+        }
+    }
+
+    SCLogInfo("alert aggregation enabled: window %us, %u tuples per thread",
+            de_ctx->alert_agg_window, de_ctx->alert_agg_max_entries);
+}
+
+/**
+ * \brief Set up the aggregation table of a detect thread.
+ *
+ * \retval 0 ok (also if aggregation is disabled)
+ * \retval -1 error
+ */
+int PacketAlertAggregationThreadInit(DetectEngineCtx *de_ctx,
+                                     DetectEngineThreadCtx *det_ctx) {
+    uint32_t i;
+
+    if (de_ctx->alert_agg_window == 0)
+        return 0;
+
+    AlertAggThreadCtx *agg = SCMalloc(sizeof(AlertAggThreadCtx));
+    if (unlikely(agg == NULL))
+        return -1;
+    memset(agg, 0x00, sizeof(AlertAggThreadCtx));
+
+    agg->hash_size = de_ctx->alert_agg_max_entries;
+    agg->hash = SCMalloc(agg->hash_size * sizeof(AlertAggEntry *));
+    agg->entries = SCMalloc(de_ctx->alert_agg_max_entries * sizeof(AlertAggEntry));
+    if (agg->hash == NULL || agg->entries == NULL) {
+        det_ctx->alert_agg = agg;
+        PacketAlertAggregationThreadDeinit(det_ctx);
+        return -1;
+    }
+    memset(agg->hash, 0x00, agg->hash_size * sizeof(AlertAggEntry *));
+
+    for (i = 0; i < de_ctx->alert_agg_max_entries; i++) {
+        agg->entries[i].next = agg->free_list;
+        agg->free_list = &agg->entries[i];
+    }
+
+    det_ctx->alert_agg = agg;
+    return 0;
+}
+
+void PacketAlertAggregationThreadDeinit(DetectEngineThreadCtx *det_ctx) {
+    AlertAggThreadCtx *agg = det_ctx->alert_agg;
+    if (agg == NULL)
+        return;
+
+    if (agg->hash != NULL)
+        SCFree(agg->hash);
+    if (agg->entries != NULL)
+        SCFree(agg->entries);
+    SCFree(agg);
+    det_ctx->alert_agg = NULL;
+}
+
+/**
+ * \internal
+ * \brief Build the record of the alerts an entry coalesced: a header only
+ *        pseudo packet for the tuple, carrying one alert with the count.
+ *
+ * \retval rp record packet or NULL on error
+ */
+static Packet *PacketAlertAggregationRecord(AlertAggEntry *e, Packet *p) {
+    Packet *rp = PacketGetFromAlloc();
+    if (unlikely(rp == NULL))
+        return NULL;
+
+    rp->ts = p->ts;
+    rp->datalink = DLT_RAW;
+    rp->proto = e->proto;
+    rp->sp = e->sp;
+    rp->dp = (uint16_t)e->key[2];
+    rp->src.family = rp->dst.family = (char)e->key[3];
+    memcpy(rp->src.addr_data32, &e->key[4], 4 * sizeof(uint32_t));
+    memcpy(rp->dst.addr_data32, &e->key[8], 4 * sizeof(uint32_t));
+    /* not a real packet: no verdict, not written to pcap */
+    rp->flags |= PKT_PSEUDO_STREAM_END|PKT_STREAM_NOPCAPLOG;
+
+    if (rp->src.family == AF_INET) {
+        rp->ip4h = (IPV4Hdr *)GET_PKT_DATA(rp);
+        rp->ip4h->ip_verhl = 0x45;
+        rp->ip4h->ip_len = htons(20);
+        rp->ip4h->ip_ttl = 64;
+        rp->ip4h->ip_proto = e->proto;
+        rp->ip4h->s_ip_src.s_addr = rp->src.addr_data32[0];
+        rp->ip4h->s_ip_dst.s_addr = rp->dst.addr_data32[0];
+        rp->ip4h->ip_csum = IPV4CalculateChecksum((uint16_t *)rp->ip4h,
+                IPV4_GET_RAW_HLEN(rp->ip4h));
+        SET_PKT_LEN(rp, 20);
+    } else {
+        rp->ip6h = (IPV6Hdr *)GET_PKT_DATA(rp);
+        rp->ip6h->s_ip6_vfc = 0x60;
+        rp->ip6h->s_ip6_nxt = e->proto;
+        rp->ip6h->s_ip6_hlim = 64;
+        memcpy(rp->ip6h->s_ip6_src, rp->src.addr_data32, 4 * sizeof(uint32_t));
+        memcpy(rp->ip6h->s_ip6_dst, rp->dst.addr_data32, 4 * sizeof(uint32_t));
+        rp->ip6vars.l4proto = e->proto;
+        SET_PKT_LEN(rp, 40);
+    }
+
+    rp->alerts.alerts[0].num = e->s->num;
+    rp->alerts.alerts[0].order_id = e->s->order_id;
+    rp->alerts.alerts[0].action = e->s->action;
+    rp->alerts.alerts[0].flags = 0;
+    rp->alerts.alerts[0].count = e->suppressed;
+    rp->alerts.alerts[0].s = e->s;
+    rp->alerts.cnt = 1;
+
+    return rp;
+}
+
+/**
+ * \brief Expire the aggregation entries whose window has passed.
+ *
+ * Called for every packet from Detect(), at most once per window of
+ * packet time. For an entry that coalesced alerts in its window a record
+ * carrying the count is queued in pq, so the count is logged even if the
+ * tuple doesn't alert again.
+ *
+ * \param det_ctx detection engine thread ctx
+ * \param p       packet driving the time
+ * \param pq      queue the records are added to, to be passed on to the
+ *                output modules
+ */
+void PacketAlertAggregationTimeout(DetectEngineThreadCtx *det_ctx, Packet *p,
+                                   PacketQueue *pq) {
+    AlertAggThreadCtx *agg = det_ctx->alert_agg;
+    uint32_t i;
+
+    if (agg == NULL)
+        return;
+
+    uint32_t now = (uint32_t)p->ts.tv_sec;
+    uint32_t window = det_ctx->de_ctx->alert_agg_window;
+    if (now - agg->last_flush < window)
+        return;
+
+    for (i = 0; i < agg->hash_size; i++) {
+        AlertAggEntry **prev = &agg->hash[i];
+        AlertAggEntry *e = agg->hash[i];
+        while (e != NULL) {
+            AlertAggEntry *next = e->next;
+            if (now - e->window_start >= window) {
+                if (e->suppressed > 0 && pq != NULL) {
+                    Packet *rp = PacketAlertAggregationRecord(e, p);
+                    if (rp != NULL)
+                        PacketEnqueue(pq, rp);
+                }
+                *prev = next;
+                e->next = agg->free_list;
+                agg->free_list = e;
+            } else {
+                prev = &e->next;
+            }
+            e = next;
+        }
+    }
+
+    agg->last_flush = now;
+}
+
+/**
+ * \internal
+ * \brief Coalesce an alert with the identical alerts (same sig, source,
+ *        destination and destination port) of the current window.
+ *
+ * The first alert of a window is logged, the others in the window are
+ * only counted. The first alert of the next window carries that count,
+ * unless PacketAlertAggregationTimeout() expired the entry and logged the
+ * count in a record before.
+ *
+ * \retval 1 log the alert, pa->count is set
+ * \retval 0 alert is coalesced into the logged one
+ */
+static int PacketAlertAggregate(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx,
+                                Signature *s, Packet *p, PacketAlert *pa) {
+    AlertAggThreadCtx *agg = det_ctx->alert_agg;
+    uint32_t now = (uint32_t)p->ts.tv_sec;
+    uint32_t window = de_ctx->alert_agg_window;
+    uint32_t key[ALERT_AGG_KEY_LEN];
+
+    key[0] = s->gid;
+    key[1] = s->id;
+    key[2] = p->dp;
+    key[3] = (uint32_t)p->src.family;
+    memcpy(&key[4], p->src.addr_data32, 4 * sizeof(uint32_t));
+    memcpy(&key[8], p->dst.addr_data32, 4 * sizeof(uint32_t));
+
+    uint32_t hash = hashword(key, ALERT_AGG_KEY_LEN, 0) % agg->hash_size;
+
+    AlertAggEntry *e;
+    for (e = agg->hash[hash]; e != NULL; e = e->next) {
+        if (memcmp(e->key, key, sizeof(key)) == 0)
+            break;
+    }
+
+    if (e == NULL) {
+        /* table full: log the alert as is */
+        if (agg->free_list == NULL)
+            return 1;
+
+        e = agg->free_list;
+        agg->free_list = e->next;
+
+        memcpy(e->key, key, sizeof(key));
+        e->suppressed = 0;
+        e->s = s;
+        e->sp = p->sp;
+        e->proto = IP_GET_IPPROTO(p);
+        e->window_start = now;
+        e->next = agg->hash[hash];
+        agg->hash[hash] = e;
+        return 1;
+    }
+
+    if (now - e->window_start < window) {
+        e->suppressed++;
+        e->s = s;
+        e->sp = p->sp;
+        e->proto = IP_GET_IPPROTO(p);
+        SCPerfCounterIncr(det_ctx->counter_alerts_aggregated, det_ctx->tv->sc_perf_pca);
+        return 0;
+    }
+
+    pa->count += e->suppressed;
+    e->suppressed = 0;
+    e->window_start = now;
+    return 1;
+}
+
 /**
  * \brief Check if a certain sid alerted, this is used in the test functions
  *
@@ -170,6 +478,7 @@ int PacketAlertAppend(DetectEngineThreadCtx *det_ctx, Signature *s, Packet *p, u
         p->alerts.alerts[p->alerts.cnt].order_id = s->order_id;
         p->alerts.alerts[p->alerts.cnt].action = s->action;
         p->alerts.alerts[p->alerts.cnt].flags = flags;
+        p->alerts.alerts[p->alerts.cnt].count = 1;
         p->alerts.alerts[p->alerts.cnt].s = s;
     } else {
         /* We need to make room for this s->num
@@ -184,6 +493,7 @@ int PacketAlertAppend(DetectEngineThreadCtx *det_ctx, Signature *s, Packet *p, u
         p->alerts.alerts[i].order_id = s->order_id;
         p->alerts.alerts[i].action = s->action;
         p->alerts.alerts[i].flags = flags;
+        p->alerts.alerts[i].count = 1;
         p->alerts.alerts[i].s = s;
     }
 
@@ -269,6 +579,15 @@ void PacketAlertFinalize(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
                 p->flow->flags |= FLOW_ACTION_DROP;
                 FLOWLOCK_UNLOCK(p->flow);
             }
+
+            /* identical alerts in the aggregation window are only counted,
+             * the rule actions above still apply to the packet */
+            if (res == 1 && det_ctx->alert_agg != NULL &&
+                (PKT_IS_IPV4(p) || PKT_IS_IPV6(p)) &&
+                PacketAlertAggregate(de_ctx, det_ctx, s, p, &p->alerts.alerts[i]) == 0)
+            {
+                res = 2;
+            }
         }
 
         /* Thresholding removes this alert */
@@ -288,3 +607,287 @@ void PacketAlertFinalize(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
 }
 
 
+
+#ifdef UNITTESTS
+
+/** \test identical alerts within the window are coalesced, the next
+ *        logged alert carries their count */
+static int DetectEngineAlertAggregationTest01(void) {
+    Packet *p = NULL;
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    int result = 0;
+
+    memset(&tv, 0, sizeof(tv));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL) {
+        goto end;
+    }
+
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->alert_agg_window = 60;
+    de_ctx->alert_agg_max_entries = 16;
+
+    de_ctx->sig_list = SigInit(de_ctx, "alert tcp any any -> any any (msg:\"Test agg\"; "
+                               "content:\"boo\"; sid:1;)");
+    if (de_ctx->sig_list == NULL) {
+        goto end;
+    }
+
+    SigGroupBuild(de_ctx);
+    tv.name = "detect_test";
+    DetectEngineThreadCtxInit(&tv, de_ctx, (void *)&det_ctx);
+
+    p = UTHBuildPacket((uint8_t *)"boo", strlen("boo"), IPPROTO_TCP);
+    p->ts.tv_sec = 1000;
+
+    /* first alert of the window is logged */
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1 || p->alerts.alerts[0].count != 1) {
+        printf("first alert not logged: ");
+        goto end;
+    }
+
+    /* the next ones in the window are coalesced */
+    p->ts.tv_sec = 1010;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 0) {
+        printf("second alert not coalesced: ");
+        goto end;
+    }
+    p->ts.tv_sec = 1059;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 0) {
+        printf("third alert not coalesced: ");
+        goto end;
+    }
+
+    /* a different destination port is a different tuple */
+    p->dp++;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1 || p->alerts.alerts[0].count != 1) {
+        printf("alert for other port not logged: ");
+        goto end;
+    }
+    p->dp--;
+
+    /* next window: logged with the count of the coalesced ones */
+    p->ts.tv_sec = 1060;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1 || p->alerts.alerts[0].count != 3) {
+        printf("alert in next window not logged with count 3: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    UTHFreePackets(&p, 1);
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        if (det_ctx != NULL)
+            DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    return result;
+}
+
+/** \test a full table logs alerts of new tuples uncoalesced and the
+ *        flush frees the entries of passed windows */
+static int DetectEngineAlertAggregationTest02(void) {
+    Packet *p = NULL;
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    PacketQueue pq;
+    int result = 0;
+    int i;
+
+    memset(&tv, 0, sizeof(tv));
+    memset(&pq, 0, sizeof(pq));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL) {
+        goto end;
+    }
+
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->alert_agg_window = 10;
+    de_ctx->alert_agg_max_entries = 2;
+
+    de_ctx->sig_list = SigInit(de_ctx, "alert tcp any any -> any any (msg:\"Test agg\"; "
+                               "content:\"boo\"; sid:1;)");
+    if (de_ctx->sig_list == NULL) {
+        goto end;
+    }
+
+    SigGroupBuild(de_ctx);
+    tv.name = "detect_test";
+    DetectEngineThreadCtxInit(&tv, de_ctx, (void *)&det_ctx);
+
+    p = UTHBuildPacket((uint8_t *)"boo", strlen("boo"), IPPROTO_TCP);
+    p->ts.tv_sec = 1000;
+
+    /* fill the table with 2 tuples, the 3rd doesn't fit */
+    for (i = 0; i < 3; i++) {
+        p->dp = 80 + i;
+        SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+        if (PacketAlertCheck(p, 1) != 1) {
+            printf("alert %d not logged: ", i);
+            goto end;
+        }
+    }
+    if (det_ctx->alert_agg->free_list != NULL) {
+        printf("table should be full: ");
+        goto end;
+    }
+
+    /* untracked tuple isn't coalesced */
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1) {
+        printf("untracked tuple coalesced: ");
+        goto end;
+    }
+
+    /* after the window the flush makes room for it */
+    p->ts.tv_sec = 1010;
+    PacketAlertAggregationTimeout(det_ctx, p, &pq);
+    if (pq.len != 0) {
+        printf("records queued for tuples without coalesced alerts: ");
+        goto end;
+    }
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1) {
+        printf("alert after flush not logged: ");
+        goto end;
+    }
+    p->ts.tv_sec = 1011;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 0) {
+        printf("alert after flush not coalesced: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    UTHFreePackets(&p, 1);
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        if (det_ctx != NULL)
+            DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    return result;
+}
+
+/** \test an expired entry that coalesced alerts logs its count in a
+ *        record, even if the tuple doesn't alert again */
+static int DetectEngineAlertAggregationTest03(void) {
+    Packet *p = NULL;
+    Packet *rp = NULL;
+    ThreadVars tv;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    PacketQueue pq;
+    int result = 0;
+
+    memset(&tv, 0, sizeof(tv));
+    memset(&pq, 0, sizeof(pq));
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL) {
+        goto end;
+    }
+
+    de_ctx->flags |= DE_QUIET;
+    de_ctx->alert_agg_window = 10;
+    de_ctx->alert_agg_max_entries = 16;
+
+    de_ctx->sig_list = SigInit(de_ctx, "alert tcp any any -> any any (msg:\"Test agg\"; "
+                               "content:\"boo\"; sid:1;)");
+    if (de_ctx->sig_list == NULL) {
+        goto end;
+    }
+
+    SigGroupBuild(de_ctx);
+    tv.name = "detect_test";
+    DetectEngineThreadCtxInit(&tv, de_ctx, (void *)&det_ctx);
+
+    p = UTHBuildPacket((uint8_t *)"boo", strlen("boo"), IPPROTO_TCP);
+    p->ts.tv_sec = 1000;
+    PacketAlertAggregationTimeout(det_ctx, p, &pq);
+
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    p->ts.tv_sec = 1002;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    p->ts.tv_sec = 1004;
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 0) {
+        printf("alerts not coalesced: ");
+        goto end;
+    }
+
+    /* still in the window */
+    p->ts.tv_sec = 1009;
+    PacketAlertAggregationTimeout(det_ctx, p, &pq);
+    if (pq.len != 0) {
+        printf("record queued before the window passed: ");
+        goto end;
+    }
+
+    /* window passed: the 2 coalesced alerts are logged in a record */
+    p->ts.tv_sec = 1010;
+    PacketAlertAggregationTimeout(det_ctx, p, &pq);
+    if (pq.len != 1) {
+        printf("no record queued: ");
+        goto end;
+    }
+    rp = PacketDequeue(&pq);
+    if (rp->alerts.cnt != 1 || rp->alerts.alerts[0].s == NULL ||
+        rp->alerts.alerts[0].s->id != 1 || rp->alerts.alerts[0].count != 2) {
+        printf("record doesn't carry sid 1 with count 2: ");
+        goto end;
+    }
+    if (!PKT_IS_IPV4(rp) || IPV4_GET_IPPROTO(rp) != IPPROTO_TCP ||
+        rp->dp != p->dp || rp->sp != p->sp ||
+        CMP_ADDR(&rp->src, &p->src) == 0 || CMP_ADDR(&rp->dst, &p->dst) == 0) {
+        printf("record tuple doesn't match the alerts: ");
+        goto end;
+    }
+
+    /* the entry is gone, the next alert starts over */
+    SigMatchSignatures(&tv, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1) != 1 || p->alerts.alerts[0].count != 1) {
+        printf("alert after the record not logged with count 1: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (rp != NULL) {
+        PACKET_CLEANUP(rp);
+        SCFree(rp);
+    }
+    UTHFreePackets(&p, 1);
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        if (det_ctx != NULL)
+            DetectEngineThreadCtxDeinit(&tv, (void *)det_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void DetectEngineAlertRegisterTests(void) {
+#ifdef UNITTESTS
+    UtRegisterTest("DetectEngineAlertAggregationTest01",
+                   DetectEngineAlertAggregationTest01, 1);
+    UtRegisterTest("DetectEngineAlertAggregationTest02",
+                   DetectEngineAlertAggregationTest02, 1);
+    UtRegisterTest("DetectEngineAlertAggregationTest03",
+                   DetectEngineAlertAggregationTest03, 1);
+#endif /* UNITTESTS */
+}
@@ -34,5 +34,10 @@ int PacketAlertCheck(Packet *, uint32_t);
 int PacketAlertRemove(Packet *, uint16_t);
 void PacketAlertTagInit(void);
 PacketAlert *PacketAlertGetTag(void);
+void PacketAlertAggregationLoadConf(DetectEngineCtx *);
+int PacketAlertAggregationThreadInit(DetectEngineCtx *, DetectEngineThreadCtx *);
+void PacketAlertAggregationThreadDeinit(DetectEngineThreadCtx *);
+void PacketAlertAggregationTimeout(DetectEngineThreadCtx *, Packet *, PacketQueue *);
+void DetectEngineAlertRegisterTests(void);
 
 #endif /* __DETECT_ENGINE_ALERT_H__ */
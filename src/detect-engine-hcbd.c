@@ -53,6 +53,7 @@
 #include "util-unittest-helper.h"
 #include "app-layer.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-protos.h"
 
 #define BUFFER_STEP 50
@@ -180,41 +181,21 @@ static uint8_t *DetectEngineHCBDGetBufferForTX(int tx_id,
         goto end;
     }
 
-    int first = 1;
-    while (cur != NULL) {
-        /* see if we can filter out chunks */
-        if (htud->request_body.body_inspected > 0) {
-            if (cur->stream_offset < htud->request_body.body_inspected) {
-                if ((htud->request_body.body_inspected - cur->stream_offset) > htp_state->cfg->request_inspect_min_size) {
-                    cur = cur->next;
-                    continue;
-                } else {
-                    /* include this one */
-                }
-            } else {
-                /* include this one */
-            }
-        }
-
-        if (first) {
-            det_ctx->hcbd[index].offset = cur->stream_offset;
-            first = 0;
+    /* skip the chunks that were inspected already, except for the ones
+     * in the inspect window */
+    if (htud->request_body.body_inspected > 0) {
+        while (cur != NULL && cur->stream_offset < htud->request_body.body_inspected &&
+               (htud->request_body.body_inspected - cur->stream_offset) > htp_state->cfg->request_inspect_min_size) {
+            cur = cur->next;
         }
+    }
 
-        /* see if we need to grow the buffer */
-        if (det_ctx->hcbd[index].buffer == NULL || (det_ctx->hcbd[index].buffer_len + cur->len) > det_ctx->hcbd[index].buffer_size) {
-            det_ctx->hcbd[index].buffer_size += cur->len * 2;
-
-            if ((det_ctx->hcbd[index].buffer = SCRealloc(det_ctx->hcbd[index].buffer, det_ctx->hcbd[index].buffer_size)) == NULL) {
-                det_ctx->hcbd[index].buffer_size = 0;
-                det_ctx->hcbd[index].buffer_len = 0;
-                goto end;
-            }
-        }
-        memcpy(det_ctx->hcbd[index].buffer + det_ctx->hcbd[index].buffer_len, cur->data, cur->len);
-        det_ctx->hcbd[index].buffer_len += cur->len;
-
-        cur = cur->next;
+    /* the chunks are stored back to back in the body arena, so the
+     * buffer is a window into it and needs no copying */
+    if (cur != NULL) {
+        det_ctx->hcbd[index].offset = cur->stream_offset;
+        det_ctx->hcbd[index].buffer = HtpBodyGetWindow(&htud->request_body, cur,
+                &det_ctx->hcbd[index].buffer_len);
     }
 
     /* update inspected tracker */
@@ -304,6 +285,7 @@ void DetectEngineCleanHCBDBuffers(DetectEngineThreadCtx *det_ctx)
 {
     if (det_ctx->hcbd_buffers_list_len > 0) {
         for (int i = 0; i < det_ctx->hcbd_buffers_list_len; i++) {
+            det_ctx->hcbd[i].buffer = NULL;
             det_ctx->hcbd[i].buffer_len = 0;
             det_ctx->hcbd[i].offset = 0;
         }
@@ -88,21 +88,10 @@ int DetectEngineRunHttpCookieMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
         if (tx == NULL)
             continue;
 
-        htp_header_t *h = NULL;
-        if (flags & STREAM_TOSERVER) {
-            h = (htp_header_t *)table_getc(tx->request_headers,
-                                           "Cookie");
-            if (h == NULL) {
-                SCLogDebug("HTTP cookie header not present in this request");
-                continue;
-            }
-        } else {
-            h = (htp_header_t *)table_getc(tx->response_headers,
-                                           "Set-Cookie");
-            if (h == NULL) {
-                SCLogDebug("HTTP Set-Cookie header not present in this request");
-                continue;
-            }
+        htp_header_t *h = HtpTxGetCookieHeader(tx, flags);
+        if (h == NULL) {
+            SCLogDebug("HTTP cookie header not present in this tx");
+            continue;
         }
 
         cnt += HttpCookiePatternSearch(det_ctx,
@@ -139,21 +128,10 @@ int DetectEngineInspectHttpCookie(ThreadVars *tv,
     if (tx == NULL)
         return 0;
 
-    htp_header_t *h = NULL;
-    if (flags & STREAM_TOSERVER) {
-        h = (htp_header_t *)table_getc(tx->request_headers,
-                                       "Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP cookie header not present in this request");
-            return 0;
-        }
-    } else {
-        h = (htp_header_t *)table_getc(tx->response_headers,
-                                       "Set-Cookie");
-        if (h == NULL) {
-            SCLogDebug("HTTP Set-Cookie header not present in this request");
-            return 0;
-        }
+    htp_header_t *h = HtpTxGetCookieHeader(tx, flags);
+    if (h == NULL) {
+        SCLogDebug("HTTP cookie header not present in this tx");
+        return 0;
     }
 
     det_ctx->buffer_offset = 0;
@@ -32,7 +32,6 @@ int DetectEngineInspectHttpHeader(ThreadVars *tv,
                                   void *alstate, int tx_id);
 int DetectEngineRunHttpHeaderMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
                                  HtpState *htp_state, uint8_t flags);
-void DetectEngineCleanHHDBuffers(DetectEngineThreadCtx *det_ctx);
 
 void DetectEngineHttpHeaderRegisterTests(void);
 
@@ -54,6 +54,7 @@
 #include "util-unittest-helper.h"
 #include "app-layer.h"
 #include "app-layer-htp.h"
+#include "app-layer-htp-body.h"
 #include "app-layer-protos.h"
 
 #define BUFFER_STEP 50
@@ -181,41 +182,21 @@ static uint8_t *DetectEngineHSBDGetBufferForTX(int tx_id,
         goto end;
     }
 
-    int first = 1;
-    while (cur != NULL) {
-        /* see if we can filter out chunks */
-        if (htud->response_body.body_inspected > 0) {
-            if (cur->stream_offset < htud->response_body.body_inspected) {
-                if ((htud->response_body.body_inspected - cur->stream_offset) > htp_state->cfg->response_inspect_window) {
-                    cur = cur->next;
-                    continue;
-                } else {
-                    /* include this one */
-                }
-            } else {
-                /* include this one */
-            }
-        }
-
-        if (first) {
-            det_ctx->hsbd[index].offset = cur->stream_offset;
-            first = 0;
+    /* skip the chunks that were inspected already, except for the ones
+     * in the inspect window */
+    if (htud->response_body.body_inspected > 0) {
+        while (cur != NULL && cur->stream_offset < htud->response_body.body_inspected &&
+               (htud->response_body.body_inspected - cur->stream_offset) > htp_state->cfg->response_inspect_window) {
+            cur = cur->next;
         }
+    }
 
-        /* see if we need to grow the buffer */
-        if (det_ctx->hsbd[index].buffer == NULL || (det_ctx->hsbd[index].buffer_len + cur->len) > det_ctx->hsbd[index].buffer_size) {
-            det_ctx->hsbd[index].buffer_size += cur->len * 2;
-
-            if ((det_ctx->hsbd[index].buffer = SCRealloc(det_ctx->hsbd[index].buffer, det_ctx->hsbd[index].buffer_size)) == NULL) {
-                det_ctx->hsbd[index].buffer_size = 0;
-                det_ctx->hsbd[index].buffer_len = 0;
-                goto end;
-            }
-        }
-        memcpy(det_ctx->hsbd[index].buffer + det_ctx->hsbd[index].buffer_len, cur->data, cur->len);
-        det_ctx->hsbd[index].buffer_len += cur->len;
-
-        cur = cur->next;
+    /* the chunks are stored back to back in the body arena, so the
+     * buffer is a window into it and needs no copying */
+    if (cur != NULL) {
+        det_ctx->hsbd[index].offset = cur->stream_offset;
+        det_ctx->hsbd[index].buffer = HtpBodyGetWindow(&htud->response_body, cur,
+                &det_ctx->hsbd[index].buffer_len);
     }
 
     /* update inspected tracker */
@@ -304,6 +285,7 @@ void DetectEngineCleanHSBDBuffers(DetectEngineThreadCtx *det_ctx)
 {
     if (det_ctx->hsbd_buffers_list_len > 0) {
         for (int i = 0; i < det_ctx->hsbd_buffers_list_len; i++) {
+            det_ctx->hsbd[i].buffer = NULL;
             det_ctx->hsbd[i].buffer_len = 0;
             det_ctx->hsbd[i].offset = 0;
         }
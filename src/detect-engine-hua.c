@@ -89,8 +89,7 @@ int DetectEngineRunHttpUAMpm(DetectEngineThreadCtx *det_ctx, Flow *f,
         if (tx == NULL)
             continue;
 
-        htp_header_t *h = (htp_header_t *)table_getc(tx->request_headers,
-                                                     "User-Agent");
+        htp_header_t *h = HtpTxGetUserAgentHeader(tx);
         if (h == NULL) {
             SCLogDebug("HTTP user agent header not present in this request");
             continue;
@@ -130,8 +129,7 @@ int DetectEngineInspectHttpUA(ThreadVars *tv,
     if (tx == NULL)
         return 0;
 
-    htp_header_t *h = (htp_header_t *)table_getc(tx->request_headers,
-                                                 "User-Agent");
+    htp_header_t *h = HtpTxGetUserAgentHeader(tx);
     if (h == NULL) {
         SCLogDebug("HTTP user agent header not present in this request");
         return 0;
@@ -828,6 +828,15 @@ error:
     return -1;
 }
 
+static void IPOnlyIPV4TableFree(IPOnlyIPV4Table *t)
+{
+    if (t->start != NULL)
+        SCFree(t->start);
+    if (t->id != NULL)
+        SCFree(t->id);
+    memset(t, 0x00, sizeof(IPOnlyIPV4Table));
+}
+
 /**
  * \brief Setup the IP Only detection engine context
  *
@@ -872,6 +881,12 @@ void DetectEngineIPOnlyThreadInit(DetectEngineCtx *de_ctx,
     }
 
     memset(io_tctx->sig_match_array, 0, io_tctx->sig_match_size);
+
+    memset(io_tctx->pair_cache, 0x00, sizeof(io_tctx->pair_cache));
+    io_tctx->pair_results = SCMalloc(IPONLY_PAIR_CACHE_SIZE * io_tctx->sig_match_size);
+    if (io_tctx->pair_results == NULL) {
+        exit(EXIT_FAILURE);
+    }
 }
 
 /**
@@ -907,6 +922,13 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx) {
     if (io_ctx->tree_ipv6dst != NULL)
         SCRadixReleaseRadixTree(io_ctx->tree_ipv6dst);
 
+    IPOnlyIPV4TableFree(&io_ctx->table_ipv4src);
+    IPOnlyIPV4TableFree(&io_ctx->table_ipv4dst);
+    if (io_ctx->sets != NULL)
+        SCFree(io_ctx->sets);
+    io_ctx->sets = NULL;
+    io_ctx->sets_cnt = 0;
+
     if (io_ctx->sig_init_array)
         SCFree(io_ctx->sig_init_array);
 
@@ -921,6 +943,8 @@ void IPOnlyDeinit(DetectEngineCtx *de_ctx, DetectEngineIPOnlyCtx *io_ctx) {
  */
 void DetectEngineIPOnlyThreadDeinit(DetectEngineIPOnlyThreadCtx *io_tctx) {
     SCFree(io_tctx->sig_match_array);
+    if (io_tctx->pair_results != NULL)
+        SCFree(io_tctx->pair_results);
 }
 
 static inline
@@ -943,6 +967,166 @@ int IPOnlyMatchCompatSMs(ThreadVars *tv,
     return 1;
 }
 
+/**
+ * \brief Check the signatures set in a bit array against the packet and
+ *        append the alerts.
+ *
+ * \param match_array bit array of sig nums, the intersection of the src
+ *                    and dst sets for the packet
+ * \param size size in bytes of the array
+ */
+static void IPOnlyMatchSigs(ThreadVars *tv, DetectEngineCtx *de_ctx,
+                            DetectEngineThreadCtx *det_ctx,
+                            const uint8_t *match_array, uint32_t size,
+                            Packet *p)
+{
+    uint32_t u;
+    for (u = 0; u < size; u++) {
+        /* We have to move the logic of the signature checking
+         * to the main detect loop, in order to apply the
+         * priority of actions (pass, drop, reject, alert) */
+        if (match_array[u] != 0) {
+            /* We have a match :) Let's see from which signum's */
+            uint8_t bitarray = match_array[u];
+            uint8_t i = 0;
+
+            for (; i < 8; i++, bitarray = bitarray >> 1) {
+                if (bitarray & 0x01) {
+                    Signature *s = de_ctx->sig_array[u * 8 + i];
+
+                    if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
+                        SCLogDebug("ip version didn't match");
+                        continue;
+                    }
+                    if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
+                        SCLogDebug("ip version didn't match");
+                        continue;
+                    }
+
+                    if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
+                        SCLogDebug("proto didn't match");
+                        continue;
+                    }
+
+                    /* check the source & dst port in the sig */
+                    if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
+                        if (!(s->flags & SIG_FLAG_DP_ANY)) {
+                            DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
+                            if (dport == NULL) {
+                                SCLogDebug("dport didn't match.");
+                                continue;
+                            }
+                        }
+                        if (!(s->flags & SIG_FLAG_SP_ANY)) {
+                            DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
+                            if (sport == NULL) {
+                                SCLogDebug("sport didn't match.");
+                                continue;
+                            }
+                        }
+                    }
+
+                    if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
+                        continue;
+                    }
+
+                    SCLogDebug("Signum %"PRIu16" match (sid: %"PRIu16", msg: %s)",
+                               u * 8 + i, s->id, s->msg);
+
+                    if (s->sm_lists[DETECT_SM_LIST_POSTMATCH] != NULL) {
+                        SigMatch *sm = s->sm_lists[DETECT_SM_LIST_POSTMATCH];
+
+                        SCLogDebug("running match functions, sm %p", sm);
+
+                        for ( ; sm != NULL; sm = sm->next) {
+                            (void)sigmatch_table[sm->type].Match(tv, det_ctx, p, s, sm);
+                        }
+                    }
+                    if (!(s->flags & SIG_FLAG_NOALERT)) {
+                        if (s->action & ACTION_DROP)
+                            PacketAlertAppend(det_ctx, s, p, PACKET_ALERT_FLAG_DROP_FLOW);
+                        else
+                            PacketAlertAppend(det_ctx, s, p, 0);
+                    } else {
+                        /* apply actions for noalert/rule suppressed as well */
+                        p->action |= s->action;
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+ * \brief Find the set id of an address in an IPv4 table
+ *
+ * \param addr address in host order
+ *
+ * \retval id set id, 0 if no sigs apply
+ */
+static inline uint32_t IPOnlyIPV4TableLookup(const IPOnlyIPV4Table *t,
+                                             uint32_t addr)
+{
+    /* the first interval starts at 0, find the last one starting
+     * at or before addr */
+    uint32_t lo = 0, hi = t->cnt;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (t->start[mid] <= addr)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return t->id[lo];
+}
+
+/**
+ * \brief Match an IPv4 packet using the compiled interval tables. The
+ *        intersection of the src and dst sets is cached per thread,
+ *        most traffic hits a few set pairs.
+ */
+static void IPOnlyMatchPacketIPV4(ThreadVars *tv,
+                                  DetectEngineCtx *de_ctx,
+                                  DetectEngineThreadCtx *det_ctx,
+                                  DetectEngineIPOnlyCtx *io_ctx,
+                                  DetectEngineIPOnlyThreadCtx *io_tctx,
+                                  Packet *p)
+{
+    uint32_t src_id = IPOnlyIPV4TableLookup(&io_ctx->table_ipv4src,
+                                            ntohl(GET_IPV4_SRC_ADDR_U32(p)));
+    if (src_id == 0)
+        return;
+    uint32_t dst_id = IPOnlyIPV4TableLookup(&io_ctx->table_ipv4dst,
+                                            ntohl(GET_IPV4_DST_ADDR_U32(p)));
+    if (dst_id == 0)
+        return;
+
+    uint32_t h = ((src_id * 0x9e3779b1U) ^ dst_id) & (IPONLY_PAIR_CACHE_SIZE - 1);
+    IPOnlyPairCacheEntry *e = &io_tctx->pair_cache[h];
+    uint8_t *match_array = io_tctx->pair_results + h * io_tctx->sig_match_size;
+
+    if (e->src_id != src_id || e->dst_id != dst_id) {
+        SigNumArray *src = io_ctx->sets[src_id];
+        SigNumArray *dst = io_ctx->sets[dst_id];
+        uint8_t any = 0;
+        uint32_t u;
+
+        for (u = 0; u < io_tctx->sig_match_size; u++) {
+            match_array[u] = dst->array[u] & src->array[u];
+            any |= match_array[u];
+        }
+
+        e->src_id = src_id;
+        e->dst_id = dst_id;
+        e->empty = (any == 0);
+    }
+
+    if (e->empty)
+        return;
+
+    IPOnlyMatchSigs(tv, de_ctx, det_ctx, match_array, io_tctx->sig_match_size, p);
+}
+
 /**
  * \brief Match a packet against the IP Only detection engine contexts
  *
@@ -961,6 +1145,12 @@ void IPOnlyMatchPacket(ThreadVars *tv,
     SigNumArray *src = NULL;
     SigNumArray *dst = NULL;
 
+    if (p->src.family == AF_INET && p->dst.family == AF_INET &&
+        io_ctx->table_ipv4src.cnt > 0 && io_ctx->table_ipv4dst.cnt > 0) {
+        IPOnlyMatchPacketIPV4(tv, de_ctx, det_ctx, io_ctx, io_tctx, p);
+        return;
+    }
+
     if (p->src.family == AF_INET) {
         srcnode = SCRadixFindKeyIPV4BestMatch((uint8_t *)&GET_IPV4_SRC_ADDR_U32(p),
                                               io_ctx->tree_ipv4src);
@@ -1010,80 +1200,310 @@ void IPOnlyMatchPacket(ThreadVars *tv,
 
         /* The final results will be at io_tctx */
         io_tctx->sig_match_array[u] = dst->array[u] & src->array[u];
+    }
 
-        /* We have to move the logic of the signature checking
-         * to the main detect loop, in order to apply the
-         * priority of actions (pass, drop, reject, alert) */
-        if (io_tctx->sig_match_array[u] != 0) {
-            /* We have a match :) Let's see from which signum's */
-            uint8_t bitarray = io_tctx->sig_match_array[u];
-            uint8_t i = 0;
+    IPOnlyMatchSigs(tv, de_ctx, det_ctx, io_tctx->sig_match_array,
+                    src->size, p);
+}
 
-            for (; i < 8; i++, bitarray = bitarray >> 1) {
-                if (bitarray & 0x01) {
-                    Signature *s = de_ctx->sig_array[u * 8 + i];
+typedef struct IPOnlyIPV4Range_ {
+    uint32_t start;
+    uint32_t end;
+    uint8_t netmask;
+    SigNumArray *sna;
+} IPOnlyIPV4Range;
+
+typedef struct IPOnlyRangeList_ {
+    IPOnlyIPV4Range *ranges;
+    uint32_t cnt;
+    uint32_t size;
+} IPOnlyRangeList;
+
+typedef struct IPOnlySetEntry_ {
+    SigNumArray *sna;
+    uint32_t id;
+} IPOnlySetEntry;
+
+static uint32_t IPOnlySetHash(HashListTable *ht, void *data, uint16_t datalen)
+{
+    IPOnlySetEntry *e = (IPOnlySetEntry *)data;
+    uint32_t hash = 0;
+    uint32_t u;
 
-                    if ((s->proto.flags & DETECT_PROTO_IPV4) && !PKT_IS_IPV4(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
-                    if ((s->proto.flags & DETECT_PROTO_IPV6) && !PKT_IS_IPV6(p)) {
-                        SCLogDebug("ip version didn't match");
-                        continue;
-                    }
+    for (u = 0; u < e->sna->size; u++)
+        hash = hash * 31 + e->sna->array[u];
 
-                    if (DetectProtoContainsProto(&s->proto, IP_GET_IPPROTO(p)) == 0) {
-                        SCLogDebug("proto didn't match");
-                        continue;
-                    }
+    return hash % ht->array_size;
+}
 
-                    /* check the source & dst port in the sig */
-                    if (p->proto == IPPROTO_TCP || p->proto == IPPROTO_UDP || p->proto == IPPROTO_SCTP) {
-                        if (!(s->flags & SIG_FLAG_DP_ANY)) {
-                            DetectPort *dport = DetectPortLookupGroup(s->dp,p->dp);
-                            if (dport == NULL) {
-                                SCLogDebug("dport didn't match.");
-                                continue;
-                            }
-                        }
-                        if (!(s->flags & SIG_FLAG_SP_ANY)) {
-                            DetectPort *sport = DetectPortLookupGroup(s->sp,p->sp);
-                            if (sport == NULL) {
-                                SCLogDebug("sport didn't match.");
-                                continue;
-                            }
-                        }
-                    }
+static char IPOnlySetCompare(void *data1, uint16_t len1, void *data2, uint16_t len2)
+{
+    IPOnlySetEntry *e1 = (IPOnlySetEntry *)data1;
+    IPOnlySetEntry *e2 = (IPOnlySetEntry *)data2;
 
-                    if (!IPOnlyMatchCompatSMs(tv, det_ctx, s, p)) {
-                        continue;
-                    }
+    if (e1->sna->size != e2->sna->size)
+        return 0;
+    return (memcmp(e1->sna->array, e2->sna->array, e1->sna->size) == 0);
+}
 
-                    SCLogDebug("Signum %"PRIu16" match (sid: %"PRIu16", msg: %s)",
-                               u * 8 + i, s->id, s->msg);
+static void IPOnlySetFree(void *data)
+{
+    SCFree(data);
+}
 
-                    if (s->sm_lists[DETECT_SM_LIST_POSTMATCH] != NULL) {
-                        SigMatch *sm = s->sm_lists[DETECT_SM_LIST_POSTMATCH];
+/**
+ * \brief Get the set id for a SigNumArray, sets with the same sigs
+ *        share the id.
+ *
+ * \retval id set id, 0 for an empty set, -1 on error
+ */
+static int64_t IPOnlySetGetId(DetectEngineIPOnlyCtx *io_ctx, HashListTable *ht,
+                              SigNumArray *sna)
+{
+    uint32_t u;
 
-                        SCLogDebug("running match functions, sm %p", sm);
+    if (sna == NULL)
+        return 0;
 
-                        for ( ; sm != NULL; sm = sm->next) {
-                            (void)sigmatch_table[sm->type].Match(tv, det_ctx, p, s, sm);
-                        }
-                    }
-                    if (!(s->flags & SIG_FLAG_NOALERT)) {
-                        if (s->action & ACTION_DROP)
-                            PacketAlertAppend(det_ctx, s, p, PACKET_ALERT_FLAG_DROP_FLOW);
-                        else
-                            PacketAlertAppend(det_ctx, s, p, 0);
-                    } else {
-                        /* apply actions for noalert/rule suppressed as well */
-                        p->action |= s->action;
-                    }
-                }
+    for (u = 0; u < sna->size; u++) {
+        if (sna->array[u] != 0)
+            break;
+    }
+    if (u == sna->size)
+        return 0;
+
+    IPOnlySetEntry lookup = { sna, 0 };
+    IPOnlySetEntry *e = HashListTableLookup(ht, &lookup, 0);
+    if (e != NULL)
+        return e->id;
+
+    SigNumArray **sets = SCRealloc(io_ctx->sets,
+                                   (io_ctx->sets_cnt + 1) * sizeof(SigNumArray *));
+    if (sets == NULL)
+        return -1;
+    io_ctx->sets = sets;
+
+    e = SCMalloc(sizeof(IPOnlySetEntry));
+    if (e == NULL)
+        return -1;
+    e->sna = sna;
+    e->id = io_ctx->sets_cnt;
+    if (HashListTableAdd(ht, e, 0) != 0) {
+        SCFree(e);
+        return -1;
+    }
+
+    io_ctx->sets[io_ctx->sets_cnt++] = sna;
+    return e->id;
+}
+
+static int IPOnlyIPV4RangeCollect(SCRadixNode *node, IPOnlyRangeList *list)
+{
+    if (node == NULL)
+        return 0;
+
+    if (node->prefix != NULL && node->prefix->stream != NULL) {
+        SCRadixUserData *ud = node->prefix->user_data;
+        for ( ; ud != NULL; ud = ud->next) {
+            if (list->cnt == list->size) {
+                uint32_t size = list->size ? list->size * 2 : 64;
+                IPOnlyIPV4Range *ptmp = SCRealloc(list->ranges,
+                                                  size * sizeof(IPOnlyIPV4Range));
+                if (ptmp == NULL)
+                    return -1;
+                list->ranges = ptmp;
+                list->size = size;
+            }
+
+            uint32_t addr;
+            memcpy(&addr, node->prefix->stream, sizeof(addr));
+            addr = ntohl(addr);
+
+            uint8_t netmask = (ud->netmask > 32) ? 32 : ud->netmask;
+            uint32_t mask = netmask ? (0xffffffffU << (32 - netmask)) : 0;
+
+            IPOnlyIPV4Range *r = &list->ranges[list->cnt++];
+            r->start = addr & mask;
+            r->end = r->start | ~mask;
+            r->netmask = netmask;
+            r->sna = (SigNumArray *)ud->user;
+        }
+    }
+
+    if (IPOnlyIPV4RangeCollect(node->left, list) != 0)
+        return -1;
+    return IPOnlyIPV4RangeCollect(node->right, list);
+}
+
+static int IPOnlyIPV4RangeCompare(const void *a, const void *b)
+{
+    const IPOnlyIPV4Range *ra = a;
+    const IPOnlyIPV4Range *rb = b;
+
+    if (ra->start != rb->start)
+        return (ra->start < rb->start) ? -1 : 1;
+    /* the bigger network first, it contains the smaller ones */
+    return (int)ra->netmask - (int)rb->netmask;
+}
+
+/**
+ * \brief Add an interval to a table, merging it with the previous one
+ *        if they map to the same set.
+ */
+static int IPOnlyIPV4TableAppend(IPOnlyIPV4Table *t, uint32_t *size,
+                                 uint32_t start, uint32_t id)
+{
+    if (t->cnt > 0 && t->id[t->cnt - 1] == id)
+        return 0;
+
+    if (t->cnt == *size) {
+        uint32_t newsize = *size ? *size * 2 : 64;
+        uint32_t *pstart = SCRealloc(t->start, newsize * sizeof(uint32_t));
+        if (pstart == NULL)
+            return -1;
+        t->start = pstart;
+        uint32_t *pid = SCRealloc(t->id, newsize * sizeof(uint32_t));
+        if (pid == NULL)
+            return -1;
+        t->id = pid;
+        *size = newsize;
+    }
+
+    t->start[t->cnt] = start;
+    t->id[t->cnt] = id;
+    t->cnt++;
+    return 0;
+}
+
+/**
+ * \brief Flatten an IPv4 radix tree into disjoint intervals covering
+ *        the whole address space. CIDR blocks are either nested or
+ *        disjoint, so a sweep over the sorted blocks with a stack of
+ *        the enclosing blocks gives the longest match of every interval.
+ *
+ * \retval 0 ok, -1 on error
+ */
+static int IPOnlyIPV4TableBuild(DetectEngineIPOnlyCtx *io_ctx, HashListTable *ht,
+                                SCRadixTree *tree, IPOnlyIPV4Table *t)
+{
+    IPOnlyRangeList list;
+    IPOnlyIPV4Range *stack[33];
+    int depth = 0;
+    uint32_t size = 0;
+    uint64_t cur = 0;
+    int64_t id;
+    uint32_t i;
+
+    memset(&list, 0x00, sizeof(list));
+    memset(t, 0x00, sizeof(IPOnlyIPV4Table));
+
+    if (IPOnlyIPV4RangeCollect(tree->head, &list) != 0)
+        goto error;
+    if (list.cnt > 0)
+        qsort(list.ranges, list.cnt, sizeof(IPOnlyIPV4Range), IPOnlyIPV4RangeCompare);
+
+    for (i = 0; i < list.cnt; i++) {
+        IPOnlyIPV4Range *r = &list.ranges[i];
+
+        /* close the enclosing blocks that end before this one */
+        while (depth > 0 && stack[depth - 1]->end < r->start) {
+            IPOnlyIPV4Range *top = stack[--depth];
+            if (cur <= top->end) {
+                if ((id = IPOnlySetGetId(io_ctx, ht, top->sna)) < 0)
+                    goto error;
+                if (IPOnlyIPV4TableAppend(t, &size, (uint32_t)cur, (uint32_t)id) != 0)
+                    goto error;
+                cur = (uint64_t)top->end + 1;
             }
         }
+
+        /* the gap up to this block belongs to the innermost open block */
+        if (cur < r->start) {
+            id = (depth > 0) ? IPOnlySetGetId(io_ctx, ht, stack[depth - 1]->sna) : 0;
+            if (id < 0)
+                goto error;
+            if (IPOnlyIPV4TableAppend(t, &size, (uint32_t)cur, (uint32_t)id) != 0)
+                goto error;
+            cur = r->start;
+        }
+
+        /* same block twice, the tree keeps one netmask entry per block */
+        if (depth > 0 && stack[depth - 1]->start == r->start &&
+            stack[depth - 1]->netmask == r->netmask)
+            depth--;
+
+        BUG_ON(depth >= 33);
+        stack[depth++] = r;
+    }
+
+    while (depth > 0) {
+        IPOnlyIPV4Range *top = stack[--depth];
+        if (cur <= top->end) {
+            if ((id = IPOnlySetGetId(io_ctx, ht, top->sna)) < 0)
+                goto error;
+            if (IPOnlyIPV4TableAppend(t, &size, (uint32_t)cur, (uint32_t)id) != 0)
+                goto error;
+            cur = (uint64_t)top->end + 1;
+        }
     }
+    if (cur <= 0xffffffffULL) {
+        if (IPOnlyIPV4TableAppend(t, &size, (uint32_t)cur, 0) != 0)
+            goto error;
+    }
+
+    if (list.ranges != NULL)
+        SCFree(list.ranges);
+    return 0;
+
+error:
+    if (list.ranges != NULL)
+        SCFree(list.ranges);
+    IPOnlyIPV4TableFree(t);
+    return -1;
+}
+
+/**
+ * \brief Compile the IPv4 radix trees into interval tables. On failure
+ *        the tables are left empty and matching uses the radix trees.
+ */
+static void IPOnlyIPV4TablesBuild(DetectEngineIPOnlyCtx *io_ctx)
+{
+    HashListTable *ht = HashListTableInit(4096, IPOnlySetHash,
+                                          IPOnlySetCompare, IPOnlySetFree);
+    if (ht == NULL)
+        return;
+
+    /* set id 0 means no sigs apply */
+    io_ctx->sets = SCMalloc(sizeof(SigNumArray *));
+    if (io_ctx->sets == NULL)
+        goto error;
+    io_ctx->sets[0] = NULL;
+    io_ctx->sets_cnt = 1;
+
+    if (IPOnlyIPV4TableBuild(io_ctx, ht, io_ctx->tree_ipv4src,
+                             &io_ctx->table_ipv4src) != 0)
+        goto error;
+    if (IPOnlyIPV4TableBuild(io_ctx, ht, io_ctx->tree_ipv4dst,
+                             &io_ctx->table_ipv4dst) != 0)
+        goto error;
+
+    SCLogDebug("IPv4 tables: %"PRIu32" src intervals, %"PRIu32" dst intervals, "
+               "%"PRIu32" distinct sets", io_ctx->table_ipv4src.cnt,
+               io_ctx->table_ipv4dst.cnt, io_ctx->sets_cnt - 1);
+
+    HashListTableFree(ht);
+    return;
+
+error:
+    SCLogWarning(SC_ERR_MEM_ALLOC, "building the IP only IPv4 tables failed, "
+                 "using the radix trees");
+    IPOnlyIPV4TableFree(&io_ctx->table_ipv4src);
+    IPOnlyIPV4TableFree(&io_ctx->table_ipv4dst);
+    if (io_ctx->sets != NULL)
+        SCFree(io_ctx->sets);
+    io_ctx->sets = NULL;
+    io_ctx->sets_cnt = 0;
+    HashListTableFree(ht);
 }
 
 /**
@@ -1491,6 +1911,8 @@ void IPOnlyPrepare(DetectEngineCtx *de_ctx) {
     SCRadixPrintTree((de_ctx->io_ctx).tree_ipv6dst);
     SCLogDebug("__________________");
     */
+
+    IPOnlyIPV4TablesBuild(&de_ctx->io_ctx);
 }
 
 /**
@@ -2213,6 +2635,117 @@ int IPOnlyTestSig16(void)
     return result;
 }
 
+/**
+ * \test The compiled IPv4 tables give the same sig sets as the radix trees.
+ */
+static int IPOnlyTestSig17(void)
+{
+    int result = 0;
+    char *addrs[] = { "0.0.0.0", "10.0.0.1", "10.1.0.0", "10.1.255.255",
+                      "10.2.0.0", "192.168.0.1", "192.168.1.1", "192.168.1.5",
+                      "192.168.1.255", "192.168.2.0", "192.169.0.0",
+                      "255.255.255.255", NULL };
+    int i, d;
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL)
+        goto end;
+    de_ctx->flags |= DE_QUIET;
+
+    if (DetectEngineAppendSig(de_ctx, "alert tcp 192.168.1.5 any -> any any "
+                "(sid:1;)") == NULL)
+        goto end;
+    if (DetectEngineAppendSig(de_ctx, "alert tcp 192.168.0.0/16 any -> "
+                "[10.0.0.0/8,!10.1.0.0/16] any (sid:2;)") == NULL)
+        goto end;
+    if (DetectEngineAppendSig(de_ctx, "alert tcp [192.168.1.0/24,10.1.0.0/16] any -> "
+                "192.168.1.1 any (sid:3;)") == NULL)
+        goto end;
+    if (DetectEngineAppendSig(de_ctx, "alert tcp !192.168.1.0/24 any -> any any "
+                "(sid:4;)") == NULL)
+        goto end;
+
+    SigGroupBuild(de_ctx);
+
+    DetectEngineIPOnlyCtx *io_ctx = &de_ctx->io_ctx;
+    if (io_ctx->table_ipv4src.cnt == 0 || io_ctx->table_ipv4dst.cnt == 0) {
+        printf("tables not built: ");
+        goto end;
+    }
+
+    for (d = 0; d < 2; d++) {
+        SCRadixTree *tree = d ? io_ctx->tree_ipv4dst : io_ctx->tree_ipv4src;
+        IPOnlyIPV4Table *table = d ? &io_ctx->table_ipv4dst : &io_ctx->table_ipv4src;
+
+        for (i = 0; addrs[i] != NULL; i++) {
+            struct in_addr in;
+            if (inet_pton(AF_INET, addrs[i], &in) <= 0)
+                goto end;
+
+            SCRadixNode *node = SCRadixFindKeyIPV4BestMatch((uint8_t *)&in, tree);
+            SigNumArray *radix = SC_RADIX_NODE_USERDATA(node, SigNumArray);
+            SigNumArray *set = io_ctx->sets[IPOnlyIPV4TableLookup(table, ntohl(in.s_addr))];
+            uint32_t u;
+
+            for (u = 0; u < io_ctx->max_idx / 8 + 1; u++) {
+                uint8_t r = radix ? radix->array[u] : 0;
+                uint8_t t = set ? set->array[u] : 0;
+                if (r != t) {
+                    printf("%s %s: radix %02x table %02x: ", d ? "dst" : "src",
+                           addrs[i], r, t);
+                    goto end;
+                }
+            }
+        }
+    }
+
+    result = 1;
+end:
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        SigCleanSignatures(de_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+    return result;
+}
+
+/**
+ * \test Packets with the same address pair are matched from the per
+ *       thread intersection cache.
+ */
+static int IPOnlyTestSig18(void)
+{
+    int result = 0;
+    uint8_t *buf = (uint8_t *)"Hi all!";
+    uint16_t buflen = strlen((char *)buf);
+
+    uint8_t numpkts = 3;
+    uint8_t numsigs = 2;
+
+    Packet *p[3];
+
+    p[0] = UTHBuildPacketSrcDst((uint8_t *)buf, buflen, IPPROTO_TCP, "192.168.1.5", "10.0.0.1");
+    p[1] = UTHBuildPacketSrcDst((uint8_t *)buf, buflen, IPPROTO_TCP, "192.168.1.5", "10.0.0.1");
+    p[2] = UTHBuildPacketSrcDst((uint8_t *)buf, buflen, IPPROTO_TCP, "192.168.1.6", "10.0.0.1");
+
+    char *sigs[numsigs];
+    sigs[0]= "alert tcp 192.168.1.5 any -> 10.0.0.0/8 any (msg:\"Testing src/dst ip (sid 1)\"; sid:1;)";
+    sigs[1]= "alert tcp 192.168.1.0/24 any -> 10.0.0.1 any (msg:\"Testing src/dst ip (sid 2)\"; sid:2;)";
+
+    /* Sid numbers (we could extract them from the sig) */
+    uint32_t sid[2] = { 1, 2};
+    uint32_t results[3][2] = {
+                              { 1, 1},
+                              { 1, 1},
+                              { 0, 1} };
+
+    result = UTHGenericTest(p, numpkts, sigs, sid, (uint32_t *) results, numsigs);
+
+    UTHFreePackets(p, numpkts);
+
+    return result;
+}
+
 #endif /* UNITTESTS */
 
 void IPOnlyRegisterTests(void) {
@@ -2245,6 +2778,8 @@ void IPOnlyRegisterTests(void) {
     UtRegisterTest("IPOnlyTestSig14", IPOnlyTestSig14, 1);
     UtRegisterTest("IPOnlyTestSig15", IPOnlyTestSig15, 1);
     UtRegisterTest("IPOnlyTestSig16", IPOnlyTestSig16, 1);
+    UtRegisterTest("IPOnlyTestSig17", IPOnlyTestSig17, 1);
+    UtRegisterTest("IPOnlyTestSig18", IPOnlyTestSig18, 1);
 #endif
 
     return;
@@ -289,6 +289,8 @@ void DetectEngineStateReset(DetectEngineState *state) {
     state->tail = NULL;
 
     state->cnt = 0;
+    state->toclient_tx_done = 0;
+    state->toserver_tx_done = 0;
 
     SCReturn;
 }
@@ -403,6 +405,59 @@ void DeStateStoreStateVersion(DetectEngineState *de_state, uint8_t direction,
     }
 }
 
+static uint16_t DeStateGetTxDone(DetectEngineState *de_state, uint8_t direction) {
+    if (direction & STREAM_TOSERVER) {
+        SCReturnUInt(de_state->toserver_tx_done);
+    } else {
+        SCReturnUInt(de_state->toclient_tx_done);
+    }
+}
+
+static void DeStateStoreTxDone(DetectEngineState *de_state, uint8_t direction,
+        uint16_t tx_done)
+{
+    if (direction & STREAM_TOSERVER) {
+        SCLogDebug("STREAM_TOSERVER tx done updated to %"PRIu16, tx_done);
+        de_state->toserver_tx_done = tx_done;
+    } else {
+        SCLogDebug("STREAM_TOCLIENT tx done updated to %"PRIu16, tx_done);
+        de_state->toclient_tx_done = tx_done;
+    }
+}
+
+/**
+ *  \brief Get the id of the first HTTP transaction, starting at tx_id, that
+ *         is still in progress in a direction.
+ *
+ *  A transaction that is complete in a direction won't change anymore, so
+ *  once it has been inspected by all stored signatures it doesn't need to
+ *  be inspected again on the next packets.
+ *
+ *  \param htp_state LOCKED htp state
+ *  \param direction STREAM_TOSERVER or STREAM_TOCLIENT
+ *
+ *  \retval tx_id id of the first tx in progress or total_txs if all are done
+ */
+static int DeStateHttpGetTxInProgress(HtpState *htp_state, int tx_id,
+        int total_txs, uint8_t direction)
+{
+    for ( ; tx_id < total_txs; tx_id++) {
+        htp_tx_t *tx = list_get(htp_state->connp->conn->transactions, tx_id);
+        if (tx == NULL)
+            continue;
+
+        if (direction & STREAM_TOSERVER) {
+            if (tx->progress < TX_PROGRESS_WAIT)
+                break;
+        } else {
+            if (tx->progress < TX_PROGRESS_DONE)
+                break;
+        }
+    }
+
+    return tx_id;
+}
+
 /**
  *  \brief Increment de_state filestore_cnt in the proper direction.
  *
@@ -447,6 +502,46 @@ int DeStateFlowHasState(Flow *f, uint8_t flags, uint16_t alversion) {
     SCReturnInt(r);
 }
 
+/**
+ *  \brief Check if the flow has stored signatures that didn't fully match
+ *         and can still match.
+ *
+ *  \param f flow
+ *
+ *  \retval 1 open state
+ *  \retval 0 no (open) state
+ */
+int DeStateFlowHasOpenState(Flow *f) {
+    SCEnter();
+
+    DeStateStore *store;
+    SigIntId store_cnt;
+    SigIntId cnt = 0;
+    int r = 0;
+
+    SCMutexLock(&f->de_state_m);
+
+    if (f->de_state != NULL) {
+        for (store = f->de_state->head; store != NULL && r == 0;
+                store = store->next)
+        {
+            for (store_cnt = 0;
+                    store_cnt < DE_STATE_CHUNK_SIZE && cnt < f->de_state->cnt;
+                    store_cnt++, cnt++)
+            {
+                if (!(store->store[store_cnt].flags &
+                            (DE_STATE_FLAG_FULL_MATCH|DE_STATE_FLAG_SIG_CANT_MATCH))) {
+                    r = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    SCMutexUnlock(&f->de_state_m);
+    SCReturnInt(r);
+}
+
 /** \brief Match app layer sig list against state. Set up state for non matches
  *         and partial matches.
  *  \retval 1 match
@@ -631,6 +726,8 @@ int DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx, Dete
     uint32_t match_flags = 0;
     int match = 0;
     uint16_t file_no_match = 0;
+    uint16_t tx_done = 0;
+    uint16_t new_tx_done = 0;
 
     if (f == NULL || alstate == NULL || alproto == ALPROTO_UNKNOWN) {
         return 0;
@@ -643,6 +740,31 @@ int DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx, Dete
 
     DeStateResetFileInspection(f, alproto, alstate);
 
+    /* txs before tx_done were complete when all stored sigs inspected them
+     * on an earlier run, so they are skipped. Txs that are complete now
+     * will be inspected by all sigs in this run, so the next run can skip
+     * them as well. */
+    tx_done = DeStateGetTxDone(f->de_state, flags);
+    new_tx_done = tx_done;
+    if (alproto == ALPROTO_HTTP) {
+        FLOWLOCK_WRLOCK(f);
+
+        HtpState *htp_state = (HtpState *)alstate;
+        int tx_id = AppLayerTransactionGetInspectId(f);
+        if (htp_state->connp != NULL && htp_state->connp->conn != NULL &&
+                tx_id != -1)
+        {
+            if (tx_id < tx_done)
+                tx_id = tx_done;
+
+            int total_txs = (int)list_size(htp_state->connp->conn->transactions);
+            new_tx_done = (uint16_t)DeStateHttpGetTxInProgress(htp_state,
+                    tx_id, total_txs, flags);
+        }
+
+        FLOWLOCK_UNLOCK(f);
+    }
+
     /* loop through the stores */
     for (store = f->de_state->head; store != NULL; store = store->next)
     {
@@ -737,6 +859,8 @@ int DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx, Dete
                     FLOWLOCK_UNLOCK(f);
                     goto end;
                 }
+                if (tx_id < tx_done)
+                    tx_id = tx_done;
 
                 int total_txs = (int)list_size(htp_state->connp->conn->transactions);
                 for ( ; tx_id < total_txs; tx_id++) {
@@ -864,6 +988,7 @@ int DeStateDetectContinueDetection(ThreadVars *tv, DetectEngineCtx *de_ctx, Dete
 
     DeStateStoreStateVersion(f->de_state, flags, alversion);
     DeStateStoreFileNoMatch(f->de_state, flags, file_no_match);
+    DeStateStoreTxDone(f->de_state, flags, new_tx_done);
 
     if (!(f->de_state->flags & DE_STATE_FILE_STORE_DISABLED)) {
         if (DeStateStoreFilestoreSigsCantMatch(det_ctx->sgh, f->de_state, flags) == 1) {
@@ -1962,6 +2087,124 @@ end:
     return result;
 }
 
+/** \test pipelined transactions that are complete are not inspected again
+ *        once all stored sigs have seen them */
+static int DeStateSigTest08(void) {
+    int result = 0;
+    Signature *s = NULL;
+    DetectEngineThreadCtx *det_ctx = NULL;
+    ThreadVars th_v;
+    Flow f;
+    TcpSession ssn;
+    Packet *p = NULL;
+    uint8_t httpbuf1[] = "GET /one HTTP/1.1\r\nHost: a\r\n\r\n"
+                         "GET /two HTTP/1.1\r\nHost: a\r\n\r\n"
+                         "GET /three HTTP/1.1\r\n";
+    uint8_t httpbuf2[] = "Host: a\r\n";
+    uint8_t httpbuf3[] = "Cookie: dummy\r\n\r\n";
+    uint32_t httplen1 = sizeof(httpbuf1) - 1; /* minus the \0 */
+    uint32_t httplen2 = sizeof(httpbuf2) - 1; /* minus the \0 */
+    uint32_t httplen3 = sizeof(httpbuf3) - 1; /* minus the \0 */
+
+    memset(&th_v, 0, sizeof(th_v));
+    memset(&f, 0, sizeof(f));
+    memset(&ssn, 0, sizeof(ssn));
+
+    p = UTHBuildPacket(NULL, 0, IPPROTO_TCP);
+
+    FLOW_INITIALIZE(&f);
+    f.protoctx = (void *)&ssn;
+    f.flags |= FLOW_IPV4;
+
+    p->flow = &f;
+    p->flags |= PKT_HAS_FLOW|PKT_STREAM_EST;
+    p->flowflags |= FLOW_PKT_TOSERVER;
+    p->flowflags |= FLOW_PKT_ESTABLISHED;
+    f.alproto = ALPROTO_HTTP;
+
+    StreamTcpInitConfig(TRUE);
+
+    DetectEngineCtx *de_ctx = DetectEngineCtxInit();
+    if (de_ctx == NULL) {
+        goto end;
+    }
+
+    de_ctx->flags |= DE_QUIET;
+
+    s = de_ctx->sig_list = SigInit(de_ctx, "alert tcp any any -> any any (content:\"/three\"; http_uri; content:\"dummy\"; http_cookie; sid:1; rev:1;)");
+    if (s == NULL) {
+        printf("sig parse failed: ");
+        goto end;
+    }
+
+    SigGroupBuild(de_ctx);
+    DetectEngineThreadCtxInit(&th_v, (void *)de_ctx, (void *)&det_ctx);
+
+    int r = AppLayerParse(NULL, &f, ALPROTO_HTTP, STREAM_TOSERVER, httpbuf1, httplen1);
+    if (r != 0) {
+        printf("toserver chunk 1 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1)) {
+        printf("sig 1 alerted: ");
+        goto end;
+    }
+    p->alerts.cnt = 0;
+
+    r = AppLayerParse(NULL, &f, ALPROTO_HTTP, STREAM_TOSERVER, httpbuf2, httplen2);
+    if (r != 0) {
+        printf("toserver chunk 2 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    if (PacketAlertCheck(p, 1)) {
+        printf("sig 1 alerted (2): ");
+        goto end;
+    }
+    p->alerts.cnt = 0;
+
+    /* the first two requests were complete on the continued inspection,
+     * the third one is still in progress */
+    if (f.de_state == NULL || f.de_state->toserver_tx_done != 2) {
+        printf("toserver_tx_done %u, expected 2: ",
+                f.de_state ? f.de_state->toserver_tx_done : 0);
+        goto end;
+    }
+
+    r = AppLayerParse(NULL, &f, ALPROTO_HTTP, STREAM_TOSERVER, httpbuf3, httplen3);
+    if (r != 0) {
+        printf("toserver chunk 3 returned %" PRId32 ", expected 0: ", r);
+        goto end;
+    }
+    SigMatchSignatures(&th_v, de_ctx, det_ctx, p);
+    if (!(PacketAlertCheck(p, 1))) {
+        printf("sig 1 didn't alert: ");
+        goto end;
+    }
+    p->alerts.cnt = 0;
+
+    if (f.de_state->toserver_tx_done != 3) {
+        printf("toserver_tx_done %u, expected 3: ", f.de_state->toserver_tx_done);
+        goto end;
+    }
+
+    result = 1;
+end:
+    if (det_ctx != NULL) {
+        DetectEngineThreadCtxDeinit(&th_v, (void *)det_ctx);
+    }
+    if (de_ctx != NULL) {
+        SigGroupCleanup(de_ctx);
+        DetectEngineCtxFree(de_ctx);
+    }
+
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    UTHFreePacket(p);
+    return result;
+}
+
 #endif
 
 void DeStateRegisterTests(void) {
@@ -1976,6 +2219,7 @@ void DeStateRegisterTests(void) {
     UtRegisterTest("DeStateSigTest05", DeStateSigTest05, 1);
     UtRegisterTest("DeStateSigTest06", DeStateSigTest06, 1);
     UtRegisterTest("DeStateSigTest07", DeStateSigTest07, 1);
+    UtRegisterTest("DeStateSigTest08", DeStateSigTest08, 1);
 #endif
 }
 
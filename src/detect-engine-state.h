@@ -132,6 +132,12 @@ typedef struct DetectEngineState_ {
                                      *   cannot match in to client direction. */
     uint16_t toserver_filestore_cnt;/**< number of sigs with filestore that
                                      *   cannot match in to server direction. */
+    uint16_t toclient_tx_done;      /**< txs before this id were complete in
+                                     *   the to client direction when all
+                                     *   stored sigs inspected them */
+    uint16_t toserver_tx_done;      /**< txs before this id were complete in
+                                     *   the to server direction when all
+                                     *   stored sigs inspected them */
     uint16_t flags;
 #ifdef __tile__
     struct DetectEngineState_ *pool_next;
@@ -148,6 +154,7 @@ void DetectEngineStateReset(DetectEngineState *state);
 void DetectEngineStateFree(DetectEngineState *);
 
 int DeStateFlowHasState(Flow *, uint8_t, uint16_t);
+int DeStateFlowHasOpenState(Flow *);
 
 int DeStateDetectStartDetection(ThreadVars *, DetectEngineCtx *,
         DetectEngineThreadCtx *, Signature *, Flow *, uint8_t, void *,
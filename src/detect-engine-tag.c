@@ -478,14 +478,14 @@ void TagHandlePacket(DetectEngineCtx *de_ctx,
         FLOWLOCK_UNLOCK(p->flow);
     }
 
-    Host *src = HostLookupHostFromHash(&p->src);
+    Host *src = HostLookupHostFromCache(&det_ctx->host_cache, &p->src);
     if (src) {
         if (src->tag != NULL) {
             TagHandlePacketHost(src,p);
         }
         HostRelease(src);
     }
-    Host *dst = HostLookupHostFromHash(&p->dst);
+    Host *dst = HostLookupHostFromCache(&det_ctx->host_cache, &p->dst);
     if (dst) {
         if (dst->tag != NULL) {
             TagHandlePacketHost(dst,p);
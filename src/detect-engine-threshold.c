@@ -591,13 +591,13 @@ int PacketAlertThreshold(DetectEngineCtx *de_ctx, DetectEngineThreadCtx *det_ctx
     }
 
     if (td->track == TRACK_SRC) {
-        Host *src = HostGetHostFromHash(&p->src);
+        Host *src = HostGetHostFromCache(&det_ctx->host_cache, &p->src);
         if (src) {
             ret = ThresholdHandlePacketHost(src,p,td,s->id,s->gid);
             HostRelease(src);
         }
     } else if (td->track == TRACK_DST) {
-        Host *dst = HostGetHostFromHash(&p->dst);
+        Host *dst = HostGetHostFromCache(&det_ctx->host_cache, &p->dst);
         if (dst) {
             ret = ThresholdHandlePacketHost(dst,p,td,s->id,s->gid);
             HostRelease(dst);
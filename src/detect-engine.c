@@ -64,6 +64,7 @@
 #include "detect-content.h"
 #include "detect-uricontent.h"
 #include "detect-engine-threshold.h"
+#include "detect-engine-alert.h"
 
 #include "util-classification-config.h"
 #include "util-reference-config.h"
@@ -706,6 +707,7 @@ DetectEngineCtx *DetectEngineCtxInit(void) {
 
     de_ctx->mpm_matcher = PatternMatchDefaultMatcher();
     DetectEngineCtxLoadConf(de_ctx);
+    PacketAlertAggregationLoadConf(de_ctx);
 
     SigGroupHeadHashInit(de_ctx);
     SigGroupHeadMpmHashInit(de_ctx);
@@ -1108,6 +1110,10 @@ static TmEcode ThreadCtxDoInit (DetectEngineCtx *de_ctx, DetectEngineThreadCtx *
         return TM_ECODE_FAILED;
     }
 
+    if (PacketAlertAggregationThreadInit(de_ctx, det_ctx) < 0) {
+        return TM_ECODE_FAILED;
+    }
+
     DetectEngineThreadCtxInitKeywords(de_ctx, det_ctx);
 #ifdef PROFILING
     SCProfilingRuleThreadSetup(de_ctx->profile_ctx, det_ctx);
@@ -1137,6 +1143,8 @@ TmEcode DetectEngineThreadCtxInit(ThreadVars *tv, void *initdata, void **data)
     /** alert counter setup */
     det_ctx->counter_alerts = SCPerfTVRegisterCounter("detect.alert", tv,
                                                       SC_PERF_TYPE_UINT64, "NULL");
+    det_ctx->counter_alerts_aggregated = SCPerfTVRegisterCounter("detect.alert_aggregated", tv,
+                                                      SC_PERF_TYPE_UINT64, "NULL");
     tv->sc_perf_pca = SCPerfGetAllCountersArray(tv, &tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ? tv->thread_group_name : tv->name,
                               &tv->sc_perf_pctx);
@@ -1174,6 +1182,8 @@ static TmEcode DetectEngineThreadCtxInitForLiveRuleSwap(ThreadVars *tv, void *in
     /** alert counter setup */
     det_ctx->counter_alerts = SCPerfTVRegisterCounter("detect.alert", tv,
                                                       SC_PERF_TYPE_UINT64, "NULL");
+    det_ctx->counter_alerts_aggregated = SCPerfTVRegisterCounter("detect.alert_aggregated", tv,
+                                                      SC_PERF_TYPE_UINT64, "NULL");
     /* no counter creation here */
 
     /* pass thread data back to caller */
@@ -1214,24 +1224,13 @@ TmEcode DetectEngineThreadCtxDeinit(ThreadVars *tv, void *data) {
     if (det_ctx->bj_values != NULL)
         SCFree(det_ctx->bj_values);
 
-    if (det_ctx->hsbd != NULL) {
-        SCLogDebug("det_ctx hsbd %u", det_ctx->hsbd_buffers_list_len);
-        for (i = 0; i < det_ctx->hsbd_buffers_list_len; i++) {
-            if (det_ctx->hsbd[i].buffer != NULL)
-                SCFree(det_ctx->hsbd[i].buffer);
-        }
+    /* the body buffers point into the body arenas of the transactions */
+    if (det_ctx->hsbd != NULL)
         SCFree(det_ctx->hsbd);
-    }
-
-    if (det_ctx->hcbd != NULL) {
-        SCLogDebug("det_ctx hcbd %u", det_ctx->hcbd_buffers_list_len);
-        for (i = 0; i < det_ctx->hcbd_buffers_list_len; i++) {
-            if (det_ctx->hcbd[i].buffer != NULL)
-                SCFree(det_ctx->hcbd[i].buffer);
-            SCLogDebug("det_ctx->hcbd[i].buffer_size %u", det_ctx->hcbd[i].buffer_size);
-        }
+    if (det_ctx->hcbd != NULL)
         SCFree(det_ctx->hcbd);
-    }
+
+    PacketAlertAggregationThreadDeinit(det_ctx);
 
     DetectEngineThreadCtxDeinitKeywords(det_ctx->de_ctx, det_ctx);
     SCFree(det_ctx);
@@ -0,0 +1,343 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Shared code of the filemd5, filesha1 and filesha256 keywords: loading
+ * the list of hashes into a ROHashTable and matching the hash of a file
+ * against it.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "debug.h"
+#include "decode.h"
+
+#include "detect.h"
+#include "detect-parse.h"
+#include "detect-engine.h"
+
+#include "app-layer-htp.h"
+
+#include "util-debug.h"
+#include "util-file.h"
+
+#include "detect-file-hash-common.h"
+
+#ifdef HAVE_NSS
+
+/** sigmatch type, signature file flag and file flag per algorithm */
+static const struct {
+    int sm_type;
+    uint16_t sig_flag;
+    uint16_t file_flag;
+} file_hash_kw[FILE_HASH_MAX] = {
+    { DETECT_FILEMD5, FILE_SIG_NEED_MD5, FILE_MD5 },
+    { DETECT_FILESHA1, FILE_SIG_NEED_SHA1, FILE_SHA1 },
+    { DETECT_FILESHA256, FILE_SIG_NEED_SHA256, FILE_SHA256 },
+};
+
+/**
+ * \brief Read a hex encoded hash
+ *
+ * \param hash buffer of hash_len bytes
+ * \param str hex string of 2 * hash_len characters
+ * \param filename file the string was read from, for error messages
+ * \param line_no line in the file
+ * \param hash_len length of the hash in bytes
+ *
+ * \retval 1 ok
+ * \retval -1 invalid string
+ */
+int ReadHashString(uint8_t *hash, char *str, char *filename, int line_no,
+        uint16_t hash_len)
+{
+    if (strlen(str) != (size_t)hash_len * 2) {
+        SCLogError(SC_ERR_INVALID_HASH, "%s:%d hash string not %u characters",
+                filename, line_no, hash_len * 2);
+        return -1;
+    }
+
+    int i, x;
+    for (x = 0, i = 0; i < hash_len * 2; i += 2, x++) {
+        char buf[3] = { 0, 0, 0 };
+        buf[0] = str[i];
+        buf[1] = str[i + 1];
+
+        if (!isxdigit((unsigned char)buf[0]) || !isxdigit((unsigned char)buf[1])) {
+            SCLogError(SC_ERR_INVALID_HASH, "%s:%d hash byte \"%s\" is not hex",
+                    filename, line_no, buf);
+            return -1;
+        }
+        hash[x] = (uint8_t)strtol(buf, NULL, 16);
+    }
+
+    return 1;
+}
+
+/**
+ * \brief Add a hash to the hash table
+ *
+ * \retval 1 ok
+ * \retval -1 error
+ */
+int LoadHashTable(ROHashTable *hash_table, char *string, char *filename,
+        int line_no, FileHashAlg alg)
+{
+    uint8_t hash[FILE_HASH_MAX_LEN];
+    uint16_t hash_len = (uint16_t)FileHashLen(alg);
+
+    if (ReadHashString(hash, string, filename, line_no, hash_len) != 1)
+        return -1;
+
+    if (ROHashInitQueueValue(hash_table, hash, hash_len) != 1)
+        return -1;
+
+    return 1;
+}
+
+static FileHashAlg DetectFileHashAlg(int sm_type)
+{
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        if (file_hash_kw[alg].sm_type == sm_type)
+            return alg;
+    }
+    return FILE_HASH_MD5;
+}
+
+/**
+ * \brief match the hash of a file against the list of a filemd5,
+ *        filesha1 or filesha256 keyword
+ *
+ * \param t thread local vars
+ * \param det_ctx pattern matcher thread local data
+ * \param f *LOCKED* flow
+ * \param flags direction flags
+ * \param file file being inspected
+ * \param s signature being inspected
+ * \param m sigmatch that we will cast into DetectFileHashData
+ *
+ * \retval 0 no match
+ * \retval 1 match
+ */
+int DetectFileHashMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx,
+        Flow *f, uint8_t flags, File *file, Signature *s, SigMatch *m)
+{
+    SCEnter();
+    int ret = 0;
+    DetectFileHashData *filehash = (DetectFileHashData *)m->ctx;
+
+    if (file->txid != det_ctx->tx_id) {
+        SCReturnInt(0);
+    }
+
+    if (file->state != FILE_STATE_CLOSED) {
+        SCReturnInt(0);
+    }
+
+    FileHashAlg alg = DetectFileHashAlg(m->type);
+    if (!(file->flags & file_hash_kw[alg].file_flag)) {
+        SCReturnInt(0);
+    }
+
+    uint8_t *hash;
+    switch (alg) {
+        case FILE_HASH_SHA1:
+            hash = file->sha1;
+            break;
+        case FILE_HASH_SHA256:
+            hash = file->sha256;
+            break;
+        default:
+            hash = file->md5;
+            break;
+    }
+
+    int found = (ROHashLookup(filehash->hash, hash,
+                              (uint16_t)FileHashLen(alg)) != NULL);
+    if (filehash->negated == 0)
+        ret = found;
+    else
+        ret = !found;
+
+    SCReturnInt(ret);
+}
+
+/**
+ * \brief Parse the filemd5, filesha1 or filesha256 keyword: load the
+ *        hash list file
+ *
+ * \param str name of the list file, prefixed with ! for a negated match
+ *
+ * \retval filehash pointer to DetectFileHashData on success
+ * \retval NULL on failure
+ */
+static DetectFileHashData *DetectFileHashParse (char *str, FileHashAlg alg)
+{
+    DetectFileHashData *filehash = NULL;
+    FILE *fp = NULL;
+    char *filename = NULL;
+    uint16_t hash_len = (uint16_t)FileHashLen(alg);
+
+    filehash = SCMalloc(sizeof(DetectFileHashData));
+    if (unlikely(filehash == NULL))
+        goto error;
+
+    memset(filehash, 0x00, sizeof(DetectFileHashData));
+
+    if (strlen(str) && str[0] == '!') {
+        filehash->negated = 1;
+        str++;
+    }
+
+    filehash->hash = ROHashInit(18, hash_len);
+    if (filehash->hash == NULL) {
+        goto error;
+    }
+
+    /* get full filename */
+    filename = DetectLoadCompleteSigPath(str);
+    if (filename == NULL) {
+        goto error;
+    }
+
+    char line[8192] = "";
+    fp = fopen(filename, "r");
+    if (fp == NULL) {
+        SCLogError(SC_ERR_OPENING_RULE_FILE, "opening %s file %s: %s",
+                FileHashName(alg), filename, strerror(errno));
+        goto error;
+    }
+
+    int line_no = 0;
+    while(fgets(line, (int)sizeof(line), fp) != NULL) {
+        size_t len = strlen(line);
+        line_no++;
+
+        /* ignore comments and empty lines */
+        if (line[0] == '\n' || line [0] == '\r' || line[0] == ' ' || line[0] == '#' || line[0] == '\t')
+            continue;
+
+        /* Check if we have a trailing newline, and remove it */
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+            line[--len] = '\0';
+        }
+
+        /* cut off longer lines */
+        if (len > (size_t)hash_len * 2)
+            line[hash_len * 2] = 0x00;
+
+        if (LoadHashTable(filehash->hash, line, filename, line_no, alg) != 1) {
+            goto error;
+        }
+    }
+    fclose(fp);
+    fp = NULL;
+
+    if (ROHashInitFinalize(filehash->hash) != 1) {
+        goto error;
+    }
+    SCLogInfo("%s hash size %u bytes%s", FileHashName(alg),
+            ROHashMemorySize(filehash->hash),
+            filehash->negated ? ", negated match" : "");
+
+    SCFree(filename);
+    return filehash;
+
+error:
+    if (filehash != NULL)
+        DetectFileHashFree(filehash);
+    if (fp != NULL)
+        fclose(fp);
+    if (filename != NULL)
+        SCFree(filename);
+    return NULL;
+}
+
+/**
+ * \brief add a filemd5, filesha1 or filesha256 keyword to a signature
+ *
+ * \param de_ctx pointer to the Detection Engine Context
+ * \param s pointer to the Current Signature
+ * \param str pointer to the user provided option
+ * \param alg hash algorithm of the keyword
+ *
+ * \retval 0 on Success
+ * \retval -1 on Failure
+ */
+int DetectFileHashSetup (DetectEngineCtx *de_ctx, Signature *s, char *str,
+        FileHashAlg alg)
+{
+    DetectFileHashData *filehash = NULL;
+    SigMatch *sm = NULL;
+
+    filehash = DetectFileHashParse(str, alg);
+    if (filehash == NULL)
+        goto error;
+
+    /* Okay so far so good, lets get this into a SigMatch
+     * and put it in the Signature. */
+    sm = SigMatchAlloc();
+    if (sm == NULL)
+        goto error;
+
+    sm->type = file_hash_kw[alg].sm_type;
+    sm->ctx = (void *)filehash;
+
+    SigMatchAppendSMToList(s, sm, DETECT_SM_LIST_FILEMATCH);
+
+    if (s->alproto != ALPROTO_UNKNOWN && s->alproto != ALPROTO_HTTP) {
+        SCLogError(SC_ERR_CONFLICTING_RULE_KEYWORDS, "rule contains conflicting keywords.");
+        goto error;
+    }
+
+    AppLayerHtpNeedFileInspection();
+
+    /** \todo remove this once we support more than http */
+    s->alproto = ALPROTO_HTTP;
+
+    s->file_flags |= (FILE_SIG_NEED_FILE|file_hash_kw[alg].sig_flag);
+
+    /* files are hashed with all algorithms the rules use */
+    FileHashEnable(alg);
+    return 0;
+
+error:
+    if (filehash != NULL)
+        DetectFileHashFree(filehash);
+    if (sm != NULL)
+        SCFree(sm);
+    return -1;
+}
+
+/**
+ * \brief this function will free memory associated with DetectFileHashData
+ *
+ * \param ptr pointer to DetectFileHashData
+ */
+void DetectFileHashFree(void *ptr) {
+    if (ptr != NULL) {
+        DetectFileHashData *filehash = (DetectFileHashData *)ptr;
+        if (filehash->hash != NULL)
+            ROHashFree(filehash->hash);
+        SCFree(filehash);
+    }
+}
+
+#endif /* HAVE_NSS */
@@ -27,12 +27,7 @@
 #include "util-spm-bm.h"
 #include <magic.h>
 
-typedef struct DetectFilemagicThreadData {
-    magic_t ctx;
-} DetectFilemagicThreadData;
-
 typedef struct DetectFilemagicData {
-    int thread_ctx_id;
     uint8_t *name; /** name of the file to match */
     BmCtx *bm_ctx; /** BM context */
     uint16_t len; /** name length */
@@ -45,14 +45,13 @@
 #include "detect-ftpbounce.h"
 #include "stream-tcp.h"
 #include "util-byte.h"
+#include "util-ftp.h"
 
 int DetectFtpbounceMatch(ThreadVars *, DetectEngineThreadCtx *, Packet *,
                           Signature *, SigMatch *);
 int DetectFtpbounceALMatch(ThreadVars *, DetectEngineThreadCtx *, Flow *,
                            uint8_t, void *, Signature *, SigMatch *);
 static int DetectFtpbounceSetup(DetectEngineCtx *, Signature *, char *);
-int DetectFtpbounceMatchArgs(uint8_t *payload, uint16_t payload_len,
-                             uint32_t ip_orig, uint16_t offset);
 void DetectFtpbounceRegisterTests(void);
 void DetectFtpbounceFree(void *);
 
@@ -72,90 +71,6 @@ void DetectFtpbounceRegister(void)
     return;
 }
 
-/**
- * \brief This function is used to match ftpbounce attacks
- *
- * \param payload Payload of the PORT command
- * \param payload_len Length of the payload
- * \param ip_orig IP source to check the ftpbounce condition
- * \param offset offset to the arguments of the PORT command
- *
- * \retval 1 if ftpbounce detected, 0 if not
- */
-int DetectFtpbounceMatchArgs(uint8_t *payload, uint16_t payload_len,
-                             uint32_t ip_orig, uint16_t offset)
-{
-    SCEnter();
-    SCLogDebug("Checking ftpbounce condition");
-    char *c = NULL;
-    uint16_t i = 0;
-    int octet = 0;
-    int octet_ascii_len = 0;
-    int noctet = 0;
-    uint32_t ip = 0;
-    /* PrintRawDataFp(stdout, payload, payload_len); */
-
-    if (payload_len < 7) {
-        /* we need at least a differet ip address
-         * in the format 1,2,3,4,x,y where x,y is the port
-         * in two byte representation so let's look at
-         * least for the IP octets in comma separated */
-        return 0;
-    }
-
-    if (offset + 7 >= payload_len)
-        return 0;
-
-    c =(char*) payload;
-    if (c == NULL) {
-        SCLogDebug("No payload to check");
-        return 0;
-    }
-
-    i = offset;
-    /* Search for the first IP octect(Skips "PORT ") */
-    while (i < payload_len && !isdigit((unsigned char)c[i])) i++;
-
-    for (;i < payload_len && octet_ascii_len < 4 ;i++) {
-        if (isdigit((unsigned char)c[i])) {
-            octet =(c[i] - '0') + octet * 10;
-            octet_ascii_len++;
-        } else {
-            if (octet > 256) {
-                SCLogDebug("Octet not in ip format");
-                return 0;
-            }
-
-            if (isspace((unsigned char)c[i]))
-                while (i < payload_len && isspace((unsigned char)c[i]) ) i++;
-
-            if (i < payload_len && c[i] == ',') { /* we have an octet */
-                noctet++;
-                octet_ascii_len = 0;
-                ip =(ip << 8) + octet;
-                octet = 0;
-            } else {
-                SCLogDebug("Unrecognized character '%c'", c[i]);
-                return 0;
-            }
-            if (noctet == 4) {
-                /* Different IP than src, ftp bounce scan */
-                ip = SCByteSwap32(ip);
-
-                if (ip != ip_orig) {
-                    SCLogDebug("Different ip, so Matched ip:%d <-> ip_orig:%d",
-                               ip, ip_orig);
-                    return 1;
-                }
-                SCLogDebug("Same ip, so no match here");
-                return 0;
-            }
-        }
-    }
-    SCLogDebug("No match");
-    return 0;
-}
-
 /**
  * \brief This function is used to check matches from the FTP App Layer Parser
  *
@@ -182,7 +97,7 @@ int DetectFtpbounceALMatch(ThreadVars *t, DetectEngineThreadCtx *det_ctx,
     FLOWLOCK_RDLOCK(f);
 
     if (ftp_state->command == FTP_COMMAND_PORT) {
-        ret = DetectFtpbounceMatchArgs(ftp_state->port_line,
+        ret = FtpPortArgsBounce(ftp_state->port_line,
                   ftp_state->port_line_len, f->src.address.address_un_data32[0],
                   ftp_state->arg_offset);
     }
@@ -227,7 +142,7 @@ int DetectFtpbounceMatch(ThreadVars *t, DetectEngineThreadCtx *det_ctx,
     SCLogDebug("Payload: \"%s\"\nLen: %u Offset: %u\n", p->payload,
                p->payload_len, offset);
 
-    return DetectFtpbounceMatchArgs(p->payload, p->payload_len,
+    return FtpPortArgsBounce(p->payload, p->payload_len,
                                     p->src.addr_data32[0], offset);
 #endif
     return 0;
@@ -87,7 +87,7 @@ error:
     return;
 }
 
-static uint8_t GetHostRepSrc(Packet *p, uint8_t cat, uint32_t version) {
+static uint8_t GetHostRepSrc(DetectEngineThreadCtx *det_ctx, Packet *p, uint8_t cat, uint32_t version) {
     uint8_t val = 0;
     Host *h = NULL;
 
@@ -97,7 +97,7 @@ static uint8_t GetHostRepSrc(Packet *p, uint8_t cat, uint32_t version) {
         h = (Host *)p->host_src;
         HostLock(h);
     } else {
-        h = HostLookupHostFromHash(&(p->src));
+        h = HostLookupHostFromCache(&det_ctx->host_cache, &(p->src));
 
         p->flags |= PKT_HOST_SRC_LOOKED_UP;
 
@@ -125,7 +125,7 @@ static uint8_t GetHostRepSrc(Packet *p, uint8_t cat, uint32_t version) {
     return val;
 }
 
-static uint8_t GetHostRepDst(Packet *p, uint8_t cat, uint32_t version) {
+static uint8_t GetHostRepDst(DetectEngineThreadCtx *det_ctx, Packet *p, uint8_t cat, uint32_t version) {
     uint8_t val = 0;
     Host *h = NULL;
 
@@ -135,7 +135,7 @@ static uint8_t GetHostRepDst(Packet *p, uint8_t cat, uint32_t version) {
         h = (Host *)p->host_dst;
         HostLock(h);
     } else {
-        h = HostLookupHostFromHash(&(p->dst));
+        h = HostLookupHostFromCache(&det_ctx->host_cache, &(p->dst));
 
         p->flags |= PKT_HOST_DST_LOOKED_UP;
 
@@ -192,12 +192,12 @@ int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
     SCLogDebug("rd->cmd %u", rd->cmd);
     switch(rd->cmd) {
         case DETECT_IPREP_CMD_ANY:
-            val = GetHostRepSrc(p, rd->cat, version);
+            val = GetHostRepSrc(det_ctx, p, rd->cat, version);
             if (val > 0) {
                 if (RepMatch(rd->op, val, rd->val) == 1)
                     return 1;
             }
-            val = GetHostRepDst(p, rd->cat, version);
+            val = GetHostRepDst(det_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -205,7 +205,7 @@ int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
 
         case DETECT_IPREP_CMD_SRC:
             SCLogDebug("checking src");
-            val = GetHostRepSrc(p, rd->cat, version);
+            val = GetHostRepSrc(det_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -213,17 +213,17 @@ int DetectIPRepMatch (ThreadVars *t, DetectEngineThreadCtx *det_ctx, Packet *p,
 
         case DETECT_IPREP_CMD_DST:
             SCLogDebug("checking dst");
-            val = GetHostRepDst(p, rd->cat, version);
+            val = GetHostRepDst(det_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
             break;
 
         case DETECT_IPREP_CMD_BOTH:
-            val = GetHostRepSrc(p, rd->cat, version);
+            val = GetHostRepSrc(det_ctx, p, rd->cat, version);
             if (val == 0 || RepMatch(rd->op, val, rd->val) == 0)
                 return 0;
-            val = GetHostRepDst(p, rd->cat, version);
+            val = GetHostRepDst(det_ctx, p, rd->cat, version);
             if (val > 0) {
                 return RepMatch(rd->op, val, rd->val);
             }
@@ -100,6 +100,8 @@
 #include "detect-filestore.h"
 #include "detect-filemagic.h"
 #include "detect-filemd5.h"
+#include "detect-filesha1.h"
+#include "detect-filesha256.h"
 #include "detect-filesize.h"
 #include "detect-dsize.h"
 #include "detect-flowvar.h"
@@ -1657,7 +1659,6 @@ end:
 
     DetectEngineCleanHCBDBuffers(det_ctx);
     DetectEngineCleanHSBDBuffers(det_ctx);
-    DetectEngineCleanHHDBuffers(det_ctx);
 
     /* store the found sgh (or NULL) in the flow to save us from looking it
      * up again for the next packet. Also return any stream chunk we processed
@@ -1693,8 +1694,8 @@ end:
                     FileDisableMagic(p->flow, STREAM_TOSERVER);
                 }
 
-                /* see if this sgh requires us to consider file md5 */
-                if (!FileForceMd5() && (p->flow->sgh_toserver == NULL ||
+                /* see if this sgh requires us to consider file hashes */
+                if (!FileForceHash() && (p->flow->sgh_toserver == NULL ||
                             !(p->flow->sgh_toserver->flags & SIG_GROUP_HEAD_HAVEFILEMD5)))
                 {
                     SCLogDebug("disabling md5 for flow");
@@ -1724,8 +1725,8 @@ end:
                     FileDisableMagic(p->flow, STREAM_TOCLIENT);
                 }
 
-                /* check if this flow needs md5, if not disable it */
-                if (!FileForceMd5() && (p->flow->sgh_toclient == NULL ||
+                /* check if this flow needs file hashes, if not disable it */
+                if (!FileForceHash() && (p->flow->sgh_toclient == NULL ||
                             !(p->flow->sgh_toclient->flags & SIG_GROUP_HEAD_HAVEFILEMD5)))
                 {
                     SCLogDebug("disabling md5 for flow");
@@ -1791,6 +1792,12 @@ TmEcode Detect(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQue
 
     /* see if the packet matches one or more of the sigs */
     int r = SigMatchSignatures(tv,de_ctx,det_ctx,p);
+
+    /* log the counts of aggregated alerts whose window has passed. Pseudo
+     * packets don't drive this, at shutdown they bypass the outputs. */
+    if (!(p->flags & PKT_PSEUDO_STREAM_END))
+        PacketAlertAggregationTimeout(det_ctx, p, pq);
+
     if (r >= 0) {
         return TM_ECODE_OK;
     }
@@ -1895,7 +1902,8 @@ int SignatureIsFilemagicInspecting(Signature *s) {
 }
 
 /**
- *  \brief Check if a signature contains the filemd5 keyword.
+ *  \brief Check if a signature contains the filemd5, filesha1 or
+ *         filesha256 keyword.
  *
  *  \param s signature
  *
@@ -1906,7 +1914,7 @@ int SignatureIsFileMd5Inspecting(Signature *s) {
     if (s == NULL)
         return 0;
 
-    if (s->file_flags & FILE_SIG_NEED_MD5)
+    if (s->file_flags & (FILE_SIG_NEED_MD5|FILE_SIG_NEED_SHA1|FILE_SIG_NEED_SHA256))
         return 1;
 
     return 0;
@@ -4846,6 +4854,8 @@ void SigTableSetup(void) {
     DetectFilestoreRegister();
     DetectFilemagicRegister();
     DetectFileMd5Register();
+    DetectFileSha1Register();
+    DetectFileSha256Register();
     DetectFilesizeRegister();
     DetectAppLayerEventRegister();
     DetectHttpUARegister();
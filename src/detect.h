@@ -39,6 +39,7 @@
 #include "util-error.h"
 #include "util-radix-tree.h"
 #include "util-file.h"
+#include "host.h"
 
 #include "detect-mark.h"
 
@@ -302,6 +303,8 @@ typedef struct DetectPort_ {
 #define FILE_SIG_NEED_FILECONTENT   0x10
 #define FILE_SIG_NEED_MD5           0x20
 #define FILE_SIG_NEED_SIZE          0x40
+#define FILE_SIG_NEED_SHA1          0x80
+#define FILE_SIG_NEED_SHA256        0x100
 
 /* Detection Engine flags */
 #define DE_QUIET           0x01     /**< DE is quiet (esp for unittests) */
@@ -391,7 +394,7 @@ typedef struct Signature_ {
 
     /** inline -- action */
     uint8_t action;
-    uint8_t file_flags;
+    uint16_t file_flags;
 
     /** ipv4 match arrays */
     uint16_t addr_dst_match4_cnt;
@@ -480,11 +483,34 @@ typedef struct DetectFlowvarList_ {
     struct DetectFlowvarList_ *next;
 } DetectFlowvarList;
 
+/** size of the per thread cache of src/dst bitset intersections, power of 2 */
+#define IPONLY_PAIR_CACHE_SIZE  64
+
+typedef struct IPOnlyPairCacheEntry_ {
+    uint32_t src_id;          /**< 0 if the entry is unused */
+    uint32_t dst_id;
+    uint8_t empty;            /**< intersection has no sigs */
+} IPOnlyPairCacheEntry;
+
 typedef struct DetectEngineIPOnlyThreadCtx_ {
     uint8_t *sig_match_array; /* bit array of sig nums */
     uint32_t sig_match_size;  /* size in bytes of the array */
+
+    /* cache of intersections for recent IPv4 src/dst set pairs, the
+     * results are stored in pair_results, sig_match_size bytes each */
+    IPOnlyPairCacheEntry pair_cache[IPONLY_PAIR_CACHE_SIZE];
+    uint8_t *pair_results;
 } DetectEngineIPOnlyThreadCtx;
 
+/** \brief IPv4 address space flattened into sorted disjoint intervals.
+ *         Each interval maps to the id of the signature set of the longest
+ *         prefix covering it, so a lookup is a binary search. */
+typedef struct IPOnlyIPV4Table_ {
+    uint32_t *start;          /**< first address of the interval, host order */
+    uint32_t *id;             /**< set id per interval, 0 if no sigs apply */
+    uint32_t cnt;
+} IPOnlyIPV4Table;
+
 /** \brief IP only rules matching ctx.
  *  \todo a radix tree would be great here */
 typedef struct DetectEngineIPOnlyCtx_ {
@@ -499,6 +525,13 @@ typedef struct DetectEngineIPOnlyCtx_ {
     /* Used to build the radix trees */
     IPOnlyCIDRItem *ip_src, *ip_dst;
 
+    /* IPv4 lookup tables compiled from the radix trees */
+    IPOnlyIPV4Table table_ipv4src, table_ipv4dst;
+    /* distinct SigNumArrays used by the tables, indexed by set id. The
+     * arrays themselves are owned by the radix trees. */
+    struct SigNumArray_ **sets;
+    uint32_t sets_cnt;
+
     /* counters */
     uint32_t a_src_uniq16, a_src_total16;
     uint32_t a_dst_uniq16, a_dst_total16;
@@ -661,6 +694,11 @@ typedef struct DetectEngineCtx_ {
     /* maximum recursion depth for content inspection */
     int inspection_recursion_limit;
 
+    /** alert aggregation window in seconds, 0 if disabled */
+    uint32_t alert_agg_window;
+    /** max number of tuples an aggregation table tracks per thread */
+    uint32_t alert_agg_max_entries;
+
     /* conf parameter that limits the length of the http request body inspected */
     int hcbd_buffer_limit;
     /* conf parameter that limits the length of the http response body inspected */
@@ -737,8 +775,7 @@ enum {
 };
 
 typedef struct HttpReassembledBody_ {
-    uint8_t *buffer;
-    uint32_t buffer_size;   /**< size of the buffer itself */
+    uint8_t *buffer;        /**< window into the body arena of the tx */
     uint32_t buffer_len;    /**< data len in the buffer */
     uint64_t offset;        /**< data offset */
 } HttpReassembledBody;
@@ -775,14 +812,13 @@ typedef struct DetectionEngineThreadCtx_ {
     uint16_t hcbd_buffers_size;
     uint16_t hcbd_buffers_list_len;
 
-    uint8_t **hhd_buffers;
-    uint32_t *hhd_buffers_len;
-    uint16_t hhd_buffers_size;
-    uint16_t hhd_buffers_list_len;
-    int hhd_start_tx_id;
-
     /** id for alert counter */
     uint16_t counter_alerts;
+    /** id for counter of alerts coalesced by alert aggregation */
+    uint16_t counter_alerts_aggregated;
+
+    /** alert aggregation table, NULL if disabled */
+    struct AlertAggThreadCtx_ *alert_agg;
 
     /* used to discontinue any more matching */
     uint16_t discontinue_matching;
@@ -826,6 +862,9 @@ typedef struct DetectionEngineThreadCtx_ {
     /** ip only rules ctx */
     DetectEngineIPOnlyThreadCtx io_ctx;
 
+    /** cache of recently used hosts for thresholds, tags and iprep */
+    HostThreadCache host_cache;
+
     /* byte jump values */
     uint64_t *bj_values;
 
@@ -1128,6 +1167,8 @@ enum {
     DETECT_FILESTORE,
     DETECT_FILEMAGIC,
     DETECT_FILEMD5,
+    DETECT_FILESHA1,
+    DETECT_FILESHA256,
     DETECT_FILESIZE,
 
     DETECT_L3PROTO,
@@ -89,6 +89,10 @@ typedef struct FlowTimeoutCounters_ {
     uint32_t new;
     uint32_t est;
     uint32_t clo;
+    /** bypassed flows and the packets and bytes they bypassed */
+    uint32_t byp;
+    uint32_t byp_pkts;
+    uint64_t byp_bytes;
 } FlowTimeoutCounters;
 
 /**
@@ -298,6 +302,14 @@ static uint32_t FlowManagerHashRowTimeout(Flow *f, struct timeval *ts,
             f->hnext = NULL;
             f->hprev = NULL;
 
+            if (f->flags & FLOW_BYPASSED) {
+                SCLogDebug("bypassed flow %p: %"PRIu32" pkts, %"PRIu64" bytes",
+                        f, f->bypassed_pkts, f->bypassed_bytes);
+                counters->byp++;
+                counters->byp_pkts += f->bypassed_pkts;
+                counters->byp_bytes += f->bypassed_bytes;
+            }
+
             FlowClearMemory (f, f->protomap);
 
             /* no one is referring to this flow, use_cnt 0, removed from hash
@@ -414,6 +426,15 @@ void *FlowManagerThread(void *td)
     uint16_t flow_mgr_cnt_est = SCPerfTVRegisterCounter("flow_mgr.est_pruned", th_v,
             SC_PERF_TYPE_UINT64,
             "NULL");
+    uint16_t flow_mgr_cnt_byp = SCPerfTVRegisterCounter("flow_mgr.bypassed_pruned", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
+    uint16_t flow_mgr_byp_pkts = SCPerfTVRegisterCounter("flow.bypassed_pkts", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
+    uint16_t flow_mgr_byp_bytes = SCPerfTVRegisterCounter("flow.bypassed_bytes", th_v,
+            SC_PERF_TYPE_UINT64,
+            "NULL");
     uint16_t flow_mgr_memuse = SCPerfTVRegisterCounter("flow.memuse", th_v,
             SC_PERF_TYPE_Q_NORMAL,
             "NULL");
@@ -485,7 +506,7 @@ void *FlowManagerThread(void *td)
         FlowUpdateSpareFlows();
 
         /* try to time out flows */
-        FlowTimeoutCounters counters = { 0, 0, 0, };
+        FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, };
         FlowTimeoutHash(&ts, 0 /* check all */, &counters);
 
 
@@ -502,6 +523,9 @@ void *FlowManagerThread(void *td)
         SCPerfCounterAddUI64(flow_mgr_cnt_clo, th_v->sc_perf_pca, (uint64_t)counters.clo);
         SCPerfCounterAddUI64(flow_mgr_cnt_new, th_v->sc_perf_pca, (uint64_t)counters.new);
         SCPerfCounterAddUI64(flow_mgr_cnt_est, th_v->sc_perf_pca, (uint64_t)counters.est);
+        SCPerfCounterAddUI64(flow_mgr_cnt_byp, th_v->sc_perf_pca, (uint64_t)counters.byp);
+        SCPerfCounterAddUI64(flow_mgr_byp_pkts, th_v->sc_perf_pca, (uint64_t)counters.byp_pkts);
+        SCPerfCounterAddUI64(flow_mgr_byp_bytes, th_v->sc_perf_pca, counters.byp_bytes);
         long long unsigned int flow_memuse = SC_ATOMIC_GET(flow_memuse);
         SCPerfCounterSetUI64(flow_mgr_memuse, th_v->sc_perf_pca, (uint64_t)flow_memuse);
 
@@ -853,7 +877,7 @@ static int FlowMgrTest05 (void) {
     struct timeval ts;
     TimeGet(&ts);
     /* try to time out flows */
-    FlowTimeoutCounters counters = { 0, 0, 0, };
+    FlowTimeoutCounters counters = { 0, 0, 0, 0, 0, 0, };
     FlowTimeoutHash(&ts, 0 /* check all */, &counters);
 
     if (flow_spare_q.len > 0) {
@@ -60,12 +60,15 @@
         (f)->sgh_toserver = NULL; \
         (f)->sgh_toclient = NULL; \
         (f)->tag_list = NULL; \
+        (f)->pcap_ring = NULL; \
         (f)->flowvar = NULL; \
         SCMutexInit(&(f)->de_state_m, NULL); \
         (f)->hnext = NULL; \
         (f)->hprev = NULL; \
         (f)->lnext = NULL; \
         (f)->lprev = NULL; \
+        (f)->bypassed_pkts = 0; \
+        (f)->bypassed_bytes = 0; \
         SC_ATOMIC_INIT((f)->autofp_tmqh_flow_qid);  \
         (void) SC_ATOMIC_SET((f)->autofp_tmqh_flow_qid, -1);  \
         RESET_COUNTERS((f)); \
@@ -97,8 +100,12 @@
         (f)->sgh_toclient = NULL; \
         DetectTagDataListFree((f)->tag_list); \
         (f)->tag_list = NULL; \
+        PcapLogFlowRingFree((f)->pcap_ring); \
+        (f)->pcap_ring = NULL; \
         GenericVarFree((f)->flowvar); \
         (f)->flowvar = NULL; \
+        (f)->bypassed_pkts = 0; \
+        (f)->bypassed_bytes = 0; \
         if (SC_ATOMIC_GET((f)->autofp_tmqh_flow_qid) != -1) {   \
             (void) SC_ATOMIC_SET((f)->autofp_tmqh_flow_qid, -1);   \
         }                                       \
@@ -114,10 +121,12 @@
             DetectEngineStateFree((f)->de_state); \
         } \
         DetectTagDataListFree((f)->tag_list); \
+        PcapLogFlowRingFree((f)->pcap_ring); \
         GenericVarFree((f)->flowvar); \
         SCMutexDestroy(&(f)->de_state_m); \
         SC_ATOMIC_DESTROY((f)->autofp_tmqh_flow_qid);   \
         (f)->tag_list = NULL; \
+        (f)->pcap_ring = NULL; \
     } while(0)
 
 /** \brief check if a memory alloc would fit in the memcap
@@ -307,6 +307,16 @@ void FlowHandlePacket (ThreadVars *tv, Packet *p)
         DecodeSetNoPayloadInspectionFlag(p);
     }
 
+    /* bypassed flow: account for the packet here, the stream engine and
+     * detection will skip it */
+    if (f->flags & FLOW_BYPASSED) {
+        f->bypassed_pkts++;
+        f->bypassed_bytes += GET_PKT_LEN(p);
+
+        p->flags |= (PKT_FLOW_BYPASSED|PKT_STREAM_NOPCAPLOG);
+        DecodeSetNoPacketInspectionFlag(p);
+    }
+
     FLOWLOCK_UNLOCK(f);
 
     /* set the flow in the packet */
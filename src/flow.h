@@ -45,7 +45,8 @@
 /** At least on packet from the destination address was seen */
 #define FLOW_TO_DST_SEEN                  0x00000002
 
-// vacany 1x
+/** Flow is bypassed: its packets skip stream tracking and detection */
+#define FLOW_BYPASSED                     0x00000004
 
 /** no magic on files in this flow */
 #define FLOW_FILE_NO_MAGIC_TS             0x00000008
@@ -351,6 +352,9 @@ typedef struct Flow_
     /** List of tags of this flow (from "tag" keyword of type "session") */
     void *tag_list;
 
+    /** Ring of recent packets kept by conditional pcap logging */
+    struct PcapLogRing_ *pcap_ring;
+
     /* pointer to the var list */
     GenericVar *flowvar;
 
@@ -365,6 +369,10 @@ typedef struct Flow_
     struct Flow_ *lnext; /* list */
     struct Flow_ *lprev;
     struct timeval startts;
+
+    /** packets and bytes seen after the flow was bypassed */
+    uint32_t bypassed_pkts;
+    uint64_t bypassed_bytes;
 #ifdef DEBUG
     uint32_t todstpktcnt;
     uint32_t tosrcpktcnt;
@@ -410,11 +418,15 @@ struct FlowQueue_;
 
 int FlowUpdateSpareFlows(void);
 
+/* implemented by conditional pcap logging in log-pcap.c */
+void PcapLogFlowRingFree(struct PcapLogRing_ *);
+
 static inline void FlowLockSetNoPacketInspectionFlag(Flow *);
 static inline void FlowSetNoPacketInspectionFlag(Flow *);
 static inline void FlowLockSetNoPayloadInspectionFlag(Flow *);
 static inline void FlowSetNoPayloadInspectionFlag(Flow *);
 static inline void FlowSetSessionNoApplayerInspectionFlag(Flow *);
+static inline void FlowSetBypassFlag(Flow *);
 
 int FlowGetPacketDirection(Flow *, Packet *);
 
@@ -486,6 +498,17 @@ static inline void FlowSetSessionNoApplayerInspectionFlag(Flow *f) {
     f->flags |= FLOW_NO_APPLAYER_INSPECTION;
 }
 
+/** \brief set flow flag to bypass the flow. Packets of the flow are
+ *         then only accounted for in FlowHandlePacket and skip stream
+ *         tracking and detection.
+ *
+ *  \param f *LOCKED* flow
+ */
+static inline void FlowSetBypassFlag(Flow *f) {
+    SCLogDebug("flow %p bypassed", f);
+    f->flags |= FLOW_BYPASSED;
+}
+
 #define FlowReference(dst_f_ptr, f) do {            \
         if ((f) != NULL) {                          \
             FlowIncrUsecnt((f));                    \
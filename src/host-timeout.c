@@ -23,6 +23,7 @@
 
 #include "suricata-common.h"
 #include "host.h"
+#include "host-timeout.h"
 
 #include "detect-engine-tag.h"
 #include "detect-engine-threshold.h"
@@ -114,6 +115,7 @@ static uint32_t HostHashRowTimeout(HostHashRow *hb, Host *h, struct timeval *ts)
 
             h->hnext = NULL;
             h->hprev = NULL;
+            h->flags &= ~HOST_FLAG_IN_HASH;
 
             HostClearMemory (h);
 
@@ -136,20 +138,28 @@ static uint32_t HostHashRowTimeout(HostHashRow *hb, Host *h, struct timeval *ts)
 }
 
 /**
- *  \brief time out hosts from the hash
+ *  \internal
  *
+ *  \brief check the next slice of rows of a shard for timed out hosts
+ *
+ *  \param hs host shard
  *  \param ts timestamp
  *
- *  \retval cnt number of timed out host
+ *  \retval cnt timed out hosts
  */
-uint32_t HostTimeoutHash(struct timeval *ts) {
-    uint32_t idx = 0;
+static uint32_t HostShardTimeout(HostShard *hs, struct timeval *ts)
+{
     uint32_t cnt = 0;
+    uint32_t rows = (hs->row_cnt + HOST_TIMEOUT_SWEEP_STEPS - 1) /
+                    HOST_TIMEOUT_SWEEP_STEPS;
+
+    while (rows--) {
+        if (hs->sweep_idx >= hs->row_cnt)
+            hs->sweep_idx = 0;
+
+        HostHashRow *hb = &host_hash[hs->row_start + hs->sweep_idx];
+        hs->sweep_idx++;
 
-    for (idx = 0; idx < host_config.hash_size; idx++) {
-        HostHashRow *hb = &host_hash[idx];
-        if (hb == NULL)
-            continue;
         if (HRLOCK_TRYLOCK(hb) != 0)
             continue;
 
@@ -168,3 +178,29 @@ uint32_t HostTimeoutHash(struct timeval *ts) {
     return cnt;
 }
 
+/**
+ *  \brief time out hosts from the hash
+ *
+ *  The hash is swept incrementally: each call checks 1/HOST_TIMEOUT_SWEEP_STEPS
+ *  of the rows of every shard, so a full pass over the table takes
+ *  HOST_TIMEOUT_SWEEP_STEPS calls. This keeps the time the flow manager
+ *  spends on hosts per run short on large host tables.
+ *
+ *  \param ts timestamp
+ *
+ *  \retval cnt number of timed out host
+ */
+uint32_t HostTimeoutHash(struct timeval *ts) {
+    uint32_t u;
+    uint32_t cnt = 0;
+
+    if (host_shards == NULL)
+        return 0;
+
+    for (u = 0; u < host_config.shards; u++) {
+        cnt += HostShardTimeout(&host_shards[u], ts);
+    }
+
+    return cnt;
+}
+
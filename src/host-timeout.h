@@ -24,6 +24,9 @@
 #ifndef __HOST_TIMEOUT_H__
 #define __HOST_TIMEOUT_H__
 
+/** number of HostTimeoutHash() calls needed to check the complete host hash */
+#define HOST_TIMEOUT_SWEEP_STEPS 8
+
 uint32_t HostTimeoutHash(struct timeval *ts);
 
 uint32_t HostGetSpareCount(void);
@@ -41,16 +41,40 @@
 #include "util-hash-lookup3.h"
 
 static Host *HostGetUsedHost(void);
+uint32_t HostGetKey(Address *a);
 
-/** queue with spare hosts */
-static HostQueue host_spare_q;
+/** queues with spare hosts, one per shard */
+static HostQueue *host_spare_qs = NULL;
+
+/** bumped each time the host engine is (re)initialized or shut down, so
+ *  that per thread caches holding hosts of a previous instance are reset */
+static uint32_t host_cache_epoch = 0;
 
 uint32_t HostSpareQueueGetSize(void) {
-    return HostQueueLen(&host_spare_q);
+    uint32_t len = 0;
+    uint32_t u;
+
+    if (host_shards == NULL)
+        return 0;
+
+    for (u = 0; u < host_config.shards; u++) {
+        len += HostQueueLen(host_shards[u].spare_q);
+    }
+    return len;
+}
+
+/** \internal
+ *  \brief get the shard a hash row belongs to */
+static inline HostShard *HostGetShard(uint32_t key) {
+    uint32_t idx = key / host_shards[0].row_cnt;
+    if (idx >= host_config.shards)
+        idx = host_config.shards - 1;
+    return &host_shards[idx];
 }
 
 void HostMoveToSpare(Host *h) {
-    HostEnqueue(&host_spare_q, h);
+    HostShard *hs = HostGetShard(HostGetKey(&h->a));
+    HostEnqueue(hs->spare_q, h);
     (void) SC_ATOMIC_SUB(host_counter, 1);
 }
 
@@ -118,6 +142,7 @@ void HostClearMemory(Host *h) {
 #define HOST_DEFAULT_HASHSIZE 4096
 #define HOST_DEFAULT_MEMCAP 16777216
 #define HOST_DEFAULT_PREALLOC 1000
+#define HOST_DEFAULT_SHARDS 16
 
 /** \brief initialize the configuration
  *  \warning Not thread safe */
@@ -130,7 +155,6 @@ void HostInitConfig(char quiet)
     SC_ATOMIC_INIT(host_counter);
     SC_ATOMIC_INIT(host_memuse);
     SC_ATOMIC_INIT(host_prune_idx);
-    HostQueueInit(&host_spare_q);
 
     unsigned int seed = RandomTimePreseed();
     /* set defaults */
@@ -139,6 +163,7 @@ void HostInitConfig(char quiet)
     host_config.hash_size   = HOST_DEFAULT_HASHSIZE;
     host_config.memcap      = HOST_DEFAULT_MEMCAP;
     host_config.prealloc    = HOST_DEFAULT_PREALLOC;
+    host_config.shards      = HOST_DEFAULT_SHARDS;
 
     /* Check if we have memcap and hash_size defined at config */
     char *conf_val;
@@ -169,9 +194,22 @@ void HostInitConfig(char quiet)
             host_config.prealloc = configval;
         }
     }
+    if ((ConfGet("host.shards", &conf_val)) == 1)
+    {
+        if (ByteExtractStringUint32(&configval, 10, strlen(conf_val),
+                                    conf_val) > 0) {
+            host_config.shards = configval;
+        }
+    }
+    if (host_config.shards == 0)
+        host_config.shards = 1;
+    if (host_config.shards > host_config.hash_size)
+        host_config.shards = host_config.hash_size;
+
     SCLogDebug("Host config from suricata.yaml: memcap: %"PRIu64", hash-size: "
-               "%"PRIu32", prealloc: %"PRIu32, host_config.memcap,
-               host_config.hash_size, host_config.prealloc);
+               "%"PRIu32", prealloc: %"PRIu32", shards: %"PRIu32,
+               host_config.memcap, host_config.hash_size,
+               host_config.prealloc, host_config.shards);
 
     /* alloc hash memory */
     uint64_t hash_size = host_config.hash_size * sizeof(HostHashRow);
@@ -197,6 +235,24 @@ void HostInitConfig(char quiet)
     }
     (void) SC_ATOMIC_ADD(host_memuse, (host_config.hash_size * sizeof(HostHashRow)));
 
+    /* set up the shards, the last one takes the remainder of the rows */
+    host_shards = SCCalloc(host_config.shards, sizeof(HostShard));
+    host_spare_qs = SCCalloc(host_config.shards, sizeof(HostQueue));
+    if (unlikely(host_shards == NULL || host_spare_qs == NULL)) {
+        SCLogError(SC_ERR_FATAL, "Fatal error encountered in HostInitConfig. Exiting...");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t shard_rows = host_config.hash_size / host_config.shards;
+    for (i = 0; i < host_config.shards; i++) {
+        HostQueueInit(&host_spare_qs[i]);
+        host_shards[i].spare_q = &host_spare_qs[i];
+        host_shards[i].row_start = i * shard_rows;
+        host_shards[i].row_cnt = shard_rows;
+    }
+    host_shards[host_config.shards - 1].row_cnt +=
+        host_config.hash_size - (shard_rows * host_config.shards);
+    host_cache_epoch++;
+
     if (quiet == FALSE) {
         SCLogInfo("allocated %llu bytes of memory for the host hash... "
                   "%" PRIu32 " buckets of size %" PRIuMAX "",
@@ -219,12 +275,13 @@ void HostInitConfig(char quiet)
             SCLogError(SC_ERR_HOST_INIT, "preallocating host failed: %s", strerror(errno));
             exit(EXIT_FAILURE);
         }
-        HostEnqueue(&host_spare_q,h);
+        HostEnqueue(host_shards[i % host_config.shards].spare_q, h);
     }
 
     if (quiet == FALSE) {
-        SCLogInfo("preallocated %" PRIu32 " hosts of size %" PRIuMAX "",
-                host_spare_q.len, (uintmax_t)sizeof(Host));
+        SCLogInfo("preallocated %" PRIu32 " hosts of size %" PRIuMAX " "
+                "in %" PRIu32 " shards", HostSpareQueueGetSize(),
+                (uintmax_t)sizeof(Host), host_config.shards);
         SCLogInfo("host memory usage: %llu bytes, maximum: %"PRIu64,
                 SC_ATOMIC_GET(host_memuse), host_config.memcap);
     }
@@ -254,10 +311,14 @@ void HostShutdown(void)
 
     HostPrintStats();
 
-    /* free spare queue */
-    while((h = HostDequeue(&host_spare_q))) {
-        BUG_ON(SC_ATOMIC_GET(h->use_cnt) > 0);
-        HostFree(h);
+    /* free spare queues */
+    if (host_shards != NULL) {
+        for (u = 0; u < host_config.shards; u++) {
+            while((h = HostDequeue(host_shards[u].spare_q))) {
+                BUG_ON(SC_ATOMIC_GET(h->use_cnt) > 0);
+                HostFree(h);
+            }
+        }
     }
 
     /* clear and free the hash */
@@ -276,7 +337,17 @@ void HostShutdown(void)
         host_hash = NULL;
     }
     (void) SC_ATOMIC_SUB(host_memuse, host_config.hash_size * sizeof(HostHashRow));
-    HostQueueDestroy(&host_spare_q);
+
+    if (host_shards != NULL) {
+        for (u = 0; u < host_config.shards; u++) {
+            HostQueueDestroy(host_shards[u].spare_q);
+        }
+        SCFree(host_spare_qs);
+        host_spare_qs = NULL;
+        SCFree(host_shards);
+        host_shards = NULL;
+    }
+    host_cache_epoch++;
 
     SC_ATOMIC_DESTROY(host_prune_idx);
     SC_ATOMIC_DESTROY(host_memuse);
@@ -301,6 +372,11 @@ void HostCleanup(void)
             HostHashRow *hb = &host_hash[u];
             HRLOCK_LOCK(hb);
             while (h) {
+                /* wait for a host that is in use, its tags and
+                 * thresholds must be cleared too. Row then host is
+                 * the lock order of HostGetHostFromHash as well. */
+                SCMutexLock(&h->m);
+
                 if ((SC_ATOMIC_GET(h->use_cnt) > 0) && (h->iprep != NULL)) {
                     /* iprep is attached to host only clear tag and threshold */
                     if (h->tag != NULL) {
@@ -311,6 +387,7 @@ void HostCleanup(void)
                         ThresholdListFree(h->threshold);
                         h->threshold = NULL;
                     }
+                    SCMutexUnlock(&h->m);
                     h = h->hnext;
                 } else {
                     Host *n = h->hnext;
@@ -325,7 +402,9 @@ void HostCleanup(void)
                         hb->tail = h->hprev;
                     h->hnext = NULL;
                     h->hprev = NULL;
+                    h->flags &= ~HOST_FLAG_IN_HASH;
                     HostClearMemory(h);
+                    SCMutexUnlock(&h->m);
                     HostMoveToSpare(h);
                     h = n;
                 }
@@ -375,11 +454,20 @@ static inline int HostCompare(Host *h, Address *a) {
  *
  *  \retval h *LOCKED* host on succes, NULL on error.
  */
-static Host *HostGetNew(Address *a) {
+static Host *HostGetNew(HostShard *hs, Address *a) {
     Host *h = NULL;
 
-    /* get a host from the spare queue */
-    h = HostDequeue(&host_spare_q);
+    /* get a host from the spare queue of our shard */
+    h = HostDequeue(hs->spare_q);
+    if (h == NULL) {
+        /* see if another shard has spares before growing the table. The
+         * unlocked len check is just a hint to skip empty queues. */
+        uint32_t u;
+        for (u = 0; u < host_config.shards && h == NULL; u++) {
+            if (host_shards[u].spare_q->len > 0)
+                h = HostDequeue(host_shards[u].spare_q);
+        }
+    }
     if (h == NULL) {
         /* If we reached the max memcap, we get a used host */
         if (!(HOST_CHECK_MEMCAP(sizeof(Host)))) {
@@ -421,6 +509,7 @@ static Host *HostGetNew(Address *a) {
 
 void HostInit(Host *h, Address *a) {
     COPY_ADDRESS(a, &h->a);
+    h->flags |= HOST_FLAG_IN_HASH;
     (void) HostIncrUsecnt(h);
 }
 
@@ -453,7 +542,7 @@ Host *HostGetHostFromHash (Address *a)
 
     /* see if the bucket already has a host */
     if (hb->head == NULL) {
-        h = HostGetNew(a);
+        h = HostGetNew(HostGetShard(key), a);
         if (h == NULL) {
             HRLOCK_UNLOCK(hb);
             return NULL;
@@ -482,7 +571,7 @@ Host *HostGetHostFromHash (Address *a)
             h = h->hnext;
 
             if (h == NULL) {
-                h = ph->hnext = HostGetNew(a);
+                h = ph->hnext = HostGetNew(HostGetShard(key), a);
                 if (h == NULL) {
                     HRLOCK_UNLOCK(hb);
                     return NULL;
@@ -603,6 +692,96 @@ Host *HostLookupHostFromHash (Address *a)
     return h;
 }
 
+/** \internal
+ *  \brief get the per thread cache slot for an address */
+static inline uint32_t HostThreadCacheIdx(Address *a) {
+    uint32_t v = a->addr_data32[0];
+    if (a->family == AF_INET6) {
+        v ^= a->addr_data32[1] ^ a->addr_data32[2] ^ a->addr_data32[3];
+    }
+    return (v * 2654435761U) >> (32 - HOST_THREAD_CACHE_BITS);
+}
+
+/** \internal
+ *  \brief check the per thread cache for a host
+ *
+ *  The host is locked before its address and hash membership are checked.
+ *  Removing a host from the hash requires the host lock, so if the checks
+ *  pass the host can't go away until we release it.
+ *
+ *  \retval h *LOCKED* host or NULL
+ */
+static Host *HostThreadCacheCheck(HostThreadCache *hc, Address *a, uint32_t idx) {
+    if (unlikely(hc->epoch != host_cache_epoch)) {
+        memset(hc->hosts, 0x00, sizeof(hc->hosts));
+        hc->epoch = host_cache_epoch;
+        return NULL;
+    }
+
+    Host *h = hc->hosts[idx];
+    if (h == NULL)
+        return NULL;
+
+    SCMutexLock(&h->m);
+    if ((h->flags & HOST_FLAG_IN_HASH) && HostCompare(h, a) != 0) {
+        (void) HostIncrUsecnt(h);
+        return h;
+    }
+    SCMutexUnlock(&h->m);
+
+    /* host was recycled, forget it */
+    hc->hosts[idx] = NULL;
+    return NULL;
+}
+
+/** \brief look up a host, checking the per thread cache first
+ *
+ *  Same as HostLookupHostFromHash(), but the hash row lock is only taken
+ *  if the host is not in the callers cache.
+ *
+ *  \param hc per thread host cache
+ *  \param a address to look up
+ *
+ *  \retval h *LOCKED* host or NULL
+ */
+Host *HostLookupHostFromCache (HostThreadCache *hc, Address *a)
+{
+    uint32_t idx = HostThreadCacheIdx(a);
+
+    Host *h = HostThreadCacheCheck(hc, a, idx);
+    if (h != NULL)
+        return h;
+
+    h = HostLookupHostFromHash(a);
+    if (h != NULL)
+        hc->hosts[idx] = h;
+    return h;
+}
+
+/** \brief get a host, checking the per thread cache first
+ *
+ *  Same as HostGetHostFromHash(), but the hash row lock is only taken
+ *  if the host is not in the callers cache.
+ *
+ *  \param hc per thread host cache
+ *  \param a address to look up
+ *
+ *  \retval h *LOCKED* host or NULL
+ */
+Host *HostGetHostFromCache (HostThreadCache *hc, Address *a)
+{
+    uint32_t idx = HostThreadCacheIdx(a);
+
+    Host *h = HostThreadCacheCheck(hc, a, idx);
+    if (h != NULL)
+        return h;
+
+    h = HostGetHostFromHash(a);
+    if (h != NULL)
+        hc->hosts[idx] = h;
+    return h;
+}
+
 /** \internal
  *  \brief Get a host from the hash directly.
  *
@@ -660,6 +839,7 @@ static Host *HostGetUsedHost(void) {
 
         h->hnext = NULL;
         h->hprev = NULL;
+        h->flags &= ~HOST_FLAG_IN_HASH;
         HRLOCK_UNLOCK(hb);
 
         HostClearMemory (h);
@@ -68,6 +68,9 @@ typedef struct Host_ {
     SC_ATOMIC_DECLARE(unsigned short, use_cnt);
 #endif
 
+    /** host flags, protected by the host mutex */
+    uint8_t flags;
+
     /** pointers to tag and threshold storage */
     void *tag;
     void *threshold;
@@ -82,6 +85,10 @@ typedef struct Host_ {
     struct Host_ *lprev;
 } Host;
 
+/** host is in the hash, set on insert and cleared when the host is removed
+ *  from its hash row. Used to validate per thread cache entries. */
+#define HOST_FLAG_IN_HASH   0x01
+
 typedef struct HostHashRow_ {
     HRLOCK_TYPE lock;
     Host *head;
@@ -95,6 +102,41 @@ typedef struct HostHashRow_ {
 /** host hash table */
 HostHashRow *host_hash;
 
+/** \brief A shard of the host table: a contiguous range of hash rows
+ *         with its own spare queue. Spreads the spare queue lock and the
+ *         timeout sweep over the shards. */
+typedef struct HostShard_ {
+    /** spare hosts of this shard */
+    struct HostQueue_ *spare_q;
+    /** first hash row of this shard */
+    uint32_t row_start;
+    /** number of hash rows in this shard */
+    uint32_t row_cnt;
+    /** next row (relative to row_start) to check in the incremental
+     *  timeout sweep. Only used by the flow manager. */
+    uint32_t sweep_idx;
+} HostShard;
+
+/** host table shards */
+HostShard *host_shards;
+
+/** number of slots in the per thread host cache, must be a power of 2 */
+#define HOST_THREAD_CACHE_BITS  6
+#define HOST_THREAD_CACHE_SIZE  (1 << HOST_THREAD_CACHE_BITS)
+
+/** \brief Per thread lookaside cache of recently used hosts.
+ *
+ *  Hosts are never freed while the engine runs, only recycled. A cache
+ *  entry is validated by locking the host and checking that it is still
+ *  in the hash with the same address, so a stale entry just results in a
+ *  regular hash lookup. */
+typedef struct HostThreadCache_ {
+    /** host engine epoch this cache was filled in, the cache is reset if
+     *  the host engine was reinitialized in the meantime */
+    uint32_t epoch;
+    Host *hosts[HOST_THREAD_CACHE_SIZE];
+} HostThreadCache;
+
 #define HOST_VERBOSE    0
 #define HOST_QUIET      1
 
@@ -103,6 +145,7 @@ typedef struct HostConfig_ {
     uint32_t hash_rand;
     uint32_t hash_size;
     uint32_t prealloc;
+    uint32_t shards;
 } HostConfig;
 
 /** \brief check if a memory alloc would fit in the memcap
@@ -145,6 +188,8 @@ void HostCleanup(void);
 
 Host *HostLookupHostFromHash (Address *);
 Host *HostGetHostFromHash (Address *);
+Host *HostLookupHostFromCache (HostThreadCache *, Address *);
+Host *HostGetHostFromCache (HostThreadCache *, Address *);
 void HostRelease(Host *);
 void HostLock(Host *);
 void HostClearMemory(Host *);
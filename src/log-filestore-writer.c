@@ -0,0 +1,820 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Asynchronous writer threads for the file-store output.
+ *
+ * The output thread copies the new chunks of a file into a job and hands
+ * it to the writer thread the file is assigned to. Writer threads keep
+ * the files they write open and collect small chunks in a per file
+ * buffer, so the disk sees write-size sized writes instead of an
+ * open/write/close for every chunk.
+ *
+ * Files are written to a "tmp" directory and moved into place once they
+ * are complete. With sharding the final location is a subdirectory
+ * named after the first byte of the md5 of the file (or of a hash of the
+ * file id if no md5 was calculated). With dedup files are named after
+ * their md5 and content that is already stored is discarded; the .meta
+ * record of each sighting is appended to the .meta file of the stored
+ * copy.
+ *
+ * Memory used by queued jobs is bounded by the memcap: when it is
+ * reached the output thread waits for the writers to catch up.
+ */
+
+#include "suricata-common.h"
+#include "threads.h"
+#include "log-filestore-writer.h"
+#include "tm-threads.h"
+#include "util-debug.h"
+#include "util-signal.h"
+#include "util-unittest.h"
+
+/** \internal
+ *  \brief write a buffer, dealing with short writes
+ *  \retval 0 on success, -1 on error
+ */
+static int FilestoreWriteAll(int fd, const uint8_t *buf, uint32_t len)
+{
+    while (len > 0) {
+        ssize_t r = write(fd, buf, len);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += r;
+        len -= (uint32_t)r;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief spread the sequential file ids over the shard directories */
+static inline uint8_t FilestoreIdHash(uint32_t file_id)
+{
+    return (uint8_t)((file_id * 2654435761U) >> 24);
+}
+
+static void FilestoreTmpPath(FilestoreWriter *fw, uint32_t file_id,
+                             char *path, size_t size)
+{
+    snprintf(path, size, "%s/tmp/file.%u", fw->base_dir, file_id);
+}
+
+/** \internal
+ *  \brief create a directory if it doesn't exist yet
+ *  \retval 0 on success, -1 on error
+ */
+static int FilestoreMkdir(const char *path)
+{
+    if (mkdir(path, S_IRWXU|S_IXGRP|S_IRGRP) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief get the final path of a file, creating its shard directory
+ *
+ *  \param md5 md5 of the file or NULL if it is unknown
+ */
+static int FilestoreFinalPath(FilestoreWriter *fw, uint32_t file_id,
+                              const uint8_t *md5, char *path, size_t size)
+{
+    char dir[PATH_MAX];
+
+    if (fw->shard) {
+        uint8_t prefix = md5 ? md5[0] : FilestoreIdHash(file_id);
+        snprintf(dir, sizeof(dir), "%s/%02x", fw->base_dir, prefix);
+        if (FilestoreMkdir(dir) < 0)
+            return -1;
+    } else {
+        strlcpy(dir, fw->base_dir, sizeof(dir));
+    }
+
+    if (fw->dedup && md5 != NULL) {
+        char hex[33];
+        int i;
+        for (i = 0; i < 16; i++) {
+            snprintf(hex + i * 2, 3, "%02x", md5[i]);
+        }
+        snprintf(path, size, "%s/%s", dir, hex);
+    } else {
+        snprintf(path, size, "%s/file.%u", dir, file_id);
+    }
+    return 0;
+}
+
+static int FilestoreFileFlush(FilestoreWriterThread *t, FilestoreFile *ff)
+{
+    if (ff->buf_len == 0)
+        return 0;
+
+    int r = -1;
+    if (ff->fd != -1) {
+        r = FilestoreWriteAll(ff->fd, ff->buf, ff->buf_len);
+        t->writes++;
+    }
+    if (r < 0)
+        t->errors++;
+    ff->buf_len = 0;
+    return r;
+}
+
+/** \internal
+ *  \brief add data to a file, coalescing small chunks in its buffer */
+static void FilestoreFileWrite(FilestoreWriterThread *t, FilestoreFile *ff,
+                               const uint8_t *data, uint32_t len)
+{
+    uint32_t write_size = t->fw->write_size;
+
+    t->bytes += len;
+
+    if (ff->fd == -1) {
+        return;
+    }
+
+    if (ff->buf_len + len > write_size) {
+        (void)FilestoreFileFlush(t, ff);
+
+        /* large chunks are written as is */
+        if (len >= write_size) {
+            if (FilestoreWriteAll(ff->fd, data, len) < 0)
+                t->errors++;
+            t->writes++;
+            return;
+        }
+    }
+
+    if (ff->buf == NULL) {
+        ff->buf = SCMalloc(write_size);
+        if (unlikely(ff->buf == NULL)) {
+            if (FilestoreWriteAll(ff->fd, data, len) < 0)
+                t->errors++;
+            t->writes++;
+            return;
+        }
+    }
+
+    memcpy(ff->buf + ff->buf_len, data, len);
+    ff->buf_len += len;
+
+    if (ff->buf_len == write_size)
+        (void)FilestoreFileFlush(t, ff);
+}
+
+static FilestoreFile *FilestoreFileLookup(FilestoreWriterThread *t, uint32_t file_id)
+{
+    FilestoreFile *ff = t->files[file_id % FILESTORE_WRITER_HASH_SIZE];
+    for ( ; ff != NULL; ff = ff->next) {
+        if (ff->file_id == file_id)
+            return ff;
+    }
+    return NULL;
+}
+
+/** \internal
+ *  \brief start writing a new file. If the file can't be created the
+ *         entry is still added, so the rest of its jobs are discarded. */
+static FilestoreFile *FilestoreFileOpen(FilestoreWriterThread *t, FilestoreJob *job)
+{
+    char path[PATH_MAX];
+
+    FilestoreFile *ff = SCMalloc(sizeof(FilestoreFile));
+    if (unlikely(ff == NULL))
+        return NULL;
+    memset(ff, 0x00, sizeof(FilestoreFile));
+
+    ff->file_id = job->file_id;
+    if (job->meta_head != NULL) {
+        ff->meta_head = SCStrdup(job->meta_head);
+    }
+
+    FilestoreTmpPath(t->fw, job->file_id, path, sizeof(path));
+    ff->fd = open(path, O_CREAT | O_TRUNC | O_NOFOLLOW | O_WRONLY, 0644);
+    if (ff->fd == -1) {
+        if (t->errors == 0) {
+            SCLogWarning(SC_ERR_FOPEN, "failed to create %s: %s", path,
+                         strerror(errno));
+        }
+        t->errors++;
+    }
+
+    uint32_t h = job->file_id % FILESTORE_WRITER_HASH_SIZE;
+    ff->next = t->files[h];
+    t->files[h] = ff;
+    return ff;
+}
+
+/** \internal
+ *  \brief write out a .meta record, appending it to an existing .meta
+ *         file of the same content */
+static void FilestoreWriteMeta(FilestoreWriterThread *t, const char *filename,
+                               const char *head, const char *tail)
+{
+    char metafilename[PATH_MAX];
+    snprintf(metafilename, sizeof(metafilename), "%s.meta", filename);
+
+    FILE *fp = fopen(metafilename, "a");
+    if (fp == NULL) {
+        t->errors++;
+        return;
+    }
+
+    /* separate the records of multiple sightings */
+    if (fseek(fp, 0, SEEK_END) == 0 && ftell(fp) > 0)
+        fprintf(fp, "\n");
+    if (head != NULL)
+        fputs(head, fp);
+    if (tail != NULL)
+        fputs(tail, fp);
+    fclose(fp);
+}
+
+/** \internal
+ *  \brief finish a file: flush and close it, then move it into place or
+ *         discard it if the content is already stored
+ *
+ *  \param job closing job or NULL if the writer is shutting down
+ */
+static void FilestoreFileClose(FilestoreWriterThread *t, FilestoreFile *ff,
+                               FilestoreJob *job)
+{
+    FilestoreWriter *fw = t->fw;
+    char tmp[PATH_MAX];
+    char path[PATH_MAX];
+    const uint8_t *md5 = NULL;
+
+    (void)FilestoreFileFlush(t, ff);
+
+    if (job != NULL && (job->flags & FILESTORE_JOB_MD5))
+        md5 = job->md5;
+
+    if (ff->fd != -1) {
+        close(ff->fd);
+        ff->fd = -1;
+
+        FilestoreTmpPath(fw, ff->file_id, tmp, sizeof(tmp));
+        if (FilestoreFinalPath(fw, ff->file_id, md5, path, sizeof(path)) < 0) {
+            SCLogWarning(SC_ERR_FOPEN, "failed to create the directory "
+                         "for file %u: %s", ff->file_id, strerror(errno));
+            t->errors++;
+            /* leave the file in tmp */
+            strlcpy(path, tmp, sizeof(path));
+        } else {
+            struct stat st;
+            if (fw->dedup && md5 != NULL && stat(path, &st) == 0) {
+                unlink(tmp);
+                t->files_dedup++;
+            } else if (rename(tmp, path) != 0) {
+                t->errors++;
+                strlcpy(path, tmp, sizeof(path));
+            } else {
+                t->files_stored++;
+            }
+        }
+
+        FilestoreWriteMeta(t, path, ff->meta_head,
+                           job ? job->meta_tail : NULL);
+    }
+
+    uint32_t h = ff->file_id % FILESTORE_WRITER_HASH_SIZE;
+    FilestoreFile **pff = &t->files[h];
+    while (*pff != ff)
+        pff = &(*pff)->next;
+    *pff = ff->next;
+
+    if (ff->meta_head != NULL)
+        SCFree(ff->meta_head);
+    if (ff->buf != NULL)
+        SCFree(ff->buf);
+    SCFree(ff);
+}
+
+static void FilestoreJobProcess(FilestoreWriterThread *t, FilestoreJob *job)
+{
+    FilestoreFile *ff = FilestoreFileLookup(t, job->file_id);
+    if (ff == NULL) {
+        ff = FilestoreFileOpen(t, job);
+        if (ff == NULL) {
+            t->errors++;
+            return;
+        }
+    }
+
+    if (job->len > 0)
+        FilestoreFileWrite(t, ff, job->data, job->len);
+
+    if (job->flags & FILESTORE_JOB_CLOSE)
+        FilestoreFileClose(t, ff, job);
+}
+
+/** \internal
+ *  \brief wake up a writer thread waiting for jobs so it sees THV_KILL */
+static void FilestoreWriterThreadWakeup(ThreadVars *tv)
+{
+    FilestoreWriterThread *t = (FilestoreWriterThread *)tv->tm_func_data;
+
+    SCMutexLock(&t->lock);
+    SCCondSignal(&t->cond);
+    SCMutexUnlock(&t->lock);
+}
+
+static void *FilestoreWriterThreadLoop(void *td)
+{
+    /* block usr2.  usr2 to be handled by the main thread only */
+    UtilSignalBlock(SIGUSR2);
+
+    ThreadVars *tv = (ThreadVars *)td;
+    FilestoreWriterThread *t = (FilestoreWriterThread *)tv->tm_func_data;
+    FilestoreWriter *fw = t->fw;
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+
+    while (1) {
+        SCMutexLock(&t->lock);
+        while (t->head == NULL && !t->stop &&
+               !TmThreadsCheckFlag(tv, THV_KILL)) {
+            SCCondWait(&t->cond, &t->lock);
+        }
+        FilestoreJob *job = t->head;
+        t->head = t->tail = NULL;
+        int stop = t->stop || TmThreadsCheckFlag(tv, THV_KILL);
+        SCMutexUnlock(&t->lock);
+
+        if (job == NULL && stop)
+            break;
+
+        uint64_t size = 0;
+        while (job != NULL) {
+            FilestoreJob *next = job->next;
+            FilestoreJobProcess(t, job);
+            size += job->size;
+            SCFree(job);
+            job = next;
+        }
+
+        SCMutexLock(&fw->mem_lock);
+        fw->memuse -= size;
+        SCCondBroadcast(&fw->mem_cond);
+        SCMutexUnlock(&fw->mem_lock);
+    }
+
+    /* files that never saw their end are moved into place as they are */
+    uint32_t h;
+    for (h = 0; h < FILESTORE_WRITER_HASH_SIZE; h++) {
+        while (t->files[h] != NULL) {
+            FilestoreFileClose(t, t->files[h], NULL);
+        }
+    }
+
+    /* if we were killed by the thread framework it takes care of the
+     * tv, in unix socket mode it may be freed before the writer is */
+    SCMutexLock(&t->lock);
+    if (!t->stop)
+        t->tv = NULL;
+    SCMutexUnlock(&t->lock);
+
+    /* jobs for this thread are dropped from now on, wake up the
+     * producers waiting for us to free memory */
+    SCMutexLock(&fw->mem_lock);
+    t->running = 0;
+    SCCondBroadcast(&fw->mem_cond);
+    SCMutexUnlock(&fw->mem_lock);
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    pthread_exit((void *) 0);
+    return NULL;
+}
+
+/**
+ * \brief Create a job for a file.
+ *
+ * The job, its data and the meta strings are a single allocation. The
+ * caller copies len bytes of file data to job->data.
+ *
+ * \param file_id id of the file
+ * \param meta_head start of the .meta record, only for the first job
+ * \param meta_tail end of the .meta record, only for the last job
+ * \param len length of the new data
+ *
+ * \retval job or NULL on error
+ */
+FilestoreJob *FilestoreJobNew(uint32_t file_id, const char *meta_head,
+                              const char *meta_tail, uint32_t len)
+{
+    size_t head_len = meta_head ? strlen(meta_head) + 1 : 0;
+    size_t tail_len = meta_tail ? strlen(meta_tail) + 1 : 0;
+    size_t size = sizeof(FilestoreJob) + len + head_len + tail_len;
+
+    FilestoreJob *job = SCMalloc(size);
+    if (unlikely(job == NULL))
+        return NULL;
+    memset(job, 0x00, sizeof(FilestoreJob));
+
+    uint8_t *ptr = (uint8_t *)(job + 1);
+    job->file_id = file_id;
+    job->size = (uint32_t)size;
+    job->len = len;
+    job->data = ptr;
+    ptr += len;
+
+    if (meta_head != NULL) {
+        job->meta_head = (char *)ptr;
+        memcpy(ptr, meta_head, head_len);
+        ptr += head_len;
+    }
+    if (meta_tail != NULL) {
+        job->meta_tail = (char *)ptr;
+        memcpy(ptr, meta_tail, tail_len);
+        job->flags |= FILESTORE_JOB_CLOSE;
+    }
+    return job;
+}
+
+/**
+ * \brief Queue a job. Waits for the writers if the memcap is reached.
+ *
+ * Jobs for a writer thread that already exited are dropped.
+ *
+ * \param job job created with FilestoreJobNew, owned by the writer after
+ *        this call
+ */
+void FilestoreWriterSubmit(FilestoreWriter *fw, FilestoreJob *job)
+{
+    FilestoreWriterThread *t = &fw->threads[job->file_id % fw->nthreads];
+
+    SCMutexLock(&fw->mem_lock);
+    if (t->running && fw->memuse > 0 && fw->memuse + job->size > fw->memcap) {
+        fw->waits++;
+        /* a job larger than the memcap is let through once the queues
+         * are empty */
+        while (t->running && fw->memuse > 0 &&
+               fw->memuse + job->size > fw->memcap) {
+            SCCondWait(&fw->mem_cond, &fw->mem_lock);
+        }
+    }
+    if (!t->running) {
+        fw->dropped++;
+        SCMutexUnlock(&fw->mem_lock);
+        SCFree(job);
+        return;
+    }
+    fw->memuse += job->size;
+    SCMutexUnlock(&fw->mem_lock);
+
+    job->next = NULL;
+    SCMutexLock(&t->lock);
+    if (t->tail != NULL)
+        t->tail->next = job;
+    else
+        t->head = job;
+    t->tail = job;
+    SCCondSignal(&t->cond);
+    SCMutexUnlock(&t->lock);
+}
+
+/**
+ * \brief Create a writer. The threads are not started.
+ *
+ * \param base_dir directory to store the files in
+ * \param nthreads number of writer threads
+ * \param memcap max memory used by queued jobs
+ * \param write_size size of the per file write buffer
+ * \param shard store files in hash prefix subdirectories
+ * \param dedup name files after their md5 and store each content once
+ *
+ * \retval fw writer or NULL on error
+ */
+FilestoreWriter *FilestoreWriterNew(const char *base_dir, uint32_t nthreads,
+                                    uint64_t memcap, uint32_t write_size,
+                                    int shard, int dedup)
+{
+    if (nthreads == 0 || nthreads > FILESTORE_WRITER_MAX_THREADS ||
+        write_size == 0)
+        return NULL;
+
+    FilestoreWriter *fw = SCMalloc(sizeof(FilestoreWriter));
+    if (unlikely(fw == NULL))
+        return NULL;
+    memset(fw, 0x00, sizeof(FilestoreWriter));
+
+    fw->threads = SCMalloc(nthreads * sizeof(FilestoreWriterThread));
+    if (unlikely(fw->threads == NULL)) {
+        SCFree(fw);
+        return NULL;
+    }
+    memset(fw->threads, 0x00, nthreads * sizeof(FilestoreWriterThread));
+
+    strlcpy(fw->base_dir, base_dir, sizeof(fw->base_dir));
+    fw->nthreads = nthreads;
+    fw->memcap = memcap;
+    fw->write_size = write_size;
+    fw->shard = shard ? 1 : 0;
+    fw->dedup = dedup ? 1 : 0;
+
+    SCMutexInit(&fw->mem_lock, NULL);
+    SCCondInit(&fw->mem_cond, NULL);
+
+    uint32_t i;
+    for (i = 0; i < nthreads; i++) {
+        FilestoreWriterThread *t = &fw->threads[i];
+        t->fw = fw;
+        SCMutexInit(&t->lock, NULL);
+        SCCondInit(&t->cond, NULL);
+    }
+    return fw;
+}
+
+/**
+ * \brief Create the store directories and start the writer threads.
+ *
+ * \retval 0 on success, -1 on error
+ */
+int FilestoreWriterStart(FilestoreWriter *fw)
+{
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s/tmp", fw->base_dir);
+    if (FilestoreMkdir(fw->base_dir) < 0 || FilestoreMkdir(tmp) < 0) {
+        SCLogError(SC_ERR_LOGDIR_CONFIG, "Cannot create file store "
+                   "directory %s: %s", tmp, strerror(errno));
+        return -1;
+    }
+
+    uint32_t i;
+    for (i = 0; i < fw->nthreads; i++) {
+        FilestoreWriterThread *t = &fw->threads[i];
+        snprintf(t->tv_name, sizeof(t->tv_name), "FilestoreWriter%"PRIu32,
+                 i + 1);
+
+        ThreadVars *tv = TmThreadCreateMgmtThread(t->tv_name,
+                FilestoreWriterThreadLoop, 0);
+        if (tv == NULL) {
+            SCLogError(SC_ERR_THREAD_CREATE, "failed to create file store "
+                       "writer thread");
+            return -1;
+        }
+        tv->tm_func_data = t;
+        tv->InShutdownHandler = FilestoreWriterThreadWakeup;
+
+        t->tv = tv;
+        t->running = 1;
+        if (TmThreadSpawn(tv) != TM_ECODE_OK) {
+            SCLogError(SC_ERR_THREAD_SPAWN, "failed to spawn file store "
+                       "writer thread");
+            t->tv = NULL;
+            t->running = 0;
+            TmThreadFree(tv);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief Stop the writer threads after they wrote out all queued jobs.
+ *
+ * No jobs may be submitted anymore.
+ */
+void FilestoreWriterStop(FilestoreWriter *fw)
+{
+    uint32_t i;
+    for (i = 0; i < fw->nthreads; i++) {
+        FilestoreWriterThread *t = &fw->threads[i];
+
+        SCMutexLock(&t->lock);
+        t->stop = 1;
+        SCCondSignal(&t->cond);
+        ThreadVars *tv = t->tv;
+        SCMutexUnlock(&t->lock);
+
+        /* not started or already stopped by the thread framework */
+        if (tv == NULL)
+            continue;
+
+        TmThreadKillThread(tv);
+        pthread_join(tv->t, NULL);
+#ifndef __tile__
+        TmThreadRemove(tv, tv->type);
+#endif
+        TmThreadFree(tv);
+        t->tv = NULL;
+    }
+}
+
+/**
+ * \brief Stop the writer threads and free the writer.
+ */
+void FilestoreWriterFree(FilestoreWriter *fw)
+{
+    if (fw == NULL)
+        return;
+
+    FilestoreWriterStop(fw);
+
+    uint64_t stored = 0, dedup = 0, bytes = 0, writes = 0, errors = 0;
+    uint32_t i;
+    for (i = 0; i < fw->nthreads; i++) {
+        FilestoreWriterThread *t = &fw->threads[i];
+
+        /* jobs left if the thread never ran or exited early */
+        FilestoreJob *job = t->head;
+        while (job != NULL) {
+            FilestoreJob *next = job->next;
+            SCFree(job);
+            job = next;
+        }
+
+        stored += t->files_stored;
+        dedup += t->files_dedup;
+        bytes += t->bytes;
+        writes += t->writes;
+        errors += t->errors;
+
+        SCCondDestroy(&t->cond);
+        SCMutexDestroy(&t->lock);
+    }
+
+    SCLogInfo("file store writer: %"PRIu64" files stored, %"PRIu64
+              " duplicates discarded, %"PRIu64" bytes in %"PRIu64" writes, "
+              "%"PRIu64" errors, waited for memory %"PRIu64" times, "
+              "%"PRIu64" jobs dropped", stored, dedup, bytes, writes,
+              errors, fw->waits, fw->dropped);
+
+    SCCondDestroy(&fw->mem_cond);
+    SCMutexDestroy(&fw->mem_lock);
+    SCFree(fw->threads);
+    SCFree(fw);
+}
+
+#ifdef UNITTESTS
+
+static void FilestoreTestSubmit(FilestoreWriter *fw, uint32_t file_id,
+                                const char *head, const char *tail,
+                                const char *data, const uint8_t *md5)
+{
+    uint32_t len = (uint32_t)strlen(data);
+    FilestoreJob *job = FilestoreJobNew(file_id, head, tail, len);
+    if (job == NULL)
+        return;
+    memcpy(job->data, data, len);
+    if (md5 != NULL) {
+        memcpy(job->md5, md5, sizeof(job->md5));
+        job->flags |= FILESTORE_JOB_MD5;
+    }
+    FilestoreWriterSubmit(fw, job);
+}
+
+static off_t FilestoreTestFileSize(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return -1;
+    return st.st_size;
+}
+
+/**
+ * \test small chunks are coalesced into a single write
+ */
+static int FilestoreWriterTest01(void)
+{
+    char dir[] = "/tmp/suricata-filestore-XXXXXX";
+    char path[PATH_MAX];
+    int result = 0;
+
+    if (mkdtemp(dir) == NULL)
+        return 0;
+
+    FilestoreWriter *fw = FilestoreWriterNew(dir, 1, 1024 * 1024, 64, 0, 0);
+    if (fw == NULL)
+        goto end;
+    if (FilestoreWriterStart(fw) < 0)
+        goto end;
+
+    FilestoreTestSubmit(fw, 7, "HEAD\n", NULL, "0123456789", NULL);
+    FilestoreTestSubmit(fw, 7, NULL, NULL, "0123456789", NULL);
+    FilestoreTestSubmit(fw, 7, NULL, "TAIL\n", "0123456789", NULL);
+    FilestoreWriterStop(fw);
+
+    if (fw->threads[0].writes != 1 || fw->threads[0].files_stored != 1) {
+        printf("writes %"PRIu64" stored %"PRIu64": ",
+               fw->threads[0].writes, fw->threads[0].files_stored);
+        goto end;
+    }
+    if (fw->memuse != 0) {
+        printf("memuse %"PRIu64": ", fw->memuse);
+        goto end;
+    }
+
+    snprintf(path, sizeof(path), "%s/file.7", dir);
+    if (FilestoreTestFileSize(path) != 30)
+        goto end;
+    snprintf(path, sizeof(path), "%s/file.7.meta", dir);
+    if (FilestoreTestFileSize(path) != 10)
+        goto end;
+
+    result = 1;
+end:
+    if (fw != NULL)
+        FilestoreWriterFree(fw);
+    snprintf(path, sizeof(path), "%s/file.7", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/file.7.meta", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/tmp", dir);
+    rmdir(path);
+    rmdir(dir);
+    return result;
+}
+
+/**
+ * \test files are sharded by md5 prefix and duplicate content is only
+ *       stored once, with the .meta records of both sightings
+ */
+static int FilestoreWriterTest02(void)
+{
+    char dir[] = "/tmp/suricata-filestore-XXXXXX";
+    char path[PATH_MAX];
+    uint8_t md5[16] = { 0xab, 0xcd, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+                        0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e };
+    int result = 0;
+
+    if (mkdtemp(dir) == NULL)
+        return 0;
+
+    FilestoreWriter *fw = FilestoreWriterNew(dir, 1, 1024 * 1024, 8, 1, 1);
+    if (fw == NULL)
+        goto end;
+    if (FilestoreWriterStart(fw) < 0)
+        goto end;
+
+    FilestoreTestSubmit(fw, 1, "ONE\n", NULL, "0123456789", NULL);
+    FilestoreTestSubmit(fw, 2, "TWO\n", NULL, "0123456789", NULL);
+    FilestoreTestSubmit(fw, 1, NULL, "END\n", "abc", md5);
+    FilestoreTestSubmit(fw, 2, NULL, "END\n", "abc", md5);
+    FilestoreWriterStop(fw);
+
+    if (fw->threads[0].files_stored != 1 || fw->threads[0].files_dedup != 1)
+        goto end;
+
+    snprintf(path, sizeof(path), "%s/ab/abcd0102030405060708090a0b0c0d0e", dir);
+    if (FilestoreTestFileSize(path) != 13)
+        goto end;
+    snprintf(path, sizeof(path), "%s/ab/abcd0102030405060708090a0b0c0d0e.meta", dir);
+    if (FilestoreTestFileSize(path) != (off_t)strlen("ONE\nEND\n\nTWO\nEND\n"))
+        goto end;
+    snprintf(path, sizeof(path), "%s/tmp/file.2", dir);
+    if (FilestoreTestFileSize(path) != -1)
+        goto end;
+
+    result = 1;
+end:
+    if (fw != NULL)
+        FilestoreWriterFree(fw);
+    snprintf(path, sizeof(path), "%s/ab/abcd0102030405060708090a0b0c0d0e", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/ab/abcd0102030405060708090a0b0c0d0e.meta", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/ab", dir);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/tmp", dir);
+    rmdir(path);
+    rmdir(dir);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void FilestoreWriterRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("FilestoreWriterTest01", FilestoreWriterTest01, 1);
+    UtRegisterTest("FilestoreWriterTest02", FilestoreWriterTest02, 1);
+#endif /* UNITTESTS */
+}
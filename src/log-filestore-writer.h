@@ -0,0 +1,146 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Asynchronous writer threads for the file-store output.
+ */
+
+#ifndef __LOG_FILESTORE_WRITER_H__
+#define __LOG_FILESTORE_WRITER_H__
+
+#include "threads.h"
+#include "threadvars.h"
+
+/** default max memory used by queued file data */
+#define FILESTORE_WRITER_DEFAULT_MEMCAP     (32 * 1024 * 1024)
+/** default size of the per file write buffer */
+#define FILESTORE_WRITER_DEFAULT_WRITE_SIZE (256 * 1024)
+#define FILESTORE_WRITER_DEFAULT_THREADS    1
+#define FILESTORE_WRITER_MAX_THREADS        64
+
+/** size of the buffers the .meta records are formatted in */
+#define FILESTORE_META_SIZE                 4096
+
+/** number of buckets of the per writer table of open files */
+#define FILESTORE_WRITER_HASH_SIZE          256
+
+#define FILESTORE_JOB_CLOSE     0x01    /**< last job for this file */
+#define FILESTORE_JOB_MD5       0x02    /**< md5 field is set */
+
+/**
+ * \brief Unit of work for a writer thread: new data for a single file.
+ *
+ * The first job of a file carries the start of the .meta record, the
+ * last one (FILESTORE_JOB_CLOSE) the end of it and, if it was
+ * calculated, the md5 of the file.
+ */
+typedef struct FilestoreJob_ {
+    uint32_t file_id;
+    uint8_t flags;
+    uint8_t md5[16];
+
+    char *meta_head;
+    char *meta_tail;
+
+    uint8_t *data;
+    uint32_t len;
+
+    /** memory accounted against the writer memcap */
+    uint32_t size;
+
+    struct FilestoreJob_ *next;
+} FilestoreJob;
+
+/** \brief File being written by a writer thread */
+typedef struct FilestoreFile_ {
+    uint32_t file_id;
+    int fd;
+    char *meta_head;
+
+    /** write coalescing buffer */
+    uint8_t *buf;
+    uint32_t buf_len;
+
+    struct FilestoreFile_ *next;
+} FilestoreFile;
+
+struct FilestoreWriter_;
+
+/** \brief Writer thread with its own job queue. All jobs of a file go to
+ *         the same thread, so they are written in order. */
+typedef struct FilestoreWriterThread_ {
+    struct FilestoreWriter_ *fw;
+
+    SCMutex lock;
+    SCCondT cond;
+    FilestoreJob *head;     /**< protected by lock */
+    FilestoreJob *tail;     /**< protected by lock */
+    uint8_t stop;           /**< protected by lock */
+
+    /** thread, protected by lock. Only valid until the thread exits or,
+     *  if it was killed by the thread framework, until it stops. */
+    ThreadVars *tv;
+    char tv_name[32];
+    /** cleared by the thread when it exits, protected by fw->mem_lock */
+    uint8_t running;
+
+    /** files this thread has open, only used by the thread itself */
+    FilestoreFile *files[FILESTORE_WRITER_HASH_SIZE];
+
+    /** stats, only updated by the thread itself */
+    uint64_t files_stored;
+    uint64_t files_dedup;
+    uint64_t bytes;
+    uint64_t writes;
+    uint64_t errors;
+} FilestoreWriterThread;
+
+typedef struct FilestoreWriter_ {
+    char base_dir[PATH_MAX];
+
+    uint64_t memcap;
+    uint32_t write_size;
+    uint8_t shard;          /**< store files in hash prefix subdirectories */
+    uint8_t dedup;          /**< don't store the same content twice */
+
+    /** memory used by queued jobs, protected by mem_lock. Producers wait
+     *  on mem_cond while the memcap is reached. */
+    SCMutex mem_lock;
+    SCCondT mem_cond;
+    uint64_t memuse;
+    uint64_t waits;         /**< times a producer had to wait */
+    uint64_t dropped;       /**< jobs submitted after their writer thread
+                             *   exited */
+
+    uint32_t nthreads;
+    FilestoreWriterThread *threads;
+} FilestoreWriter;
+
+FilestoreWriter *FilestoreWriterNew(const char *, uint32_t, uint64_t,
+                                    uint32_t, int, int);
+int FilestoreWriterStart(FilestoreWriter *);
+void FilestoreWriterStop(FilestoreWriter *);
+void FilestoreWriterFree(FilestoreWriter *);
+
+FilestoreJob *FilestoreJobNew(uint32_t, const char *, const char *, uint32_t);
+void FilestoreWriterSubmit(FilestoreWriter *, FilestoreJob *);
+
+void FilestoreWriterRegisterTests(void);
+
+#endif /* __LOG_FILESTORE_WRITER_H__ */
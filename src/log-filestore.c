@@ -45,6 +45,8 @@
 #include "util-debug.h"
 #include "util-atomic.h"
 #include "util-file.h"
+#include "util-fmemopen.h"
+#include "util-misc.h"
 
 #include "output.h"
 
@@ -54,6 +56,7 @@
 #include "app-layer-htp.h"
 #include "util-memcmp.h"
 #include "stream-tcp-reassemble.h"
+#include "log-filestore-writer.h"
 
 #define MODULE_NAME "LogFilestoreLog"
 
@@ -70,6 +73,8 @@ static void LogFilestoreLogDeInitCtx(OutputCtx *);
 SC_ATOMIC_DECLARE(unsigned int, file_id);
 static char g_logfile_base_dir[PATH_MAX] = "/tmp";
 static char g_waldo[PATH_MAX] = "";
+/** writer threads, NULL if files are written by the output thread */
+static FilestoreWriter *g_filestore_writer = NULL;
 
 void TmModuleLogFilestoreRegister (void) {
     tmm_modules[TMM_FILESTORE].name = MODULE_NAME;
@@ -77,7 +82,7 @@ void TmModuleLogFilestoreRegister (void) {
     tmm_modules[TMM_FILESTORE].Func = LogFilestoreLog;
     tmm_modules[TMM_FILESTORE].ThreadExitPrintStats = LogFilestoreLogExitPrintStats;
     tmm_modules[TMM_FILESTORE].ThreadDeinit = LogFilestoreLogThreadDeinit;
-    tmm_modules[TMM_FILESTORE].RegisterTests = NULL;
+    tmm_modules[TMM_FILESTORE].RegisterTests = FilestoreWriterRegisterTests;
     tmm_modules[TMM_FILESTORE].cap_flags = 0;
 
     OutputRegisterModule(MODULE_NAME, "file", LogFilestoreLogInitCtx);
@@ -190,64 +195,114 @@ static void LogFilestoreMetaGetUserAgent(FILE *fp, Packet *p, File *ff) {
     fprintf(fp, "<unknown>");
 }
 
+static void LogFilestoreLogWriteMetaHead(FILE *fp, Packet *p, File *ff, int ipver) {
+    char timebuf[64];
+
+    CreateTimeString(&p->ts, timebuf, sizeof(timebuf));
+
+    fprintf(fp, "TIME:              %s\n", timebuf);
+    if (p->pcap_cnt > 0) {
+        fprintf(fp, "PCAP PKT NUM:      %"PRIu64"\n", p->pcap_cnt);
+    }
+
+    char srcip[46], dstip[46];
+    Port sp, dp;
+    switch (ipver) {
+        case AF_INET:
+            PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p), srcip, sizeof(srcip));
+            PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p), dstip, sizeof(dstip));
+            break;
+        case AF_INET6:
+            PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p), srcip, sizeof(srcip));
+            PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p), dstip, sizeof(dstip));
+            break;
+        default:
+            strlcpy(srcip, "<unknown>", sizeof(srcip));
+            strlcpy(dstip, "<unknown>", sizeof(dstip));
+            break;
+    }
+    sp = p->sp;
+    dp = p->dp;
+
+    fprintf(fp, "SRC IP:            %s\n", srcip);
+    fprintf(fp, "DST IP:            %s\n", dstip);
+    fprintf(fp, "PROTO:             %" PRIu32 "\n", p->proto);
+    if (PKT_IS_TCP(p) || PKT_IS_UDP(p)) {
+        fprintf(fp, "SRC PORT:          %" PRIu16 "\n", sp);
+        fprintf(fp, "DST PORT:          %" PRIu16 "\n", dp);
+    }
+    fprintf(fp, "HTTP URI:          ");
+    LogFilestoreMetaGetUri(fp, p, ff);
+    fprintf(fp, "\n");
+    fprintf(fp, "HTTP HOST:         ");
+    LogFilestoreMetaGetHost(fp, p, ff);
+    fprintf(fp, "\n");
+    fprintf(fp, "HTTP REFERER:      ");
+    LogFilestoreMetaGetReferer(fp, p, ff);
+    fprintf(fp, "\n");
+    fprintf(fp, "HTTP USER AGENT:   ");
+    LogFilestoreMetaGetUserAgent(fp, p, ff);
+    fprintf(fp, "\n");
+    fprintf(fp, "FILENAME:          ");
+    PrintRawUriFp(fp, ff->name, ff->name_len);
+    fprintf(fp, "\n");
+}
+
 static void LogFilestoreLogCreateMetaFile(Packet *p, File *ff, char *filename, int ipver) {
     char metafilename[PATH_MAX] = "";
     snprintf(metafilename, sizeof(metafilename), "%s.meta", filename);
     FILE *fp = fopen(metafilename, "w+");
     if (fp != NULL) {
-        char timebuf[64];
+        LogFilestoreLogWriteMetaHead(fp, p, ff, ipver);
+        fclose(fp);
+    }
+}
 
-        CreateTimeString(&p->ts, timebuf, sizeof(timebuf));
+static void LogFilestoreLogWriteMetaTail(FILE *fp, File *ff) {
+    fprintf(fp, "MAGIC:             %s\n",
+            ff->magic ? ff->magic : "<unknown>");
 
-        fprintf(fp, "TIME:              %s\n", timebuf);
-        if (p->pcap_cnt > 0) {
-            fprintf(fp, "PCAP PKT NUM:      %"PRIu64"\n", p->pcap_cnt);
-        }
-
-        char srcip[46], dstip[46];
-        Port sp, dp;
-        switch (ipver) {
-            case AF_INET:
-                PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p), srcip, sizeof(srcip));
-                PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p), dstip, sizeof(dstip));
-                break;
-            case AF_INET6:
-                PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p), srcip, sizeof(srcip));
-                PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p), dstip, sizeof(dstip));
-                break;
-            default:
-                strlcpy(srcip, "<unknown>", sizeof(srcip));
-                strlcpy(dstip, "<unknown>", sizeof(dstip));
-                break;
-        }
-        sp = p->sp;
-        dp = p->dp;
-
-        fprintf(fp, "SRC IP:            %s\n", srcip);
-        fprintf(fp, "DST IP:            %s\n", dstip);
-        fprintf(fp, "PROTO:             %" PRIu32 "\n", p->proto);
-        if (PKT_IS_TCP(p) || PKT_IS_UDP(p)) {
-            fprintf(fp, "SRC PORT:          %" PRIu16 "\n", sp);
-            fprintf(fp, "DST PORT:          %" PRIu16 "\n", dp);
-        }
-        fprintf(fp, "HTTP URI:          ");
-        LogFilestoreMetaGetUri(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP HOST:         ");
-        LogFilestoreMetaGetHost(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP REFERER:      ");
-        LogFilestoreMetaGetReferer(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "HTTP USER AGENT:   ");
-        LogFilestoreMetaGetUserAgent(fp, p, ff);
-        fprintf(fp, "\n");
-        fprintf(fp, "FILENAME:          ");
-        PrintRawUriFp(fp, ff->name, ff->name_len);
-        fprintf(fp, "\n");
-
-        fclose(fp);
+    switch (ff->state) {
+        case FILE_STATE_CLOSED:
+            fprintf(fp, "STATE:             CLOSED\n");
+#ifdef HAVE_NSS
+            if (ff->flags & FILE_MD5) {
+                fprintf(fp, "MD5:               ");
+                size_t x;
+                for (x = 0; x < sizeof(ff->md5); x++) {
+                    fprintf(fp, "%02x", ff->md5[x]);
+                }
+                fprintf(fp, "\n");
+            }
+            if (ff->flags & FILE_SHA1) {
+                fprintf(fp, "SHA1:              ");
+                size_t x;
+                for (x = 0; x < sizeof(ff->sha1); x++) {
+                    fprintf(fp, "%02x", ff->sha1[x]);
+                }
+                fprintf(fp, "\n");
+            }
+            if (ff->flags & FILE_SHA256) {
+                fprintf(fp, "SHA256:            ");
+                size_t x;
+                for (x = 0; x < sizeof(ff->sha256); x++) {
+                    fprintf(fp, "%02x", ff->sha256[x]);
+                }
+                fprintf(fp, "\n");
+            }
+#endif
+            break;
+        case FILE_STATE_TRUNCATED:
+            fprintf(fp, "STATE:             TRUNCATED\n");
+            break;
+        case FILE_STATE_ERROR:
+            fprintf(fp, "STATE:             ERROR\n");
+            break;
+        default:
+            fprintf(fp, "STATE:             UNKNOWN\n");
+            break;
     }
+    fprintf(fp, "SIZE:              %"PRIu64"\n", ff->size);
 }
 
 static void LogFilestoreLogCloseMetaFile(File *ff) {
@@ -258,41 +313,122 @@ static void LogFilestoreLogCloseMetaFile(File *ff) {
     snprintf(metafilename, sizeof(metafilename), "%s.meta", filename);
     FILE *fp = fopen(metafilename, "a");
     if (fp != NULL) {
-        fprintf(fp, "MAGIC:             %s\n",
-                ff->magic ? ff->magic : "<unknown>");
-
-        switch (ff->state) {
-            case FILE_STATE_CLOSED:
-                fprintf(fp, "STATE:             CLOSED\n");
-#ifdef HAVE_NSS
-                if (ff->flags & FILE_MD5) {
-                    fprintf(fp, "MD5:               ");
-                    size_t x;
-                    for (x = 0; x < sizeof(ff->md5); x++) {
-                        fprintf(fp, "%02x", ff->md5[x]);
-                    }
-                    fprintf(fp, "\n");
-                }
-#endif
-                break;
-            case FILE_STATE_TRUNCATED:
-                fprintf(fp, "STATE:             TRUNCATED\n");
-                break;
-            case FILE_STATE_ERROR:
-                fprintf(fp, "STATE:             ERROR\n");
-                break;
-            default:
-                fprintf(fp, "STATE:             UNKNOWN\n");
-                break;
-        }
-        fprintf(fp, "SIZE:              %"PRIu64"\n", ff->size);
-
+        LogFilestoreLogWriteMetaTail(fp, ff);
         fclose(fp);
     } else {
         SCLogInfo("opening %s failed: %s", metafilename, strerror(errno));
     }
 }
 
+/**
+ *  \internal
+ *
+ *  \brief format the start or the end of the .meta record of a file in a
+ *         buffer, for the writer threads
+ *
+ *  \param tail format the end of the record instead of the start
+ */
+static void LogFilestoreLogFormatMeta(char *buf, size_t size, Packet *p,
+                                      File *ff, int ipver, int tail)
+{
+    buf[0] = '\0';
+
+    FILE *fp = SCFmemopen(buf, size, "w");
+    if (fp == NULL)
+        return;
+
+    if (tail)
+        LogFilestoreLogWriteMetaTail(fp, ff);
+    else
+        LogFilestoreLogWriteMetaHead(fp, p, ff, ipver);
+
+    long pos = ftell(fp);
+    fclose(fp);
+
+    if (pos < 0)
+        pos = 0;
+    else if ((size_t)pos >= size)
+        pos = (long)size - 1;
+    buf[pos] = '\0';
+}
+
+/**
+ *  \internal
+ *
+ *  \brief hand the new chunks of a file to the writer threads
+ *
+ *  All chunks not stored yet are copied into a single job. The job that
+ *  completes the file carries the md5, if it was calculated.
+ */
+static void LogFilestoreLogQueueFile(LogFilestoreLogThread *aft, Packet *p,
+                                     File *ff, int ipver, int file_close,
+                                     int file_trunc)
+{
+    char head[FILESTORE_META_SIZE];
+    char tail[FILESTORE_META_SIZE];
+    FileData *ffd;
+    uint32_t len = 0;
+
+    for (ffd = ff->chunks_head; ffd != NULL; ffd = ffd->next) {
+        if (ffd->stored == 0)
+            len += ffd->len;
+    }
+
+    /* like the synchronous store, only files with data are stored */
+    if (ff->file_id == 0 && len == 0)
+        return;
+
+    if (file_trunc && ff->state < FILE_STATE_CLOSED)
+        ff->state = FILE_STATE_TRUNCATED;
+
+    int close = (ff->state >= FILE_STATE_CLOSED ||
+                 (file_close == 1 && ff->state < FILE_STATE_CLOSED));
+    if (len == 0 && !close)
+        return;
+
+    int new_file = (ff->file_id == 0);
+    if (new_file) {
+        ff->file_id = SC_ATOMIC_ADD(file_id, 1);
+        LogFilestoreLogFormatMeta(head, sizeof(head), p, ff, ipver, 0);
+    }
+    if (close) {
+        LogFilestoreLogFormatMeta(tail, sizeof(tail), p, ff, ipver, 1);
+    }
+
+    FilestoreJob *job = FilestoreJobNew(ff->file_id, new_file ? head : NULL,
+                                        close ? tail : NULL, len);
+    if (job == NULL) {
+        /* the chunks are not flagged as stored, so this is retried on
+         * the next packet */
+        if (new_file)
+            ff->file_id = 0;
+        return;
+    }
+
+    uint8_t *ptr = job->data;
+    for (ffd = ff->chunks_head; ffd != NULL; ffd = ffd->next) {
+        if (ffd->stored == 0) {
+            memcpy(ptr, ffd->data, ffd->len);
+            ptr += ffd->len;
+            ffd->stored = 1;
+        }
+    }
+
+    if (close) {
+#ifdef HAVE_NSS
+        if (ff->state == FILE_STATE_CLOSED && (ff->flags & FILE_MD5)) {
+            memcpy(job->md5, ff->md5, sizeof(job->md5));
+            job->flags |= FILESTORE_JOB_MD5;
+        }
+#endif
+        ff->flags |= FILE_STORED;
+    }
+    if (new_file)
+        aft->file_cnt++;
+
+    FilestoreWriterSubmit(g_filestore_writer, job);
+}
+
 static TmEcode LogFilestoreLogWrap(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQueue *postpq, int ipver)
 {
     SCEnter();
@@ -337,6 +473,11 @@ static TmEcode LogFilestoreLogWrap(ThreadVars *tv, Packet *p, void *data, Packet
                 continue;
             }
 
+            if (g_filestore_writer != NULL) {
+                LogFilestoreLogQueueFile(aft, p, ff, ipver, file_close, file_trunc);
+                continue;
+            }
+
             FileData *ffd;
             for (ffd = ff->chunks_head; ffd != NULL; ffd = ffd->next) {
                 SCLogDebug("ffd %p", ffd);
@@ -564,6 +705,89 @@ static void LogFilestoreLogStoreWaldo(const char *path) {
     fclose(fp);
 }
 
+/**
+ *  \internal
+ *
+ *  \brief Set up the writer threads if the output configuration asks for
+ *         them.
+ *
+ *  Example:
+ *
+ *    - file-store:
+ *        async:
+ *          enabled: yes
+ *          threads: 2
+ *          memcap: 32mb
+ *          write-size: 256kb
+ *          shard-dirs: yes
+ *          dedup: yes
+ *
+ *  \retval 0 on success (also if async writing is not enabled), -1 on error
+ */
+static int LogFilestoreLogSetupAsync(ConfNode *conf)
+{
+    ConfNode *async = ConfNodeLookupChild(conf, "async");
+    if (async == NULL || !ConfNodeChildValueIsTrue(async, "enabled"))
+        return 0;
+
+    intmax_t threads = FILESTORE_WRITER_DEFAULT_THREADS;
+    if (ConfGetChildValueInt(async, "threads", &threads) == 1) {
+        if (threads <= 0 || threads > FILESTORE_WRITER_MAX_THREADS) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "file-store: async.threads "
+                       "must be between 1 and %d", FILESTORE_WRITER_MAX_THREADS);
+            return -1;
+        }
+    }
+
+    uint64_t memcap = FILESTORE_WRITER_DEFAULT_MEMCAP;
+    const char *val = ConfNodeLookupChildValue(async, "memcap");
+    if (val != NULL) {
+        if (ParseSizeStringU64(val, &memcap) < 0 || memcap == 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "file-store: invalid async.memcap "
+                       "\"%s\"", val);
+            return -1;
+        }
+    }
+
+    uint32_t write_size = FILESTORE_WRITER_DEFAULT_WRITE_SIZE;
+    val = ConfNodeLookupChildValue(async, "write-size");
+    if (val != NULL) {
+        if (ParseSizeStringU32(val, &write_size) < 0 || write_size == 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "file-store: invalid "
+                       "async.write-size \"%s\"", val);
+            return -1;
+        }
+    }
+
+    int shard = ConfNodeChildValueIsTrue(async, "shard-dirs");
+    int dedup = ConfNodeChildValueIsTrue(async, "dedup");
+    if (dedup) {
+#ifdef HAVE_NSS
+        /* files are named after their md5 */
+        FileForceMd5Enable();
+#else
+        SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "file-store: "
+                     "async.dedup requires linking against libnss, disabled");
+        dedup = 0;
+#endif
+    }
+
+    FilestoreWriter *fw = FilestoreWriterNew(g_logfile_base_dir,
+            (uint32_t)threads, memcap, write_size, shard, dedup);
+    if (fw == NULL)
+        return -1;
+    if (FilestoreWriterStart(fw) < 0) {
+        FilestoreWriterFree(fw);
+        return -1;
+    }
+    g_filestore_writer = fw;
+
+    SCLogInfo("file-store: %"PRIuMAX" writer threads, memcap %"PRIu64", "
+              "write size %"PRIu32"%s%s", (uintmax_t)threads, memcap,
+              write_size, shard ? ", sharded" : "", dedup ? ", dedup" : "");
+    return 0;
+}
+
 /** \brief Create a new http log LogFilestoreCtx.
  *  \param conf Pointer to ConfNode containing this loggers configuration.
  *  \return NULL if failure, LogFilestoreCtx* to the file_ctx if succesful
@@ -618,6 +842,16 @@ static OutputCtx *LogFilestoreLogInitCtx(ConfNode *conf)
 #endif
     }
 
+    if (FileForceHashParseConfig(conf, "file-store") < 0) {
+        SCFree(output_ctx);
+        return NULL;
+    }
+
+    if (LogFilestoreLogSetupAsync(conf) < 0) {
+        SCFree(output_ctx);
+        return NULL;
+    }
+
     const char *waldo = ConfNodeLookupChildValue(conf, "waldo");
     if (waldo != NULL && strlen(waldo) > 0) {
         if (PathIsAbsolute(waldo)) {
@@ -647,6 +881,12 @@ static void LogFilestoreLogDeInitCtx(OutputCtx *output_ctx)
     LogFileFreeCtx(logfile_ctx);
     free(output_ctx);
 
+    /* write out the queued files before the waldo */
+    if (g_filestore_writer != NULL) {
+        FilestoreWriterFree(g_filestore_writer);
+        g_filestore_writer = NULL;
+    }
+
     if (strlen(g_waldo) > 0) {
         LogFilestoreLogStoreWaldo(g_waldo);
     }
@@ -47,6 +47,7 @@
 #include "util-buffer.h"
 
 #include "util-logopenfile.h"
+#include "util-logwriter.h"
 
 #define DEFAULT_LOG_FILENAME "http.log"
 
@@ -140,6 +141,8 @@ typedef struct LogHttpLogThread_ {
     uint32_t uri_cnt;
 
     MemBuffer *buffer;
+    /** our buffer if the file is written asynchronously */
+    LogWriterBuffer *log_buf;
 } LogHttpLogThread;
 
 static void CreateTimeString (const struct timeval *ts, char *str, size_t size)
@@ -520,10 +523,8 @@ static TmEcode LogHttpLogIPWrapper(ThreadVars *tv, Packet *p, void *data, Packet
 
         aft->uri_cnt ++;
 
-        SCMutexLock(&hlog->file_ctx->fp_mutex);
-        (void)MemBufferPrintToFPAsString(aft->buffer, hlog->file_ctx->fp);
-        fflush(hlog->file_ctx->fp);
-        SCMutexUnlock(&hlog->file_ctx->fp_mutex);
+        (void)LogFileWrite(hlog->file_ctx, aft->log_buf,
+                (const char *)aft->buffer->buffer, aft->buffer->offset);
 
         AppLayerTransactionUpdateLoggedId(p->flow);
     }
@@ -588,6 +589,7 @@ TmEcode LogHttpLogThreadInit(ThreadVars *t, void *initdata, void **data)
 
     /* Use the Ouptut Context (file pointer and mutex) */
     aft->httplog_ctx= ((OutputCtx *)initdata)->data;
+    aft->log_buf = LogWriterRegisterThread(aft->httplog_ctx->file_ctx, t);
 
     *data = (void *)aft;
     return TM_ECODE_OK;
@@ -635,6 +637,10 @@ OutputCtx *LogHttpLogInitCtx(ConfNode *conf)
         LogFileFreeCtx(file_ctx);
         return NULL;
     }
+    if (LogWriterSetup(file_ctx, conf) < 0) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
 
     LogHttpFileCtx *httplog_ctx = SCMalloc(sizeof(LogHttpFileCtx));
     if (unlikely(httplog_ctx == NULL)) {
@@ -28,6 +28,7 @@
 #include "debug.h"
 #include "detect.h"
 #include "flow.h"
+#include "flow-util.h"
 #include "conf.h"
 
 #include "threads.h"
@@ -35,6 +36,7 @@
 #include "tm-threads.h"
 
 #include "util-unittest.h"
+#include "util-unittest-helper.h"
 #include "log-pcap.h"
 #include "decode-ipv4.h"
 
@@ -58,6 +60,7 @@
 
 #define LOGMODE_NORMAL                  0
 #define LOGMODE_SGUIL                   1
+#define LOGMODE_MULTI                   2
 
 #define RING_BUFFER_MODE_DISABLED       0
 #define RING_BUFFER_MODE_ENABLED        1
@@ -68,10 +71,19 @@
 #define USE_STREAM_DEPTH_DISABLED       0
 #define USE_STREAM_DEPTH_ENABLED        1
 
+#define LOGMODE_COND_ALL                0
+#define LOGMODE_COND_ALERTS             1
+
+#define DEFAULT_RING_SECONDS            10
+#define DEFAULT_RING_FLOW_LIMIT         256 * 1024
+#define DEFAULT_RING_MEMCAP             64 * 1024 * 1024
+#define PCAPLOG_RING_MIN_SIZE           4096
+
 TmEcode PcapLog(ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
 TmEcode PcapLogDataInit(ThreadVars *, void *, void **);
 TmEcode PcapLogDataDeinit(ThreadVars *, void *);
 static void PcapLogFileDeInitCtx(OutputCtx *);
+static void PcapLogRegisterTests(void);
 
 typedef struct PcapFileName_ {
     char *filename;
@@ -101,6 +113,10 @@ typedef struct PcapLogData_ {
     int timestamp_format;       /**< timestamp format sec or usec */
     int use_stream_depth;       /**< use stream depth i.e. ignore packets that reach limit */
     char dir[PATH_MAX];         /**< pcap log directory */
+    uint32_t thread_cnt;        /**< multi mode: threads that got a copy */
+    int conditional;            /**< log all packets or only alerted flows */
+    uint32_t ring_seconds;      /**< conditional: seconds of history per flow */
+    uint32_t ring_flow_limit;   /**< conditional: max ring bytes per flow */
 
     SCMutex plog_lock;
     TAILQ_HEAD(, PcapFileName_) pcap_file_list;
@@ -108,13 +124,48 @@ typedef struct PcapLogData_ {
 
 int PcapLogOpenFileCtx(PcapLogData *);
 
+/** header of a packet stored in a flow's ring, the packet data follows */
+typedef struct PcapLogRingRec_ {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t len;
+} PcapLogRingRec;
+
+/** record size, keeping the next header 4 byte aligned */
+#define PCAPLOG_RING_REC_SIZE(len) \
+    (uint32_t)(sizeof(PcapLogRingRec) + (((len) + 3) & ~3))
+
+/** flow alerted or got tagged, its packets are written directly */
+#define PCAPLOG_RING_TRIGGERED          0x01
+
+/**
+ *  Per flow ring of recent packets for conditional logging.
+ *
+ *  Records are stored back to back in a single buffer that grows up to
+ *  ring-flow-limit. Live data is [head, tail) or, once wrapped,
+ *  [head, wrap) followed by [0, tail). Protected by the flow lock.
+ */
+typedef struct PcapLogRing_ {
+    uint8_t *buf;
+    uint32_t size;              /**< allocated size of buf */
+    uint32_t head;              /**< offset of the oldest record */
+    uint32_t tail;              /**< offset the next record goes to */
+    uint32_t wrap;              /**< end of the upper part if wrapped, else 0 */
+    uint32_t cnt;               /**< number of records */
+    uint8_t flags;
+} PcapLogRing;
+
+/** memory used by all flow rings, bounded by pcap_ring_memcap */
+SC_ATOMIC_DECLARE(uint64_t, pcap_ring_memuse);
+static uint64_t pcap_ring_memcap = DEFAULT_RING_MEMCAP;
+
 void TmModulePcapLogRegister(void)
 {
     tmm_modules[TMM_PCAPLOG].name = MODULE_NAME;
     tmm_modules[TMM_PCAPLOG].ThreadInit = PcapLogDataInit;
     tmm_modules[TMM_PCAPLOG].Func = PcapLog;
     tmm_modules[TMM_PCAPLOG].ThreadDeinit = PcapLogDataDeinit;
-    tmm_modules[TMM_PCAPLOG].RegisterTests = NULL;
+    tmm_modules[TMM_PCAPLOG].RegisterTests = PcapLogRegisterTests;
 
     OutputRegisterModule(MODULE_NAME, "pcap-log", PcapLogInitCtx);
 
@@ -224,55 +275,45 @@ int PcapLogRotateFile(ThreadVars *t, PcapLogData *pl)
 }
 
 /**
- * \brief Pcap logging main function
+ * \brief Write one packet to the current pcap file, opening or rotating
+ *        the file as needed. Caller holds pl->plog_lock.
  *
  * \param t threadvar
- * \param p packet
- * \param data thread module specific data
- * \param pq pre-packet-queue
- * \param postpq post-packet-queue
+ * \param pl PcapLog data
+ * \param ts packet timestamp
+ * \param data packet data
+ * \param data_len packet data length
+ * \param datalink link type, used when the dump handle is created
  *
  * \retval TM_ECODE_OK on succes
  * \retval TM_ECODE_FAILED on serious error
  */
-TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
-                 PacketQueue *postpq)
+static TmEcode PcapLogWrite(ThreadVars *t, PcapLogData *pl,
+                            const struct timeval *ts, uint8_t *data,
+                            uint32_t data_len, int datalink)
 {
     size_t len;
     int rotate = 0;
     int ret = 0;
 
-    PcapLogData *pl = (PcapLogData *)data;
-
-    if ((p->flags & PKT_PSEUDO_STREAM_END) ||
-        ((p->flags & PKT_STREAM_NOPCAPLOG) &&
-         (pl->use_stream_depth == USE_STREAM_DEPTH_ENABLED)) ||
-        (IS_TUNNEL_PKT(p) && !IS_TUNNEL_ROOT_PKT(p)))
-    {
-        return TM_ECODE_OK;
-    }
-
-    SCMutexLock(&pl->plog_lock);
-
     pl->pkt_cnt++;
-    pl->h->ts.tv_sec = p->ts.tv_sec;
-    pl->h->ts.tv_usec = p->ts.tv_usec;
-    pl->h->caplen = GET_PKT_LEN(p);
-    pl->h->len = GET_PKT_LEN(p);
-    len = sizeof(*pl->h) + GET_PKT_LEN(p);
+    pl->h->ts.tv_sec = ts->tv_sec;
+    pl->h->ts.tv_usec = ts->tv_usec;
+    pl->h->caplen = data_len;
+    pl->h->len = data_len;
+    len = sizeof(*pl->h) + data_len;
 
     if (pl->filename == NULL) {
         SCLogDebug("Opening PCAP log file %s", pl->filename);
         ret = PcapLogOpenFileCtx(pl);
         if (ret < 0) {
-            SCMutexUnlock(&pl->plog_lock);
             return TM_ECODE_FAILED;
         }
     }
 
     if (pl->mode == LOGMODE_SGUIL) {
         struct tm local_tm;
-        struct tm *tms = (struct tm *)SCLocalTime(p->ts.tv_sec, &local_tm);
+        struct tm *tms = (struct tm *)SCLocalTime(ts->tv_sec, &local_tm);
         if (tms->tm_mday != pl->prev_day) {
             rotate = 1;
             pl->prev_day = tms->tm_mday;
@@ -281,7 +322,6 @@ TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
 
     if ((pl->size_current + len) > pl->size_limit || rotate) {
         if (PcapLogRotateFile(t,pl) < 0) {
-            SCMutexUnlock(&pl->plog_lock);
             SCLogDebug("rotation of pcap failed");
             return TM_ECODE_FAILED;
         }
@@ -290,13 +330,11 @@ TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
     /* XXX pcap handles, nfq, pfring, can only have one link type ipfw? we do
      * this here as we don't know the link type until we get our first packet */
     if (pl->pcap_dead_handle == NULL) {
-        SCLogDebug("Setting pcap-log link type to %u", p->datalink);
+        SCLogDebug("Setting pcap-log link type to %u", datalink);
 
-        if ((pl->pcap_dead_handle = pcap_open_dead(p->datalink,
+        if ((pl->pcap_dead_handle = pcap_open_dead(datalink,
                                                    -1)) == NULL) {
             SCLogDebug("Error opening dead pcap handle");
-
-            SCMutexUnlock(&pl->plog_lock);
             return TM_ECODE_FAILED;
         }
     }
@@ -306,21 +344,356 @@ TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
         if ((pl->pcap_dumper = pcap_dump_open(pl->pcap_dead_handle,
                                               pl->filename)) == NULL) {
             SCLogInfo("Error opening dump file %s", pcap_geterr(pl->pcap_dead_handle));
-
-            SCMutexUnlock(&pl->plog_lock);
             return TM_ECODE_FAILED;
         }
     }
 
-    pcap_dump((u_char *)pl->pcap_dumper, pl->h, GET_PKT_DATA(p));
+    pcap_dump((u_char *)pl->pcap_dumper, pl->h, data);
     pl->size_current += len;
     SCLogDebug("pl->size_current %"PRIu64",  pl->size_limit %"PRIu64,
                pl->size_current, pl->size_limit);
 
-    SCMutexUnlock(&pl->plog_lock);
     return TM_ECODE_OK;
 }
 
+/** \internal
+ *  \brief Reserve ring memory against the global memcap.
+ *  \retval 1 reserved
+ *  \retval 0 memcap reached
+ */
+static int PcapLogRingMemReserve(uint32_t size)
+{
+    uint64_t memuse = SC_ATOMIC_ADD(pcap_ring_memuse, size);
+    if (pcap_ring_memcap != 0 && memuse > pcap_ring_memcap) {
+        (void)SC_ATOMIC_SUB(pcap_ring_memuse, size);
+        return 0;
+    }
+    return 1;
+}
+
+static void PcapLogRingMemRelease(uint32_t size)
+{
+    (void)SC_ATOMIC_SUB(pcap_ring_memuse, size);
+}
+
+/**
+ *  \brief Free a flow's packet ring. Called from the flow recycle and
+ *         destroy paths.
+ */
+void PcapLogFlowRingFree(PcapLogRing *ring)
+{
+    if (ring == NULL)
+        return;
+
+    if (ring->buf != NULL)
+        SCFree(ring->buf);
+    PcapLogRingMemRelease(ring->size + sizeof(PcapLogRing));
+    SCFree(ring);
+}
+
+/** \internal
+ *  \brief Drop the oldest record of the ring */
+static void PcapLogRingDropOldest(PcapLogRing *ring)
+{
+    PcapLogRingRec *rec = (PcapLogRingRec *)(ring->buf + ring->head);
+
+    ring->head += PCAPLOG_RING_REC_SIZE(rec->len);
+    ring->cnt--;
+
+    if (ring->cnt == 0) {
+        ring->head = ring->tail = ring->wrap = 0;
+    } else if (ring->wrap != 0 && ring->head == ring->wrap) {
+        ring->head = 0;
+        ring->wrap = 0;
+    }
+}
+
+/** \internal
+ *  \brief Grow a ring that is not wrapped, up to the per flow limit.
+ *  \retval 1 grown
+ *  \retval 0 at the limit or out of memory
+ */
+static int PcapLogRingGrow(PcapLogData *pl, PcapLogRing *ring, uint32_t need)
+{
+    if (ring->size >= pl->ring_flow_limit)
+        return 0;
+
+    uint32_t size = ring->size ? ring->size * 2 : PCAPLOG_RING_MIN_SIZE;
+    if (size < ring->tail + need)
+        size = ring->tail + need;
+    if (size > pl->ring_flow_limit)
+        size = pl->ring_flow_limit;
+    if (size <= ring->size)
+        return 0;
+
+    if (!PcapLogRingMemReserve(size - ring->size))
+        return 0;
+
+    uint8_t *buf = SCRealloc(ring->buf, size);
+    if (unlikely(buf == NULL)) {
+        PcapLogRingMemRelease(size - ring->size);
+        return 0;
+    }
+    ring->buf = buf;
+    ring->size = size;
+    return 1;
+}
+
+/**
+ *  \brief Store a packet in the flow's ring.
+ *
+ *  Records are never split: if the tail of the buffer can't hold one the
+ *  ring wraps to the start. Records older than ring_seconds are expired
+ *  first, after that the oldest records make room for the new one.
+ *
+ *  \param pl PcapLog data
+ *  \param f locked flow
+ *  \param p packet
+ *
+ *  \retval 1 packet stored
+ *  \retval 0 packet not stored (memcap or packet larger than the ring)
+ */
+static int PcapLogRingAdd(PcapLogData *pl, Flow *f, Packet *p)
+{
+    PcapLogRing *ring = f->pcap_ring;
+    uint32_t need = PCAPLOG_RING_REC_SIZE(GET_PKT_LEN(p));
+
+    if (need > pl->ring_flow_limit)
+        return 0;
+
+    if (ring == NULL) {
+        if (!PcapLogRingMemReserve(sizeof(PcapLogRing)))
+            return 0;
+        ring = SCMalloc(sizeof(PcapLogRing));
+        if (unlikely(ring == NULL)) {
+            PcapLogRingMemRelease(sizeof(PcapLogRing));
+            return 0;
+        }
+        memset(ring, 0, sizeof(PcapLogRing));
+        f->pcap_ring = ring;
+    }
+
+    /* expire what fell out of the time window */
+    while (ring->cnt > 0) {
+        PcapLogRingRec *rec = (PcapLogRingRec *)(ring->buf + ring->head);
+        if (rec->ts_sec + pl->ring_seconds >= (uint32_t)p->ts.tv_sec)
+            break;
+        PcapLogRingDropOldest(ring);
+    }
+
+    uint32_t offset;
+    while (1) {
+        if (ring->wrap == 0) {
+            if (ring->size - ring->tail >= need) {
+                offset = ring->tail;
+                break;
+            }
+            if (PcapLogRingGrow(pl, ring, need))
+                continue;
+            if (ring->cnt > 0 && ring->head >= need) {
+                ring->wrap = ring->tail;
+                offset = 0;
+                break;
+            }
+            if (ring->cnt == 0) {
+                /* empty and it can't grow */
+                return 0;
+            }
+        } else if (ring->head - ring->tail >= need) {
+            offset = ring->tail;
+            break;
+        }
+        PcapLogRingDropOldest(ring);
+    }
+
+    PcapLogRingRec *rec = (PcapLogRingRec *)(ring->buf + offset);
+    rec->ts_sec = (uint32_t)p->ts.tv_sec;
+    rec->ts_usec = (uint32_t)p->ts.tv_usec;
+    rec->len = GET_PKT_LEN(p);
+    memcpy(ring->buf + offset + sizeof(PcapLogRingRec), GET_PKT_DATA(p),
+           GET_PKT_LEN(p));
+    ring->tail = offset + need;
+    ring->cnt++;
+    return 1;
+}
+
+/**
+ *  \brief Write the buffered packets of a flow oldest first and release
+ *         the buffer. Caller holds the flow lock and pl->plog_lock.
+ */
+static TmEcode PcapLogRingFlush(ThreadVars *t, PcapLogData *pl,
+                                PcapLogRing *ring, int datalink)
+{
+    TmEcode ret = TM_ECODE_OK;
+    uint32_t offset = ring->head;
+    uint32_t cnt = ring->cnt;
+
+    while (cnt-- > 0 && ret == TM_ECODE_OK) {
+        PcapLogRingRec *rec = (PcapLogRingRec *)(ring->buf + offset);
+        struct timeval ts = { rec->ts_sec, rec->ts_usec };
+
+        ret = PcapLogWrite(t, pl, &ts, (uint8_t *)rec + sizeof(PcapLogRingRec),
+                           rec->len, datalink);
+
+        offset += PCAPLOG_RING_REC_SIZE(rec->len);
+        if (ring->wrap != 0 && offset == ring->wrap)
+            offset = 0;
+    }
+
+    if (ring->buf != NULL) {
+        SCFree(ring->buf);
+        PcapLogRingMemRelease(ring->size);
+    }
+    ring->buf = NULL;
+    ring->size = ring->head = ring->tail = ring->wrap = ring->cnt = 0;
+    return ret;
+}
+
+/**
+ *  \brief Conditional logging: packets are kept in a per flow ring until
+ *         the flow alerts or gets tagged. Then the ring is written out and
+ *         the rest of the flow is logged directly.
+ */
+static TmEcode PcapLogConditional(ThreadVars *t, PcapLogData *pl, Packet *p)
+{
+    TmEcode ret = TM_ECODE_OK;
+    int trigger = (p->alerts.cnt > 0 || (p->flags & PKT_HAS_TAG));
+    Flow *f = p->flow;
+
+    if (f == NULL) {
+        if (trigger) {
+            SCMutexLock(&pl->plog_lock);
+            ret = PcapLogWrite(t, pl, &p->ts, GET_PKT_DATA(p), GET_PKT_LEN(p),
+                               p->datalink);
+            SCMutexUnlock(&pl->plog_lock);
+        }
+        return ret;
+    }
+
+    FLOWLOCK_WRLOCK(f);
+    PcapLogRing *ring = f->pcap_ring;
+
+    if (trigger || f->tag_list != NULL ||
+        (ring != NULL && (ring->flags & PCAPLOG_RING_TRIGGERED)))
+    {
+        SCMutexLock(&pl->plog_lock);
+        if (ring != NULL && ring->cnt > 0) {
+            ret = PcapLogRingFlush(t, pl, ring, p->datalink);
+        }
+        if (ret == TM_ECODE_OK) {
+            ret = PcapLogWrite(t, pl, &p->ts, GET_PKT_DATA(p), GET_PKT_LEN(p),
+                               p->datalink);
+        }
+        SCMutexUnlock(&pl->plog_lock);
+
+        if (ring != NULL) {
+            ring->flags |= PCAPLOG_RING_TRIGGERED;
+        } else if (PcapLogRingMemReserve(sizeof(PcapLogRing))) {
+            ring = SCMalloc(sizeof(PcapLogRing));
+            if (likely(ring != NULL)) {
+                memset(ring, 0, sizeof(PcapLogRing));
+                ring->flags = PCAPLOG_RING_TRIGGERED;
+                f->pcap_ring = ring;
+            } else {
+                PcapLogRingMemRelease(sizeof(PcapLogRing));
+            }
+        }
+    } else if (!PcapLogRingAdd(pl, f, p)) {
+        SCLogDebug("packet %"PRIu64" not buffered, ring memcap reached",
+                   p->pcap_cnt);
+    }
+
+    FLOWLOCK_UNLOCK(f);
+    return ret;
+}
+
+/**
+ * \brief Pcap logging main function
+ *
+ * \param t threadvar
+ * \param p packet
+ * \param data thread module specific data
+ * \param pq pre-packet-queue
+ * \param postpq post-packet-queue
+ *
+ * \retval TM_ECODE_OK on succes
+ * \retval TM_ECODE_FAILED on serious error
+ */
+TmEcode PcapLog (ThreadVars *t, Packet *p, void *data, PacketQueue *pq,
+                 PacketQueue *postpq)
+{
+    TmEcode ret;
+    PcapLogData *pl = (PcapLogData *)data;
+
+    if ((p->flags & PKT_PSEUDO_STREAM_END) ||
+        ((p->flags & PKT_STREAM_NOPCAPLOG) &&
+         (pl->use_stream_depth == USE_STREAM_DEPTH_ENABLED)) ||
+        (IS_TUNNEL_PKT(p) && !IS_TUNNEL_ROOT_PKT(p)))
+    {
+        return TM_ECODE_OK;
+    }
+
+    if (pl->conditional == LOGMODE_COND_ALERTS) {
+        return PcapLogConditional(t, pl, p);
+    }
+
+    SCMutexLock(&pl->plog_lock);
+    ret = PcapLogWrite(t, pl, &p->ts, GET_PKT_DATA(p), GET_PKT_LEN(p),
+                       p->datalink);
+    SCMutexUnlock(&pl->plog_lock);
+    return ret;
+}
+
+/**
+ *  \brief Create the private copy of the log settings for a thread in multi
+ *          mode.
+ *
+ *  Each thread writes its own file sequence named
+ *  <prefix>.<thread number>.<timestamp>, so the files of all threads for a
+ *  time range can be found and merged by name. Size limit and max-files
+ *  apply per thread.
+ *
+ *  \param pl shared settings, locked by the caller
+ */
+static PcapLogData *PcapLogDataCopy(PcapLogData *pl)
+{
+    PcapLogData *copy = SCMalloc(sizeof(PcapLogData));
+    if (unlikely(copy == NULL))
+        return NULL;
+    memset(copy, 0, sizeof(PcapLogData));
+
+    copy->h = SCMalloc(sizeof(*copy->h));
+    if (unlikely(copy->h == NULL)) {
+        SCFree(copy);
+        return NULL;
+    }
+
+    char prefix[PATH_MAX];
+    snprintf(prefix, sizeof(prefix), "%s.%" PRIu32, pl->prefix, ++pl->thread_cnt);
+    if ((copy->prefix = SCStrdup(prefix)) == NULL) {
+        SCFree(copy->h);
+        SCFree(copy);
+        return NULL;
+    }
+
+    copy->size_limit = pl->size_limit;
+    copy->max_files = pl->max_files;
+    copy->mode = pl->mode;
+    copy->use_ringbuffer = pl->use_ringbuffer;
+    copy->timestamp_format = pl->timestamp_format;
+    copy->use_stream_depth = pl->use_stream_depth;
+    copy->conditional = pl->conditional;
+    copy->ring_seconds = pl->ring_seconds;
+    copy->ring_flow_limit = pl->ring_flow_limit;
+    strlcpy(copy->dir, pl->dir, sizeof(copy->dir));
+
+    TAILQ_INIT(&copy->pcap_file_list);
+    /* only ever taken by the owning thread */
+    SCMutexInit(&copy->plog_lock, NULL);
+
+    return copy;
+}
+
 TmEcode PcapLogDataInit(ThreadVars *t, void *initdata, void **data)
 {
     if (initdata == NULL) {
@@ -332,6 +705,19 @@ TmEcode PcapLogDataInit(ThreadVars *t, void *initdata, void **data)
 
     SCMutexLock(&pl->plog_lock);
 
+    if (pl->mode == LOGMODE_MULTI) {
+        PcapLogData *copy = PcapLogDataCopy(pl);
+        SCMutexUnlock(&pl->plog_lock);
+        if (copy == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Failed to allocate memory for "
+                       "per thread pcap-log data");
+            return TM_ECODE_FAILED;
+        }
+        pl = copy;
+        SCMutexLock(&pl->plog_lock);
+        SCLogInfo("%s: logging to %s/%s.*", t->name, pl->dir, pl->prefix);
+    }
+
     /** Use the Ouptut Context (file pointer and mutex) */
     pl->pkt_cnt = 0;
     pl->pcap_dead_handle = NULL;
@@ -362,6 +748,26 @@ TmEcode PcapLogDataInit(ThreadVars *t, void *initdata, void **data)
 
 TmEcode PcapLogDataDeinit(ThreadVars *t, void *data)
 {
+    PcapLogData *pl = (PcapLogData *)data;
+
+    /* only the multi mode copies are owned by the thread */
+    if (pl == NULL || pl->mode != LOGMODE_MULTI)
+        return TM_ECODE_OK;
+
+    PcapLogCloseFile(t, pl);
+
+    PcapFileName *pf;
+    while ((pf = TAILQ_FIRST(&pl->pcap_file_list)) != NULL) {
+        TAILQ_REMOVE(&pl->pcap_file_list, pf, next);
+        PcapFileNameFree(pf);
+    }
+
+    SCMutexDestroy(&pl->plog_lock);
+    if (pl->filename != NULL)
+        SCFree(pl->filename);
+    SCFree(pl->prefix);
+    SCFree(pl->h);
+    SCFree(pl);
     return TM_ECODE_OK;
 }
 
@@ -391,6 +797,9 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
     pl->use_ringbuffer = RING_BUFFER_MODE_DISABLED;
     pl->timestamp_format = TS_FORMAT_SEC;
     pl->use_stream_depth = USE_STREAM_DEPTH_DISABLED;
+    pl->conditional = LOGMODE_COND_ALL;
+    pl->ring_seconds = DEFAULT_RING_SECONDS;
+    pl->ring_flow_limit = DEFAULT_RING_FLOW_LIMIT;
 
     TAILQ_INIT(&pl->pcap_file_list);
 
@@ -442,10 +851,12 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
         if (s_mode != NULL) {
             if (strcasecmp(s_mode, "sguil") == 0) {
                 pl->mode = LOGMODE_SGUIL;
+            } else if (strcasecmp(s_mode, "multi") == 0) {
+                pl->mode = LOGMODE_MULTI;
             } else if (strcasecmp(s_mode, "normal") != 0) {
                 SCLogError(SC_ERR_INVALID_ARGUMENT,
-                    "log-pcap you must specify \"sguil\" or \"normal\" mode "
-                    "option to be set.");
+                    "log-pcap you must specify \"sguil\", \"multi\" or "
+                    "\"normal\" mode option to be set.");
                 exit(EXIT_FAILURE);
             }
         }
@@ -495,7 +906,8 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
     }
 
     SCLogInfo("using %s logging", pl->mode == LOGMODE_SGUIL ?
-              "Sguil compatible" : "normal");
+              "Sguil compatible" : (pl->mode == LOGMODE_MULTI ?
+              "per thread" : "normal"));
 
     uint32_t max_file_limit = DEFAULT_FILE_LIMIT;
     if (conf != NULL) {
@@ -551,6 +963,59 @@ OutputCtx *PcapLogInitCtx(ConfNode *conf)
         }
     }
 
+    if (conf != NULL) {
+        const char *s_cond = ConfNodeLookupChildValue(conf, "conditional");
+        if (s_cond != NULL) {
+            if (strcasecmp(s_cond, "alerts") == 0) {
+                pl->conditional = LOGMODE_COND_ALERTS;
+            } else if (strcasecmp(s_cond, "all") != 0) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT,
+                    "log-pcap \"conditional\" must be \"all\" or \"alerts\"");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    if (pl->conditional == LOGMODE_COND_ALERTS) {
+        const char *s_secs = ConfNodeLookupChildValue(conf, "ring-seconds");
+        if (s_secs != NULL) {
+            if (ByteExtractStringUint32(&pl->ring_seconds, 10, 0,
+                                        s_secs) == -1) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT, "Failed to initialize "
+                           "pcap-log output, invalid ring-seconds: %s", s_secs);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        const char *s_flow_limit = ConfNodeLookupChildValue(conf, "ring-flow-limit");
+        if (s_flow_limit != NULL) {
+            uint64_t flow_limit = 0;
+            if (ParseSizeStringU64(s_flow_limit, &flow_limit) < 0 ||
+                flow_limit < PCAPLOG_RING_MIN_SIZE || flow_limit > UINT32_MAX) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT, "Failed to initialize "
+                           "pcap-log output, invalid ring-flow-limit: %s",
+                           s_flow_limit);
+                exit(EXIT_FAILURE);
+            }
+            pl->ring_flow_limit = (uint32_t)flow_limit;
+        }
+
+        const char *s_memcap = ConfNodeLookupChildValue(conf, "ring-memcap");
+        if (s_memcap != NULL) {
+            if (ParseSizeStringU64(s_memcap, &pcap_ring_memcap) < 0) {
+                SCLogError(SC_ERR_INVALID_ARGUMENT, "Failed to initialize "
+                           "pcap-log output, invalid ring-memcap: %s", s_memcap);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        SCLogInfo("conditional logging: keeping %"PRIu32"s of packets per "
+                  "flow, at most %"PRIu32" bytes per flow and %"PRIu64" bytes "
+                  "in total", pl->ring_seconds, pl->ring_flow_limit,
+                  pcap_ring_memcap);
+    }
+    SC_ATOMIC_INIT(pcap_ring_memuse);
+
     /* create the output ctx and send it back */
 
     OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
@@ -668,3 +1133,122 @@ error:
     PcapFileNameFree(pf);
     return -1;
 }
+
+#ifdef UNITTESTS
+/** \test ring expiry, per flow limit and wrapping */
+static int PcapLogTestRing01(void)
+{
+    int result = 0;
+    uint8_t payload[1000];
+    PcapLogData pl;
+    Flow f;
+
+    memset(payload, 0x41, sizeof(payload));
+    memset(&pl, 0, sizeof(pl));
+    pl.ring_seconds = 10;
+    pl.ring_flow_limit = 4096;
+    SC_ATOMIC_INIT(pcap_ring_memuse);
+    pcap_ring_memcap = DEFAULT_RING_MEMCAP;
+
+    memset(&f, 0, sizeof(f));
+    FLOW_INITIALIZE(&f);
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    if (p == NULL)
+        goto end;
+    p->ts.tv_sec = 100;
+
+    int i;
+    for (i = 0; i < 3; i++) {
+        if (PcapLogRingAdd(&pl, &f, p) != 1)
+            goto end;
+    }
+    PcapLogRing *ring = (PcapLogRing *)f.pcap_ring;
+    if (ring == NULL || ring->cnt != 3 || ring->wrap != 0 ||
+        ring->size != pl.ring_flow_limit) {
+        printf("expected 3 unwrapped records: ");
+        goto end;
+    }
+
+    /* doesn't fit at the tail: oldest is dropped and the ring wraps */
+    if (PcapLogRingAdd(&pl, &f, p) != 1)
+        goto end;
+    if (ring->cnt != 3 || ring->wrap == 0 || ring->tail > ring->head) {
+        printf("expected wrapped ring with 3 records: ");
+        goto end;
+    }
+
+    /* everything older than 10s is expired */
+    p->ts.tv_sec = 111;
+    if (PcapLogRingAdd(&pl, &f, p) != 1)
+        goto end;
+    if (ring->cnt != 1 || ring->wrap != 0 || ring->head != 0) {
+        printf("expected a single record after expiry: ");
+        goto end;
+    }
+
+    if (SC_ATOMIC_GET(pcap_ring_memuse) != sizeof(PcapLogRing) + ring->size) {
+        printf("memuse mismatch: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    FLOW_DESTROY(&f);
+    if (p != NULL)
+        UTHFreePacket(p);
+    if (result == 1 && SC_ATOMIC_GET(pcap_ring_memuse) != 0) {
+        printf("ring memory not released: ");
+        result = 0;
+    }
+    return result;
+}
+
+/** \test memcap stops buffering */
+static int PcapLogTestRing02(void)
+{
+    int result = 0;
+    uint8_t payload[100];
+    PcapLogData pl;
+    Flow f;
+
+    memset(payload, 0x41, sizeof(payload));
+    memset(&pl, 0, sizeof(pl));
+    pl.ring_seconds = 10;
+    pl.ring_flow_limit = DEFAULT_RING_FLOW_LIMIT;
+    SC_ATOMIC_INIT(pcap_ring_memuse);
+    pcap_ring_memcap = sizeof(PcapLogRing) + 100;
+
+    memset(&f, 0, sizeof(f));
+    FLOW_INITIALIZE(&f);
+
+    Packet *p = UTHBuildPacket(payload, sizeof(payload), IPPROTO_TCP);
+    if (p == NULL)
+        goto end;
+
+    if (PcapLogRingAdd(&pl, &f, p) != 0) {
+        printf("packet buffered beyond the memcap: ");
+        goto end;
+    }
+    if (SC_ATOMIC_GET(pcap_ring_memuse) != sizeof(PcapLogRing)) {
+        printf("memuse mismatch: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    FLOW_DESTROY(&f);
+    if (p != NULL)
+        UTHFreePacket(p);
+    pcap_ring_memcap = DEFAULT_RING_MEMCAP;
+    return result;
+}
+#endif /* UNITTESTS */
+
+static void PcapLogRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("PcapLogTestRing01", PcapLogTestRing01, 1);
+    UtRegisterTest("PcapLogTestRing02", PcapLogTestRing02, 1);
+#endif /* UNITTESTS */
+}
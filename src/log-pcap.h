@@ -6,6 +6,9 @@
 #ifndef __PCAP_LOG_ALERT_H__
 #define __PCAP_LOG_ALERT_H__
 
+#include "conf.h"
+#include "tm-modules.h"
+
 void TmModulePcapLogRegister (void);
 OutputCtx *PcapLogInitCtx(ConfNode *);
 
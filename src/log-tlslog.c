@@ -47,6 +47,7 @@
 #include "util-buffer.h"
 
 #include "util-logopenfile.h"
+#include "util-logwriter.h"
 #include "util-crypt.h"
 
 #define DEFAULT_LOG_FILENAME "tls.log"
@@ -123,6 +124,8 @@ typedef struct LogTlsLogThread_ {
     MemBuffer *buffer;
     uint8_t*   enc_buf;
     size_t     enc_buf_len;
+    /** our buffer if the file is written asynchronously */
+    LogWriterBuffer *log_buf;
 } LogTlsLogThread;
 
 static void CreateTimeString(const struct timeval *ts, char *str, size_t size)
@@ -426,10 +429,8 @@ static TmEcode LogTlsLogIPWrapper(ThreadVars *tv, Packet *p, void *data, PacketQ
 
     aft->tls_cnt ++;
 
-    SCMutexLock(&hlog->file_ctx->fp_mutex);
-    MemBufferPrintToFPAsString(aft->buffer, hlog->file_ctx->fp);
-    fflush(hlog->file_ctx->fp);
-    SCMutexUnlock(&hlog->file_ctx->fp_mutex);
+    (void)LogFileWrite(hlog->file_ctx, aft->log_buf,
+            (const char *)aft->buffer->buffer, aft->buffer->offset);
 
 end:
     FLOWLOCK_UNLOCK(p->flow);
@@ -498,6 +499,7 @@ TmEcode LogTlsLogThreadInit(ThreadVars *t, void *initdata, void **data)
 
     /* Use the Ouptut Context (file pointer and mutex) */
     aft->tlslog_ctx = ((OutputCtx *) initdata)->data;
+    aft->log_buf = LogWriterRegisterThread(aft->tlslog_ctx->file_ctx, t);
 
     *data = (void *) aft;
     return TM_ECODE_OK;
@@ -564,6 +566,9 @@ OutputCtx *LogTlsLogInitCtx(ConfNode *conf)
     if (SCConfLogOpenGeneric(conf, file_ctx, DEFAULT_LOG_FILENAME) < 0) {
         goto filectx_error;
     }
+    if (LogWriterSetup(file_ctx, conf) < 0) {
+        goto filectx_error;
+    }
 
     LogTlsFileCtx *tlslog_ctx = SCCalloc(1, sizeof(LogTlsFileCtx));
     if (unlikely(tlslog_ctx == NULL))
@@ -0,0 +1,685 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Unified JSON event output ("eve-log").
+ *
+ * Writes alert, http, tls and file events as one JSON object per line to
+ * a single file or unix socket. Records are built with the serializer in
+ * util-json.c in a buffer allocated once per thread, so logging an event
+ * doesn't allocate.
+ *
+ * Http and tls transactions are tracked with a logged id of their own,
+ * files with their own flag, so this output can be used next to the
+ * http-log, tls-log and file-log outputs.
+ */
+
+#include "suricata-common.h"
+#include "debug.h"
+#include "detect.h"
+#include "flow.h"
+#include "conf.h"
+
+#include "threads.h"
+#include "tm-threads.h"
+#include "threadvars.h"
+
+#include "app-layer.h"
+#include "app-layer-parser.h"
+#include "app-layer-htp.h"
+#include "app-layer-ssl.h"
+
+#include "detect-filemagic.h"
+#include "stream-tcp-reassemble.h"
+
+#include "output.h"
+#include "output-json.h"
+
+#include "util-debug.h"
+#include "util-file.h"
+#include "util-json.h"
+#include "util-logopenfile.h"
+#include "util-logwriter.h"
+#include "util-print.h"
+#include "util-proto-name.h"
+#include "util-time.h"
+#include "util-unittest.h"
+
+#define DEFAULT_LOG_FILENAME "eve.json"
+
+#define MODULE_NAME "JsonEventLog"
+
+/** size of the per thread record buffer, larger records are dropped */
+#define JSON_EVENT_BUFFER_SIZE  65536
+
+/* event types, set from the "types" list of the config */
+#define JSON_EVENT_ALERT    0x01
+#define JSON_EVENT_HTTP     0x02
+#define JSON_EVENT_TLS      0x04
+#define JSON_EVENT_FILE     0x08
+
+TmEcode JsonEventLog(ThreadVars *, Packet *, void *, PacketQueue *, PacketQueue *);
+TmEcode JsonEventLogThreadInit(ThreadVars *, void *, void **);
+TmEcode JsonEventLogThreadDeinit(ThreadVars *, void *);
+void JsonEventLogExitPrintStats(ThreadVars *, void *);
+static OutputCtx *JsonEventLogInitCtx(ConfNode *);
+static void JsonEventLogDeInitCtx(OutputCtx *);
+
+void TmModuleJsonEventLogRegister(void)
+{
+    tmm_modules[TMM_JSONEVENTLOG].name = MODULE_NAME;
+    tmm_modules[TMM_JSONEVENTLOG].ThreadInit = JsonEventLogThreadInit;
+    tmm_modules[TMM_JSONEVENTLOG].Func = JsonEventLog;
+    tmm_modules[TMM_JSONEVENTLOG].ThreadExitPrintStats = JsonEventLogExitPrintStats;
+    tmm_modules[TMM_JSONEVENTLOG].ThreadDeinit = JsonEventLogThreadDeinit;
+    tmm_modules[TMM_JSONEVENTLOG].RegisterTests = NULL;
+    tmm_modules[TMM_JSONEVENTLOG].cap_flags = 0;
+
+    OutputRegisterModule(MODULE_NAME, "eve-log", JsonEventLogInitCtx);
+}
+
+typedef struct JsonEventLogCtx_ {
+    LogFileCtx *file_ctx;
+    uint32_t types;         /**< JSON_EVENT_* flags */
+} JsonEventLogCtx;
+
+typedef struct JsonEventLogThread_ {
+    JsonEventLogCtx *ctx;
+    /** our buffer if the file is written asynchronously */
+    LogWriterBuffer *log_buf;
+
+    SCJson js;
+    char *buffer;
+
+    /** quoted timestamp of the last second logged, only the microseconds
+     *  are updated for events in the same second */
+    time_t ts_sec;
+    uint32_t ts_len;
+    char ts_str[48];
+
+    uint64_t alerts;
+    uint64_t http_cnt;
+    uint64_t tls_cnt;
+    uint64_t file_cnt;
+    uint64_t oversized;     /**< records dropped for not fitting the buffer */
+} JsonEventLogThread;
+
+/** offset of the microseconds in ts_str: quote, "YYYY-MM-DDTHH:MM:SS" and
+ *  the dot */
+#define JSON_EVENT_TS_USEC_OFFSET   21
+
+static void JsonEventLogAddTimestamp(JsonEventLogThread *aft,
+                                     const struct timeval *ts)
+{
+    if (aft->ts_len == 0 || ts->tv_sec != aft->ts_sec) {
+        struct tm local_tm;
+        struct tm *t = SCLocalTime(ts->tv_sec, &local_tm);
+
+        aft->ts_len = strftime(aft->ts_str, sizeof(aft->ts_str),
+                "\"%Y-%m-%dT%H:%M:%S.000000%z\"", t);
+        aft->ts_sec = ts->tv_sec;
+    }
+    if (unlikely(aft->ts_len <= JSON_EVENT_TS_USEC_OFFSET + 6))
+        return;
+
+    uint32_t usec = (uint32_t)ts->tv_usec;
+    int i;
+    for (i = 5; i >= 0; i--) {
+        aft->ts_str[JSON_EVENT_TS_USEC_OFFSET + i] = '0' + (usec % 10);
+        usec /= 10;
+    }
+
+    SCJsonAddRaw(&aft->js, "timestamp", aft->ts_str, aft->ts_len);
+}
+
+/**
+ * \internal
+ * \brief start a record with the members all events have in common
+ *
+ * \param flip log the packet's destination as source, used to log
+ *             transactions from the client's point of view
+ */
+static void JsonEventLogHeader(JsonEventLogThread *aft, const Packet *p,
+                               const char *event_type, int flip)
+{
+    SCJson *js = &aft->js;
+    char srcip[46], dstip[46];
+    Port sp = p->sp, dp = p->dp;
+
+    SCJsonReset(js);
+    SCJsonOpenObject(js, NULL);
+    JsonEventLogAddTimestamp(aft, &p->ts);
+    SCJsonAddString(js, "event_type", event_type);
+
+    if (PKT_IS_IPV4(p)) {
+        PrintInet(AF_INET, (const void *)GET_IPV4_SRC_ADDR_PTR(p), srcip, sizeof(srcip));
+        PrintInet(AF_INET, (const void *)GET_IPV4_DST_ADDR_PTR(p), dstip, sizeof(dstip));
+    } else if (PKT_IS_IPV6(p)) {
+        PrintInet(AF_INET6, (const void *)GET_IPV6_SRC_ADDR(p), srcip, sizeof(srcip));
+        PrintInet(AF_INET6, (const void *)GET_IPV6_DST_ADDR(p), dstip, sizeof(dstip));
+    } else {
+        /* decoder events on non-IP packets */
+        return;
+    }
+
+    if (flip) {
+        SCJsonAddString(js, "src_ip", dstip);
+        if (PKT_IS_TCP(p) || PKT_IS_UDP(p))
+            SCJsonAddUint(js, "src_port", dp);
+        SCJsonAddString(js, "dest_ip", srcip);
+        if (PKT_IS_TCP(p) || PKT_IS_UDP(p))
+            SCJsonAddUint(js, "dest_port", sp);
+    } else {
+        SCJsonAddString(js, "src_ip", srcip);
+        if (PKT_IS_TCP(p) || PKT_IS_UDP(p))
+            SCJsonAddUint(js, "src_port", sp);
+        SCJsonAddString(js, "dest_ip", dstip);
+        if (PKT_IS_TCP(p) || PKT_IS_UDP(p))
+            SCJsonAddUint(js, "dest_port", dp);
+    }
+
+    uint8_t proto = IP_GET_IPPROTO(p);
+    if (SCProtoNameValid(proto) == TRUE)
+        SCJsonAddString(js, "proto", known_proto[proto]);
+    else
+        SCJsonAddUint(js, "proto", proto);
+}
+
+/**
+ * \internal
+ * \brief close the record and hand it to the output
+ *
+ * \retval 0 record written, -1 dropped
+ */
+static int JsonEventLogWrite(JsonEventLogThread *aft)
+{
+    SCJsonCloseObject(&aft->js);
+
+    int len = SCJsonFinish(&aft->js);
+    if (len < 0) {
+        aft->oversized++;
+        return -1;
+    }
+
+    return LogFileWrite(aft->ctx->file_ctx, aft->log_buf, aft->buffer,
+                        (size_t)len);
+}
+
+static void JsonEventLogAlerts(JsonEventLogThread *aft, const Packet *p)
+{
+    extern uint8_t engine_mode;
+    SCJson *js = &aft->js;
+    int i;
+
+    for (i = 0; i < p->alerts.cnt; i++) {
+        const PacketAlert *pa = &p->alerts.alerts[i];
+        if (unlikely(pa->s == NULL)) {
+            continue;
+        }
+
+        JsonEventLogHeader(aft, p, "alert", 0);
+
+        SCJsonOpenObject(js, "alert");
+        if ((pa->action & ACTION_DROP) && IS_ENGINE_MODE_IPS(engine_mode))
+            SCJsonAddString(js, "action", "blocked");
+        else
+            SCJsonAddString(js, "action", "allowed");
+        SCJsonAddUint(js, "gid", pa->s->gid);
+        SCJsonAddUint(js, "signature_id", pa->s->id);
+        SCJsonAddUint(js, "rev", pa->s->rev);
+        SCJsonAddString(js, "signature", pa->s->msg ? pa->s->msg : "");
+        SCJsonAddString(js, "category", pa->s->class_msg ? pa->s->class_msg : "");
+        SCJsonAddUint(js, "severity", pa->s->prio);
+        if (pa->count > 1)
+            SCJsonAddUint(js, "count", pa->count);
+        SCJsonCloseObject(js);
+
+        if (p->pcap_cnt != 0)
+            SCJsonAddUint(js, "pcap_cnt", p->pcap_cnt);
+
+        if (JsonEventLogWrite(aft) == 0)
+            aft->alerts++;
+    }
+}
+
+/** \internal
+ *  \brief add a request header as string member if the tx has it */
+static void JsonEventLogHttpHeader(SCJson *js, table_t *headers,
+                                   const char *name, const char *key)
+{
+    if (headers == NULL)
+        return;
+
+    htp_header_t *h = table_getc(headers, (char *)name);
+    if (h != NULL && h->value != NULL) {
+        SCJsonAddStringN(js, key, (uint8_t *)bstr_ptr(h->value),
+                         bstr_len(h->value));
+    }
+}
+
+static void JsonEventLogHttpTx(JsonEventLogThread *aft, const Packet *p,
+                               htp_tx_t *tx)
+{
+    SCJson *js = &aft->js;
+
+    JsonEventLogHeader(aft, p, "http", !(PKT_IS_TOSERVER(p)));
+
+    SCJsonOpenObject(js, "http");
+    if (tx->parsed_uri != NULL && tx->parsed_uri->hostname != NULL) {
+        SCJsonAddStringN(js, "hostname",
+                (uint8_t *)bstr_ptr(tx->parsed_uri->hostname),
+                bstr_len(tx->parsed_uri->hostname));
+    }
+    if (tx->request_uri != NULL) {
+        SCJsonAddStringN(js, "url", (uint8_t *)bstr_ptr(tx->request_uri),
+                bstr_len(tx->request_uri));
+    }
+    JsonEventLogHttpHeader(js, tx->request_headers, "user-agent",
+                           "http_user_agent");
+    JsonEventLogHttpHeader(js, tx->request_headers, "referer", "http_refer");
+    if (tx->request_method != NULL) {
+        SCJsonAddStringN(js, "http_method",
+                (uint8_t *)bstr_ptr(tx->request_method),
+                bstr_len(tx->request_method));
+    }
+    if (tx->request_protocol != NULL) {
+        SCJsonAddStringN(js, "protocol",
+                (uint8_t *)bstr_ptr(tx->request_protocol),
+                bstr_len(tx->request_protocol));
+    }
+    if (tx->response_status != NULL) {
+        SCJsonAddInt(js, "status", tx->response_status_number);
+        if (tx->response_status_number > 300 && tx->response_status_number < 303) {
+            JsonEventLogHttpHeader(js, tx->response_headers, "location",
+                                   "redirect");
+        }
+    }
+    SCJsonAddUint(js, "length", (uint64_t)tx->response_message_len);
+    SCJsonCloseObject(js);
+
+    if (JsonEventLogWrite(aft) == 0)
+        aft->http_cnt++;
+}
+
+/** \internal
+ *  \brief log the http transactions that are complete. Flow is locked. */
+static void JsonEventLogHttp(JsonEventLogThread *aft, Packet *p)
+{
+    int r = AppLayerTransactionGetEveLoggedId(p->flow);
+    if (r < 0)
+        return;
+    int logged = r;
+
+    r = HtpTransactionGetLoggableId(p->flow);
+    if (r < 0 || logged >= r)
+        return;
+    int loggable = r;
+
+    HtpState *htp_state = (HtpState *)AppLayerGetProtoStateFromPacket(p);
+    if (htp_state == NULL || htp_state->connp == NULL ||
+            htp_state->connp->conn == NULL)
+        return;
+
+    int idx;
+    for (idx = logged; idx < loggable; idx++) {
+        htp_tx_t *tx = list_get(htp_state->connp->conn->transactions, idx);
+        if (tx != NULL)
+            JsonEventLogHttpTx(aft, p, tx);
+
+        AppLayerTransactionUpdateEveLoggedId(p->flow);
+    }
+}
+
+/** \internal
+ *  \brief log the server certificate once per flow. Flow is locked. */
+static void JsonEventLogTls(JsonEventLogThread *aft, Packet *p)
+{
+    SCJson *js = &aft->js;
+
+    SSLState *ssl_state = (SSLState *)AppLayerGetProtoStateFromPacket(p);
+    if (ssl_state == NULL)
+        return;
+
+    if (ssl_state->server_connp.cert0_issuerdn == NULL ||
+            ssl_state->server_connp.cert0_subject == NULL)
+        return;
+
+    if (AppLayerTransactionGetEveLoggedId(p->flow) != 0)
+        return;
+
+    JsonEventLogHeader(aft, p, "tls", !(PKT_IS_TOSERVER(p)));
+
+    SCJsonOpenObject(js, "tls");
+    SCJsonAddString(js, "subject", ssl_state->server_connp.cert0_subject);
+    SCJsonAddString(js, "issuerdn", ssl_state->server_connp.cert0_issuerdn);
+    if (ssl_state->server_connp.cert0_fingerprint != NULL) {
+        SCJsonAddString(js, "fingerprint",
+                        ssl_state->server_connp.cert0_fingerprint);
+    }
+    switch (ssl_state->server_connp.version) {
+        case SSL_VERSION_2:
+            SCJsonAddString(js, "version", "SSLv2");
+            break;
+        case SSL_VERSION_3:
+            SCJsonAddString(js, "version", "SSLv3");
+            break;
+        case TLS_VERSION_10:
+            SCJsonAddString(js, "version", "TLSv1");
+            break;
+        case TLS_VERSION_11:
+            SCJsonAddString(js, "version", "TLS 1.1");
+            break;
+        case TLS_VERSION_12:
+            SCJsonAddString(js, "version", "TLS 1.2");
+            break;
+        default:
+            SCJsonAddString(js, "version", "UNDETERMINED");
+            break;
+    }
+    SCJsonCloseObject(js);
+
+    if (JsonEventLogWrite(aft) == 0)
+        aft->tls_cnt++;
+
+    AppLayerTransactionUpdateEveLoggedId(p->flow);
+}
+
+static void JsonEventLogFileRecord(JsonEventLogThread *aft, Packet *p,
+                                   File *ff)
+{
+    SCJson *js = &aft->js;
+
+    JsonEventLogHeader(aft, p, "fileinfo", 0);
+
+    HtpState *htp_state = (HtpState *)p->flow->alstate;
+    if (AppLayerGetProtoFromPacket(p) == ALPROTO_HTTP && htp_state != NULL &&
+            htp_state->connp != NULL && htp_state->connp->conn != NULL) {
+        htp_tx_t *tx = list_get(htp_state->connp->conn->transactions, ff->txid);
+        if (tx != NULL) {
+            SCJsonOpenObject(js, "http");
+            if (tx->request_uri_normalized != NULL) {
+                SCJsonAddStringN(js, "url",
+                        (uint8_t *)bstr_ptr(tx->request_uri_normalized),
+                        bstr_len(tx->request_uri_normalized));
+            }
+            JsonEventLogHttpHeader(js, tx->request_headers, "host",
+                                   "hostname");
+            JsonEventLogHttpHeader(js, tx->request_headers, "referer",
+                                   "http_refer");
+            JsonEventLogHttpHeader(js, tx->request_headers, "user-agent",
+                                   "http_user_agent");
+            SCJsonCloseObject(js);
+        }
+    }
+
+    SCJsonOpenObject(js, "fileinfo");
+    if (ff->file_id > 0)
+        SCJsonAddUint(js, "id", ff->file_id);
+    SCJsonAddStringN(js, "filename", ff->name, ff->name_len);
+    if (ff->magic != NULL)
+        SCJsonAddString(js, "magic", ff->magic);
+    switch (ff->state) {
+        case FILE_STATE_CLOSED:
+            SCJsonAddString(js, "state", "CLOSED");
+#ifdef HAVE_NSS
+            if (ff->flags & FILE_MD5)
+                SCJsonAddHex(js, "md5", ff->md5, sizeof(ff->md5));
+            if (ff->flags & FILE_SHA1)
+                SCJsonAddHex(js, "sha1", ff->sha1, sizeof(ff->sha1));
+            if (ff->flags & FILE_SHA256)
+                SCJsonAddHex(js, "sha256", ff->sha256, sizeof(ff->sha256));
+#endif
+            break;
+        case FILE_STATE_TRUNCATED:
+            SCJsonAddString(js, "state", "TRUNCATED");
+            break;
+        case FILE_STATE_ERROR:
+            SCJsonAddString(js, "state", "ERROR");
+            break;
+        default:
+            SCJsonAddString(js, "state", "UNKNOWN");
+            break;
+    }
+    SCJsonAddBool(js, "stored", (ff->flags & FILE_STORED) ? 1 : 0);
+    SCJsonAddUint(js, "size", ff->size);
+    SCJsonCloseObject(js);
+
+    if (JsonEventLogWrite(aft) == 0)
+        aft->file_cnt++;
+}
+
+/** \internal
+ *  \brief log the files that are done. Flow is locked. */
+static void JsonEventLogFiles(JsonEventLogThread *aft, Packet *p)
+{
+    uint8_t flags = (p->flowflags & FLOW_PKT_TOCLIENT) ?
+        STREAM_TOCLIENT : STREAM_TOSERVER;
+    int file_close = (p->flags & PKT_PSEUDO_STREAM_END) ? 1 : 0;
+    int file_trunc = StreamTcpReassembleDepthReached(p);
+
+    FileContainer *ffc = AppLayerGetFilesFromFlow(p->flow, flags);
+    if (ffc == NULL)
+        return;
+
+    File *ff;
+    for (ff = ffc->head; ff != NULL; ff = ff->next) {
+        if (ff->flags & FILE_EVE_LOGGED)
+            continue;
+
+        if (FileForceMagic() && ff->magic == NULL) {
+            FilemagicGlobalLookup(ff);
+        }
+
+        if (file_trunc && ff->state < FILE_STATE_CLOSED)
+            ff->state = FILE_STATE_TRUNCATED;
+
+        if (ff->state == FILE_STATE_CLOSED ||
+                ff->state == FILE_STATE_TRUNCATED || ff->state == FILE_STATE_ERROR ||
+                (file_close == 1 && ff->state < FILE_STATE_CLOSED))
+        {
+            JsonEventLogFileRecord(aft, p, ff);
+            ff->flags |= FILE_EVE_LOGGED;
+        }
+    }
+
+    FilePrune(ffc);
+}
+
+TmEcode JsonEventLog(ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, PacketQueue *postpq)
+{
+    SCEnter();
+    JsonEventLogThread *aft = (JsonEventLogThread *)data;
+    uint32_t types = aft->ctx->types;
+
+    if ((types & JSON_EVENT_ALERT) && p->alerts.cnt > 0)
+        JsonEventLogAlerts(aft, p);
+
+    if (!(types & (JSON_EVENT_HTTP|JSON_EVENT_TLS|JSON_EVENT_FILE)) ||
+            p->flow == NULL || !(PKT_IS_TCP(p)) ||
+            !(PKT_IS_IPV4(p) || PKT_IS_IPV6(p)))
+        SCReturnInt(TM_ECODE_OK);
+
+    /* WRITE lock before we update the logged id and file flags */
+    FLOWLOCK_WRLOCK(p->flow);
+    uint16_t proto = AppLayerGetProtoFromPacket(p);
+    if (proto == ALPROTO_HTTP && (types & JSON_EVENT_HTTP))
+        JsonEventLogHttp(aft, p);
+    else if (proto == ALPROTO_TLS && (types & JSON_EVENT_TLS))
+        JsonEventLogTls(aft, p);
+
+    if (types & JSON_EVENT_FILE)
+        JsonEventLogFiles(aft, p);
+    FLOWLOCK_UNLOCK(p->flow);
+
+    SCReturnInt(TM_ECODE_OK);
+}
+
+TmEcode JsonEventLogThreadInit(ThreadVars *t, void *initdata, void **data)
+{
+    if (initdata == NULL) {
+        SCLogDebug("Error getting context for JsonEventLog. \"initdata\" argument NULL");
+        return TM_ECODE_FAILED;
+    }
+
+    JsonEventLogThread *aft = SCMalloc(sizeof(JsonEventLogThread));
+    if (unlikely(aft == NULL))
+        return TM_ECODE_FAILED;
+    memset(aft, 0, sizeof(JsonEventLogThread));
+
+    aft->buffer = SCMalloc(JSON_EVENT_BUFFER_SIZE);
+    if (unlikely(aft->buffer == NULL)) {
+        SCFree(aft);
+        return TM_ECODE_FAILED;
+    }
+    SCJsonInit(&aft->js, aft->buffer, JSON_EVENT_BUFFER_SIZE);
+
+    aft->ctx = ((OutputCtx *)initdata)->data;
+    aft->log_buf = LogWriterRegisterThread(aft->ctx->file_ctx, t);
+
+    *data = (void *)aft;
+    return TM_ECODE_OK;
+}
+
+TmEcode JsonEventLogThreadDeinit(ThreadVars *t, void *data)
+{
+    JsonEventLogThread *aft = (JsonEventLogThread *)data;
+    if (aft == NULL) {
+        return TM_ECODE_OK;
+    }
+
+    if (aft->buffer != NULL)
+        SCFree(aft->buffer);
+
+    /* clear memory */
+    memset(aft, 0, sizeof(JsonEventLogThread));
+
+    SCFree(aft);
+    return TM_ECODE_OK;
+}
+
+void JsonEventLogExitPrintStats(ThreadVars *tv, void *data)
+{
+    JsonEventLogThread *aft = (JsonEventLogThread *)data;
+    if (aft == NULL) {
+        return;
+    }
+
+    SCLogInfo("(%s) eve-log: alerts %" PRIu64 ", http %" PRIu64 ", tls %"
+              PRIu64 ", files %" PRIu64 ", records too large %" PRIu64,
+              tv->name, aft->alerts, aft->http_cnt, aft->tls_cnt,
+              aft->file_cnt, aft->oversized);
+}
+
+/** \internal
+ *  \brief parse the "types" list
+ *  \retval flags JSON_EVENT_* flags, all types if the list is missing
+ */
+static uint32_t JsonEventLogParseTypes(ConfNode *conf)
+{
+    ConfNode *types = ConfNodeLookupChild(conf, "types");
+    ConfNode *type;
+    uint32_t flags = 0;
+
+    if (types == NULL)
+        return JSON_EVENT_ALERT|JSON_EVENT_HTTP|JSON_EVENT_TLS|JSON_EVENT_FILE;
+
+    TAILQ_FOREACH(type, &types->head, next) {
+        if (type->val == NULL)
+            continue;
+
+        if (strcasecmp(type->val, "alert") == 0) {
+            flags |= JSON_EVENT_ALERT;
+        } else if (strcasecmp(type->val, "http") == 0) {
+            flags |= JSON_EVENT_HTTP;
+        } else if (strcasecmp(type->val, "tls") == 0) {
+            flags |= JSON_EVENT_TLS;
+        } else if (strcasecmp(type->val, "file") == 0) {
+            flags |= JSON_EVENT_FILE;
+        } else {
+            SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: unknown event "
+                         "type \"%s\", ignoring", conf->name, type->val);
+        }
+    }
+
+    return flags;
+}
+
+/** \brief Create the eve-log output context.
+ *  \param conf Pointer to ConfNode containing this loggers configuration.
+ *  \return NULL if failure, OutputCtx* if succesful
+ * */
+static OutputCtx *JsonEventLogInitCtx(ConfNode *conf)
+{
+    LogFileCtx *file_ctx = LogFileNewCtx();
+    if (file_ctx == NULL) {
+        SCLogDebug("Could not create new LogFileCtx");
+        return NULL;
+    }
+
+    if (SCConfLogOpenGeneric(conf, file_ctx, DEFAULT_LOG_FILENAME) < 0) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
+    if (SCConfLogRotateSetup(conf, file_ctx) < 0 ||
+            LogWriterSetup(file_ctx, conf) < 0) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
+
+    JsonEventLogCtx *ctx = SCCalloc(1, sizeof(JsonEventLogCtx));
+    if (unlikely(ctx == NULL)) {
+        LogFileFreeCtx(file_ctx);
+        return NULL;
+    }
+    ctx->file_ctx = file_ctx;
+    ctx->types = JsonEventLogParseTypes(conf);
+
+    OutputCtx *output_ctx = SCCalloc(1, sizeof(OutputCtx));
+    if (unlikely(output_ctx == NULL)) {
+        LogFileFreeCtx(file_ctx);
+        SCFree(ctx);
+        return NULL;
+    }
+    output_ctx->data = ctx;
+    output_ctx->DeInit = JsonEventLogDeInitCtx;
+
+    /* keep transactions around until we logged them */
+    if (ctx->types & JSON_EVENT_HTTP)
+        AppLayerRegisterEveLogger(ALPROTO_HTTP);
+    if (ctx->types & JSON_EVENT_TLS)
+        AppLayerRegisterEveLogger(ALPROTO_TLS);
+    if (ctx->types & JSON_EVENT_FILE)
+        FileForceTrackingEnable();
+
+    SCLogInfo("eve-log output: alert %s, http %s, tls %s, file %s",
+              (ctx->types & JSON_EVENT_ALERT) ? "yes" : "no",
+              (ctx->types & JSON_EVENT_HTTP) ? "yes" : "no",
+              (ctx->types & JSON_EVENT_TLS) ? "yes" : "no",
+              (ctx->types & JSON_EVENT_FILE) ? "yes" : "no");
+
+    return output_ctx;
+}
+
+static void JsonEventLogDeInitCtx(OutputCtx *output_ctx)
+{
+    JsonEventLogCtx *ctx = (JsonEventLogCtx *)output_ctx->data;
+    LogFileFreeCtx(ctx->file_ctx);
+    SCFree(ctx);
+    SCFree(output_ctx);
+}
@@ -204,6 +204,8 @@ typedef struct TcpSession_ {
     uint8_t state;
     uint8_t queue_len;                      /**< length of queue list below */
     uint16_t flags;
+    uint16_t alproto_detect_ts_cnt;         /**< proto detection calls toserver */
+    uint16_t alproto_detect_tc_cnt;         /**< proto detection calls toclient */
     TcpStream server;
     TcpStream client;
     struct StreamMsg_ *toserver_smsg_head;  /**< list of stream msgs (for detection inspection) */
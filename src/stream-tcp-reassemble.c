@@ -86,6 +86,9 @@ static uint16_t segment_pool_poolsizes_prealloc[segment_pool_num] = {256, 512, 5
                                                             1024, 128};
 static Pool *segment_pool[segment_pool_num];
 static SCMutex segment_pool_mutex[segment_pool_num];
+/* segment caches of the stream thread we're running in, NULL in other
+ * threads */
+static __thread PoolCache *segment_pool_cache[segment_pool_num];
 #ifdef DEBUG
 static SCMutex segment_pool_cnt_mutex;
 static uint64_t segment_pool_cnt = 0;
@@ -140,8 +143,21 @@ void StreamTcpReassembleDecrMemuse(uint64_t size) {
 
 void StreamTcpReassembleMemuseCounter(ThreadVars *tv, TcpReassemblyThreadCtx *rtv) {
     uint64_t smemuse = SC_ATOMIC_GET(ra_memuse);
-    if (tv != NULL && rtv != NULL)
+    if (tv != NULL && rtv != NULL) {
         SCPerfCounterSetUI64(rtv->counter_tcp_reass_memuse, tv->sc_perf_pca, smemuse);
+
+        uint64_t live = 0, live_max = 0;
+        uint16_t u16;
+        for (u16 = 0; u16 < segment_pool_num; u16++) {
+            uint64_t size = sizeof(TcpSegment) + segment_pool_pktsizes[u16];
+            live += PoolGetLive(segment_pool[u16]) * size;
+            live_max += PoolGetLiveMax(segment_pool[u16]) * size;
+        }
+        SCPerfCounterSetUI64(rtv->counter_tcp_segment_pool_memuse,
+                tv->sc_perf_pca, live);
+        SCPerfCounterSetUI64(rtv->counter_tcp_segment_pool_memuse_max,
+                tv->sc_perf_pca, live_max);
+    }
     return;
 }
 
@@ -186,7 +202,6 @@ int TcpSegmentPoolInit(void *data, void *payload_len)
 
     seg->payload = SCMalloc(seg->payload_len);
     if (seg->payload == NULL) {
-        SCFree(seg);
         return 0;
     }
 
@@ -237,6 +252,11 @@ void StreamTcpSegmentReturntoPool(TcpSegment *seg)
     seg->prev = NULL;
 
     uint16_t idx = segment_pool_idx[seg->pool_size];
+    if (segment_pool_cache[idx] != NULL) {
+        PoolCacheReturn(segment_pool_cache[idx], (void *) seg);
+        return;
+    }
+
     SCMutexLock(&segment_pool_mutex[idx]);
     PoolReturn(segment_pool[idx], (void *) seg);
     SCLogDebug("segment_pool[%"PRIu16"]->empty_list_size %"PRIu32"",
@@ -391,6 +411,40 @@ void StreamTcpReassembleFreeThreadCtx(TcpReassemblyThreadCtx *ra_ctx)
     SCReturn;
 }
 
+/**
+ *  \brief Set up the segment caches of the calling stream thread. Segments
+ *         this thread gets and returns then only take the pool locks for
+ *         batches of segments.
+ *
+ *  \retval 0 ok
+ *  \retval -1 error
+ */
+int StreamTcpReassembleInitThreadCache(void)
+{
+    uint16_t u16;
+    for (u16 = 0; u16 < segment_pool_num; u16++) {
+        segment_pool_cache[u16] = PoolCacheInit(segment_pool[u16],
+                                                &segment_pool_mutex[u16]);
+        if (segment_pool_cache[u16] == NULL) {
+            StreamTcpReassembleFreeThreadCache();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  \brief Return the cached segments of the calling thread to the pools.
+ */
+void StreamTcpReassembleFreeThreadCache(void)
+{
+    uint16_t u16;
+    for (u16 = 0; u16 < segment_pool_num; u16++) {
+        PoolCacheFree(segment_pool_cache[u16]);
+        segment_pool_cache[u16] = NULL;
+    }
+}
+
 void PrintList2(TcpSegment *seg)
 {
     TcpSegment *prev_seg = NULL;
@@ -3560,14 +3614,19 @@ TcpSegment* StreamTcpGetSegment(ThreadVars *tv, TcpReassemblyThreadCtx *ra_ctx,
     SCLogDebug("segment_pool_idx %" PRIu32 " for payload_len %" PRIu32 "",
                 idx, len);
 
-    SCMutexLock(&segment_pool_mutex[idx]);
-    TcpSegment *seg = (TcpSegment *) PoolGet(segment_pool[idx]);
+    TcpSegment *seg;
+    if (segment_pool_cache[idx] != NULL) {
+        seg = (TcpSegment *) PoolCacheGet(segment_pool_cache[idx]);
+    } else {
+        SCMutexLock(&segment_pool_mutex[idx]);
+        seg = (TcpSegment *) PoolGet(segment_pool[idx]);
 
-    SCLogDebug("segment_pool[%u]->empty_list_size %u, segment_pool[%u]->alloc_"
-               "list_size %u, alloc %u", idx, segment_pool[idx]->empty_list_size,
-               idx, segment_pool[idx]->alloc_list_size,
-               segment_pool[idx]->allocated);
-    SCMutexUnlock(&segment_pool_mutex[idx]);
+        SCLogDebug("segment_pool[%u]->empty_list_size %u, segment_pool[%u]->alloc_"
+                   "list_size %u, alloc %u", idx, segment_pool[idx]->empty_list_size,
+                   idx, segment_pool[idx]->alloc_list_size,
+                   segment_pool[idx]->allocated);
+        SCMutexUnlock(&segment_pool_mutex[idx]);
+    }
 
     SCLogDebug("seg we return is %p", seg);
     if (seg == NULL) {
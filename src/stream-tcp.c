@@ -32,6 +32,7 @@
 #include "decode.h"
 #include "debug.h"
 #include "detect.h"
+#include "detect-engine-state.h"
 
 #include "flow.h"
 #include "flow-util.h"
@@ -106,9 +107,9 @@ static inline int StreamTcpValidateAck(TcpSession *ssn, TcpStream *, Packet *);
 
 static Pool *ssn_pool = NULL;
 static SCMutex ssn_pool_mutex;
-#ifdef DEBUG
-static uint64_t ssn_pool_cnt = 0; /** counts ssns, protected by ssn_pool_mutex */
-#endif
+/* session cache of the stream thread we're running in, NULL in other
+ * threads such as the flow manager */
+static __thread PoolCache *ssn_pool_cache = NULL;
 
 extern uint8_t engine_mode;
 
@@ -142,6 +143,10 @@ void StreamTcpDecrMemuse(uint64_t size) {
 void StreamTcpMemuseCounter(ThreadVars *tv, StreamTcpThread *stt) {
     uint64_t memusecopy = SC_ATOMIC_GET(st_memuse);
     SCPerfCounterSetUI64(stt->counter_tcp_memuse, tv->sc_perf_pca, memusecopy);
+    SCPerfCounterSetUI64(stt->counter_tcp_ssn_pool_memuse, tv->sc_perf_pca,
+            (uint64_t)PoolGetLive(ssn_pool) * sizeof(TcpSession));
+    SCPerfCounterSetUI64(stt->counter_tcp_ssn_pool_memuse_max, tv->sc_perf_pca,
+            (uint64_t)PoolGetLiveMax(ssn_pool) * sizeof(TcpSession));
     return;
 }
 
@@ -210,12 +215,13 @@ void StreamTcpSessionClear(void *ssnptr)
     ssn->toclient_smsg_head = NULL;
 
     memset(ssn, 0, sizeof(TcpSession));
-    SCMutexLock(&ssn_pool_mutex);
-    PoolReturn(ssn_pool, ssn);
-#ifdef DEBUG
-    ssn_pool_cnt--;
-#endif
-    SCMutexUnlock(&ssn_pool_mutex);
+    if (ssn_pool_cache != NULL) {
+        PoolCacheReturn(ssn_pool_cache, ssn);
+    } else {
+        SCMutexLock(&ssn_pool_mutex);
+        PoolReturn(ssn_pool, ssn);
+        SCMutexUnlock(&ssn_pool_mutex);
+    }
 
     SCReturn;
 }
@@ -390,6 +396,12 @@ void StreamTcpInitConfig(char quiet)
         SCLogInfo("stream \"async-oneside\": %s", stream_config.async_oneside ? "enabled" : "disabled");
     }
 
+    ConfGetBool("stream.bypass", &stream_config.bypass);
+
+    if (!quiet) {
+        SCLogInfo("stream \"bypass\": %s", stream_config.bypass ? "enabled" : "disabled");
+    }
+
     int csum = 0;
 
     if ((ConfGetBool("stream.checksum-validation", &csum)) == 1) {
@@ -595,13 +607,29 @@ void StreamTcpFreeConfig(char quiet)
 
     SCMutexLock(&ssn_pool_mutex);
     if (ssn_pool != NULL) {
+        SCLogDebug("sessions in use %"PRIu32", max %"PRIu32,
+                PoolGetLive(ssn_pool), PoolGetLiveMax(ssn_pool));
         PoolFree(ssn_pool);
         ssn_pool = NULL;
     }
     SCMutexUnlock(&ssn_pool_mutex);
     SCMutexDestroy(&ssn_pool_mutex);
+}
+
+/**
+ *  \brief Stop bypassing the flow of the packet, the packet itself is
+ *         inspected as well.
+ *
+ *  \param p packet of the *LOCKED* flow
+ */
+static void StreamTcpClearBypass(Packet *p)
+{
+    SCLogDebug("flow %p no longer bypassed", p->flow);
 
-    SCLogDebug("ssn_pool_cnt %"PRIu64"", ssn_pool_cnt);
+    p->flow->flags &= ~FLOW_BYPASSED;
+    p->flags &= ~(PKT_FLOW_BYPASSED|PKT_STREAM_NOPCAPLOG);
+    if (!(p->flow->flags & FLOW_NOPACKET_INSPECTION))
+        p->flags &= ~PKT_NOPACKET_INSPECTION;
 }
 
 /** \brief The function is used to to fetch a TCP session from the
@@ -616,13 +644,13 @@ TcpSession *StreamTcpNewSession (Packet *p)
     TcpSession *ssn = (TcpSession *)p->flow->protoctx;
 
     if (ssn == NULL) {
-        SCMutexLock(&ssn_pool_mutex);
-        p->flow->protoctx = PoolGet(ssn_pool);
-#ifdef DEBUG
-        if (p->flow->protoctx != NULL)
-            ssn_pool_cnt++;
-#endif
-        SCMutexUnlock(&ssn_pool_mutex);
+        if (ssn_pool_cache != NULL) {
+            p->flow->protoctx = PoolCacheGet(ssn_pool_cache);
+        } else {
+            SCMutexLock(&ssn_pool_mutex);
+            p->flow->protoctx = PoolGet(ssn_pool);
+            SCMutexUnlock(&ssn_pool_mutex);
+        }
 
         ssn = (TcpSession *)p->flow->protoctx;
         if (ssn == NULL) {
@@ -716,6 +744,47 @@ void StreamTcpSetOSPolicy(TcpStream *stream, Packet *p)
     } \
 }
 
+/**
+ *  \brief Keep the sequence tracking of a bypassed session up to date for
+ *         a packet that skips the state machine.
+ *
+ *  Only next_seq, last_ack, window and next_win are updated, so that the
+ *  SYN, FIN and RST packets that still go through the state machine pass
+ *  its window checks.
+ *
+ *  \param p packet of the *LOCKED* flow
+ */
+static void StreamTcpBypassTrack(Packet *p)
+{
+    TcpSession *ssn = (TcpSession *)p->flow->protoctx;
+    TcpStream *stream, *ostream;
+
+    if (ssn == NULL)
+        return;
+
+    if (PKT_IS_TOSERVER(p)) {
+        stream = &ssn->client;
+        ostream = &ssn->server;
+    } else {
+        stream = &ssn->server;
+        ostream = &ssn->client;
+    }
+
+    uint32_t seq = TCP_GET_SEQ(p) + p->payload_len;
+    if (SEQ_GT(seq, stream->next_seq))
+        stream->next_seq = seq;
+
+    if (p->tcph->th_flags & TH_ACK) {
+        ostream->window = TCP_GET_WINDOW(p) << ostream->wscale;
+        StreamTcpUpdateLastAck(ssn, ostream, TCP_GET_ACK(p));
+
+        if (SEQ_LT(ostream->next_seq, TCP_GET_ACK(p)))
+            ostream->next_seq = TCP_GET_ACK(p);
+
+        StreamTcpUpdateNextWin(ssn, ostream, (ostream->last_ack + ostream->window));
+    }
+}
+
 static int StreamTcpPacketIsRetransmission(TcpStream *stream, Packet *p) {
     if (p->payload_len == 0)
         SCReturnInt(0);
@@ -4101,6 +4170,10 @@ static int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
                     ssn->client.flags = 0;
                     ssn->server.flags = 0;
 
+                    /* the new session is inspected again */
+                    if (p->flow->flags & FLOW_BYPASSED)
+                        StreamTcpClearBypass(p);
+
                     /* set state the NONE, also pulls flow out of closed queue */
                     StreamTcpPacketSetState(p, ssn, TCP_NONE);
 
@@ -4172,6 +4245,25 @@ static int StreamTcpPacket (ThreadVars *tv, Packet *p, StreamTcpThread *stt,
             ReCalculateChecksum(p);
         }
 
+        /* a bypassed flow is tracked and inspected again once the session
+         * is closing, so that a reuse of the session is not bypassed */
+        if ((p->flow->flags & FLOW_BYPASSED) && ssn->state != TCP_ESTABLISHED) {
+            StreamTcpClearBypass(p);
+        }
+
+        /* neither direction is reassembled anymore (encrypted or depth
+         * reached), so there is nothing left for the app layer and the
+         * stream inspection. Bypass the rest of the flow if enabled and
+         * no stateful signature is still in progress. */
+        if (stream_config.bypass && ssn->state == TCP_ESTABLISHED &&
+            (ssn->client.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY) &&
+            (ssn->server.flags & STREAMTCP_STREAM_FLAG_NOREASSEMBLY) &&
+            !(p->flow->flags & (FLOW_BYPASSED|FLOW_ACTION_DROP)) &&
+            DeStateFlowHasOpenState(p->flow) == 0)
+        {
+            FlowSetBypassFlag(p->flow);
+        }
+
         /* check for conditions that may make us not want to log this packet */
 
         /* streams that hit depth */
@@ -4270,6 +4362,19 @@ TmEcode StreamTcp (ThreadVars *tv, Packet *p, void *data, PacketQueue *pq, Packe
         return TM_ECODE_OK;
     }
 
+    /* flow was bypassed, FlowHandlePacket already accounted for it. Only
+     * packets that may change the session state go through the state
+     * machine, for the others we just keep the sequence tracking going. */
+    if ((p->flags & PKT_FLOW_BYPASSED) &&
+        !(p->tcph->th_flags & (TH_SYN|TH_FIN|TH_RST))) {
+        FLOWLOCK_WRLOCK(p->flow);
+        StreamTcpBypassTrack(p);
+        FLOWLOCK_UNLOCK(p->flow);
+
+        SCPerfCounterIncr(stt->counter_tcp_bypassed, tv->sc_perf_pca);
+        return TM_ECODE_OK;
+    }
+
     if (stream_config.flags & STREAMTCP_INIT_FLAG_CHECKSUM_VALIDATION) {
         if (StreamTcpValidateChecksum(p) == 0) {
             SCPerfCounterIncr(stt->counter_tcp_invalid_checksum, tv->sc_perf_pca);
@@ -4317,6 +4422,9 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->counter_tcp_no_flow = SCPerfTVRegisterCounter("tcp.no_flow", tv,
                                                         SC_PERF_TYPE_UINT64,
                                                         "NULL");
+    stt->counter_tcp_bypassed = SCPerfTVRegisterCounter("tcp.bypassed", tv,
+                                                        SC_PERF_TYPE_UINT64,
+                                                        "NULL");
     stt->counter_tcp_reused_ssn = SCPerfTVRegisterCounter("tcp.reused_ssn", tv,
                                                         SC_PERF_TYPE_UINT64,
                                                         "NULL");
@@ -4332,6 +4440,12 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->counter_tcp_rst = SCPerfTVRegisterCounter("tcp.rst", tv,
                                                         SC_PERF_TYPE_UINT64,
                                                         "NULL");
+    stt->counter_tcp_ssn_pool_memuse = SCPerfTVRegisterCounter("tcp.ssn_pool_memuse", tv,
+                                                        SC_PERF_TYPE_Q_NORMAL,
+                                                        "NULL");
+    stt->counter_tcp_ssn_pool_memuse_max = SCPerfTVRegisterCounter("tcp.ssn_pool_memuse_max", tv,
+                                                        SC_PERF_TYPE_Q_NORMAL,
+                                                        "NULL");
 
     /* init reassembly ctx */
     stt->ra_ctx = StreamTcpReassembleInitThreadCtx(tv);
@@ -4350,6 +4464,19 @@ TmEcode StreamTcpThreadInit(ThreadVars *tv, void *initdata, void **data)
     stt->ra_ctx->counter_tcp_reass_gap = SCPerfTVRegisterCounter("tcp.reassembly_gap", tv,
                                                         SC_PERF_TYPE_UINT64,
                                                         "NULL");
+    stt->ra_ctx->counter_tcp_segment_pool_memuse = SCPerfTVRegisterCounter("tcp.segment_pool_memuse", tv,
+                                                        SC_PERF_TYPE_Q_NORMAL,
+                                                        "NULL");
+    stt->ra_ctx->counter_tcp_segment_pool_memuse_max = SCPerfTVRegisterCounter("tcp.segment_pool_memuse_max", tv,
+                                                        SC_PERF_TYPE_Q_NORMAL,
+                                                        "NULL");
+
+    /* per thread session and segment caches */
+    ssn_pool_cache = PoolCacheInit(ssn_pool, &ssn_pool_mutex);
+    if (ssn_pool_cache == NULL)
+        SCReturnInt(TM_ECODE_FAILED);
+    if (StreamTcpReassembleInitThreadCache() < 0)
+        SCReturnInt(TM_ECODE_FAILED);
 
     tv->sc_perf_pca = SCPerfGetAllCountersArray(tv, &tv->sc_perf_pctx);
     SCPerfAddToClubbedTMTable(tv->name, &tv->sc_perf_pctx);
@@ -4369,6 +4496,11 @@ TmEcode StreamTcpThreadDeinit(ThreadVars *tv, void *data)
 
     /* XXX */
 
+    /* return the cached sessions and segments to the pools */
+    PoolCacheFree(ssn_pool_cache);
+    ssn_pool_cache = NULL;
+    StreamTcpReassembleFreeThreadCache();
+
     /* free reassembly ctx */
     StreamTcpReassembleFreeThreadCtx(stt->ra_ctx);
 
@@ -9784,6 +9916,372 @@ end:
     return ret;
 }
 
+/** \test flow is bypassed once neither direction is reassembled */
+static int StreamTcpTest46 (void) {
+    int ret = 0;
+    Flow f;
+    ThreadVars tv;
+    StreamTcpThread stt;
+    TCPHdr tcph;
+    PacketQueue pq;
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    TcpSession *ssn;
+
+    if (unlikely(p == NULL))
+        return 0;
+    memset(p, 0, SIZE_OF_PACKET);
+    p->pkt = (uint8_t *)(p + 1);
+
+    memset(&pq,0,sizeof(PacketQueue));
+    memset (&f, 0, sizeof(Flow));
+    memset(&tv, 0, sizeof (ThreadVars));
+    memset(&stt, 0, sizeof (StreamTcpThread));
+    memset(&tcph, 0, sizeof (TCPHdr));
+
+    StreamTcpInitConfig(TRUE);
+    stream_config.bypass = TRUE;
+
+    p->tcph = &tcph;
+    tcph.th_win = htons(5480);
+    p->flow = &f;
+
+    /* SYN pkt */
+    tcph.th_flags = TH_SYN;
+    tcph.th_seq = htonl(100);
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    if (StreamTcpPacket(&tv, p, &stt, &pq) == -1)
+        goto end;
+
+    /* SYN/ACK */
+    p->tcph->th_seq = htonl(500);
+    p->tcph->th_ack = htonl(101);
+    p->tcph->th_flags = TH_SYN | TH_ACK;
+    p->flowflags = FLOW_PKT_TOCLIENT;
+
+    if (StreamTcpPacket(&tv, p, &stt, &pq) == -1)
+        goto end;
+
+    /* ACK */
+    p->tcph->th_ack = htonl(501);
+    p->tcph->th_seq = htonl(101);
+    p->tcph->th_flags = TH_ACK;
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    if (StreamTcpPacket(&tv, p, &stt, &pq) == -1)
+        goto end;
+
+    ssn = p->flow->protoctx;
+    if (ssn == NULL || ssn->state != TCP_ESTABLISHED) {
+        printf("state not TCP_ESTABLISHED: ");
+        goto end;
+    }
+
+    /* only one direction is done, no bypass yet */
+    ssn->client.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+
+    if (StreamTcpPacket(&tv, p, &stt, &pq) == -1)
+        goto end;
+
+    if (f.flags & FLOW_BYPASSED) {
+        printf("flow bypassed with one direction reassembled: ");
+        goto end;
+    }
+
+    ssn->server.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+
+    if (StreamTcpPacket(&tv, p, &stt, &pq) == -1)
+        goto end;
+
+    if (!(f.flags & FLOW_BYPASSED)) {
+        printf("flow not bypassed: ");
+        goto end;
+    }
+
+    StreamTcpSessionClear(p->flow->protoctx);
+
+    ret = 1;
+end:
+    StreamTcpFreeConfig(TRUE);
+    SCFree(p);
+    return ret;
+}
+
+/** \test control packets of a bypassed flow are tracked, so a reused
+ *        session is inspected again */
+static int StreamTcpTest47 (void) {
+    int ret = 0;
+    Flow f;
+    ThreadVars tv;
+    StreamTcpThread stt;
+    TCPHdr tcph;
+    PacketQueue pq;
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    TcpSession *ssn;
+    uint64_t pkts;
+
+    if (unlikely(p == NULL))
+        return 0;
+    memset(p, 0, SIZE_OF_PACKET);
+    p->pkt = (uint8_t *)(p + 1);
+
+    memset(&pq,0,sizeof(PacketQueue));
+    memset (&f, 0, sizeof(Flow));
+    memset(&tv, 0, sizeof (ThreadVars));
+    memset(&stt, 0, sizeof (StreamTcpThread));
+    memset(&tcph, 0, sizeof (TCPHdr));
+
+    FLOW_INITIALIZE(&f);
+    StreamTcpInitConfig(TRUE);
+    stream_config.bypass = TRUE;
+    stream_config.flags &= ~STREAMTCP_INIT_FLAG_CHECKSUM_VALIDATION;
+    stt.ra_ctx = StreamTcpReassembleInitThreadCtx(&tv);
+    if (stt.ra_ctx == NULL)
+        goto end;
+
+    p->tcph = &tcph;
+    tcph.th_win = htons(5480);
+    p->flow = &f;
+
+    /* SYN pkt */
+    tcph.th_flags = TH_SYN;
+    tcph.th_seq = htonl(100);
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    /* SYN/ACK */
+    p->tcph->th_seq = htonl(500);
+    p->tcph->th_ack = htonl(101);
+    p->tcph->th_flags = TH_SYN | TH_ACK;
+    p->flowflags = FLOW_PKT_TOCLIENT;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    /* ACK */
+    p->tcph->th_ack = htonl(501);
+    p->tcph->th_seq = htonl(101);
+    p->tcph->th_flags = TH_ACK;
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    ssn = p->flow->protoctx;
+    if (ssn == NULL)
+        goto end;
+    ssn->client.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+    ssn->server.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (!(f.flags & FLOW_BYPASSED)) {
+        printf("flow not bypassed: ");
+        goto end;
+    }
+
+    /* ACK of the bypassed flow, flagged like FlowHandlePacket does */
+    p->flags |= (PKT_FLOW_BYPASSED|PKT_NOPACKET_INSPECTION);
+    pkts = stt.pkts;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (stt.pkts != pkts) {
+        printf("bypassed packet processed: ");
+        goto end;
+    }
+
+    /* RST of the bypassed flow */
+    p->tcph->th_seq = htonl(101);
+    p->tcph->th_ack = 0;
+    p->tcph->th_flags = TH_RST;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (ssn->state != TCP_CLOSED) {
+        printf("state %u, not TCP_CLOSED: ", ssn->state);
+        goto end;
+    }
+
+    if ((f.flags & FLOW_BYPASSED) ||
+        (p->flags & (PKT_FLOW_BYPASSED|PKT_NOPACKET_INSPECTION))) {
+        printf("flow still bypassed after the session closed: ");
+        goto end;
+    }
+
+    /* SYN reusing the session */
+    p->flags = 0;
+    p->tcph->th_seq = htonl(1000);
+    p->tcph->th_ack = 0;
+    p->tcph->th_flags = TH_SYN;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (ssn->state != TCP_SYN_SENT || ssn->client.isn != 1000) {
+        printf("session not reused: ");
+        goto end;
+    }
+
+    if ((f.flags & FLOW_BYPASSED) || (p->flags & PKT_NOPACKET_INSPECTION)) {
+        printf("reused session bypassed: ");
+        goto end;
+    }
+
+    StreamTcpSessionClear(p->flow->protoctx);
+
+    ret = 1;
+end:
+    if (stt.ra_ctx != NULL)
+        StreamTcpReassembleFreeThreadCtx(stt.ra_ctx);
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    SCFree(p);
+    return ret;
+}
+
+/** \test data skipped while a flow is bypassed still moves the sequence
+ *        tracking, so the FIN after it closes the session */
+static int StreamTcpTest48 (void) {
+    int ret = 0;
+    Flow f;
+    ThreadVars tv;
+    StreamTcpThread stt;
+    TCPHdr tcph;
+    PacketQueue pq;
+    Packet *p = SCMalloc(SIZE_OF_PACKET);
+    TcpSession *ssn;
+    uint8_t payload[1000];
+    int i;
+
+    if (unlikely(p == NULL))
+        return 0;
+    memset(p, 0, SIZE_OF_PACKET);
+    p->pkt = (uint8_t *)(p + 1);
+
+    memset(&pq,0,sizeof(PacketQueue));
+    memset (&f, 0, sizeof(Flow));
+    memset(&tv, 0, sizeof (ThreadVars));
+    memset(&stt, 0, sizeof (StreamTcpThread));
+    memset(&tcph, 0, sizeof (TCPHdr));
+    memset(payload, 'A', sizeof(payload));
+
+    FLOW_INITIALIZE(&f);
+    StreamTcpInitConfig(TRUE);
+    stream_config.bypass = TRUE;
+    stream_config.flags &= ~STREAMTCP_INIT_FLAG_CHECKSUM_VALIDATION;
+    stt.ra_ctx = StreamTcpReassembleInitThreadCtx(&tv);
+    if (stt.ra_ctx == NULL)
+        goto end;
+
+    p->tcph = &tcph;
+    tcph.th_win = htons(5480);
+    p->flow = &f;
+
+    /* SYN pkt */
+    tcph.th_flags = TH_SYN;
+    tcph.th_seq = htonl(100);
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    /* SYN/ACK */
+    p->tcph->th_seq = htonl(500);
+    p->tcph->th_ack = htonl(101);
+    p->tcph->th_flags = TH_SYN | TH_ACK;
+    p->flowflags = FLOW_PKT_TOCLIENT;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    /* ACK */
+    p->tcph->th_ack = htonl(501);
+    p->tcph->th_seq = htonl(101);
+    p->tcph->th_flags = TH_ACK;
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    ssn = p->flow->protoctx;
+    if (ssn == NULL)
+        goto end;
+    ssn->client.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+    ssn->server.flags |= STREAMTCP_STREAM_FLAG_NOREASSEMBLY;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (!(f.flags & FLOW_BYPASSED)) {
+        printf("flow not bypassed: ");
+        goto end;
+    }
+
+    /* 8KB of client data and the server ACKs for it, all bypassed */
+    for (i = 0; i < 8; i++) {
+        p->flags |= (PKT_FLOW_BYPASSED|PKT_NOPACKET_INSPECTION);
+        p->tcph->th_seq = htonl(101 + i * sizeof(payload));
+        p->tcph->th_ack = htonl(501);
+        p->tcph->th_flags = TH_ACK | TH_PUSH;
+        p->flowflags = FLOW_PKT_TOSERVER;
+        p->payload = payload;
+        p->payload_len = sizeof(payload);
+
+        if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+            goto end;
+
+        p->tcph->th_seq = htonl(501);
+        p->tcph->th_ack = htonl(101 + (i + 1) * sizeof(payload));
+        p->tcph->th_flags = TH_ACK;
+        p->flowflags = FLOW_PKT_TOCLIENT;
+        p->payload = NULL;
+        p->payload_len = 0;
+
+        if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+            goto end;
+    }
+
+    if (ssn->state != TCP_ESTABLISHED || ssn->client.next_seq != 8101 ||
+        ssn->client.last_ack != 8101) {
+        printf("state %u, client next_seq %"PRIu32", last_ack %"PRIu32
+               ", expected %u, 8101, 8101: ", ssn->state,
+               ssn->client.next_seq, ssn->client.last_ack, TCP_ESTABLISHED);
+        goto end;
+    }
+
+    /* FIN after the bypassed data */
+    p->flags |= (PKT_FLOW_BYPASSED|PKT_NOPACKET_INSPECTION);
+    p->tcph->th_seq = htonl(8101);
+    p->tcph->th_ack = htonl(501);
+    p->tcph->th_flags = TH_FIN | TH_ACK;
+    p->flowflags = FLOW_PKT_TOSERVER;
+
+    if (StreamTcp(&tv, p, &stt, &pq, NULL) != TM_ECODE_OK)
+        goto end;
+
+    if (ssn->state == TCP_ESTABLISHED) {
+        printf("FIN after bypassed data rejected: ");
+        goto end;
+    }
+
+    if ((f.flags & FLOW_BYPASSED) ||
+        (p->flags & (PKT_FLOW_BYPASSED|PKT_NOPACKET_INSPECTION))) {
+        printf("flow still bypassed after the FIN: ");
+        goto end;
+    }
+
+    StreamTcpSessionClear(p->flow->protoctx);
+
+    ret = 1;
+end:
+    if (stt.ra_ctx != NULL)
+        StreamTcpReassembleFreeThreadCtx(stt.ra_ctx);
+    StreamTcpFreeConfig(TRUE);
+    FLOW_DESTROY(&f);
+    SCFree(p);
+    return ret;
+}
+
 #endif /* UNITTESTS */
 
 void StreamTcpRegisterTests (void) {
@@ -9860,6 +10358,9 @@ void StreamTcpRegisterTests (void) {
     UtRegisterTest("StreamTcpTest43 -- SYN/ACK queue", StreamTcpTest43, 1);
     UtRegisterTest("StreamTcpTest44 -- SYN/ACK queue", StreamTcpTest44, 1);
     UtRegisterTest("StreamTcpTest45 -- SYN/ACK queue", StreamTcpTest45, 1);
+    UtRegisterTest("StreamTcpTest46 -- flow bypass", StreamTcpTest46, 1);
+    UtRegisterTest("StreamTcpTest47 -- flow bypass and session reuse", StreamTcpTest47, 1);
+    UtRegisterTest("StreamTcpTest48 -- flow bypass and FIN after skipped data", StreamTcpTest48, 1);
 
     /* set up the reassembly tests as well */
     StreamTcpReassembleRegisterTests();
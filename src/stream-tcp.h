@@ -52,6 +52,8 @@ typedef struct TcpStreamCnf_ {
     uint32_t prealloc_sessions;
     int midstream;
     int async_oneside;
+    /** bypass flows once both directions are done with reassembly */
+    int bypass;
     uint32_t reassembly_depth;  /**< Depth until when we reassemble the stream */
 
     uint16_t reassembly_toserver_chunk_size;
@@ -85,6 +87,8 @@ typedef struct StreamTcpThread_ {
     uint16_t counter_tcp_invalid_checksum;
     /** TCP packets with no associated flow */
     uint16_t counter_tcp_no_flow;
+    /** TCP packets of bypassed flows */
+    uint16_t counter_tcp_bypassed;
     /** sessions reused */
     uint16_t counter_tcp_reused_ssn;
     /** sessions reused */
@@ -95,6 +99,9 @@ typedef struct StreamTcpThread_ {
     uint16_t counter_tcp_synack;
     /** rst pkts */
     uint16_t counter_tcp_rst;
+    /** memory of the sessions in use and its peak */
+    uint16_t counter_tcp_ssn_pool_memuse;
+    uint16_t counter_tcp_ssn_pool_memuse_max;
 
     /** tcp reassembly thread data */
     TcpReassemblyThreadCtx *ra_ctx;
@@ -107,6 +107,7 @@
 #include "log-pcap.h"
 #include "log-file.h"
 #include "log-filestore.h"
+#include "output-json.h"
 
 #include "stream-tcp.h"
 
@@ -160,6 +161,10 @@
 #include "app-layer-smtp.h"
 
 #include "util-radix-tree.h"
+#include "util-logwriter.h"
+#include "util-json.h"
+#include "util-latency.h"
+#include "util-line.h"
 #include "util-host-os-info.h"
 #include "util-cidr.h"
 #include "util-unittest.h"
@@ -171,6 +176,7 @@
 #include "util-reference-config.h"
 #include "util-profiling.h"
 #include "util-magic.h"
+#include "util-file-hash.h"
 #include "util-signal.h"
 
 #include "util-coredump-config.h"
@@ -1589,6 +1595,7 @@ int main(int argc, char **argv)
     if (run_mode != RUNMODE_UNIX_SOCKET) {
         SCPerfInitCounterApi();
     }
+    SCLatencyInit();
 #ifdef PROFILING
     SCProfilingRulesGlobalInit();
     SCProfilingInit();
@@ -1684,6 +1691,8 @@ int main(int argc, char **argv)
     /* file log */
     TmModuleLogFileLogRegister();
     TmModuleLogFilestoreRegister();
+    /* json event log */
+    TmModuleJsonEventLogRegister();
     /* cuda */
 #ifdef __SC_CUDA_SUPPORT__
     TmModuleCudaMpmB2gRegister();
@@ -1704,11 +1713,18 @@ int main(int argc, char **argv)
         UtilSignalHandlerSetup(SIGUSR2, SignalHandlerSigusr2Disabled);
     }
 
+    FileHashSetup();
+
 #ifdef UNITTESTS
 
     if (run_mode == RUNMODE_UNITTEST) {
 #ifdef DBG_MEM_ALLOC
     SCLogInfo("Memory used at startup: %"PRIdMAX, (intmax_t)global_mem);
+#endif
+#ifdef HAVE_NSS
+        /* the file hash tests use NSS */
+        PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
+        NSS_NoDB_Init(NULL);
 #endif
         /* test and initialize the unittesting subsystem */
         if(regex_arg == NULL){
@@ -1796,10 +1812,16 @@ int main(int argc, char **argv)
         DetectEngineHttpHHRegisterTests();
         DetectEngineHttpHRHRegisterTests();
         DetectEngineRegisterTests();
+        DetectEngineAlertRegisterTests();
         SCLogRegisterTests();
         SMTPParserRegisterTests();
         MagicRegisterTests();
         UtilMiscRegisterTests();
+        LogWriterRegisterTests();
+        SCJsonRegisterTests();
+        SCLatencyRegisterTests();
+        LineBufferRegisterTests();
+        FileHashRegisterTests();
         DetectAddressTests();
         DetectProtoTests();
         DetectPortTests();
@@ -1870,7 +1892,7 @@ int main(int argc, char **argv)
     }
 
 #ifdef HAVE_NSS
-    /* init NSS for md5 */
+    /* init NSS for file hashing */
     PR_Init(PR_USER_THREAD, PR_PRIORITY_NORMAL, 0);
     NSS_NoDB_Init(NULL);
 #endif
@@ -112,6 +112,8 @@ typedef struct ThreadVars_ {
     /** slot functions */
     void *(*tm_func)(void *);
     struct TmSlot_ *tm_slots;
+    /** data for the tm_func of "custom" slot threads */
+    void *tm_func_data;
 
     uint8_t thread_setup_flags;
     uint16_t cpu_affinity; /** cpu or core number to set affinity to */
@@ -121,6 +123,11 @@ typedef struct ThreadVars_ {
     SCPerfContext sc_perf_pctx;
     SCPerfCounterArray *sc_perf_pca;
 
+    /** latency histograms, NULL if latency tracking is disabled */
+    struct SCLatHist_ *lat_queue;   /**< wait on the input queue */
+    struct SCLatHist_ *lat_packet;  /**< acquisition to release */
+    uint32_t lat_sample_cnt;        /**< packets since the last sample */
+
     SCPtMutex *m;
     SCPtCondT *cond;
 
@@ -28,6 +28,7 @@
 #include "tm-threads.h"
 #include "util-debug.h"
 #include "threads.h"
+#include "util-logwriter.h"
 
 void TmModuleDebugList(void) {
     TmModule *t;
@@ -132,6 +133,12 @@ int LogFileFreeCtx(LogFileCtx *lf_ctx)
         SCReturnInt(0);
     }
 
+    /* write out buffered records before closing the file */
+    if (lf_ctx->writer != NULL) {
+        LogWriterFree(lf_ctx->writer);
+        lf_ctx->writer = NULL;
+    }
+
     if (lf_ctx->fp != NULL)
     {
         SCMutexLock(&lf_ctx->fp_mutex);
@@ -95,11 +95,22 @@ typedef struct LogFileCtx_ {
     uint64_t alerts;
     /* flag to avoid multiple threads printing the same stats */
     uint8_t flags;
+
+    /** Writer thread if records are written asynchronously, see
+     *  util-logwriter.c */
+    struct LogWriter_ *writer;
+
+    /** Rotation of regular files, see SCConfLogRotateSetup(). Protected
+     *  by fp_mutex like the file pointer itself. */
+    uint32_t rotate_interval;   /**< seconds between rotations, 0 off */
+    time_t rotate_time;         /**< time the current file was opened */
 } LogFileCtx;
 
 /* flags for LogFileCtx */
 #define LOGFILE_HEADER_WRITTEN 0x01
 #define LOGFILE_ALERTS_PRINTED 0x02
+#define LOGFILE_PER_THREAD     0x04 /**< each thread writes its own file,
+                                     *   this ctx only holds the settings */
 
 /**
  * Structure that output modules use to maintain private data.
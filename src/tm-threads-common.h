@@ -71,6 +71,7 @@ typedef enum {
     TMM_PCAPLOG,
     TMM_FILELOG,
     TMM_FILESTORE,
+    TMM_JSONEVENTLOG,
     TMM_STREAMTCP,
     TMM_DECODEIPFW,
     TMM_VERDICTIPFW,
@@ -364,9 +364,11 @@ void *TmThreadsSlot1NoOut(void *td)
         p = tv->tmqh_in(tv);
 
         PACKET_PROFILING_TMM_START(p, s->tm_id);
+        uint64_t lat_ts = SCLatencySlotStart(p);
         r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), /* no outqh no pq */ NULL,
                         /* no outqh no pq */ NULL);
         PACKET_PROFILING_TMM_END(p, s->tm_id);
+        SCLatencySlotEnd(s, lat_ts);
 
         /* handle error */
         if (r == TM_ECODE_FAILED) {
@@ -546,9 +548,11 @@ void *TmThreadsSlot1(void *td)
         if (p != NULL) {
             TmSlotFunc SlotFunc = SC_ATOMIC_GET(s->SlotFunc);
             PACKET_PROFILING_TMM_START(p, s->tm_id);
+            uint64_t lat_ts = SCLatencySlotStart(p);
             r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), &s->slot_pre_pq,
                             &s->slot_post_pq);
             PACKET_PROFILING_TMM_END(p, s->tm_id);
+            SCLatencySlotEnd(s, lat_ts);
 
             /* handle error */
             if (r == TM_ECODE_FAILED) {
@@ -629,6 +633,7 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
     for (s = slot; s != NULL; s = s->slot_next) {
         TmSlotFunc SlotFunc = SC_ATOMIC_GET(s->SlotFunc);
         PACKET_PROFILING_TMM_START(p, s->tm_id);
+        uint64_t lat_ts = SCLatencySlotStart(p);
 
         if (unlikely(s->id == 0)) {
             r = SlotFunc(tv, p, SC_ATOMIC_GET(s->slot_data), &s->slot_pre_pq, &s->slot_post_pq);
@@ -637,6 +642,7 @@ TmEcode TmThreadsSlotVarRun(ThreadVars *tv, Packet *p,
         }
 
         PACKET_PROFILING_TMM_END(p, s->tm_id);
+        SCLatencySlotEnd(s, lat_ts);
 
         /* handle error */
         if (unlikely(r == TM_ECODE_FAILED)) {
@@ -1068,6 +1074,8 @@ static inline TmSlot * _TmSlotSetFuncAppend(ThreadVars *tv, TmModule *tm, void *
     /* we don't have to check for the return value "-1".  We wouldn't have
      * received a TM as arg, if it didn't exist */
     slot->tm_id = TmModuleGetIDForTM(tm);
+    if (sc_latency_sample != 0)
+        slot->lat_hist = SCLatHistAlloc();
 
     tv->cap_flags |= tm->cap_flags;
 
@@ -1464,6 +1472,11 @@ ThreadVars *TmThreadCreate(char *name, char *inq_name, char *inqh_name,
     SC_ATOMIC_INIT(tv->flags);
     SCMutexInit(&tv->sc_perf_pctx.m, NULL);
 
+    if (sc_latency_sample != 0) {
+        tv->lat_queue = SCLatHistAlloc();
+        tv->lat_packet = SCLatHistAlloc();
+    }
+
     tv->name = name;
     /* default state for every newly created thread */
     TmThreadsSetFlag(tv, THV_PAUSE);
@@ -2043,8 +2056,11 @@ void TmThreadFree(ThreadVars *tv)
     while (s) {
         ps = s;
         s = s->slot_next;
+        SCLatHistFree(ps->lat_hist);
         SCFree(ps);
     }
+    SCLatHistFree(tv->lat_queue);
+    SCLatHistFree(tv->lat_packet);
     SCFree(tv);
 }
 
@@ -28,6 +28,7 @@
 #include "tmqh-packetpool.h"
 #include "tm-threads-common.h"
 #include "tm-modules.h"
+#include "util-latency.h"
 #ifdef __tile__
 #include <tmc/sync.h>
 #endif
@@ -70,6 +71,10 @@ typedef struct TmSlot_ {
 
     /* linked list, only used when you have multiple slots(used by TmVarSlot) */
     struct TmSlot_ *slot_next;
+
+    /* processing time of sampled packets, NULL if latency tracking is
+     * disabled */
+    struct SCLatHist_ *lat_hist;
 } TmSlot;
 
 extern ThreadVars *tv_root[TVT_MAX];
@@ -99,6 +104,7 @@ void TmThreadKillThreads(void);
 void TmThreadClearThreadsFamily(int family);
 void TmThreadAppend(ThreadVars *, int);
 void TmThreadRemove(ThreadVars *, int);
+void TmThreadFree(ThreadVars *);
 
 TmEcode TmThreadSetCPUAffinity(ThreadVars *, uint16_t);
 TmEcode TmThreadSetThreadPriority(ThreadVars *, int);
@@ -138,6 +144,8 @@ static inline TmEcode TmThreadsSlotProcessPkt(ThreadVars *tv, TmSlot *s, Packet
 {
     TmEcode r = TM_ECODE_OK;
 
+    SC_LATENCY_PACKET_START(tv, p);
+
     if (s == NULL) {
         tv->tmqh_out(tv, p);
         return r;
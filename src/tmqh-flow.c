@@ -35,6 +35,7 @@
 #include "tmqh-flow.h"
 
 #include "tm-queuehandlers.h"
+#include "util-latency.h"
 
 #include "conf.h"
 #include "util-unittest.h"
@@ -105,6 +106,8 @@ Packet *TmqhInputFlow(ThreadVars *tv)
     if (q->len > 0) {
         Packet *p = PacketDequeue(q);
         SCMutexUnlock(&q->mutex_q);
+        if (p != NULL)
+            SC_LATENCY_QUEUE_GET(tv, p);
         return p;
     } else {
         /* return NULL if we have no pkt. Should only happen on signals. */
@@ -257,6 +260,7 @@ void TmqhOutputFlowRoundRobin(ThreadVars *tv, Packet *p)
     (void) SC_ATOMIC_ADD(ctx->queues[qid].total_packets, 1);
 
     PacketQueue *q = ctx->queues[qid].q;
+    SC_LATENCY_QUEUE_PUT(p);
     SCMutexLock(&q->mutex_q);
     PacketEnqueue(q, p);
 #ifdef __tile__
@@ -309,6 +313,7 @@ void TmqhOutputFlowActivePackets(ThreadVars *tv, Packet *p)
     (void) SC_ATOMIC_ADD(ctx->queues[qid].total_packets, 1);
 
     PacketQueue *q = ctx->queues[qid].q;
+    SC_LATENCY_QUEUE_PUT(p);
     SCMutexLock(&q->mutex_q);
     PacketEnqueue(q, p);
 #ifdef __tile__
@@ -360,6 +365,7 @@ void TmqhOutputFlowHash(ThreadVars *tv, Packet *p)
     (void) SC_ATOMIC_ADD(ctx->queues[qid].total_packets, 1);
 
     PacketQueue *q = ctx->queues[qid].q;
+    SC_LATENCY_QUEUE_PUT(p);
     SCMutexLock(&q->mutex_q);
     PacketEnqueue(q, p);
 #ifdef __tile__
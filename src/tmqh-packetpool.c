@@ -43,6 +43,7 @@
 #include "stream-tcp-reassemble.h"
 
 #include "tm-queuehandlers.h"
+#include "util-latency.h"
 
 #include "pkt-var.h"
 
@@ -395,6 +396,9 @@ void TmqhOutputPacketpool(ThreadVars *t, Packet *p)
         p->ext_pkt = NULL;
     }
 
+    /* after ReleaseData, so in IPS modes the verdict is included */
+    SC_LATENCY_PACKET_END(t, p);
+
     PACKET_PROFILING_END(p);
 
     SCLogDebug("getting rid of tunnel pkt... alloc'd %s (root %p)", p->flags & PKT_ALLOC ? "true" : "false", p->root);
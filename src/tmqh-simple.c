@@ -30,6 +30,7 @@
 #include "threadvars.h"
 
 #include "tm-queuehandlers.h"
+#include "util-latency.h"
 
 #ifdef __tile__
 #include <arch/cycle.h>
@@ -86,6 +87,8 @@ Packet *TmqhInputSimple(ThreadVars *t)
         if (q->len == 0) q->cond_q = 0;
 #endif
         SCMutexUnlock(&q->mutex_q);
+        if (p != NULL)
+            SC_LATENCY_QUEUE_GET(t, p);
         return p;
     } else {
         /* return NULL if we have no pkt. Should only happen on signals. */
@@ -119,6 +122,7 @@ void TmqhOutputSimple(ThreadVars *t, Packet *p)
 
     PacketQueue *q = &trans_q[t->outq->id];
 
+    SC_LATENCY_QUEUE_PUT(p);
     SCMutexLock(&q->mutex_q);
     PacketEnqueue(q, p);
 #ifdef __tile__
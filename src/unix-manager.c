@@ -852,6 +852,9 @@ void *UnixManagerThread(void *td)
     UnixManagerRegisterCommand("capture-mode", UnixManagerCaptureModeCommand, &command, 0);
     UnixManagerRegisterCommand("conf-get", UnixManagerConfGetCommand, &command, UNIX_CMD_TAKE_ARGS);
     UnixManagerRegisterCommand("dump-counters", SCPerfOutputCounterSocket, NULL, 0);
+    UnixManagerRegisterCommand("dump-counters-prometheus",
+                               SCPerfOutputCounterSocketPrometheus, NULL, 0);
+    UnixManagerRegisterCommand("dump-latency", SCLatencyOutputSocket, NULL, 0);
 #if 0
     UnixManagerRegisterCommand("reload-rules", UnixManagerReloadRules, NULL, 0);
 #endif
@@ -0,0 +1,753 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Incremental MD5/SHA1/SHA256 calculation for tracked files.
+ *
+ * Each algorithm has a list of engines in order of preference. At start
+ * up the first engine the system supports is selected. NSS provides all
+ * algorithms; on x86_64 CPUs with the SHA extensions SHA1 and SHA256 are
+ * calculated with the SHA-NI instructions instead.
+ *
+ * Only the algorithms enabled by the rules (filemd5, filesha1,
+ * filesha256) or the outputs (force-md5, force-hash) are calculated.
+ */
+
+#include "suricata-common.h"
+#include "util-file-hash.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+
+#ifdef HAVE_NSS
+#include <sechash.h>
+#endif
+
+/** algorithms needed by the loaded rules and outputs */
+static uint32_t g_file_hash_algs = 0;
+
+static const char *file_hash_names[FILE_HASH_MAX] = { "md5", "sha1", "sha256" };
+static const uint32_t file_hash_len[FILE_HASH_MAX] = { 16, 20, 32 };
+
+const char *FileHashName(FileHashAlg alg)
+{
+    return file_hash_names[alg];
+}
+
+uint32_t FileHashLen(FileHashAlg alg)
+{
+    return file_hash_len[alg];
+}
+
+/**
+ * \brief get the algorithm from its name
+ * \retval alg FileHashAlg or -1 if the name is unknown
+ */
+int FileHashParseName(const char *name)
+{
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        if (strcasecmp(name, file_hash_names[alg]) == 0)
+            return alg;
+    }
+    return -1;
+}
+
+/**
+ * \brief calculate an algorithm for all files that are hashed
+ */
+void FileHashEnable(FileHashAlg alg)
+{
+    g_file_hash_algs |= FILE_HASH_FLAG(alg);
+}
+
+/**
+ * \retval algs FILE_HASH_FLAG mask of the algorithms to calculate
+ */
+uint32_t FileHashEnabled(void)
+{
+    return g_file_hash_algs;
+}
+
+#ifdef HAVE_NSS
+
+/* NSS engines */
+
+static int FileHashNssSupported(void)
+{
+    return 1;
+}
+
+static void FileHashNssUpdate(void *ctx, const uint8_t *data, uint32_t len)
+{
+    HASH_Update((HASHContext *)ctx, data, len);
+}
+
+static void FileHashNssFinal(void *ctx, uint8_t *digest)
+{
+    unsigned int len = 0;
+    HASH_End((HASHContext *)ctx, digest, &len, FILE_HASH_MAX_LEN);
+}
+
+static void FileHashNssFree(void *ctx)
+{
+    HASH_Destroy((HASHContext *)ctx);
+}
+
+static void *FileHashNssNew(HASH_HashType type)
+{
+    HASHContext *ctx = HASH_Create(type);
+    if (ctx != NULL)
+        HASH_Begin(ctx);
+    return ctx;
+}
+
+static void *FileHashNssNewMd5(void)
+{
+    return FileHashNssNew(HASH_AlgMD5);
+}
+
+static void *FileHashNssNewSha1(void)
+{
+    return FileHashNssNew(HASH_AlgSHA1);
+}
+
+static void *FileHashNssNewSha256(void)
+{
+    return FileHashNssNew(HASH_AlgSHA256);
+}
+
+static const FileHashEngine file_hash_nss_md5 = {
+    "nss", FILE_HASH_MD5, FileHashNssSupported, FileHashNssNewMd5,
+    FileHashNssUpdate, FileHashNssFinal, FileHashNssFree };
+static const FileHashEngine file_hash_nss_sha1 = {
+    "nss", FILE_HASH_SHA1, FileHashNssSupported, FileHashNssNewSha1,
+    FileHashNssUpdate, FileHashNssFinal, FileHashNssFree };
+static const FileHashEngine file_hash_nss_sha256 = {
+    "nss", FILE_HASH_SHA256, FileHashNssSupported, FileHashNssNewSha256,
+    FileHashNssUpdate, FileHashNssFinal, FileHashNssFree };
+
+/* SHA-NI engines */
+
+#if defined(__x86_64__) && ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#define HAVE_FILE_HASH_SHANI 1
+#endif
+
+#ifdef HAVE_FILE_HASH_SHANI
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+/* the round loops need to be unrolled to keep the schedule in registers */
+#if defined(__clang__)
+#define SHANI_UNROLL _Pragma("unroll")
+#elif __GNUC__ >= 8
+#define SHANI_UNROLL _Pragma("GCC unroll 20")
+#else
+#define SHANI_UNROLL
+#endif
+
+/** \brief state of the SHA-NI engines. Input is only copied to buf if
+ *         it doesn't fill a block. */
+typedef struct FileHashShani_ {
+    uint32_t state[8];
+    uint64_t len;           /**< total input in bytes */
+    uint8_t buf[64];
+    uint32_t buf_len;
+    void (*Blocks)(uint32_t *, const uint8_t *, uint32_t);
+} FileHashShani;
+
+static int FileHashShaniSupported(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return 0;
+
+    __cpuid(1, eax, ebx, ecx, edx);
+    if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1))
+        return 0;
+
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    /* SHA extensions */
+    if (!(ebx & (1 << 29)))
+        return 0;
+    return 1;
+}
+
+static const uint32_t sha256_k[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/**
+ * \brief SHA256 compression of nblocks 64 byte blocks.
+ *
+ * The message schedule is kept in 4 registers of 4 words each, every
+ * iteration does 4 rounds and calculates the next 4 words.
+ */
+static SHANI_TARGET void FileHashSha256Blocks(uint32_t *state, const uint8_t *data,
+                                              uint32_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i msg[4];
+    __m128i st0, st1, tmp, m;
+
+    /* state is kept as ABEF and CDGH */
+    tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+    st1 = _mm_loadu_si128((const __m128i *)&state[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    st1 = _mm_shuffle_epi32(st1, 0x1B);
+    st0 = _mm_alignr_epi8(tmp, st1, 8);
+    st1 = _mm_blend_epi16(st1, tmp, 0xF0);
+
+    while (nblocks--) {
+        __m128i abef = st0;
+        __m128i cdgh = st1;
+        int i;
+
+        SHANI_UNROLL
+        for (i = 0; i < 16; i++) {
+            if (i < 4) {
+                msg[i] = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)(data + i * 16)), mask);
+            } else {
+                /* W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16] */
+                tmp = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+                tmp = _mm_add_epi32(tmp,
+                        _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                msg[i & 3] = _mm_sha256msg2_epu32(tmp, msg[(i + 3) & 3]);
+            }
+
+            m = _mm_add_epi32(msg[i & 3],
+                    _mm_load_si128((const __m128i *)&sha256_k[i * 4]));
+            st1 = _mm_sha256rnds2_epu32(st1, st0, m);
+            m = _mm_shuffle_epi32(m, 0x0E);
+            st0 = _mm_sha256rnds2_epu32(st0, st1, m);
+        }
+
+        st0 = _mm_add_epi32(st0, abef);
+        st1 = _mm_add_epi32(st1, cdgh);
+        data += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(st0, 0x1B);
+    st1 = _mm_shuffle_epi32(st1, 0xB1);
+    st0 = _mm_blend_epi16(tmp, st1, 0xF0);
+    st1 = _mm_alignr_epi8(st1, tmp, 8);
+    _mm_storeu_si128((__m128i *)&state[0], st0);
+    _mm_storeu_si128((__m128i *)&state[4], st1);
+}
+
+/**
+ * \brief SHA1 compression of nblocks 64 byte blocks.
+ *
+ * Every iteration does 4 rounds, the message schedule is kept in 4
+ * registers that are updated in the iterations after they are used.
+ */
+static SHANI_TARGET void FileHashSha1Blocks(uint32_t *state, const uint8_t *data,
+                                            uint32_t nblocks)
+{
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+    __m128i msg[4];
+    __m128i abcd, e[2];
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    e[0] = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+    while (nblocks--) {
+        __m128i abcd_save = abcd;
+        __m128i e_save = e[0];
+        int i;
+
+        SHANI_UNROLL
+        for (i = 0; i < 20; i++) {
+            __m128i *ecur = &e[i & 1];
+
+            if (i < 4) {
+                msg[i] = _mm_shuffle_epi8(
+                        _mm_loadu_si128((const __m128i *)(data + i * 16)), mask);
+            }
+
+            if (i == 0)
+                *ecur = _mm_add_epi32(*ecur, msg[0]);
+            else
+                *ecur = _mm_sha1nexte_epu32(*ecur, msg[i & 3]);
+            e[(i + 1) & 1] = abcd;
+
+            if (i >= 3 && i <= 18)
+                msg[(i + 1) & 3] = _mm_sha1msg2_epu32(msg[(i + 1) & 3], msg[i & 3]);
+
+            switch (i / 5) {
+                case 0: abcd = _mm_sha1rnds4_epu32(abcd, *ecur, 0); break;
+                case 1: abcd = _mm_sha1rnds4_epu32(abcd, *ecur, 1); break;
+                case 2: abcd = _mm_sha1rnds4_epu32(abcd, *ecur, 2); break;
+                default: abcd = _mm_sha1rnds4_epu32(abcd, *ecur, 3); break;
+            }
+
+            if (i >= 1 && i <= 16)
+                msg[(i + 3) & 3] = _mm_sha1msg1_epu32(msg[(i + 3) & 3], msg[i & 3]);
+            if (i >= 2 && i <= 17)
+                msg[(i + 2) & 3] = _mm_xor_si128(msg[(i + 2) & 3], msg[i & 3]);
+        }
+
+        e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+        data += 64;
+    }
+
+    abcd = _mm_shuffle_epi32(abcd, 0x1B);
+    _mm_storeu_si128((__m128i *)state, abcd);
+    state[4] = (uint32_t)_mm_extract_epi32(e[0], 3);
+}
+
+static void *FileHashShaniNew(void (*Blocks)(uint32_t *, const uint8_t *, uint32_t),
+                              const uint32_t *iv, int iv_len)
+{
+    FileHashShani *ctx = SCMalloc(sizeof(FileHashShani));
+    if (unlikely(ctx == NULL))
+        return NULL;
+    memset(ctx, 0x00, sizeof(FileHashShani));
+    memcpy(ctx->state, iv, iv_len * sizeof(uint32_t));
+    ctx->Blocks = Blocks;
+    return ctx;
+}
+
+static void *FileHashShaniNewSha1(void)
+{
+    static const uint32_t iv[5] = {
+        0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+    return FileHashShaniNew(FileHashSha1Blocks, iv, 5);
+}
+
+static void *FileHashShaniNewSha256(void)
+{
+    static const uint32_t iv[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+        0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    return FileHashShaniNew(FileHashSha256Blocks, iv, 8);
+}
+
+static void FileHashShaniUpdate(void *data, const uint8_t *buf, uint32_t len)
+{
+    FileHashShani *ctx = (FileHashShani *)data;
+
+    ctx->len += len;
+
+    if (ctx->buf_len > 0) {
+        uint32_t n = 64 - ctx->buf_len;
+        if (n > len)
+            n = len;
+        memcpy(ctx->buf + ctx->buf_len, buf, n);
+        ctx->buf_len += n;
+        buf += n;
+        len -= n;
+
+        if (ctx->buf_len < 64)
+            return;
+        ctx->Blocks(ctx->state, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+
+    /* full blocks are hashed straight from the input */
+    if (len >= 64) {
+        ctx->Blocks(ctx->state, buf, len / 64);
+        buf += len & ~63U;
+        len &= 63;
+    }
+
+    if (len > 0) {
+        memcpy(ctx->buf, buf, len);
+        ctx->buf_len = len;
+    }
+}
+
+static void FileHashShaniFinal(void *data, uint8_t *digest, int words)
+{
+    FileHashShani *ctx = (FileHashShani *)data;
+    uint64_t bits = ctx->len * 8;
+    int i;
+
+    /* pad with 0x80, zeros and the big endian length in bits */
+    ctx->buf[ctx->buf_len++] = 0x80;
+    if (ctx->buf_len > 56) {
+        memset(ctx->buf + ctx->buf_len, 0x00, 64 - ctx->buf_len);
+        ctx->Blocks(ctx->state, ctx->buf, 1);
+        ctx->buf_len = 0;
+    }
+    memset(ctx->buf + ctx->buf_len, 0x00, 56 - ctx->buf_len);
+    for (i = 0; i < 8; i++) {
+        ctx->buf[63 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    ctx->Blocks(ctx->state, ctx->buf, 1);
+
+    for (i = 0; i < words; i++) {
+        digest[i * 4] = (uint8_t)(ctx->state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(ctx->state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(ctx->state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)ctx->state[i];
+    }
+}
+
+static void FileHashShaniFinalSha1(void *data, uint8_t *digest)
+{
+    FileHashShaniFinal(data, digest, 5);
+}
+
+static void FileHashShaniFinalSha256(void *data, uint8_t *digest)
+{
+    FileHashShaniFinal(data, digest, 8);
+}
+
+static void FileHashShaniFree(void *data)
+{
+    SCFree(data);
+}
+
+static const FileHashEngine file_hash_shani_sha1 = {
+    "sha-ni", FILE_HASH_SHA1, FileHashShaniSupported, FileHashShaniNewSha1,
+    FileHashShaniUpdate, FileHashShaniFinalSha1, FileHashShaniFree };
+static const FileHashEngine file_hash_shani_sha256 = {
+    "sha-ni", FILE_HASH_SHA256, FileHashShaniSupported, FileHashShaniNewSha256,
+    FileHashShaniUpdate, FileHashShaniFinalSha256, FileHashShaniFree };
+
+#endif /* HAVE_FILE_HASH_SHANI */
+
+/** engines per algorithm, in order of preference */
+static const FileHashEngine *file_hash_md5_engines[] = {
+    &file_hash_nss_md5, NULL };
+static const FileHashEngine *file_hash_sha1_engines[] = {
+#ifdef HAVE_FILE_HASH_SHANI
+    &file_hash_shani_sha1,
+#endif
+    &file_hash_nss_sha1, NULL };
+static const FileHashEngine *file_hash_sha256_engines[] = {
+#ifdef HAVE_FILE_HASH_SHANI
+    &file_hash_shani_sha256,
+#endif
+    &file_hash_nss_sha256, NULL };
+
+static const FileHashEngine **file_hash_engines[FILE_HASH_MAX] = {
+    file_hash_md5_engines, file_hash_sha1_engines, file_hash_sha256_engines };
+
+/** engine used per algorithm, the last in the list until FileHashSetup
+ *  selected one */
+static const FileHashEngine *file_hash_engine[FILE_HASH_MAX] = {
+    &file_hash_nss_md5, &file_hash_nss_sha1, &file_hash_nss_sha256 };
+
+/**
+ * \brief Select the preferred engine the system supports for each
+ *        algorithm.
+ */
+void FileHashSetup(void)
+{
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        const FileHashEngine **e;
+        for (e = file_hash_engines[alg]; *e != NULL; e++) {
+            if ((*e)->Supported()) {
+                file_hash_engine[alg] = *e;
+                break;
+            }
+        }
+        SCLogDebug("%s: using the %s engine", file_hash_names[alg],
+                   file_hash_engine[alg]->name);
+    }
+
+    SCLogInfo("file hashing: md5 using %s, sha1 using %s, sha256 using %s",
+              file_hash_engine[FILE_HASH_MD5]->name,
+              file_hash_engine[FILE_HASH_SHA1]->name,
+              file_hash_engine[FILE_HASH_SHA256]->name);
+}
+
+/**
+ * \brief Start hashing a file.
+ *
+ * \param algs FILE_HASH_FLAG mask of the algorithms to calculate
+ *
+ * \retval ctx hash state or NULL if no algorithm was requested or on
+ *         error
+ */
+FileHashCtx *FileHashCtxNew(uint32_t algs)
+{
+    if (algs == 0)
+        return NULL;
+
+    FileHashCtx *hctx = SCMalloc(sizeof(FileHashCtx));
+    if (unlikely(hctx == NULL))
+        return NULL;
+    memset(hctx, 0x00, sizeof(FileHashCtx));
+
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        if (!(algs & FILE_HASH_FLAG(alg)))
+            continue;
+
+        const FileHashEngine *e = file_hash_engine[alg];
+        hctx->ctx[alg] = e->New();
+        if (hctx->ctx[alg] == NULL) {
+            FileHashCtxFree(hctx);
+            return NULL;
+        }
+        hctx->engine[alg] = e;
+        hctx->algs |= FILE_HASH_FLAG(alg);
+    }
+    return hctx;
+}
+
+void FileHashCtxUpdate(FileHashCtx *hctx, const uint8_t *data, uint32_t len)
+{
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        if (hctx->ctx[alg] != NULL)
+            hctx->engine[alg]->Update(hctx->ctx[alg], data, len);
+    }
+}
+
+/**
+ * \brief Get the digest of an algorithm. Must be called once per
+ *        algorithm, after all data was added.
+ *
+ * \param digest buffer of at least FileHashLen(alg) bytes
+ *
+ * \retval 1 digest written, 0 if the algorithm wasn't calculated
+ */
+int FileHashCtxFinal(FileHashCtx *hctx, FileHashAlg alg, uint8_t *digest)
+{
+    uint8_t buf[FILE_HASH_MAX_LEN];
+
+    if (hctx == NULL || hctx->ctx[alg] == NULL)
+        return 0;
+
+    hctx->engine[alg]->Final(hctx->ctx[alg], buf);
+    memcpy(digest, buf, file_hash_len[alg]);
+    return 1;
+}
+
+void FileHashCtxFree(FileHashCtx *hctx)
+{
+    if (hctx == NULL)
+        return;
+
+    int alg;
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        if (hctx->ctx[alg] != NULL)
+            hctx->engine[alg]->Free(hctx->ctx[alg]);
+    }
+    SCFree(hctx);
+}
+
+#ifdef UNITTESTS
+
+static int FileHashTestDigest(const FileHashEngine *e, const uint8_t *data,
+                              uint32_t len, uint32_t chunk, uint8_t *digest)
+{
+    void *ctx = e->New();
+    if (ctx == NULL)
+        return 0;
+
+    uint32_t off = 0;
+    while (off < len) {
+        uint32_t n = (len - off < chunk) ? len - off : chunk;
+        e->Update(ctx, data + off, n);
+        off += n;
+    }
+    e->Final(ctx, digest);
+    e->Free(ctx);
+    return 1;
+}
+
+/**
+ * \test known answers for all supported engines, with the input split
+ *       in chunks that don't line up with the block size
+ */
+static int FileHashTest01(void)
+{
+    static const char *abc = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    static const uint8_t expect[FILE_HASH_MAX][FILE_HASH_MAX_LEN] = {
+        { 0x82, 0x15, 0xef, 0x07, 0x96, 0xa2, 0x0b, 0xca,
+          0xaa, 0xe1, 0x16, 0xd3, 0x87, 0x6c, 0x66, 0x4a },
+        { 0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e,
+          0xba, 0xae, 0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5,
+          0xe5, 0x46, 0x70, 0xf1 },
+        { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+          0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+          0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+          0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 },
+    };
+    static const uint32_t chunks[] = { 1, 7, 56, 64, 1000 };
+    uint8_t digest[FILE_HASH_MAX_LEN];
+    int alg;
+
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        const FileHashEngine **e;
+        for (e = file_hash_engines[alg]; *e != NULL; e++) {
+            if (!(*e)->Supported())
+                continue;
+
+            size_t c;
+            for (c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+                if (!FileHashTestDigest(*e, (const uint8_t *)abc, strlen(abc),
+                                        chunks[c], digest))
+                    return 0;
+                if (memcmp(digest, expect[alg], file_hash_len[alg]) != 0) {
+                    printf("%s/%s chunk %u mismatch: ", file_hash_names[alg],
+                           (*e)->name, chunks[c]);
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * \test all engines of an algorithm agree on input of all lengths up to
+ *       a few blocks, so the padding is exercised
+ */
+static int FileHashTest02(void)
+{
+    uint8_t data[300];
+    uint8_t ref[FILE_HASH_MAX_LEN];
+    uint8_t digest[FILE_HASH_MAX_LEN];
+    uint32_t len;
+    int alg;
+
+    for (len = 0; len < sizeof(data); len++)
+        data[len] = (uint8_t)(len * 7 + 3);
+
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        for (len = 0; len <= sizeof(data); len++) {
+            const FileHashEngine **e = file_hash_engines[alg];
+            if (!FileHashTestDigest(*e, data, len, 13, ref))
+                return 0;
+            for (e++; *e != NULL; e++) {
+                if (!(*e)->Supported())
+                    continue;
+                if (!FileHashTestDigest(*e, data, len, 13, digest))
+                    return 0;
+                if (memcmp(digest, ref, file_hash_len[alg]) != 0) {
+                    printf("%s/%s len %u mismatch: ", file_hash_names[alg],
+                           (*e)->name, len);
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+#ifdef PROFILING
+/**
+ * \test throughput of all supported engines, hashing 64 MB in 16 kB
+ *       chunks. Reported in GB/s. Only built with profiling.
+ */
+static int FileHashTestBenchmark(void)
+{
+    uint32_t size = 64 * 1024 * 1024;
+    uint32_t chunk = 16 * 1024;
+    uint8_t digest[FILE_HASH_MAX_LEN];
+    int alg;
+
+    uint8_t *data = SCMalloc(size);
+    if (unlikely(data == NULL))
+        return 0;
+    memset(data, 0x5a, size);
+
+    for (alg = 0; alg < FILE_HASH_MAX; alg++) {
+        const FileHashEngine **e;
+        for (e = file_hash_engines[alg]; *e != NULL; e++) {
+            if (!(*e)->Supported())
+                continue;
+
+            struct timeval start, end;
+            gettimeofday(&start, NULL);
+            if (!FileHashTestDigest(*e, data, size, chunk, digest)) {
+                SCFree(data);
+                return 0;
+            }
+            gettimeofday(&end, NULL);
+
+            double secs = (end.tv_sec - start.tv_sec) +
+                          (end.tv_usec - start.tv_usec) / 1000000.0;
+            if (secs <= 0)
+                secs = 0.000001;
+            SCLogInfo("%s/%s: %.2f GB/s", file_hash_names[alg], (*e)->name,
+                      (double)size / secs / 1000000000.0);
+        }
+    }
+
+    SCFree(data);
+    return 1;
+}
+#endif /* PROFILING */
+
+#endif /* UNITTESTS */
+
+#else /* HAVE_NSS */
+
+void FileHashSetup(void)
+{
+}
+
+FileHashCtx *FileHashCtxNew(uint32_t algs)
+{
+    return NULL;
+}
+
+void FileHashCtxUpdate(FileHashCtx *hctx, const uint8_t *data, uint32_t len)
+{
+}
+
+int FileHashCtxFinal(FileHashCtx *hctx, FileHashAlg alg, uint8_t *digest)
+{
+    return 0;
+}
+
+void FileHashCtxFree(FileHashCtx *hctx)
+{
+}
+
+#endif /* HAVE_NSS */
+
+void FileHashRegisterTests(void)
+{
+#if defined(UNITTESTS) && defined(HAVE_NSS)
+    UtRegisterTest("FileHashTest01", FileHashTest01, 1);
+    UtRegisterTest("FileHashTest02", FileHashTest02, 1);
+#ifdef PROFILING
+    UtRegisterTest("FileHashTestBenchmark", FileHashTestBenchmark, 1);
+#endif
+#endif
+}
@@ -0,0 +1,78 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Incremental MD5/SHA1/SHA256 calculation for tracked files.
+ */
+
+#ifndef __UTIL_FILE_HASH_H__
+#define __UTIL_FILE_HASH_H__
+
+typedef enum FileHashAlg_ {
+    FILE_HASH_MD5 = 0,
+    FILE_HASH_SHA1,
+    FILE_HASH_SHA256,
+    FILE_HASH_MAX
+} FileHashAlg;
+
+#define FILE_HASH_FLAG(alg)     (1 << (alg))
+
+/** longest digest, SHA256 */
+#define FILE_HASH_MAX_LEN       32
+
+/**
+ * \brief Implementation of a hash algorithm. The data is passed to Update
+ *        as it arrives, implementations only keep their internal state.
+ */
+typedef struct FileHashEngine_ {
+    const char *name;
+    FileHashAlg alg;
+
+    /** returns 1 if the engine can be used on this system */
+    int (*Supported)(void);
+
+    void *(*New)(void);
+    void (*Update)(void *, const uint8_t *, uint32_t);
+    /** write out the digest, the ctx can't be updated afterwards */
+    void (*Final)(void *, uint8_t *);
+    void (*Free)(void *);
+} FileHashEngine;
+
+/** \brief hash state of a single file */
+typedef struct FileHashCtx_ {
+    uint32_t algs;                      /**< FILE_HASH_FLAG mask */
+    const FileHashEngine *engine[FILE_HASH_MAX];
+    void *ctx[FILE_HASH_MAX];
+} FileHashCtx;
+
+void FileHashSetup(void);
+void FileHashEnable(FileHashAlg);
+uint32_t FileHashEnabled(void);
+uint32_t FileHashLen(FileHashAlg);
+const char *FileHashName(FileHashAlg);
+int FileHashParseName(const char *);
+
+FileHashCtx *FileHashCtxNew(uint32_t);
+void FileHashCtxUpdate(FileHashCtx *, const uint8_t *, uint32_t);
+int FileHashCtxFinal(FileHashCtx *, FileHashAlg, uint8_t *);
+void FileHashCtxFree(FileHashCtx *);
+
+void FileHashRegisterTests(void);
+
+#endif /* __UTIL_FILE_HASH_H__ */
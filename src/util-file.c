@@ -40,10 +40,10 @@
  */
 static int g_file_force_magic = 0;
 
-/** \brief switch to force md5 calculation on all files
+/** \brief switch to force hash calculation on all files
  *         regardless of the rules.
  */
-static int g_file_force_md5 = 0;
+static int g_file_force_hash = 0;
 
 /** \brief switch to force tracking off all files
  *         regardless of the rules.
@@ -59,15 +59,57 @@ void FileForceMagicEnable(void) {
 }
 
 void FileForceMd5Enable(void) {
-    g_file_force_md5 = 1;
+    FileForceHashEnable(FILE_HASH_MD5);
+}
+
+/**
+ *  \brief calculate a hash for all files regardless of the rules
+ */
+void FileForceHashEnable(FileHashAlg alg) {
+    g_file_force_hash = 1;
+    FileHashEnable(alg);
 }
 
 int FileForceMagic(void) {
     return g_file_force_magic;
 }
 
-int FileForceMd5(void) {
-    return g_file_force_md5;
+int FileForceHash(void) {
+    return g_file_force_hash;
+}
+
+/**
+ *  \brief Parse the force-hash list of an output, e.g.
+ *
+ *    force-hash: [sha1, sha256]
+ *
+ *  \param conf output configuration node
+ *  \param name output name for log messages
+ *
+ *  \retval 0 ok, -1 on an unknown algorithm
+ */
+int FileForceHashParseConfig(ConfNode *conf, const char *name) {
+    ConfNode *node = ConfNodeLookupChild(conf, "force-hash");
+    if (node == NULL)
+        return 0;
+
+    ConfNode *child;
+    TAILQ_FOREACH(child, &node->head, next) {
+        int alg = FileHashParseName(child->val);
+        if (alg < 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: unknown "
+                    "force-hash algorithm \"%s\", expected md5, sha1 or "
+                    "sha256", name, child->val);
+            return -1;
+        }
+#ifdef HAVE_NSS
+        FileForceHashEnable(alg);
+        SCLogInfo("%s: forcing %s calculation for all files", name, child->val);
+#else
+        SCLogInfo("%s calculation requires linking against libnss", child->val);
+#endif
+    }
+    return 0;
 }
 
 void FileForceTrackingEnable(void) {
@@ -101,8 +143,8 @@ static int FileAppendFileDataFilePtr(File *ff, FileData *ffd) {
 #endif
 
 #ifdef HAVE_NSS
-    if (ff->md5_ctx)
-        HASH_Update(ff->md5_ctx, ffd->data, ffd->len);
+    if (ff->hash_ctx)
+        FileHashCtxUpdate(ff->hash_ctx, ffd->data, ffd->len);
 #endif
     SCReturnInt(0);
 }
@@ -326,8 +368,8 @@ static void FileFree(File *ff) {
     }
 
 #ifdef HAVE_NSS
-    if (ff->md5_ctx)
-        HASH_Destroy(ff->md5_ctx);
+    if (ff->hash_ctx)
+        FileHashCtxFree(ff->hash_ctx);
 #endif
     SCLogDebug("ff chunks_cnt %"PRIu64", chunks_cnt_max %"PRIu64,
             ff->chunks_cnt, ff->chunks_cnt_max);
@@ -423,10 +465,9 @@ int FileAppendData(FileContainer *ffc, uint8_t *data, uint32_t data_len) {
 
     if (FileStoreNoStoreCheck(ffc->tail) == 1) {
 #ifdef HAVE_NSS
-        /* no storage but forced md5 */
-        if (ffc->tail->md5_ctx) {
-            if (ffc->tail->md5_ctx)
-                HASH_Update(ffc->tail->md5_ctx, data, data_len);
+        /* no storage but forced hashing */
+        if (ffc->tail->hash_ctx) {
+            FileHashCtxUpdate(ffc->tail->hash_ctx, data, data_len);
 
             SCReturnInt(0);
         }
@@ -498,11 +539,13 @@ File *FileOpenFile(FileContainer *ffc, uint8_t *name,
     }
 
 #ifdef HAVE_NSS
-    if (!(ff->flags & FILE_NOMD5) || g_file_force_md5) {
-        ff->md5_ctx = HASH_Create(HASH_AlgMD5);
-        if (ff->md5_ctx != NULL) {
-            HASH_Begin(ff->md5_ctx);
-        }
+    if (!(ff->flags & FILE_NOMD5) || g_file_force_hash) {
+        /* calculate the hashes the rules and outputs need, md5 if
+         * nothing registered its need */
+        uint32_t algs = FileHashEnabled();
+        if (algs == 0)
+            algs = FILE_HASH_FLAG(FILE_HASH_MD5);
+        ff->hash_ctx = FileHashCtxNew(algs);
     }
 #endif
 
@@ -554,9 +597,9 @@ static int FileCloseFilePtr(File *ff, uint8_t *data,
 
         if (ff->flags & FILE_NOSTORE) {
 #ifdef HAVE_NSS
-            /* no storage but md5 */
-            if (ff->md5_ctx)
-                HASH_Update(ff->md5_ctx, data, data_len);
+            /* no storage but hashing */
+            if (ff->hash_ctx)
+                FileHashCtxUpdate(ff->hash_ctx, data, data_len);
 #endif
         } else {
             FileData *ffd = FileDataAlloc(data, data_len);
@@ -587,10 +630,13 @@ static int FileCloseFilePtr(File *ff, uint8_t *data,
         SCLogDebug("flowfile state transitioned to FILE_STATE_CLOSED");
 
 #ifdef HAVE_NSS
-        if (ff->md5_ctx) {
-            unsigned int len = 0;
-            HASH_End(ff->md5_ctx, ff->md5, &len, sizeof(ff->md5));
-            ff->flags |= FILE_MD5;
+        if (ff->hash_ctx) {
+            if (FileHashCtxFinal(ff->hash_ctx, FILE_HASH_MD5, ff->md5))
+                ff->flags |= FILE_MD5;
+            if (FileHashCtxFinal(ff->hash_ctx, FILE_HASH_SHA1, ff->sha1))
+                ff->flags |= FILE_SHA1;
+            if (FileHashCtxFinal(ff->hash_ctx, FILE_HASH_SHA256, ff->sha256))
+                ff->flags |= FILE_SHA256;
         }
 #endif
     }
@@ -687,7 +733,7 @@ void FileDisableMagic(Flow *f, uint8_t direction) {
 }
 
 /**
- *  \brief disable file md5 calc for this flow
+ *  \brief disable file md5/sha1/sha256 calc for this flow
  *
  *  \param f *LOCKED* flow
  *  \param direction flow direction
@@ -713,9 +759,9 @@ void FileDisableMd5(Flow *f, uint8_t direction) {
 
 #ifdef HAVE_NSS
             /* destroy any ctx we may have so far */
-            if (ptr->md5_ctx != NULL) {
-                HASH_Destroy(ptr->md5_ctx);
-                ptr->md5_ctx = NULL;
+            if (ptr->hash_ctx != NULL) {
+                FileHashCtxFree(ptr->hash_ctx);
+                ptr->hash_ctx = NULL;
             }
 #endif
         }
@@ -29,6 +29,9 @@
 #include <sechash.h>
 #endif
 
+#include "conf.h"
+#include "util-file-hash.h"
+
 #define FILE_TRUNCATED  0x0001
 #define FILE_NOMAGIC    0x0002
 #define FILE_NOMD5      0x0004
@@ -38,6 +41,9 @@
 #define FILE_STORE      0x0040
 #define FILE_STORED     0x0080
 #define FILE_NOTRACK    0x0100 /**< track size of file */
+#define FILE_EVE_LOGGED 0x0200 /**< logged by the eve-log output */
+#define FILE_SHA1       0x0400
+#define FILE_SHA256     0x0800
 
 typedef enum FileState_ {
     FILE_STATE_NONE = 0,    /**< no state */
@@ -71,8 +77,10 @@ typedef struct File_ {
     FileData *chunks_tail;
     struct File_ *next;
 #ifdef HAVE_NSS
-    HASHContext *md5_ctx;
+    FileHashCtx *hash_ctx;
     uint8_t md5[MD5_LENGTH];
+    uint8_t sha1[SHA1_LENGTH];
+    uint8_t sha256[SHA256_LENGTH];
 #endif
 #ifdef DEBUG
     uint64_t chunks_cnt;
@@ -176,7 +184,9 @@ int FileForceMagic(void);
 
 void FileDisableMd5(Flow *f, uint8_t);
 void FileForceMd5Enable(void);
-int FileForceMd5(void);
+void FileForceHashEnable(FileHashAlg);
+int FileForceHash(void);
+int FileForceHashParseConfig(ConfNode *, const char *);
 
 void FileForceTrackingEnable(void);
 
@@ -0,0 +1,112 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * FTP helpers shared by the ftp parser and the ftpbounce keyword.
+ */
+
+#include "suricata-common.h"
+#include "util-ftp.h"
+#include "util-byte.h"
+#include "util-debug.h"
+
+/**
+ * \brief Check if the address in the arguments of a PORT command is
+ *        different from the client address (ftp bounce).
+ *
+ * \param payload Payload of the PORT command
+ * \param payload_len Length of the payload
+ * \param ip_orig IP source to check the ftpbounce condition
+ * \param offset offset to the arguments of the PORT command
+ *
+ * \retval 1 if ftpbounce detected, 0 if not
+ */
+int FtpPortArgsBounce(uint8_t *payload, uint16_t payload_len,
+                      uint32_t ip_orig, uint16_t offset)
+{
+    SCEnter();
+    SCLogDebug("Checking ftpbounce condition");
+    char *c = NULL;
+    uint16_t i = 0;
+    int octet = 0;
+    int octet_ascii_len = 0;
+    int noctet = 0;
+    uint32_t ip = 0;
+    /* PrintRawDataFp(stdout, payload, payload_len); */
+
+    if (payload_len < 7) {
+        /* we need at least a differet ip address
+         * in the format 1,2,3,4,x,y where x,y is the port
+         * in two byte representation so let's look at
+         * least for the IP octets in comma separated */
+        return 0;
+    }
+
+    if (offset + 7 >= payload_len)
+        return 0;
+
+    c =(char*) payload;
+    if (c == NULL) {
+        SCLogDebug("No payload to check");
+        return 0;
+    }
+
+    i = offset;
+    /* Search for the first IP octect(Skips "PORT ") */
+    while (i < payload_len && !isdigit((unsigned char)c[i])) i++;
+
+    for (;i < payload_len && octet_ascii_len < 4 ;i++) {
+        if (isdigit((unsigned char)c[i])) {
+            octet =(c[i] - '0') + octet * 10;
+            octet_ascii_len++;
+        } else {
+            if (octet > 256) {
+                SCLogDebug("Octet not in ip format");
+                return 0;
+            }
+
+            if (isspace((unsigned char)c[i]))
+                while (i < payload_len && isspace((unsigned char)c[i]) ) i++;
+
+            if (i < payload_len && c[i] == ',') { /* we have an octet */
+                noctet++;
+                octet_ascii_len = 0;
+                ip =(ip << 8) + octet;
+                octet = 0;
+            } else {
+                SCLogDebug("Unrecognized character '%c'", c[i]);
+                return 0;
+            }
+            if (noctet == 4) {
+                /* Different IP than src, ftp bounce scan */
+                ip = SCByteSwap32(ip);
+
+                if (ip != ip_orig) {
+                    SCLogDebug("Different ip, so Matched ip:%d <-> ip_orig:%d",
+                               ip, ip_orig);
+                    return 1;
+                }
+                SCLogDebug("Same ip, so no match here");
+                return 0;
+            }
+        }
+    }
+    SCLogDebug("No match");
+    return 0;
+}
@@ -0,0 +1,421 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming JSON serializer writing into a caller supplied buffer.
+ *
+ * Used by the output modules to build one record per event without
+ * allocating or building a document tree. Strings are escaped so that
+ * the output is always valid JSON: control characters and bytes outside
+ * of printable ASCII are written as \\u00XX escapes.
+ *
+ * Usage:
+ *
+ *   SCJsonInit(&js, buf, sizeof(buf));
+ *   SCJsonOpenObject(&js, NULL);
+ *   SCJsonAddString(&js, "event_type", "alert");
+ *   SCJsonOpenObject(&js, "alert");
+ *   SCJsonAddUint(&js, "sid", 1);
+ *   SCJsonCloseObject(&js);
+ *   SCJsonCloseObject(&js);
+ *   len = SCJsonFinish(&js);
+ */
+
+#include "suricata-common.h"
+#include "util-json.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+
+/** bytes that can be copied as is, anything else needs escaping */
+static const uint8_t json_plain[256] = {
+    /* 0x00 - 0x1f: control characters */
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    /* 0x20 - 0x7f, except '"', '\\' and DEL */
+    1,1,0,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,0,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,0,
+    /* 0x80 - 0xff are left 0 */
+};
+
+static const char json_hex[] = "0123456789abcdef";
+
+/**
+ * \brief Set up a serializer for a new record.
+ *
+ * \param buf output buffer, must outlive the serializer
+ * \param size size of buf
+ */
+void SCJsonInit(SCJson *js, char *buf, uint32_t size)
+{
+    js->buf = buf;
+    js->size = size;
+    SCJsonReset(js);
+}
+
+/** \brief discard the current record and start a new one */
+void SCJsonReset(SCJson *js)
+{
+    js->offset = 0;
+    js->depth = 0;
+    js->truncated = 0;
+    js->need_comma = 0;
+}
+
+/** \internal
+ *  \brief append raw bytes, one byte is kept free for the newline
+ *         added by SCJsonFinish() */
+static inline void SCJsonPut(SCJson *js, const char *data, uint32_t len)
+{
+    if (unlikely(js->truncated))
+        return;
+
+    if (unlikely(js->size - js->offset <= len)) {
+        js->truncated = 1;
+        return;
+    }
+
+    memcpy(js->buf + js->offset, data, len);
+    js->offset += len;
+}
+
+static inline void SCJsonPutChar(SCJson *js, char c)
+{
+    SCJsonPut(js, &c, 1);
+}
+
+/** \internal
+ *  \brief append a buffer as the contents of a JSON string */
+static void SCJsonPutEscaped(SCJson *js, const uint8_t *data, uint32_t len)
+{
+    uint32_t u = 0;
+
+    while (u < len) {
+        /* copy runs of plain bytes in one go */
+        uint32_t start = u;
+        while (u < len && json_plain[data[u]])
+            u++;
+        if (u > start)
+            SCJsonPut(js, (const char *)data + start, u - start);
+        if (u == len)
+            break;
+
+        char esc[6] = { '\\', 'u', '0', '0', 0, 0 };
+        uint8_t c = data[u];
+        switch (c) {
+            case '"':
+                SCJsonPut(js, "\\\"", 2);
+                break;
+            case '\\':
+                SCJsonPut(js, "\\\\", 2);
+                break;
+            case '\n':
+                SCJsonPut(js, "\\n", 2);
+                break;
+            case '\r':
+                SCJsonPut(js, "\\r", 2);
+                break;
+            case '\t':
+                SCJsonPut(js, "\\t", 2);
+                break;
+            default:
+                esc[4] = json_hex[c >> 4];
+                esc[5] = json_hex[c & 0x0f];
+                SCJsonPut(js, esc, sizeof(esc));
+                break;
+        }
+        u++;
+    }
+}
+
+/** \internal
+ *  \brief write the separator and the key of a new member
+ *
+ *  \param key member name, NULL for array elements and the top level
+ */
+static void SCJsonPutKey(SCJson *js, const char *key)
+{
+    uint32_t bit = 1U << js->depth;
+
+    if (js->need_comma & bit)
+        SCJsonPutChar(js, ',');
+    js->need_comma |= bit;
+
+    if (key != NULL) {
+        SCJsonPutChar(js, '"');
+        SCJsonPutEscaped(js, (const uint8_t *)key, strlen(key));
+        SCJsonPut(js, "\":", 2);
+    }
+}
+
+static void SCJsonOpen(SCJson *js, const char *key, char c)
+{
+    SCJsonPutKey(js, key);
+    SCJsonPutChar(js, c);
+
+    if (unlikely(js->depth + 1 >= SC_JSON_MAX_DEPTH)) {
+        js->truncated = 1;
+        return;
+    }
+    js->depth++;
+    js->need_comma &= ~(1U << js->depth);
+}
+
+static void SCJsonClose(SCJson *js, char c)
+{
+    if (unlikely(js->depth == 0)) {
+        js->truncated = 1;
+        return;
+    }
+    js->depth--;
+    SCJsonPutChar(js, c);
+}
+
+/**
+ * \brief Open an object.
+ *
+ * \param key name of the object in the enclosing object, NULL at the top
+ *            level or inside an array
+ */
+void SCJsonOpenObject(SCJson *js, const char *key)
+{
+    SCJsonOpen(js, key, '{');
+}
+
+void SCJsonCloseObject(SCJson *js)
+{
+    SCJsonClose(js, '}');
+}
+
+void SCJsonOpenArray(SCJson *js, const char *key)
+{
+    SCJsonOpen(js, key, '[');
+}
+
+void SCJsonCloseArray(SCJson *js)
+{
+    SCJsonClose(js, ']');
+}
+
+/** \brief add a NUL terminated string member */
+void SCJsonAddString(SCJson *js, const char *key, const char *val)
+{
+    SCJsonAddStringN(js, key, (const uint8_t *)val, strlen(val));
+}
+
+/** \brief add a string member from a buffer that may contain any bytes */
+void SCJsonAddStringN(SCJson *js, const char *key, const uint8_t *val,
+                      uint32_t len)
+{
+    SCJsonPutKey(js, key);
+    SCJsonPutChar(js, '"');
+    SCJsonPutEscaped(js, val, len);
+    SCJsonPutChar(js, '"');
+}
+
+void SCJsonAddUint(SCJson *js, const char *key, uint64_t val)
+{
+    char num[20];
+    int i = sizeof(num);
+
+    do {
+        num[--i] = '0' + (char)(val % 10);
+        val /= 10;
+    } while (val != 0);
+
+    SCJsonPutKey(js, key);
+    SCJsonPut(js, num + i, sizeof(num) - i);
+}
+
+void SCJsonAddInt(SCJson *js, const char *key, int64_t val)
+{
+    if (val >= 0) {
+        SCJsonAddUint(js, key, (uint64_t)val);
+        return;
+    }
+
+    char num[20];
+    uint64_t uval = (uint64_t)0 - (uint64_t)val;
+    int i = sizeof(num);
+
+    do {
+        num[--i] = '0' + (char)(uval % 10);
+        uval /= 10;
+    } while (uval != 0);
+
+    SCJsonPutKey(js, key);
+    SCJsonPutChar(js, '-');
+    SCJsonPut(js, num + i, sizeof(num) - i);
+}
+
+void SCJsonAddBool(SCJson *js, const char *key, int val)
+{
+    SCJsonPutKey(js, key);
+    if (val)
+        SCJsonPut(js, "true", 4);
+    else
+        SCJsonPut(js, "false", 5);
+}
+
+/** \brief add a buffer as lowercase hex string, e.g. for checksums */
+void SCJsonAddHex(SCJson *js, const char *key, const uint8_t *val, uint32_t len)
+{
+    uint32_t u;
+
+    SCJsonPutKey(js, key);
+    SCJsonPutChar(js, '"');
+    for (u = 0; u < len; u++) {
+        char hex[2] = { json_hex[val[u] >> 4], json_hex[val[u] & 0x0f] };
+        SCJsonPut(js, hex, 2);
+    }
+    SCJsonPutChar(js, '"');
+}
+
+/**
+ * \brief add a member with a preformatted value
+ *
+ * The value is copied as is, it's up to the caller to make sure it's
+ * valid JSON, e.g. a cached quoted timestamp.
+ */
+void SCJsonAddRaw(SCJson *js, const char *key, const char *val, uint32_t len)
+{
+    SCJsonPutKey(js, key);
+    SCJsonPut(js, val, len);
+}
+
+/**
+ * \brief Terminate the record with a newline.
+ *
+ * \retval len length of the record including the newline
+ * \retval -1 the record didn't fit the buffer or objects were left open
+ */
+int SCJsonFinish(SCJson *js)
+{
+    if (js->truncated || js->depth != 0)
+        return -1;
+
+    /* SCJsonPut always leaves room for this */
+    js->buf[js->offset++] = '\n';
+    return (int)js->offset;
+}
+
+#ifdef UNITTESTS
+
+/** \test nesting and separators */
+static int SCJsonTest01(void)
+{
+    char buf[256];
+    SCJson js;
+    const char *expect = "{\"a\":1,\"b\":{\"c\":\"x\",\"d\":[1,-2,true]},"
+        "\"e\":false,\"f\":\"0aff\"}\n";
+
+    SCJsonInit(&js, buf, sizeof(buf));
+    SCJsonOpenObject(&js, NULL);
+    SCJsonAddUint(&js, "a", 1);
+    SCJsonOpenObject(&js, "b");
+    SCJsonAddString(&js, "c", "x");
+    SCJsonOpenArray(&js, "d");
+    SCJsonAddUint(&js, NULL, 1);
+    SCJsonAddInt(&js, NULL, -2);
+    SCJsonAddBool(&js, NULL, 1);
+    SCJsonCloseArray(&js);
+    SCJsonCloseObject(&js);
+    SCJsonAddBool(&js, "e", 0);
+    SCJsonAddHex(&js, "f", (uint8_t *)"\x0a\xff", 2);
+    SCJsonCloseObject(&js);
+
+    int len = SCJsonFinish(&js);
+    if (len != (int)strlen(expect)) {
+        printf("len %d, expected %d: ", len, (int)strlen(expect));
+        return 0;
+    }
+    if (memcmp(buf, expect, len) != 0) {
+        printf("got \"%.*s\": ", len, buf);
+        return 0;
+    }
+    return 1;
+}
+
+/** \test string escaping */
+static int SCJsonTest02(void)
+{
+    char buf[256];
+    SCJson js;
+    const uint8_t in[] = "a\"b\\c\n\x01\xe9/";
+    const char *expect = "{\"s\":\"a\\\"b\\\\c\\n\\u0001\\u00e9/\","
+        "\"n\":18446744073709551615,\"m\":-9223372036854775808}\n";
+
+    SCJsonInit(&js, buf, sizeof(buf));
+    SCJsonOpenObject(&js, NULL);
+    SCJsonAddStringN(&js, "s", in, sizeof(in) - 1);
+    SCJsonAddUint(&js, "n", UINT64_MAX);
+    SCJsonAddInt(&js, "m", INT64_MIN);
+    SCJsonCloseObject(&js);
+
+    int len = SCJsonFinish(&js);
+    if (len != (int)strlen(expect) || memcmp(buf, expect, len) != 0) {
+        printf("got \"%.*s\": ", len, buf);
+        return 0;
+    }
+    return 1;
+}
+
+/** \test records that don't fit are rejected, not cut off */
+static int SCJsonTest03(void)
+{
+    char buf[16];
+    SCJson js;
+
+    SCJsonInit(&js, buf, sizeof(buf));
+    SCJsonOpenObject(&js, NULL);
+    SCJsonAddString(&js, "key", "a long value");
+    SCJsonCloseObject(&js);
+    if (SCJsonFinish(&js) != -1)
+        return 0;
+
+    /* exactly fits: 15 bytes record plus newline */
+    SCJsonReset(&js);
+    SCJsonOpenObject(&js, NULL);
+    SCJsonAddString(&js, "k", "1234567");
+    SCJsonCloseObject(&js);
+    if (SCJsonFinish(&js) != 16)
+        return 0;
+
+    /* unbalanced */
+    SCJsonReset(&js);
+    SCJsonOpenObject(&js, NULL);
+    if (SCJsonFinish(&js) != -1)
+        return 0;
+
+    return 1;
+}
+
+#endif /* UNITTESTS */
+
+void SCJsonRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCJsonTest01", SCJsonTest01, 1);
+    UtRegisterTest("SCJsonTest02", SCJsonTest02, 1);
+    UtRegisterTest("SCJsonTest03", SCJsonTest03, 1);
+#endif /* UNITTESTS */
+}
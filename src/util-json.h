@@ -0,0 +1,67 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Streaming JSON serializer writing into a caller supplied buffer.
+ */
+
+#ifndef __UTIL_JSON_H__
+#define __UTIL_JSON_H__
+
+/** max nesting of objects and arrays */
+#define SC_JSON_MAX_DEPTH   32
+
+/**
+ * \brief Serializer state. Output is written straight into buf, nothing
+ *        is allocated. If the buffer runs out of space the record is
+ *        marked truncated and further writes are ignored.
+ */
+typedef struct SCJson_ {
+    char *buf;
+    uint32_t size;
+    uint32_t offset;
+
+    uint8_t depth;
+    uint8_t truncated;
+    /** bit per depth level, set once the level has a member so the
+     *  next one needs a separator */
+    uint32_t need_comma;
+} SCJson;
+
+void SCJsonInit(SCJson *, char *, uint32_t);
+void SCJsonReset(SCJson *);
+
+void SCJsonOpenObject(SCJson *, const char *);
+void SCJsonCloseObject(SCJson *);
+void SCJsonOpenArray(SCJson *, const char *);
+void SCJsonCloseArray(SCJson *);
+
+void SCJsonAddString(SCJson *, const char *, const char *);
+void SCJsonAddStringN(SCJson *, const char *, const uint8_t *, uint32_t);
+void SCJsonAddUint(SCJson *, const char *, uint64_t);
+void SCJsonAddInt(SCJson *, const char *, int64_t);
+void SCJsonAddBool(SCJson *, const char *, int);
+void SCJsonAddHex(SCJson *, const char *, const uint8_t *, uint32_t);
+void SCJsonAddRaw(SCJson *, const char *, const char *, uint32_t);
+
+int SCJsonFinish(SCJson *);
+
+void SCJsonRegisterTests(void);
+
+#endif /* __UTIL_JSON_H__ */
@@ -0,0 +1,440 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampled latency histograms.
+ *
+ * Each thread owns its histograms: one per slot, one for the time packets
+ * waited on its input queue and one for the time from acquisition to
+ * release of the packets it releases. Only every sample-rate'th packet
+ * of a capture thread is timed. Readers merge the histograms of all
+ * threads on request, without involving the threads.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "threadvars.h"
+#include "tm-threads.h"
+#include "tm-modules.h"
+#include "util-byte.h"
+#include "util-debug.h"
+#include "util-latency.h"
+#include "util-unittest.h"
+
+#define SC_LATENCY_DEFAULT_SAMPLE   1000
+
+/* histograms are written by their thread only, see counters.c */
+#ifdef __ATOMIC_RELAXED
+#define SC_LAT_LOAD_RELAXED(ptr) __atomic_load_n((ptr), __ATOMIC_RELAXED)
+#else
+#define SC_LAT_LOAD_RELAXED(ptr) (*(volatile typeof(*(ptr)) *)(ptr))
+#endif
+
+uint32_t sc_latency_sample = 0;
+
+/**
+ * \brief Merged histogram of all threads for one name
+ */
+typedef struct SCLatencyAgg_ {
+    char name[64];
+    SCLatHist hist;
+} SCLatencyAgg;
+
+/**
+ * \brief Reads the "latency" config section
+ */
+void SCLatencyInit(void)
+{
+    ConfNode *conf = ConfGetNode("latency");
+    if (conf == NULL)
+        return;
+
+    const char *enabled = ConfNodeLookupChildValue(conf, "enabled");
+    if (enabled == NULL || !ConfValIsTrue(enabled))
+        return;
+
+    uint32_t sample = SC_LATENCY_DEFAULT_SAMPLE;
+    const char *s_sample = ConfNodeLookupChildValue(conf, "sample-rate");
+    if (s_sample != NULL) {
+        if (ByteExtractStringUint32(&sample, 10, 0, s_sample) <= 0 ||
+            sample == 0) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "invalid latency "
+                       "sample-rate \"%s\", must be 1 or more", s_sample);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    sc_latency_sample = sample;
+    SCLogInfo("latency tracking enabled, timing 1 out of %"PRIu32" packets",
+              sc_latency_sample);
+}
+
+SCLatHist *SCLatHistAlloc(void)
+{
+    SCLatHist *h = SCMalloc(sizeof(SCLatHist));
+    if (unlikely(h == NULL))
+        return NULL;
+    memset(h, 0, sizeof(SCLatHist));
+    return h;
+}
+
+void SCLatHistFree(SCLatHist *h)
+{
+    if (h != NULL)
+        SCFree(h);
+}
+
+static inline uint32_t SCLatHistIndex(uint64_t v)
+{
+    if (v < SC_LAT_SUB_BUCKETS)
+        return (uint32_t)v;
+
+    uint32_t k = 63 - __builtin_clzll(v);
+    if (k >= SC_LAT_MAX_BITS)
+        return SC_LAT_BUCKETS - 1;
+
+    return (k - SC_LAT_SUB_BITS + 1) * SC_LAT_SUB_BUCKETS +
+           (uint32_t)((v >> (k - SC_LAT_SUB_BITS)) - SC_LAT_SUB_BUCKETS);
+}
+
+/** \internal
+ *  \brief Highest value that maps to a bucket */
+static uint64_t SCLatHistBucketValue(uint32_t idx)
+{
+    if (idx < SC_LAT_SUB_BUCKETS)
+        return idx;
+
+    uint32_t k = idx / SC_LAT_SUB_BUCKETS + SC_LAT_SUB_BITS - 1;
+    uint64_t sub = idx % SC_LAT_SUB_BUCKETS;
+    uint64_t width = 1ULL << (k - SC_LAT_SUB_BITS);
+
+    return ((SC_LAT_SUB_BUCKETS + sub) << (k - SC_LAT_SUB_BITS)) + width - 1;
+}
+
+/**
+ * \brief Add a value to a histogram. Only to be called by the thread
+ *        owning the histogram.
+ *
+ * \param h histogram, can be NULL
+ * \param v value in nsec
+ */
+void SCLatHistAdd(SCLatHist *h, uint64_t v)
+{
+    if (h == NULL)
+        return;
+
+    h->buckets[SCLatHistIndex(v)]++;
+    h->sum += v;
+    if (v > h->max)
+        h->max = v;
+}
+
+/**
+ * \brief Merge src into dst. src may be updated by its thread meanwhile.
+ */
+void SCLatHistMerge(SCLatHist *dst, const SCLatHist *src)
+{
+    uint32_t u;
+    uint64_t max;
+
+    for (u = 0; u < SC_LAT_BUCKETS; u++) {
+        dst->buckets[u] += SC_LAT_LOAD_RELAXED(&src->buckets[u]);
+    }
+    dst->sum += SC_LAT_LOAD_RELAXED(&src->sum);
+    max = SC_LAT_LOAD_RELAXED(&src->max);
+    if (max > dst->max)
+        dst->max = max;
+}
+
+uint64_t SCLatHistCount(const SCLatHist *h)
+{
+    uint64_t cnt = 0;
+    uint32_t u;
+
+    for (u = 0; u < SC_LAT_BUCKETS; u++)
+        cnt += h->buckets[u];
+    return cnt;
+}
+
+/**
+ * \brief Get a percentile from a histogram
+ *
+ * \param h histogram
+ * \param q percentile as a fraction, e.g. 0.99
+ *
+ * \retval value in nsec, at most 1/16th above the real value; 0 if the
+ *         histogram is empty
+ */
+uint64_t SCLatHistPercentile(const SCLatHist *h, double q)
+{
+    uint64_t cnt = SCLatHistCount(h);
+    uint64_t rank;
+    uint64_t seen = 0;
+    uint32_t u;
+
+    if (cnt == 0)
+        return 0;
+
+    rank = (uint64_t)(q * cnt + 0.999999);
+    if (rank == 0)
+        rank = 1;
+    if (rank > cnt)
+        rank = cnt;
+
+    for (u = 0; u < SC_LAT_BUCKETS; u++) {
+        seen += h->buckets[u];
+        if (seen >= rank) {
+            uint64_t v = SCLatHistBucketValue(u);
+            return (v > h->max) ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+/** \internal
+ *  \brief Merge a thread histogram into the named aggregate, adding it if
+ *         needed.
+ *  \retval 0 ok, -1 on allocation failure
+ */
+static int SCLatencyAggAdd(SCLatencyAgg **aggs, uint32_t *cnt,
+                           const char *name, const SCLatHist *h)
+{
+    uint32_t u;
+
+    if (h == NULL)
+        return 0;
+
+    for (u = 0; u < *cnt; u++) {
+        if (strcmp((*aggs)[u].name, name) == 0)
+            break;
+    }
+
+    if (u == *cnt) {
+        SCLatencyAgg *a = SCRealloc(*aggs, (*cnt + 1) * sizeof(SCLatencyAgg));
+        if (a == NULL)
+            return -1;
+        *aggs = a;
+        memset(&a[u], 0, sizeof(SCLatencyAgg));
+        strlcpy(a[u].name, name, sizeof(a[u].name));
+        (*cnt)++;
+    }
+
+    SCLatHistMerge(&(*aggs)[u].hist, h);
+    return 0;
+}
+
+/** \internal
+ *  \brief Merge the histograms of all threads: one entry per slot module
+ *         name, one for the queue wait and one for the packet latency.
+ */
+static SCLatencyAgg *SCLatencyCollect(uint32_t *cnt)
+{
+    SCLatencyAgg *aggs = NULL;
+    ThreadVars *tv = NULL;
+    TmSlot *s = NULL;
+    char name[64];
+    uint32_t u;
+    int r = 0;
+
+    *cnt = 0;
+
+    SCMutexLock(&tv_root_lock);
+    for (u = 0; u < TVT_MAX && r == 0; u++) {
+        for (tv = tv_root[u]; tv != NULL && r == 0; tv = tv->next) {
+            r |= SCLatencyAggAdd(&aggs, cnt, "packet", tv->lat_packet);
+            r |= SCLatencyAggAdd(&aggs, cnt, "queue", tv->lat_queue);
+
+            for (s = tv->tm_slots; s != NULL && r == 0; s = s->slot_next) {
+                TmModule *tm = TmModuleGetById(s->tm_id);
+                if (tm == NULL)
+                    continue;
+                snprintf(name, sizeof(name), "slot.%s", tm->name);
+                r |= SCLatencyAggAdd(&aggs, cnt, name, s->lat_hist);
+            }
+        }
+    }
+    SCMutexUnlock(&tv_root_lock);
+
+    if (r != 0) {
+        if (aggs != NULL)
+            SCFree(aggs);
+        *cnt = 0;
+        return NULL;
+    }
+    return aggs;
+}
+
+/**
+ * \brief Write the latency percentiles to the stats log
+ */
+void SCLatencyOutputFile(FILE *fp)
+{
+    SCLatencyAgg *aggs = NULL;
+    uint32_t cnt = 0;
+    uint32_t u;
+
+    if (sc_latency_sample == 0)
+        return;
+
+    if ((aggs = SCLatencyCollect(&cnt)) == NULL)
+        return;
+
+    fprintf(fp, "%-32s | %10s | %10s | %10s | %10s | %10s | %10s\n",
+            "Latency (usec)", "Samples", "p50", "p90", "p99", "p99.9", "Max");
+    for (u = 0; u < cnt; u++) {
+        SCLatHist *h = &aggs[u].hist;
+        uint64_t samples = SCLatHistCount(h);
+        if (samples == 0)
+            continue;
+
+        fprintf(fp, "%-32s | %10"PRIu64" | %10.1f | %10.1f | %10.1f | "
+                "%10.1f | %10.1f\n", aggs[u].name, samples,
+                SCLatHistPercentile(h, 0.5) / 1000.0,
+                SCLatHistPercentile(h, 0.9) / 1000.0,
+                SCLatHistPercentile(h, 0.99) / 1000.0,
+                SCLatHistPercentile(h, 0.999) / 1000.0,
+                h->max / 1000.0);
+    }
+    fflush(fp);
+
+    SCFree(aggs);
+}
+
+#ifdef BUILD_UNIX_SOCKET
+/**
+ * \brief Unix socket command returning the latency percentiles in nsec
+ */
+TmEcode SCLatencyOutputSocket(json_t *cmd, json_t *answer, void *data)
+{
+    SCLatencyAgg *aggs = NULL;
+    uint32_t cnt = 0;
+    uint32_t u;
+
+    if (sc_latency_sample == 0) {
+        json_object_set_new(answer, "message",
+                json_string("latency tracking is disabled"));
+        return TM_ECODE_FAILED;
+    }
+
+    json_t *jdata = json_object();
+    if (jdata == NULL) {
+        json_object_set_new(answer, "message",
+                json_string("internal error at json object creation"));
+        return TM_ECODE_FAILED;
+    }
+
+    aggs = SCLatencyCollect(&cnt);
+    for (u = 0; u < cnt; u++) {
+        SCLatHist *h = &aggs[u].hist;
+        uint64_t samples = SCLatHistCount(h);
+        if (samples == 0)
+            continue;
+
+        json_t *js = json_object();
+        if (js == NULL)
+            continue;
+        json_object_set_new(js, "samples", json_integer(samples));
+        json_object_set_new(js, "mean", json_integer(h->sum / samples));
+        json_object_set_new(js, "p50", json_integer(SCLatHistPercentile(h, 0.5)));
+        json_object_set_new(js, "p90", json_integer(SCLatHistPercentile(h, 0.9)));
+        json_object_set_new(js, "p99", json_integer(SCLatHistPercentile(h, 0.99)));
+        json_object_set_new(js, "p99.9", json_integer(SCLatHistPercentile(h, 0.999)));
+        json_object_set_new(js, "max", json_integer(h->max));
+        json_object_set_new(jdata, aggs[u].name, js);
+    }
+    if (aggs != NULL)
+        SCFree(aggs);
+
+    json_object_set_new(answer, "message", jdata);
+    return TM_ECODE_OK;
+}
+#endif /* BUILD_UNIX_SOCKET */
+
+#ifdef UNITTESTS
+/** \test bucket mapping is monotonic and the bucket value is an upper
+ *        bound within 1/16th */
+static int SCLatencyTest01(void)
+{
+    uint64_t v;
+    uint32_t prev = 0;
+
+    for (v = 0; v < (1ULL << 20); v++) {
+        uint32_t idx = SCLatHistIndex(v);
+        uint64_t ub = SCLatHistBucketValue(idx);
+
+        if (idx < prev || idx >= SC_LAT_BUCKETS) {
+            printf("index %"PRIu32" for %"PRIu64" out of order: ", idx, v);
+            return 0;
+        }
+        if (ub < v || (v >= SC_LAT_SUB_BUCKETS && ub - v > v / 16)) {
+            printf("bucket value %"PRIu64" for %"PRIu64": ", ub, v);
+            return 0;
+        }
+        prev = idx;
+    }
+
+    if (SCLatHistIndex(UINT64_MAX) != SC_LAT_BUCKETS - 1)
+        return 0;
+    if (SCLatHistIndex((1ULL << SC_LAT_MAX_BITS) - 1) != SC_LAT_BUCKETS - 1)
+        return 0;
+
+    return 1;
+}
+
+/** \test percentiles and merging */
+static int SCLatencyTest02(void)
+{
+    SCLatHist a, b;
+    uint64_t v;
+
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+
+    for (v = 1; v <= 1000; v++)
+        SCLatHistAdd(&a, v * 1000);
+    SCLatHistAdd(&b, 5000000);
+
+    if (SCLatHistPercentile(&a, 0.5) < 500000 ||
+        SCLatHistPercentile(&a, 0.5) > 500000 + 500000 / 16) {
+        printf("p50 %"PRIu64": ", SCLatHistPercentile(&a, 0.5));
+        return 0;
+    }
+    if (SCLatHistPercentile(&a, 1.0) != 1000000) {
+        printf("p100 %"PRIu64" != max: ", SCLatHistPercentile(&a, 1.0));
+        return 0;
+    }
+
+    SCLatHistMerge(&a, &b);
+    if (SCLatHistCount(&a) != 1001 || a.max != 5000000 ||
+        a.sum != 500500000ULL + 5000000) {
+        printf("merge: ");
+        return 0;
+    }
+
+    return 1;
+}
+#endif /* UNITTESTS */
+
+void SCLatencyRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("SCLatencyTest01", SCLatencyTest01, 1);
+    UtRegisterTest("SCLatencyTest02", SCLatencyTest02, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,124 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Sampled latency histograms: per slot processing time, queue wait time
+ * and the time from packet acquisition to release (the verdict in IPS
+ * modes). Available without --enable-profiling.
+ */
+
+#ifndef __UTIL_LATENCY_H__
+#define __UTIL_LATENCY_H__
+
+/** Log-linear buckets: values below 2^SC_LAT_SUB_BITS get a bucket each,
+ *  every power of two above is split in 2^SC_LAT_SUB_BITS linear buckets,
+ *  which keeps the relative error of a bucket under 1/16. */
+#define SC_LAT_SUB_BITS     4
+#define SC_LAT_SUB_BUCKETS  (1 << SC_LAT_SUB_BITS)
+/** largest tracked value is 2^SC_LAT_MAX_BITS - 1 nsec (~18 minutes), above
+ *  that values end up in the last bucket */
+#define SC_LAT_MAX_BITS     40
+#define SC_LAT_BUCKETS      ((SC_LAT_MAX_BITS - SC_LAT_SUB_BITS + 1) * SC_LAT_SUB_BUCKETS)
+
+/**
+ * \brief Latency histogram in nsec. Only written by the thread owning it,
+ *        readers use relaxed loads and merge.
+ */
+typedef struct SCLatHist_ {
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[SC_LAT_BUCKETS];
+} SCLatHist;
+
+/** time 1 out of this many packets, 0 if latency tracking is disabled */
+extern uint32_t sc_latency_sample;
+
+void SCLatencyInit(void);
+
+SCLatHist *SCLatHistAlloc(void);
+void SCLatHistFree(SCLatHist *);
+void SCLatHistAdd(SCLatHist *, uint64_t);
+void SCLatHistMerge(SCLatHist *, const SCLatHist *);
+uint64_t SCLatHistCount(const SCLatHist *);
+uint64_t SCLatHistPercentile(const SCLatHist *, double);
+
+void SCLatencyOutputFile(FILE *);
+#ifdef BUILD_UNIX_SOCKET
+#include <jansson.h>
+TmEcode SCLatencyOutputSocket(json_t *, json_t *, void *);
+#endif
+
+void SCLatencyRegisterTests(void);
+
+/** \brief monotonic time in nsec */
+static inline uint64_t SCLatencyNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/** \brief start a slot measurement if the packet is sampled
+ *  \retval ts start time to pass to SCLatencySlotEnd, 0 if not sampled */
+#define SCLatencySlotStart(p) \
+    (((p) != NULL && (p)->lat_start != 0) ? SCLatencyNow() : 0)
+
+#define SCLatencySlotEnd(s, ts) do {                            \
+        if ((ts) != 0) {                                        \
+            SCLatHistAdd((s)->lat_hist, SCLatencyNow() - (ts)); \
+        }                                                       \
+    } while (0)
+
+/** \brief Called when a packet enters the engine. Picks the sampled
+ *         packets using a per thread counter. */
+#define SC_LATENCY_PACKET_START(tv, p) do {                     \
+        if (unlikely(sc_latency_sample != 0) &&                 \
+            (p)->lat_start == 0 &&                              \
+            ++(tv)->lat_sample_cnt >= sc_latency_sample) {      \
+            (tv)->lat_sample_cnt = 0;                           \
+            (p)->lat_start = SCLatencyNow();                    \
+        }                                                       \
+    } while (0)
+
+/** \brief Called when a packet is released. In IPS modes the verdict has
+ *         been issued at this point. */
+#define SC_LATENCY_PACKET_END(tv, p) do {                       \
+        if ((p)->lat_start != 0 && (tv) != NULL) {              \
+            SCLatHistAdd((tv)->lat_packet,                      \
+                         SCLatencyNow() - (p)->lat_start);      \
+        }                                                       \
+    } while (0)
+
+/** \brief Called right before a packet is put on an inter thread queue */
+#define SC_LATENCY_QUEUE_PUT(p) do {                            \
+        if ((p)->lat_start != 0) {                              \
+            (p)->lat_queued = SCLatencyNow();                   \
+        }                                                       \
+    } while (0)
+
+/** \brief Called right after a packet is taken from an inter thread queue */
+#define SC_LATENCY_QUEUE_GET(tv, p) do {                        \
+        if ((p)->lat_queued != 0) {                             \
+            SCLatHistAdd((tv)->lat_queue,                       \
+                         SCLatencyNow() - (p)->lat_queued);     \
+            (p)->lat_queued = 0;                                \
+        }                                                       \
+    } while (0)
+
+#endif /* __UTIL_LATENCY_H__ */
@@ -0,0 +1,399 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Line splitting for the line based app layer parsers (smtp, ftp).
+ *
+ * Complete lines are returned as spans pointing into the input, so
+ * they are never copied. Only a line that is fragmented over multiple
+ * input chunks is assembled in the per direction LineBuffer.
+ */
+
+#include "suricata-common.h"
+#include "util-line.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+#include "util-misc.h"
+#include "conf.h"
+
+/**
+ * \brief Get a max line length from the config.
+ *
+ * \param name config name, e.g. "app-layer.smtp.max-line-length"
+ *
+ * \retval max_len the configured length or LINE_BUFFER_DEFAULT_MAX_LEN
+ */
+uint32_t LineBufferConfGetMaxLen(const char *name)
+{
+    uint32_t max_len = LINE_BUFFER_DEFAULT_MAX_LEN;
+    char *str = NULL;
+
+    if (ConfGet((char *)name, &str) == 1 && str != NULL) {
+        if (ParseSizeStringU32(str, &max_len) < 0 || max_len == 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "Error parsing %s from conf "
+                       "file - %s. Killing engine", name, str);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    SCLogDebug("%s %"PRIu32, name, max_len);
+    return max_len;
+}
+
+/**
+ * \internal
+ * \brief Append data to the line buffer, growing it if needed.
+ *
+ * Data beyond limit is dropped and the line is flagged as truncated.
+ *
+ * \retval 0 ok
+ * \retval -1 out of memory, the buffer is left untouched
+ */
+static int LineBufferAppend(LineBuffer *lb, uint32_t limit, uint8_t *data,
+        uint32_t data_len)
+{
+    if (data_len == 0)
+        return 0;
+
+    if (data[data_len - 1] == 0x0d)
+        lb->flags |= LINE_BUFFER_CR_SEEN;
+    else
+        lb->flags &= ~LINE_BUFFER_CR_SEEN;
+
+    if (data_len > limit - lb->len) {
+        data_len = limit - lb->len;
+        lb->flags |= LINE_BUFFER_TRUNCATED;
+        if (data_len == 0)
+            return 0;
+    }
+
+    /* lb->len + data_len <= limit, so this can't wrap */
+    uint32_t needed = lb->len + data_len;
+    if (needed > lb->size) {
+        uint32_t size = lb->size ? lb->size : LINE_BUFFER_MIN_SIZE;
+        if (size > limit)
+            size = limit;
+        while (size < needed) {
+            if (size > limit / 2) {
+                size = limit;
+                break;
+            }
+            size *= 2;
+        }
+
+        uint8_t *buf = SCRealloc(lb->buf, size);
+        if (unlikely(buf == NULL))
+            return -1;
+
+        lb->buf = buf;
+        lb->size = size;
+    }
+
+    memcpy(lb->buf + lb->len, data, data_len);
+    lb->len += data_len;
+    return 0;
+}
+
+/**
+ * \brief Get the next line from the input.
+ *
+ * If no LF is found, the remaining input is stored in the line buffer
+ * and consumed. The line is completed by a later call.
+ *
+ * Lines longer than max_len are truncated to max_len bytes and returned
+ * with span->truncated set. The rest of the line is consumed.
+ *
+ * \param lb line buffer of this direction
+ * \param max_len max length of a line, excluding the delimiter. Must
+ *        be > 0.
+ * \param input pointer to the input, advanced past the returned line
+ * \param input_len pointer to the length of the input, updated
+ * \param span filled with the line on success
+ *
+ * \retval 0 line returned in span
+ * \retval -1 no (more) complete lines or out of memory
+ */
+int LineBufferGetLine(LineBuffer *lb, uint32_t max_len, uint8_t **input,
+        int32_t *input_len, LineSpan *span)
+{
+    /* we have run out of input */
+    if (*input_len <= 0)
+        return -1;
+
+    if (lb->flags & LINE_BUFFER_LF_SEEN) {
+        /* the previous line is done with, the buffer may be reused */
+        lb->flags = 0;
+        lb->len = 0;
+    }
+
+    /* keep room for a CR after a line of max_len */
+    uint32_t limit = (max_len < UINT32_MAX) ? max_len + 1 : max_len;
+
+    uint8_t *lf_idx = memchr(*input, 0x0a, *input_len);
+    if (lf_idx == NULL) {
+        /* fragmented line, keep what we have until the rest arrives */
+        if (LineBufferAppend(lb, limit, *input, (uint32_t)*input_len) < 0)
+            return -1;
+
+        *input += *input_len;
+        *input_len = 0;
+        return -1;
+    }
+
+    uint32_t consumed = (uint32_t)(lf_idx - *input) + 1;
+
+    if (lb->len > 0) {
+        if (LineBufferAppend(lb, limit, *input, consumed - 1) < 0)
+            return -1;
+
+        if (lb->flags & LINE_BUFFER_CR_SEEN) {
+            /* a dropped CR isn't in the buffer */
+            if (!(lb->flags & LINE_BUFFER_TRUNCATED))
+                lb->len--;
+            span->delim_len = 2;
+        } else {
+            span->delim_len = 1;
+        }
+        span->line = lb->buf;
+        if (lb->len > max_len || (lb->flags & LINE_BUFFER_TRUNCATED)) {
+            span->len = max_len;
+            span->truncated = 1;
+        } else {
+            span->len = lb->len;
+            span->truncated = 0;
+        }
+    } else {
+        span->line = *input;
+        span->len = consumed - 1;
+
+        if (span->len > 0 && *(lf_idx - 1) == 0x0d) {
+            span->len--;
+            span->delim_len = 2;
+        } else {
+            span->delim_len = 1;
+        }
+        if (span->len > max_len) {
+            span->len = max_len;
+            span->truncated = 1;
+        } else {
+            span->truncated = 0;
+        }
+    }
+
+    lb->flags |= LINE_BUFFER_LF_SEEN;
+    *input += consumed;
+    *input_len -= consumed;
+    return 0;
+}
+
+/**
+ * \brief Free the memory of a line buffer, but not the buffer itself.
+ */
+void LineBufferFree(LineBuffer *lb)
+{
+    if (lb->buf != NULL) {
+        SCFree(lb->buf);
+        lb->buf = NULL;
+    }
+    lb->len = 0;
+    lb->size = 0;
+    lb->flags = 0;
+}
+
+#ifdef UNITTESTS
+
+/** \test lines in a single chunk are returned without copying */
+static int LineBufferTest01(void)
+{
+    int result = 0;
+    LineBuffer lb;
+    LineSpan span;
+    uint8_t data[] = "one\r\ntwo\nthree";
+    uint8_t *input = data;
+    int32_t input_len = sizeof(data) - 1;
+
+    memset(&lb, 0, sizeof(lb));
+
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != 0 ||
+        span.line != data || span.len != 3 || span.delim_len != 2) {
+        printf("first line wrong: ");
+        goto end;
+    }
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != 0 ||
+        span.line != data + 5 || span.len != 3 || span.delim_len != 1) {
+        printf("second line wrong: ");
+        goto end;
+    }
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != -1 ||
+        input_len != 0 || lb.len != 5 || memcmp(lb.buf, "three", 5) != 0) {
+        printf("fragment not stored: ");
+        goto end;
+    }
+    if (lb.buf == NULL || span.line == lb.buf) {
+        printf("span unexpectedly points to the line buffer: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    LineBufferFree(&lb);
+    return result;
+}
+
+/** \test fragmented lines reuse the buffer, the CR may be in an
+ *        earlier fragment than the LF */
+static int LineBufferTest02(void)
+{
+    int result = 0;
+    LineBuffer lb;
+    LineSpan span;
+    uint8_t chunk1[] = "EHLO boo.com\r";
+    uint8_t chunk2[] = "\nMAIL FR";
+    uint8_t chunk3[] = "OM:<a@b>\r\n";
+    uint8_t *input;
+    int32_t input_len;
+
+    memset(&lb, 0, sizeof(lb));
+
+    input = chunk1;
+    input_len = sizeof(chunk1) - 1;
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != -1)
+        goto end;
+
+    input = chunk2;
+    input_len = sizeof(chunk2) - 1;
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != 0 ||
+        span.line != lb.buf || span.len != 12 || span.delim_len != 2 ||
+        memcmp(span.line, "EHLO boo.com", 12) != 0) {
+        printf("first line wrong: ");
+        goto end;
+    }
+    uint8_t *buf = lb.buf;
+
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != -1 ||
+        lb.len != 7) {
+        printf("second fragment not stored: ");
+        goto end;
+    }
+
+    input = chunk3;
+    input_len = sizeof(chunk3) - 1;
+    if (LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != 0 ||
+        span.len != 15 || memcmp(span.line, "MAIL FROM:<a@b>", 15) != 0) {
+        printf("second line wrong: ");
+        goto end;
+    }
+    if (lb.buf != buf || lb.size != LINE_BUFFER_MIN_SIZE) {
+        printf("line buffer not reused: ");
+        goto end;
+    }
+    if (input_len != 0 ||
+        LineBufferGetLine(&lb, LINE_BUFFER_DEFAULT_MAX_LEN, &input, &input_len, &span) != -1) {
+        printf("input not consumed: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    LineBufferFree(&lb);
+    return result;
+}
+
+/** \test lines over the max length are truncated, the buffer doesn't
+ *        grow past it */
+static int LineBufferTest03(void)
+{
+    int result = 0;
+    LineBuffer lb;
+    LineSpan span;
+    uint8_t data[] = "0123456789\r\n01234567\r\n";
+    uint8_t chunk1[] = "01234567";
+    uint8_t chunk2[] = "\r";
+    uint8_t chunk3[] = "\n0123";
+    uint8_t chunk4[] = "456789abcdef";
+    uint8_t chunk5[] = "\r\n";
+    uint8_t *input = data;
+    int32_t input_len = sizeof(data) - 1;
+
+    memset(&lb, 0, sizeof(lb));
+
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != 0 ||
+        span.len != 8 || span.truncated != 1 || span.delim_len != 2 ||
+        memcmp(span.line, "01234567", 8) != 0) {
+        printf("long line not truncated: ");
+        goto end;
+    }
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != 0 ||
+        span.len != 8 || span.truncated != 0 || input_len != 0) {
+        printf("line of max length wrong: ");
+        goto end;
+    }
+
+    /* line of max length with the CR in its own fragment */
+    input = chunk1;
+    input_len = sizeof(chunk1) - 1;
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != -1)
+        goto end;
+    input = chunk2;
+    input_len = sizeof(chunk2) - 1;
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != -1)
+        goto end;
+    input = chunk3;
+    input_len = sizeof(chunk3) - 1;
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != 0 ||
+        span.len != 8 || span.truncated != 0 || span.delim_len != 2) {
+        printf("fragmented line of max length wrong: ");
+        goto end;
+    }
+
+    /* long fragmented line */
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != -1)
+        goto end;
+    input = chunk4;
+    input_len = sizeof(chunk4) - 1;
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != -1 ||
+        input_len != 0 || lb.size > 9) {
+        printf("fragment not consumed or buffer too large: ");
+        goto end;
+    }
+    input = chunk5;
+    input_len = sizeof(chunk5) - 1;
+    if (LineBufferGetLine(&lb, 8, &input, &input_len, &span) != 0 ||
+        span.len != 8 || span.truncated != 1 || span.delim_len != 2 ||
+        memcmp(span.line, "01234567", 8) != 0 || input_len != 0) {
+        printf("long fragmented line not truncated: ");
+        goto end;
+    }
+
+    result = 1;
+end:
+    LineBufferFree(&lb);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void LineBufferRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("LineBufferTest01", LineBufferTest01, 1);
+    UtRegisterTest("LineBufferTest02", LineBufferTest02, 1);
+    UtRegisterTest("LineBufferTest03", LineBufferTest03, 1);
+#endif /* UNITTESTS */
+}
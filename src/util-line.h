@@ -0,0 +1,74 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Line splitting for the line based app layer parsers (smtp, ftp).
+ */
+
+#ifndef __UTIL_LINE_H__
+#define __UTIL_LINE_H__
+
+/** the LF of the line last returned has been seen */
+#define LINE_BUFFER_LF_SEEN     0x01
+/** bytes of the current line were dropped, the line is too long */
+#define LINE_BUFFER_TRUNCATED   0x02
+/** the last byte of the current line seen so far is a CR */
+#define LINE_BUFFER_CR_SEEN     0x04
+
+/** initial size of the buffer holding a fragmented line */
+#define LINE_BUFFER_MIN_SIZE    256
+
+/** default max length of a line, excluding the delimiter */
+#define LINE_BUFFER_DEFAULT_MAX_LEN 65535
+
+/**
+ *  \brief per direction storage for a line that is fragmented over
+ *         multiple input chunks.
+ *
+ *  The buffer is kept for the lifetime of the parser state and reused
+ *  for every fragmented line, so it is only (re)allocated when a line
+ *  is longer than any line seen before.
+ */
+typedef struct LineBuffer_ {
+    uint8_t *buf;
+    /** bytes of the (fragmented) line in buf. Once the line is complete
+     *  this excludes the delimiter. */
+    uint32_t len;
+    /** allocated size of buf */
+    uint32_t size;
+    uint8_t flags;
+} LineBuffer;
+
+/** a line returned by LineBufferGetLine() */
+typedef struct LineSpan_ {
+    uint8_t *line;
+    /** length of line, excluding the delimiter */
+    uint32_t len;
+    /** 1 for LF, 2 for CRLF */
+    uint8_t delim_len;
+    /** 1 if the line was longer than the max length and is truncated */
+    uint8_t truncated;
+} LineSpan;
+
+uint32_t LineBufferConfGetMaxLen(const char *);
+int LineBufferGetLine(LineBuffer *, uint32_t, uint8_t **, int32_t *, LineSpan *);
+void LineBufferFree(LineBuffer *);
+void LineBufferRegisterTests(void);
+
+#endif /* __UTIL_LINE_H__ */
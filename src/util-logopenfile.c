@@ -31,6 +31,9 @@
 #include "tm-modules.h"      /* LogFileCtx */
 #include "conf.h"            /* ConfNode, etc. */
 #include "output.h"          /* DEFAULT_LOG_* */
+#include "util-logopenfile.h"
+#include "util-misc.h"       /* ParseSizeStringU64 */
+#include "util-time.h"       /* SCLocalTime */
 
 /** \brief connect to the indicated local stream socket, logging any errors
  *  \param path filesystem path to connect to
@@ -187,6 +190,11 @@ SCConfLogOpenGeneric(ConfNode *conf,
         if (append == NULL)
             append = DEFAULT_LOG_MODE_APPEND;
         log_ctx->fp = SCLogOpenFileFp(log_path, append);
+        if (log_ctx->fp != NULL && log_ctx->filename == NULL) {
+            /* remember the path so the file can be rotated */
+            log_ctx->filename = SCStrdup(log_path);
+            log_ctx->rotate_time = time(NULL);
+        }
 #ifdef __tile__
     } else if (strcasecmp(filetype, "tile_pcie") == 0) {
         const char *append;
@@ -222,3 +230,163 @@ SCConfLogOpenGeneric(ConfNode *conf,
 
     return 0;
 }
+
+/** \internal
+ *  \brief parse an interval like "3600", "30m", "1h" or "1d"
+ *  \retval 0 on success, -1 on error
+ */
+static int SCConfLogParseInterval(const char *str, uint32_t *res)
+{
+    char *end = NULL;
+    unsigned long val = strtoul(str, &end, 10);
+    if (end == str)
+        return -1;
+
+    while (isspace((unsigned char)*end))
+        end++;
+
+    switch (*end) {
+        case '\0':
+        case 's':
+            break;
+        case 'm':
+            val *= 60;
+            break;
+        case 'h':
+            val *= 60 * 60;
+            break;
+        case 'd':
+            val *= 24 * 60 * 60;
+            break;
+        default:
+            return -1;
+    }
+    if (*end != '\0' && *(end + 1) != '\0')
+        return -1;
+    if (val > UINT32_MAX)
+        return -1;
+
+    *res = (uint32_t)val;
+    return 0;
+}
+
+/**
+ * \brief Read the rotation settings of a regular file output.
+ *
+ * "rotate-interval" closes the file every so many seconds (suffixes m, h
+ * and d are accepted), "limit" when it reaches a size. The old file is
+ * renamed to the original name with the time it was opened appended.
+ * Rotation is done by SCLogFileRotateCheck(), so only outputs writing
+ * through LogFileWrite() honor it.
+ *
+ * \retval 0 on success or if no rotation is configured, -1 on error
+ */
+int SCConfLogRotateSetup(ConfNode *conf, LogFileCtx *log_ctx)
+{
+    const char *interval = ConfNodeLookupChildValue(conf, "rotate-interval");
+    const char *limit = ConfNodeLookupChildValue(conf, "limit");
+
+    if (interval == NULL && limit == NULL)
+        return 0;
+
+    if (log_ctx->filename == NULL) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: rotation is only "
+                   "supported for regular files", conf->name);
+        return -1;
+    }
+
+    if (interval != NULL &&
+            SCConfLogParseInterval(interval, &log_ctx->rotate_interval) < 0) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: invalid "
+                   "rotate-interval \"%s\"", conf->name, interval);
+        return -1;
+    }
+    if (limit != NULL && ParseSizeStringU64(limit, &log_ctx->size_limit) < 0) {
+        SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: invalid limit "
+                   "\"%s\"", conf->name, limit);
+        return -1;
+    }
+
+    /* appending to an existing file */
+    struct stat st;
+    if (fstat(fileno(log_ctx->fp), &st) == 0)
+        log_ctx->size_current = (uint64_t)st.st_size;
+
+    SCLogInfo("%s: rotating %s every %"PRIu32" seconds, size limit %"PRIu64,
+              conf->name, log_ctx->filename, log_ctx->rotate_interval,
+              log_ctx->size_limit);
+    return 0;
+}
+
+/** \internal
+ *  \brief close the current file, move it aside and open a new one */
+static int SCLogFileRotate(LogFileCtx *log_ctx, time_t now)
+{
+    char rotated[PATH_MAX];
+    char timebuf[32];
+    struct tm local_tm;
+    struct tm *t = SCLocalTime(log_ctx->rotate_time, &local_tm);
+    unsigned int i;
+
+    strftime(timebuf, sizeof(timebuf), "%Y%m%d-%H%M%S", t);
+    snprintf(rotated, sizeof(rotated), "%s.%s", log_ctx->filename, timebuf);
+    /* size based rotation can happen more than once a second */
+    for (i = 1; access(rotated, F_OK) == 0 && i < 1000; i++) {
+        snprintf(rotated, sizeof(rotated), "%s.%s.%u", log_ctx->filename,
+                 timebuf, i);
+    }
+
+    /* after a failed reopen there is nothing to move aside */
+    if (log_ctx->fp != NULL) {
+        fflush(log_ctx->fp);
+        fclose(log_ctx->fp);
+        log_ctx->fp = NULL;
+
+        if (rename(log_ctx->filename, rotated) != 0) {
+            SCLogWarning(SC_ERR_FOPEN, "renaming \"%s\" to \"%s\" failed: %s",
+                         log_ctx->filename, rotated, strerror(errno));
+        }
+    }
+
+    log_ctx->fp = SCLogOpenFileFp(log_ctx->filename, "no");
+    log_ctx->rotate_time = now;
+    log_ctx->size_current = 0;
+
+    return (log_ctx->fp != NULL) ? 0 : -1;
+}
+
+/**
+ * \brief Rotate the file if it's due before len bytes are written to it.
+ *
+ * Must be called with fp_mutex held.
+ *
+ * \retval 0 file is ready to be written to
+ * \retval -1 the file could not be reopened
+ */
+int SCLogFileRotateCheck(LogFileCtx *log_ctx, uint32_t len)
+{
+    if (log_ctx->rotate_interval == 0 && log_ctx->size_limit == 0)
+        return 0;
+
+    time_t now = time(NULL);
+    int rotate = 0;
+
+    if (log_ctx->fp == NULL) {
+        /* reopening failed before, retry once a second */
+        if (now == log_ctx->rotate_time)
+            return -1;
+        rotate = 1;
+    } else if (log_ctx->rotate_interval != 0 &&
+            now - log_ctx->rotate_time >= (time_t)log_ctx->rotate_interval) {
+        rotate = 1;
+    } else if (log_ctx->size_limit != 0 && log_ctx->size_current != 0 &&
+            log_ctx->size_current + len > log_ctx->size_limit) {
+        rotate = 1;
+    }
+
+    if (rotate && SCLogFileRotate(log_ctx, now) < 0)
+        return -1;
+
+    log_ctx->size_current += len;
+    return 0;
+}
@@ -28,5 +28,7 @@
 #include "tm-modules.h"      /* LogFileCtx */
 
 int SCConfLogOpenGeneric(ConfNode *conf, LogFileCtx *, const char *);
+int SCConfLogRotateSetup(ConfNode *conf, LogFileCtx *);
+int SCLogFileRotateCheck(LogFileCtx *, uint32_t);
 
 #endif /* __UTIL_LOGOPENFILE_H__ */
@@ -0,0 +1,736 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Asynchronous writer for LogFileCtx based outputs.
+ *
+ * Without a writer, records are written by the packet threads with the
+ * LogFileCtx fp_mutex held and the file is flushed after each record.
+ * With a writer, each packet thread copies its formatted records into a
+ * private ring buffer and a writer thread per output drains the buffers
+ * of all threads with writev(), at least every flush-interval ms and
+ * sooner if a buffer fills up.
+ *
+ * When a buffer is full the record is dropped and counted, or, with
+ * full-policy "block", the packet thread waits for the writer.
+ */
+
+#include "suricata-common.h"
+#include "conf.h"
+#include "threads.h"
+#include "threadvars.h"
+#include "tm-modules.h"
+#include "tm-threads.h"
+#include "counters.h"
+#include "util-logwriter.h"
+#include "util-logopenfile.h"
+#include "util-misc.h"
+#include "util-signal.h"
+#include "util-atomic.h"
+#include "util-debug.h"
+#include "util-unittest.h"
+
+#include <sys/uio.h>
+
+/** \internal
+ *  \brief write all iovecs, dealing with short writes
+ *  \retval 0 on success, -1 on error
+ */
+static int LogWriterWritev(int fd, struct iovec *iov, int cnt)
+{
+    while (cnt > 0) {
+        ssize_t r = writev(fd, iov, cnt);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        while (cnt > 0 && (size_t)r >= iov->iov_len) {
+            r -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + r;
+            iov->iov_len -= r;
+        }
+    }
+    return 0;
+}
+
+/** \internal
+ *  \brief write a batch of buffer segments and release them
+ *
+ *  \param bufs buffers the segments belong to
+ *  \param heads head of each buffer at the time the segments were taken
+ */
+static void LogWriterCommit(LogWriter *lw, struct iovec *iov, int iov_cnt,
+                            LogWriterBuffer **bufs, uint64_t *heads, int buf_cnt)
+{
+    LogFileCtx *file_ctx = lw->file_ctx;
+    uint32_t len = 0;
+    int i;
+    int r;
+
+    for (i = 0; i < iov_cnt; i++)
+        len += iov[i].iov_len;
+
+    /* the writer thread is the only one writing to the file, the lock
+     * only guards against rotation changing the file pointer */
+    SCMutexLock(&file_ctx->fp_mutex);
+    if (SCLogFileRotateCheck(file_ctx, len) < 0) {
+        errno = EBADF;
+        r = -1;
+    } else {
+        r = LogWriterWritev(fileno(file_ctx->fp), iov, iov_cnt);
+    }
+    SCMutexUnlock(&file_ctx->fp_mutex);
+
+    if (r < 0) {
+        /* don't stall the packet threads on a broken output, the data
+         * is lost either way */
+        if (lw->write_errors == 0) {
+            SCLogWarning(SC_ERR_FWRITE, "%s: writing log records failed: %s",
+                         lw->name, strerror(errno));
+        }
+        lw->write_errors++;
+    }
+
+    for (i = 0; i < buf_cnt; i++) {
+        (void) SC_ATOMIC_SET(bufs[i]->tail, heads[i]);
+    }
+}
+
+/**
+ * \brief Write out the contents of all buffers of a writer.
+ *
+ * Called from the writer thread. Records added while the buffers are
+ * being written are left for the next call.
+ *
+ * \retval bytes written
+ */
+int LogWriterFlush(LogWriter *lw)
+{
+    struct iovec iov[LOG_WRITER_IOV_MAX];
+    LogWriterBuffer *bufs[LOG_WRITER_IOV_MAX];
+    uint64_t heads[LOG_WRITER_IOV_MAX];
+    int iov_cnt = 0;
+    int buf_cnt = 0;
+    int bytes = 0;
+
+    /* buffers are only ever prepended to the list, so once we have the
+     * head we can walk it without the lock */
+    SCMutexLock(&lw->lock);
+    LogWriterBuffer *lb = lw->buffers;
+    SCMutexUnlock(&lw->lock);
+
+    for ( ; lb != NULL; lb = lb->next) {
+        uint64_t tail = SC_ATOMIC_GET(lb->tail);
+        uint64_t head = SC_ATOMIC_GET(lb->head);
+        if (head == tail)
+            continue;
+
+        if (iov_cnt + 2 > LOG_WRITER_IOV_MAX) {
+            LogWriterCommit(lw, iov, iov_cnt, bufs, heads, buf_cnt);
+            iov_cnt = buf_cnt = 0;
+        }
+
+        /* the data may wrap around the end of the ring */
+        uint32_t offset = tail % lb->size;
+        uint32_t len = (uint32_t)(head - tail);
+        uint32_t first = (len < lb->size - offset) ? len : lb->size - offset;
+
+        iov[iov_cnt].iov_base = lb->data + offset;
+        iov[iov_cnt].iov_len = first;
+        iov_cnt++;
+        if (len > first) {
+            iov[iov_cnt].iov_base = lb->data;
+            iov[iov_cnt].iov_len = len - first;
+            iov_cnt++;
+        }
+        bufs[buf_cnt] = lb;
+        heads[buf_cnt] = head;
+        buf_cnt++;
+        bytes += len;
+    }
+
+    if (iov_cnt > 0)
+        LogWriterCommit(lw, iov, iov_cnt, bufs, heads, buf_cnt);
+
+    return bytes;
+}
+
+/** \internal
+ *  \brief wake up the writer thread so it sees THV_KILL without waiting
+ *         for the flush interval */
+static void LogWriterThreadWakeup(ThreadVars *tv)
+{
+    LogWriter *lw = (LogWriter *)tv->tm_func_data;
+
+    SCMutexLock(&lw->lock);
+    SCCondSignal(&lw->cond);
+    SCMutexUnlock(&lw->lock);
+}
+
+static void *LogWriterThread(void *td)
+{
+    /* block usr2.  usr2 to be handled by the main thread only */
+    UtilSignalBlock(SIGUSR2);
+
+    ThreadVars *tv = (ThreadVars *)td;
+    LogWriter *lw = (LogWriter *)tv->tm_func_data;
+    struct timeval now;
+    struct timespec ts;
+
+    if (tv->thread_setup_flags != 0)
+        TmThreadSetupOptions(tv);
+
+    if (SCSetThreadName(tv->name) < 0) {
+        SCLogWarning(SC_ERR_THREAD_INIT, "Unable to set thread name");
+    }
+
+    TmThreadsSetFlag(tv, THV_INIT_DONE);
+
+    SCMutexLock(&lw->lock);
+    while (!lw->stop && !TmThreadsCheckFlag(tv, THV_KILL)) {
+        gettimeofday(&now, NULL);
+        uint64_t usec = (uint64_t)now.tv_usec + (uint64_t)lw->flush_interval * 1000;
+        ts.tv_sec = now.tv_sec + (usec / 1000000);
+        ts.tv_nsec = (usec % 1000000) * 1000;
+
+        SCCondTimedwait(&lw->cond, &lw->lock, &ts);
+        if (lw->stop || TmThreadsCheckFlag(tv, THV_KILL))
+            break;
+
+        SCMutexUnlock(&lw->lock);
+        LogWriterFlush(lw);
+        SCMutexLock(&lw->lock);
+    }
+    SCMutexUnlock(&lw->lock);
+
+    /* write what is left */
+    LogWriterFlush(lw);
+
+    /* from here on records are dropped instead of waited for and what
+     * is still buffered is written by LogWriterFree(). If we were killed
+     * by the thread framework it also takes care of the tv, in unix
+     * socket mode it may be freed before the writer is. */
+    SCMutexLock(&lw->lock);
+    (void) SC_ATOMIC_SET(lw->running, 0);
+    if (!lw->stop)
+        lw->tv = NULL;
+    SCMutexUnlock(&lw->lock);
+
+    TmThreadsSetFlag(tv, THV_RUNNING_DONE);
+    TmThreadWaitForFlag(tv, THV_DEINIT);
+    TmThreadsSetFlag(tv, THV_CLOSED);
+    pthread_exit((void *) 0);
+    return NULL;
+}
+
+/**
+ * \brief Create a writer for a log file. The writer thread is not started.
+ *
+ * \param file_ctx opened log file
+ * \param name output name, used for log messages and counter names
+ * \param buffer_size size of each per thread buffer
+ * \param flush_interval max time in ms records are buffered
+ * \param block wait for the writer instead of dropping records if a buffer
+ *        is full
+ *
+ * \retval lw writer or NULL on error
+ */
+LogWriter *LogWriterNew(LogFileCtx *file_ctx, const char *name,
+                        uint32_t buffer_size, uint32_t flush_interval, int block)
+{
+    LogWriter *lw = SCMalloc(sizeof(LogWriter));
+    if (unlikely(lw == NULL))
+        return NULL;
+    memset(lw, 0x00, sizeof(LogWriter));
+
+    lw->name = SCStrdup(name);
+    if (unlikely(lw->name == NULL)) {
+        SCFree(lw);
+        return NULL;
+    }
+
+    lw->file_ctx = file_ctx;
+    lw->buffer_size = buffer_size;
+    lw->flush_interval = flush_interval ? flush_interval : 1;
+    lw->block = block ? 1 : 0;
+
+    SCMutexInit(&lw->lock, NULL);
+    SCCondInit(&lw->cond, NULL);
+    SC_ATOMIC_INIT(lw->running);
+    SC_ATOMIC_INIT(lw->dropped);
+    return lw;
+}
+
+/**
+ * \brief Start the writer thread.
+ *
+ * \retval 0 on success, -1 on error
+ */
+int LogWriterStart(LogWriter *lw)
+{
+    snprintf(lw->tv_name, sizeof(lw->tv_name), "LogWriter-%s", lw->name);
+
+    ThreadVars *tv = TmThreadCreateMgmtThread(lw->tv_name, LogWriterThread, 0);
+    if (tv == NULL) {
+        SCLogError(SC_ERR_THREAD_CREATE, "%s: failed to create log writer "
+                   "thread", lw->name);
+        return -1;
+    }
+    tv->tm_func_data = lw;
+    tv->InShutdownHandler = LogWriterThreadWakeup;
+
+    lw->tv = tv;
+    (void) SC_ATOMIC_SET(lw->running, 1);
+    if (TmThreadSpawn(tv) != TM_ECODE_OK) {
+        SCLogError(SC_ERR_THREAD_SPAWN, "%s: failed to spawn log writer "
+                   "thread", lw->name);
+        lw->tv = NULL;
+        (void) SC_ATOMIC_SET(lw->running, 0);
+        TmThreadFree(tv);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief Stop the writer thread, write out all buffered records and free
+ *        the writer and its buffers.
+ *
+ * All threads that registered a buffer must have stopped logging.
+ */
+void LogWriterFree(LogWriter *lw)
+{
+    if (lw == NULL)
+        return;
+
+    SCMutexLock(&lw->lock);
+    lw->stop = 1;
+    SCCondSignal(&lw->cond);
+    ThreadVars *tv = lw->tv;
+    SCMutexUnlock(&lw->lock);
+
+    if (tv != NULL) {
+        /* the thread writes out the buffers before it exits */
+        TmThreadKillThread(tv);
+        pthread_join(tv->t, NULL);
+#ifndef __tile__
+        TmThreadRemove(tv, tv->type);
+#endif
+        TmThreadFree(tv);
+        lw->tv = NULL;
+    } else {
+        /* never started or already stopped by the thread framework */
+        LogWriterFlush(lw);
+    }
+
+    if (SC_ATOMIC_GET(lw->dropped) > 0 || lw->write_errors > 0) {
+        SCLogInfo("%s: %"PRIu64" records dropped because the log buffers "
+                  "were full, %"PRIu64" failed writes", lw->name,
+                  (uint64_t)SC_ATOMIC_GET(lw->dropped), lw->write_errors);
+    }
+
+    LogWriterBuffer *lb = lw->buffers;
+    while (lb != NULL) {
+        LogWriterBuffer *next = lb->next;
+        SC_ATOMIC_DESTROY(lb->head);
+        SC_ATOMIC_DESTROY(lb->tail);
+        SCFree(lb->data);
+        SCFree(lb);
+        lb = next;
+    }
+
+    SC_ATOMIC_DESTROY(lw->running);
+    SC_ATOMIC_DESTROY(lw->dropped);
+    SCCondDestroy(&lw->cond);
+    SCMutexDestroy(&lw->lock);
+    SCFree(lw->name);
+    SCFree(lw);
+}
+
+/**
+ * \brief Set up asynchronous writing for a log file if its output
+ *        configuration asks for it.
+ *
+ * Example:
+ *
+ *   - fast:
+ *       filename: fast.log
+ *       async:
+ *         enabled: yes
+ *         buffer-size: 1mb
+ *         flush-interval: 100
+ *         full-policy: drop
+ *
+ * Only outputs that write all their records with LogFileWrite() may use
+ * this, as the writer bypasses the stdio buffer of the file.
+ *
+ * \param file_ctx opened log file
+ * \param conf output configuration node
+ *
+ * \retval 0 on success (also if async writing is not enabled), -1 on error
+ */
+int LogWriterSetup(LogFileCtx *file_ctx, ConfNode *conf)
+{
+    ConfNode *async = ConfNodeLookupChild(conf, "async");
+    if (async == NULL || !ConfNodeChildValueIsTrue(async, "enabled"))
+        return 0;
+
+#ifdef __tile__
+    if (file_ctx->filetype == tile_pcie) {
+        SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: async writing is "
+                     "not supported for tile_pcie outputs", conf->name);
+        return 0;
+    }
+#endif
+    const char *filetype = ConfNodeLookupChildValue(conf, "filetype");
+    if (filetype != NULL && strcasecmp(filetype, "unix_dgram") == 0) {
+        /* writes are batched, so records would no longer be sent as
+         * separate datagrams */
+        SCLogWarning(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: async writing is "
+                     "not supported for unix_dgram outputs", conf->name);
+        return 0;
+    }
+
+    uint32_t buffer_size = LOG_WRITER_DEFAULT_BUFFER_SIZE;
+    const char *val = ConfNodeLookupChildValue(async, "buffer-size");
+    if (val != NULL) {
+        if (ParseSizeStringU32(val, &buffer_size) < 0 || buffer_size == 0) {
+            SCLogError(SC_ERR_SIZE_PARSE, "%s: invalid async.buffer-size "
+                       "\"%s\"", conf->name, val);
+            return -1;
+        }
+    }
+
+    intmax_t flush_interval = LOG_WRITER_DEFAULT_FLUSH_INTERVAL;
+    if (ConfGetChildValueInt(async, "flush-interval", &flush_interval) == 1) {
+        if (flush_interval <= 0 || flush_interval > 60000) {
+            SCLogError(SC_ERR_INVALID_ARGUMENT, "%s: async.flush-interval "
+                       "must be between 1 and 60000 ms", conf->name);
+            return -1;
+        }
+    }
+
+    int block = 0;
+    val = ConfNodeLookupChildValue(async, "full-policy");
+    if (val != NULL) {
+        if (strcasecmp(val, "block") == 0) {
+            block = 1;
+        } else if (strcasecmp(val, "drop") != 0) {
+            SCLogError(SC_ERR_INVALID_YAML_CONF_ENTRY, "%s: invalid "
+                       "async.full-policy \"%s\", expected \"drop\" or "
+                       "\"block\"", conf->name, val);
+            return -1;
+        }
+    }
+
+    LogWriter *lw = LogWriterNew(file_ctx, conf->name, buffer_size,
+                                 (uint32_t)flush_interval, block);
+    if (lw == NULL)
+        return -1;
+    if (LogWriterStart(lw) < 0) {
+        LogWriterFree(lw);
+        return -1;
+    }
+    file_ctx->writer = lw;
+
+    SCLogInfo("%s: async writing enabled, buffer size %"PRIu32", flush "
+              "interval %"PRIuMAX" ms, %s records if full", conf->name,
+              buffer_size, (uintmax_t)flush_interval,
+              block ? "block on" : "drop");
+    return 0;
+}
+
+/**
+ * \brief Register a logging thread with the writer of a log file.
+ *
+ * Called from the output modules ThreadInit. Also registers the
+ * "<output>.log_queue_depth" and "<output>.log_dropped" counters with the
+ * thread.
+ *
+ * \param file_ctx log file
+ * \param tv thread that will log, may be NULL
+ *
+ * \retval lb buffer to pass to LogFileWrite(), NULL if the log file is
+ *         written synchronously or on error, in which case LogFileWrite()
+ *         falls back to writing directly.
+ */
+LogWriterBuffer *LogWriterRegisterThread(LogFileCtx *file_ctx, ThreadVars *tv)
+{
+    LogWriter *lw = file_ctx->writer;
+    if (lw == NULL)
+        return NULL;
+
+    LogWriterBuffer *lb = SCMalloc(sizeof(LogWriterBuffer));
+    if (unlikely(lb == NULL))
+        return NULL;
+    memset(lb, 0x00, sizeof(LogWriterBuffer));
+
+    lb->data = SCMalloc(lw->buffer_size);
+    if (unlikely(lb->data == NULL)) {
+        SCFree(lb);
+        return NULL;
+    }
+    lb->size = lw->buffer_size;
+    SC_ATOMIC_INIT(lb->head);
+    SC_ATOMIC_INIT(lb->tail);
+
+    if (tv != NULL) {
+        char name[64];
+
+        lb->tv = tv;
+        snprintf(name, sizeof(name), "%s.log_queue_depth", lw->name);
+        lb->counter_depth = SCPerfTVRegisterCounter(name, tv,
+                SC_PERF_TYPE_UINT64, "NULL");
+        snprintf(name, sizeof(name), "%s.log_dropped", lw->name);
+        lb->counter_dropped = SCPerfTVRegisterCounter(name, tv,
+                SC_PERF_TYPE_UINT64, "NULL");
+
+        tv->sc_perf_pca = SCPerfGetAllCountersArray(tv, &tv->sc_perf_pctx);
+        SCPerfAddToClubbedTMTable((tv->thread_group_name != NULL) ?
+                tv->thread_group_name : tv->name, &tv->sc_perf_pctx);
+    }
+
+    SCMutexLock(&lw->lock);
+    lb->next = lw->buffers;
+    lw->buffers = lb;
+    SCMutexUnlock(&lw->lock);
+
+    return lb;
+}
+
+/** \internal
+ *  \brief add a record to a thread buffer
+ *  \retval 0 on success, -1 if the record was dropped
+ */
+static int LogWriterBufferAdd(LogWriter *lw, LogWriterBuffer *lb,
+                              const char *buf, size_t len)
+{
+    uint64_t head = SC_ATOMIC_GET(lb->head);
+    uint64_t tail = SC_ATOMIC_GET(lb->tail);
+
+    if (unlikely(len > lb->size))
+        goto drop;
+
+    while (head + len - tail > lb->size) {
+        /* don't wait for a writer that is gone */
+        if (!lw->block || !SC_ATOMIC_GET(lw->running))
+            goto drop;
+
+        SCCondSignal(&lw->cond);
+        usleep(100);
+        tail = SC_ATOMIC_GET(lb->tail);
+    }
+
+    uint32_t offset = head % lb->size;
+    uint32_t first = ((uint32_t)len < lb->size - offset) ?
+        (uint32_t)len : lb->size - offset;
+    memcpy(lb->data + offset, buf, first);
+    if (len > first)
+        memcpy(lb->data, buf + first, len - first);
+
+    /* publish the record */
+    (void) SC_ATOMIC_SET(lb->head, head + len);
+
+    uint64_t depth = head + len - tail;
+    if (lb->tv != NULL) {
+        SCPerfCounterSetUI64(lb->counter_depth, lb->tv->sc_perf_pca, depth);
+    }
+    /* don't wait for the flush interval if we're filling up. Only signal
+     * when crossing the mark so we don't wake the writer for each record. */
+    if (depth > lb->size / 2 && depth - len <= lb->size / 2)
+        SCCondSignal(&lw->cond);
+    return 0;
+
+drop:
+    (void) SC_ATOMIC_ADD(lw->dropped, 1);
+    if (lb->tv != NULL) {
+        SCPerfCounterIncr(lb->counter_dropped, lb->tv->sc_perf_pca);
+    }
+    return -1;
+}
+
+/**
+ * \brief Write a complete record to a log file.
+ *
+ * \param file_ctx log file
+ * \param lb buffer of the calling thread from LogWriterRegisterThread(),
+ *        or NULL to write directly
+ * \param buf formatted record
+ * \param len record length
+ *
+ * \retval 0 on success, -1 if the record was dropped or could not be
+ *         written
+ */
+int LogFileWrite(LogFileCtx *file_ctx, LogWriterBuffer *lb,
+                 const char *buf, size_t len)
+{
+    if (lb != NULL)
+        return LogWriterBufferAdd(file_ctx->writer, lb, buf, len);
+
+    int r = 0;
+    SCMutexLock(&file_ctx->fp_mutex);
+    if (SCLogFileRotateCheck(file_ctx, (uint32_t)len) < 0) {
+        r = -1;
+    } else {
+        if (fwrite(buf, 1, len, file_ctx->fp) != len)
+            r = -1;
+        fflush(file_ctx->fp);
+    }
+    SCMutexUnlock(&file_ctx->fp_mutex);
+    return r;
+}
+
+#ifdef UNITTESTS
+
+/** \test records of several threads end up in the file, each threads
+ *        records in order */
+static int LogWriterTest01(void)
+{
+    LogFileCtx *file_ctx = NULL;
+    LogWriterBuffer *lb[2];
+    char rec[32];
+    char line[64];
+    int next[2] = { 0, 0 };
+    int i, t;
+    int result = 0;
+
+    file_ctx = LogFileNewCtx();
+    if (file_ctx == NULL)
+        return 0;
+    file_ctx->fp = tmpfile();
+    if (file_ctx->fp == NULL)
+        goto end;
+
+    /* small buffers so they wrap and the writer gets woken up */
+    file_ctx->writer = LogWriterNew(file_ctx, "test", 256, 1, 1);
+    if (file_ctx->writer == NULL)
+        goto end;
+    if (LogWriterStart(file_ctx->writer) < 0)
+        goto end;
+
+    for (t = 0; t < 2; t++) {
+        lb[t] = LogWriterRegisterThread(file_ctx, NULL);
+        if (lb[t] == NULL)
+            goto end;
+    }
+
+    for (i = 0; i < 1000; i++) {
+        for (t = 0; t < 2; t++) {
+            int len = snprintf(rec, sizeof(rec), "%d %d\n", t, i);
+            if (LogFileWrite(file_ctx, lb[t], rec, len) != 0)
+                goto end;
+        }
+    }
+
+    /* stops the writer, writing out everything */
+    LogWriterFree(file_ctx->writer);
+    file_ctx->writer = NULL;
+
+    rewind(file_ctx->fp);
+    while (fgets(line, sizeof(line), file_ctx->fp) != NULL) {
+        if (sscanf(line, "%d %d", &t, &i) != 2 || t < 0 || t > 1)
+            goto end;
+        if (i != next[t])
+            goto end;
+        next[t]++;
+    }
+    if (next[0] != 1000 || next[1] != 1000)
+        goto end;
+
+    result = 1;
+end:
+    LogFileFreeCtx(file_ctx);
+    return result;
+}
+
+/** \test records are dropped if a buffer is full and not blocking */
+static int LogWriterTest02(void)
+{
+    LogFileCtx *file_ctx = NULL;
+    LogWriterBuffer *lb;
+    const char *rec = "0123456789abcdef\n";
+    size_t len = strlen(rec);
+    char line[64];
+    int i;
+    int lines = 0;
+    int result = 0;
+
+    file_ctx = LogFileNewCtx();
+    if (file_ctx == NULL)
+        return 0;
+    file_ctx->fp = tmpfile();
+    if (file_ctx->fp == NULL)
+        goto end;
+
+    /* writer thread not started, we flush by hand */
+    file_ctx->writer = LogWriterNew(file_ctx, "test", 64, 100, 0);
+    if (file_ctx->writer == NULL)
+        goto end;
+    lb = LogWriterRegisterThread(file_ctx, NULL);
+    if (lb == NULL)
+        goto end;
+
+    /* 3 records of 17 bytes fit in 64 bytes */
+    for (i = 0; i < 5; i++) {
+        int r = LogFileWrite(file_ctx, lb, rec, len);
+        if ((i < 3 && r != 0) || (i >= 3 && r != -1))
+            goto end;
+    }
+    if (SC_ATOMIC_GET(file_ctx->writer->dropped) != 2)
+        goto end;
+
+    if (LogWriterFlush(file_ctx->writer) != (int)(3 * len))
+        goto end;
+
+    /* room again, this one wraps around the end of the buffer */
+    if (LogFileWrite(file_ctx, lb, rec, len) != 0)
+        goto end;
+    if (LogWriterFlush(file_ctx->writer) != (int)len)
+        goto end;
+
+    rewind(file_ctx->fp);
+    while (fgets(line, sizeof(line), file_ctx->fp) != NULL) {
+        if (strcmp(line, rec) != 0)
+            goto end;
+        lines++;
+    }
+    if (lines != 4)
+        goto end;
+
+    result = 1;
+end:
+    LogFileFreeCtx(file_ctx);
+    return result;
+}
+
+#endif /* UNITTESTS */
+
+void LogWriterRegisterTests(void)
+{
+#ifdef UNITTESTS
+    UtRegisterTest("LogWriterTest01", LogWriterTest01, 1);
+    UtRegisterTest("LogWriterTest02", LogWriterTest02, 1);
+#endif /* UNITTESTS */
+}
@@ -0,0 +1,112 @@
+/* Copyright (C) 2007-2013 Open Information Security Foundation
+ *
+ * You can copy, redistribute or modify this Program under the terms of
+ * the GNU General Public License version 2 as published by the Free
+ * Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * version 2 along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+/**
+ * \file
+ *
+ * Asynchronous writer for LogFileCtx based outputs.
+ */
+
+#ifndef __UTIL_LOGWRITER_H__
+#define __UTIL_LOGWRITER_H__
+
+#include "conf.h"            /* ConfNode   */
+#include "tm-modules.h"      /* LogFileCtx */
+#include "threadvars.h"
+
+/** default size of the per thread record buffer */
+#define LOG_WRITER_DEFAULT_BUFFER_SIZE      (1024 * 1024)
+/** default max time in ms records stay in a buffer before being written */
+#define LOG_WRITER_DEFAULT_FLUSH_INTERVAL   100
+
+/** max number of iovecs handed to a single writev() call */
+#define LOG_WRITER_IOV_MAX                  64
+
+/**
+ * \brief Per thread ring buffer of formatted records.
+ *
+ * The thread that registered the buffer is the only producer, the writer
+ * thread the only consumer, so no lock is needed. head and tail count the
+ * bytes ever added and removed, the position in the ring is the count
+ * modulo size. Only complete records are added.
+ */
+typedef struct LogWriterBuffer_ {
+    uint8_t *data;
+    uint32_t size;
+
+    SC_ATOMIC_DECLARE(uint64_t, head);  /**< updated by the producer */
+    SC_ATOMIC_DECLARE(uint64_t, tail);  /**< updated by the writer */
+
+    /** producer side stats */
+    ThreadVars *tv;
+    uint16_t counter_depth;
+    uint16_t counter_dropped;
+
+    struct LogWriterBuffer_ *next;
+} LogWriterBuffer;
+
+/**
+ * \brief Writer for a single LogFileCtx. Drains the buffers of all
+ *        threads logging to the file with writev() from its own thread.
+ */
+typedef struct LogWriter_ {
+    LogFileCtx *file_ctx;
+
+    /** output name, used to name the counters */
+    char *name;
+
+    uint32_t buffer_size;       /**< size of each per thread buffer */
+    uint32_t flush_interval;    /**< max ms between writes */
+    uint8_t block;              /**< wait for room instead of dropping
+                                 *   records if a buffer is full */
+    uint8_t stop;               /**< tell the writer thread to exit,
+                                 *   protected by lock */
+
+    /** protects the buffer list and is used with cond to wake the
+     *  writer thread */
+    SCMutex lock;
+    SCCondT cond;
+
+    /** writer thread, only valid while running */
+    ThreadVars *tv;
+    char tv_name[64];
+
+    /** buffers of all registered threads. Buffers are only added while
+     *  running and are freed with the writer. */
+    LogWriterBuffer *buffers;
+
+    /** writer thread is running, cleared by the thread when it exits.
+     *  Read without lock by blocking producers. */
+    SC_ATOMIC_DECLARE(int, running);
+
+    /** records dropped because a buffer was full */
+    SC_ATOMIC_DECLARE(uint64_t, dropped);
+    /** bytes that could not be written */
+    uint64_t write_errors;
+} LogWriter;
+
+int LogWriterSetup(LogFileCtx *, ConfNode *);
+LogWriter *LogWriterNew(LogFileCtx *, const char *, uint32_t, uint32_t, int);
+int LogWriterStart(LogWriter *);
+void LogWriterFree(LogWriter *);
+int LogWriterFlush(LogWriter *);
+LogWriterBuffer *LogWriterRegisterThread(LogFileCtx *, ThreadVars *);
+int LogFileWrite(LogFileCtx *, LogWriterBuffer *, const char *, size_t);
+
+void LogWriterRegisterTests(void);
+
+#endif /* __UTIL_LOGWRITER_H__ */
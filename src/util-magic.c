@@ -24,18 +24,73 @@
  *
  * Libmagic's API is not thread safe. The data the pointer returned by
  * magic_buffer is overwritten by the next magic_buffer call. This is
- * why we need to lock calls and copy the returned string.
+ * why every thread gets its own magic context on its first lookup. The
+ * global context, protected by a lock, is only used if a thread context
+ * can't be set up.
+ *
+ * Optionally a small built-in signature table ("magic-prefilter") answers
+ * the most common file types from their first bytes, so that libmagic
+ * doesn't need to be called for them at all.
  */
 
 #include "suricata-common.h"
 #include "conf.h"
 
+#include "util-atomic.h"
 #include "util-unittest.h"
+#include "util-magic.h"
 #include <magic.h>
 
 static magic_t g_magic_ctx = NULL;
 static SCMutex g_magic_lock;
 
+/** magic file from the config, NULL for the libmagic default */
+static char *g_magic_file = NULL;
+/** answer common types from the built-in table */
+static int g_magic_prefilter = 0;
+
+/** \brief libmagic context of a thread */
+typedef struct MagicThreadCtx_ {
+    magic_t ctx;
+    struct MagicThreadCtx_ *next;
+} MagicThreadCtx;
+
+/** all thread contexts, so MagicDeinit can close them. Protected by
+ *  g_magic_lock. */
+static MagicThreadCtx *g_magic_thread_ctxs = NULL;
+/** bumped by MagicInit, so thread contexts of a previous init aren't
+ *  used after MagicDeinit closed them */
+static uint32_t g_magic_generation = 0;
+
+static __thread MagicThreadCtx *t_magic_ctx = NULL;
+static __thread uint32_t t_magic_generation = 0;
+
+SC_ATOMIC_DECLARE(uint64_t, magic_lookups);
+SC_ATOMIC_DECLARE(uint64_t, magic_prefilter_hits);
+SC_ATOMIC_DECLARE(uint64_t, magic_libmagic_calls);
+SC_ATOMIC_DECLARE(uint64_t, magic_libmagic_usecs);
+
+/**
+ *  \brief Open a magic context and load the magic file into it.
+ *
+ *  \retval ctx the context or NULL on error
+ */
+static magic_t MagicOpen(void) {
+    magic_t ctx = magic_open(0);
+    if (ctx == NULL) {
+        SCLogError(SC_ERR_MAGIC_OPEN, "magic_open failed: %s", magic_error(ctx));
+        return NULL;
+    }
+
+    if (magic_load(ctx, g_magic_file) != 0) {
+        SCLogError(SC_ERR_MAGIC_LOAD, "magic_load failed: %s", magic_error(ctx));
+        magic_close(ctx);
+        return NULL;
+    }
+
+    return ctx;
+}
+
 /**
  *  \brief Initialize the "magic" context.
  */
@@ -50,12 +105,12 @@ int MagicInit(void) {
     SCMutexInit(&g_magic_lock, NULL);
     SCMutexLock(&g_magic_lock);
 
-    g_magic_ctx = magic_open(0);
-    if (g_magic_ctx == NULL) {
-        SCLogError(SC_ERR_MAGIC_OPEN, "magic_open failed: %s", magic_error(g_magic_ctx));
-        goto error;
-    }
+    SC_ATOMIC_INIT(magic_lookups);
+    SC_ATOMIC_INIT(magic_prefilter_hits);
+    SC_ATOMIC_INIT(magic_libmagic_calls);
+    SC_ATOMIC_INIT(magic_libmagic_usecs);
 
+    g_magic_file = NULL;
     (void)ConfGet("magic-file", &filename);
     if (filename != NULL) {
         SCLogInfo("using magic-file %s", filename);
@@ -65,13 +120,22 @@ int MagicInit(void) {
             goto error;
         }
         fclose(fd);
+        g_magic_file = filename;
     }
 
-    if (magic_load(g_magic_ctx, filename) != 0) {
-        SCLogError(SC_ERR_MAGIC_LOAD, "magic_load failed: %s", magic_error(g_magic_ctx));
+    g_magic_prefilter = 0;
+    (void)ConfGetBool("magic-prefilter", &g_magic_prefilter);
+    if (g_magic_prefilter) {
+        SCLogInfo("answering common file types from the magic prefilter");
+    }
+
+    g_magic_ctx = MagicOpen();
+    if (g_magic_ctx == NULL) {
         goto error;
     }
 
+    g_magic_generation++;
+
     SCMutexUnlock(&g_magic_lock);
     SCReturnInt(0);
 
@@ -85,31 +149,321 @@ error:
     SCReturnInt(-1);
 }
 
+/**
+ *  \brief Get the magic context of the calling thread, opening it on
+ *         first use.
+ *
+ *  \retval ctx the context or NULL if it couldn't be opened
+ */
+static magic_t *MagicThreadCtxGet(void) {
+    if (t_magic_ctx != NULL && t_magic_generation == g_magic_generation)
+        return &t_magic_ctx->ctx;
+
+    t_magic_ctx = NULL;
+
+    MagicThreadCtx *tctx = SCMalloc(sizeof(MagicThreadCtx));
+    if (unlikely(tctx == NULL))
+        return NULL;
+
+    tctx->ctx = MagicOpen();
+    if (tctx->ctx == NULL) {
+        SCFree(tctx);
+        return NULL;
+    }
+
+    SCMutexLock(&g_magic_lock);
+    tctx->next = g_magic_thread_ctxs;
+    g_magic_thread_ctxs = tctx;
+    SCMutexUnlock(&g_magic_lock);
+
+    t_magic_ctx = tctx;
+    t_magic_generation = g_magic_generation;
+    return &tctx->ctx;
+}
+
+/**
+ *  \brief Call libmagic and copy the result.
+ *
+ *  \retval magic strdup'd result or NULL
+ */
+static char *MagicBufferLookup(magic_t ctx, uint8_t *buf, uint32_t buflen) {
+    struct timeval start, end;
+    const char *result = NULL;
+    char *magic = NULL;
+
+    gettimeofday(&start, NULL);
+    result = magic_buffer(ctx, (void *)buf, (size_t)buflen);
+    if (result != NULL) {
+        magic = SCStrdup(result);
+        if (magic == NULL) {
+            SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
+        }
+    }
+    gettimeofday(&end, NULL);
+
+    SC_ATOMIC_ADD(magic_libmagic_calls, 1);
+    SC_ATOMIC_ADD(magic_libmagic_usecs,
+            (uint64_t)((end.tv_sec - start.tv_sec) * 1000000 +
+                       (end.tv_usec - start.tv_usec)));
+    return magic;
+}
+
+/** \internal PE header, only the fields the prefilter uses */
+static char *MagicPrefilterPE(const uint8_t *buf, uint32_t buflen) {
+    const char *machine = NULL;
+    const char *pe = NULL;
+    char str[128];
+    uint32_t pe_off;
+
+    if (buflen < 0x40)
+        return SCStrdup("MS-DOS executable");
+
+    pe_off = buf[0x3c] | (buf[0x3d] << 8) | (buf[0x3e] << 16) |
+             ((uint32_t)buf[0x3f] << 24);
+    /* signature, coff header and the optional header up to the subsystem */
+    if (pe_off > buflen || buflen - pe_off < 24 + 70 ||
+        memcmp(buf + pe_off, "PE\0\0", 4) != 0)
+        return SCStrdup("MS-DOS executable");
+
+    const uint8_t *coff = buf + pe_off + 4;
+    const uint8_t *opt = coff + 20;
+    uint16_t mach = coff[0] | (coff[1] << 8);
+    uint16_t characteristics = coff[18] | (coff[19] << 8);
+    uint16_t opt_magic = opt[0] | (opt[1] << 8);
+    uint16_t subsystem = opt[68] | (opt[69] << 8);
+
+    switch (mach) {
+        case 0x014c: machine = "Intel 80386"; break;
+        case 0x8664: machine = "x86-64"; break;
+        case 0x01c0: machine = "ARM"; break;
+        case 0x01c4: machine = "ARMv7 Thumb"; break;
+        case 0xaa64: machine = "Aarch64"; break;
+        default: return NULL;
+    }
+    switch (opt_magic) {
+        case 0x010b: pe = "PE32"; break;
+        case 0x020b: pe = "PE32+"; break;
+        default: return NULL;
+    }
+
+    snprintf(str, sizeof(str), "%s executable%s%s %s, for MS Windows", pe,
+             (characteristics & 0x2000) ? " (DLL)" : "",
+             subsystem == 2 ? " (GUI)" : (subsystem == 3 ? " (console)" : ""),
+             machine);
+    return SCStrdup(str);
+}
+
+/** \internal ELF identification and header */
+static char *MagicPrefilterELF(const uint8_t *buf, uint32_t buflen) {
+    const char *type = NULL;
+    const char *machine = NULL;
+    char str[128];
+
+    if (buflen < 20)
+        return NULL;
+
+    int bits = buf[4] == 1 ? 32 : (buf[4] == 2 ? 64 : 0);
+    int lsb = (buf[5] == 1);
+    if (bits == 0 || (buf[5] != 1 && buf[5] != 2))
+        return NULL;
+
+    uint16_t e_type = lsb ? (buf[16] | (buf[17] << 8)) : ((buf[16] << 8) | buf[17]);
+    uint16_t e_machine = lsb ? (buf[18] | (buf[19] << 8)) : ((buf[18] << 8) | buf[19]);
+
+    switch (e_type) {
+        case 1: type = "relocatable"; break;
+        case 2: type = "executable"; break;
+        case 3: type = "shared object"; break;
+        case 4: type = "core file"; break;
+        default: return NULL;
+    }
+    switch (e_machine) {
+        case 3: machine = "Intel 80386"; break;
+        case 8: machine = "MIPS"; break;
+        case 20: machine = "PowerPC or cisco 4500"; break;
+        case 40: machine = "ARM"; break;
+        case 62: machine = "x86-64"; break;
+        case 183: machine = "ARM aarch64"; break;
+        default: return NULL;
+    }
+
+    snprintf(str, sizeof(str), "ELF %d-bit %s %s, %s", bits,
+             lsb ? "LSB" : "MSB", type, machine);
+    return SCStrdup(str);
+}
+
+static char *MagicPrefilterPDF(const uint8_t *buf, uint32_t buflen) {
+    char str[32];
+
+    if (buflen < 8 || !isdigit(buf[5]) || buf[6] != '.' || !isdigit(buf[7]))
+        return SCStrdup("PDF document");
+
+    snprintf(str, sizeof(str), "PDF document, version %c.%c", buf[5], buf[7]);
+    return SCStrdup(str);
+}
+
+static char *MagicPrefilterZIP(const uint8_t *buf, uint32_t buflen) {
+    char str[64];
+
+    if (buflen < 30)
+        return NULL;
+
+    /* zip based documents and archives (OpenDocument, OOXML, jar) get a
+     * more specific description from libmagic, leave those to it */
+    uint16_t name_len = buf[26] | (buf[27] << 8);
+    if (name_len == 0 || (uint32_t)name_len > buflen - 30)
+        return NULL;
+    const char *name = (const char *)buf + 30;
+    if ((name_len == 8 && memcmp(name, "mimetype", 8) == 0) ||
+        (name_len >= 9 && memcmp(name, "META-INF/", 9) == 0) ||
+        (name_len >= 5 && memcmp(name, "[Cont", 5) == 0) ||
+        (name_len >= 5 && memcmp(name, "_rels", 5) == 0))
+        return NULL;
+
+    uint16_t version = buf[4] | (buf[5] << 8);
+    snprintf(str, sizeof(str), "Zip archive data, at least v%u.%u to extract",
+             version / 10, version % 10);
+    return SCStrdup(str);
+}
+
+static char *MagicPrefilterOLE(const uint8_t *buf, uint32_t buflen) {
+    return SCStrdup("Composite Document File V2 Document");
+}
+
+static char *MagicPrefilterPNG(const uint8_t *buf, uint32_t buflen) {
+    const char *color = NULL;
+    char str[128];
+
+    if (buflen < 29 || memcmp(buf + 12, "IHDR", 4) != 0)
+        return SCStrdup("PNG image data");
+
+    uint32_t width = ((uint32_t)buf[16] << 24) | (buf[17] << 16) | (buf[18] << 8) | buf[19];
+    uint32_t height = ((uint32_t)buf[20] << 24) | (buf[21] << 16) | (buf[22] << 8) | buf[23];
+
+    switch (buf[25]) {
+        case 0: color = "grayscale"; break;
+        case 2: color = "/color RGB"; break;
+        case 3: color = "colormap"; break;
+        case 4: color = "gray+alpha"; break;
+        case 6: color = "/color RGBA"; break;
+        default: return NULL;
+    }
+
+    snprintf(str, sizeof(str), "PNG image data, %u x %u, %u-bit%s%s, %s",
+             width, height, buf[24], color[0] == '/' ? "" : " ", color,
+             buf[28] ? "interlaced" : "non-interlaced");
+    return SCStrdup(str);
+}
+
+static char *MagicPrefilterGIF(const uint8_t *buf, uint32_t buflen) {
+    char str[64];
+
+    if (buflen < 10)
+        return NULL;
+
+    snprintf(str, sizeof(str), "GIF image data, version %.3s, %u x %u",
+             (const char *)buf + 3, buf[6] | (buf[7] << 8), buf[8] | (buf[9] << 8));
+    return SCStrdup(str);
+}
+
+static char *MagicPrefilterJPEG(const uint8_t *buf, uint32_t buflen) {
+    char str[64];
+
+    if (buflen < 13 || buf[3] != 0xe0 || memcmp(buf + 6, "JFIF\0", 5) != 0)
+        return SCStrdup("JPEG image data");
+
+    snprintf(str, sizeof(str), "JPEG image data, JFIF standard %u.%02u",
+             buf[11], buf[12]);
+    return SCStrdup(str);
+}
+
+/** built-in signatures, checked in order. The descriptions follow the
+ *  ones libmagic gives, but only up to the details that can be taken
+ *  from the first few bytes. */
+static const struct {
+    const char *sig;
+    uint16_t sig_len;
+    char *(*Describe)(const uint8_t *, uint32_t);
+} magic_prefilter_table[] = {
+    { "MZ", 2, MagicPrefilterPE },
+    { "\x7f" "ELF", 4, MagicPrefilterELF },
+    { "%PDF-", 5, MagicPrefilterPDF },
+    { "PK\x03\x04", 4, MagicPrefilterZIP },
+    { "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8, MagicPrefilterOLE },
+    { "\x89PNG\r\n\x1a\n", 8, MagicPrefilterPNG },
+    { "GIF87a", 6, MagicPrefilterGIF },
+    { "GIF89a", 6, MagicPrefilterGIF },
+    { "\xff\xd8\xff", 3, MagicPrefilterJPEG },
+};
+
+/**
+ *  \brief Look up the type of a buffer in the built-in signature table.
+ *
+ *  \param buf the buffer
+ *  \param buflen length of the buffer
+ *
+ *  \retval magic strdup'd description or NULL if the table has no answer
+ */
+char *MagicPrefilterLookup(uint8_t *buf, uint32_t buflen) {
+    size_t i;
+
+    if (buf == NULL || buflen == 0)
+        return NULL;
+
+    for (i = 0; i < sizeof(magic_prefilter_table) / sizeof(magic_prefilter_table[0]); i++) {
+        if (buflen < magic_prefilter_table[i].sig_len)
+            continue;
+        if (memcmp(buf, magic_prefilter_table[i].sig,
+                   magic_prefilter_table[i].sig_len) != 0)
+            continue;
+
+        return magic_prefilter_table[i].Describe(buf, buflen);
+    }
+
+    return NULL;
+}
+
 /**
  *  \brief Find the magic value for a buffer.
  *
+ *  Uses the prefilter if enabled, then the magic context of the calling
+ *  thread. Only if that can't be opened the global context is used.
+ *
  *  \param buf the buffer
  *  \param buflen length of the buffer
  *
  *  \retval result pointer to null terminated string
  */
 char *MagicGlobalLookup(uint8_t *buf, uint32_t buflen) {
-    const char *result = NULL;
     char *magic = NULL;
 
-    SCMutexLock(&g_magic_lock);
+    if (buf == NULL || buflen == 0)
+        SCReturnPtr(NULL, "const char");
 
-    if (buf != NULL && buflen > 0) {
-        result = magic_buffer(g_magic_ctx, (void *)buf, (size_t)buflen);
-        if (result != NULL) {
-            magic = SCStrdup(result);
-            if (magic == NULL) {
-                SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
-            }
+    SC_ATOMIC_ADD(magic_lookups, 1);
+
+    if (g_magic_prefilter) {
+        magic = MagicPrefilterLookup(buf, buflen);
+        if (magic != NULL) {
+            SC_ATOMIC_ADD(magic_prefilter_hits, 1);
+            SCReturnPtr(magic, "const char");
         }
     }
 
-    SCMutexUnlock(&g_magic_lock);
+    /* not initialized */
+    if (g_magic_ctx == NULL)
+        SCReturnPtr(NULL, "const char");
+
+    magic_t *ctx = MagicThreadCtxGet();
+    if (ctx != NULL) {
+        magic = MagicBufferLookup(*ctx, buf, buflen);
+    } else {
+        SCMutexLock(&g_magic_lock);
+        if (g_magic_ctx != NULL)
+            magic = MagicBufferLookup(g_magic_ctx, buf, buflen);
+        SCMutexUnlock(&g_magic_lock);
+    }
+
     SCReturnPtr(magic, "const char");
 }
 
@@ -122,30 +476,47 @@ char *MagicGlobalLookup(uint8_t *buf, uint32_t buflen) {
  *  \retval result pointer to null terminated string
  */
 char *MagicThreadLookup(magic_t *ctx, uint8_t *buf, uint32_t buflen) {
-    const char *result = NULL;
     char *magic = NULL;
 
     if (buf != NULL && buflen > 0) {
-        result = magic_buffer(*ctx, (void *)buf, (size_t)buflen);
-        if (result != NULL) {
-            magic = SCStrdup(result);
-            if (magic == NULL) {
-                SCLogError(SC_ERR_MEM_ALLOC, "Unable to dup magic");
-            }
-        }
+        magic = MagicBufferLookup(*ctx, buf, buflen);
     }
 
     SCReturnPtr(magic, "const char");
 }
 
 void MagicDeinit(void) {
+    uint64_t lookups = SC_ATOMIC_GET(magic_lookups);
+    uint64_t calls = SC_ATOMIC_GET(magic_libmagic_calls);
+    uint64_t usecs = SC_ATOMIC_GET(magic_libmagic_usecs);
+
+    if (lookups > 0 || calls > 0) {
+        SCLogInfo("magic: %"PRIu64" lookups, %"PRIu64" answered by the "
+                "prefilter, %"PRIu64" libmagic calls taking %"PRIu64" usec "
+                "(%"PRIu64" usec per call)", lookups,
+                (uint64_t)SC_ATOMIC_GET(magic_prefilter_hits), calls, usecs,
+                calls ? usecs / calls : 0);
+    }
+
     SCMutexLock(&g_magic_lock);
     if (g_magic_ctx != NULL) {
         magic_close(g_magic_ctx);
         g_magic_ctx = NULL;
     }
+    while (g_magic_thread_ctxs != NULL) {
+        MagicThreadCtx *tctx = g_magic_thread_ctxs;
+        g_magic_thread_ctxs = tctx->next;
+        magic_close(tctx->ctx);
+        SCFree(tctx);
+    }
+    g_magic_generation++;
     SCMutexUnlock(&g_magic_lock);
     SCMutexDestroy(&g_magic_lock);
+
+    SC_ATOMIC_DESTROY(magic_lookups);
+    SC_ATOMIC_DESTROY(magic_prefilter_hits);
+    SC_ATOMIC_DESTROY(magic_libmagic_calls);
+    SC_ATOMIC_DESTROY(magic_libmagic_usecs);
 }
 
 #ifdef UNITTESTS
@@ -582,6 +953,137 @@ end:
     return retval;
 }
 
+/** \test built-in signature table */
+static int MagicPrefilterTest01(void) {
+    uint8_t pdf[] = { 0x25, 'P', 'D', 'F', '-', '1', '.', '3', 0x0d, 0x0a };
+    uint8_t gif[] = { 'G', 'I', 'F', '8', '9', 'a', 0x01, 0x00, 0x02, 0x00 };
+    uint8_t elf[20] = { 0x7f, 'E', 'L', 'F', 0x02, 0x01, 0x01, 0x00 };
+    uint8_t png[29] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a,
+                        0x00, 0x00, 0x00, 0x0d, 'I', 'H', 'D', 'R',
+                        0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x20,
+                        0x08, 0x06, 0x00, 0x00, 0x00 };
+    uint8_t zip[38] = { 'P', 'K', 0x03, 0x04, 0x14, 0x00 };
+    uint8_t pe[256] = { 'M', 'Z' };
+    uint8_t text[] = "just some text";
+    struct {
+        uint8_t *buf;
+        uint32_t len;
+        const char *expect;
+    } t[] = {
+        { pdf, sizeof(pdf), "PDF document, version 1.3" },
+        { gif, sizeof(gif), "GIF image data, version 89a, 1 x 2" },
+        { elf, sizeof(elf), "ELF 64-bit LSB executable, x86-64" },
+        { png, sizeof(png), "PNG image data, 16 x 32, 8-bit/color RGBA, non-interlaced" },
+        { zip, sizeof(zip), "Zip archive data, at least v2.0 to extract" },
+        { pe, sizeof(pe), "PE32 executable (GUI) Intel 80386, for MS Windows" },
+        { pe, 0x40, "MS-DOS executable" },
+        { text, sizeof(text) - 1, NULL },
+    };
+    size_t i;
+
+    elf[16] = 0x02;     /* ET_EXEC */
+    elf[18] = 62;       /* x86-64 */
+
+    zip[26] = 8;        /* file name length */
+    memcpy(zip + 30, "file.txt", 8);
+
+    pe[0x3c] = 0x80;
+    memcpy(pe + 0x80, "PE\0\0", 4);
+    pe[0x84] = 0x4c; pe[0x85] = 0x01;       /* i386 */
+    pe[0x98] = 0x0b; pe[0x99] = 0x01;       /* PE32 */
+    pe[0x98 + 68] = 0x02;                   /* GUI subsystem */
+
+    for (i = 0; i < sizeof(t) / sizeof(t[0]); i++) {
+        char *result = MagicPrefilterLookup(t[i].buf, t[i].len);
+        if (t[i].expect == NULL) {
+            if (result != NULL) {
+                printf("%d: expected no result, got \"%s\": ", (int)i, result);
+                SCFree(result);
+                return 0;
+            }
+            continue;
+        }
+        if (result == NULL || strcmp(result, t[i].expect) != 0) {
+            printf("%d: result \"%s\", expected \"%s\": ", (int)i,
+                   result ? result : "(null)", t[i].expect);
+            if (result != NULL)
+                SCFree(result);
+            return 0;
+        }
+        SCFree(result);
+    }
+
+    /* zip based document formats are left to libmagic */
+    memcpy(zip + 30, "mimetype", 8);
+    if (MagicPrefilterLookup(zip, sizeof(zip)) != NULL) {
+        printf("OpenDocument zip answered by the prefilter: ");
+        return 0;
+    }
+
+    return 1;
+}
+
+static void *MagicThreadCtxTestThread(void *data) {
+    uint8_t buffer[] = { 0x25, 'P', 'D', 'F', '-', '1', '.', '3', 0x0d, 0x0a};
+    char *result = MagicGlobalLookup(buffer, sizeof(buffer));
+    if (result == NULL || strncmp(result, "PDF document", 12) != 0)
+        *(int *)data = 0;
+    if (result != NULL)
+        SCFree(result);
+    return NULL;
+}
+
+/** \test every thread gets its own context, reused for its lookups */
+static int MagicThreadCtxTest01(void) {
+    uint8_t buffer[] = { 0x25, 'P', 'D', 'F', '-', '1', '.', '3', 0x0d, 0x0a};
+    pthread_t thread;
+    int thread_ok = 1;
+    int retval = 0;
+    int cnt = 0;
+    int i;
+
+    if (MagicInit() != 0)
+        return 0;
+
+    for (i = 0; i < 2; i++) {
+        char *result = MagicGlobalLookup(buffer, sizeof(buffer));
+        if (result == NULL || strncmp(result, "PDF document", 12) != 0) {
+            printf("lookup %d failed: ", i);
+            if (result != NULL)
+                SCFree(result);
+            goto end;
+        }
+        SCFree(result);
+    }
+
+    if (pthread_create(&thread, NULL, MagicThreadCtxTestThread, &thread_ok) != 0)
+        goto end;
+    pthread_join(thread, NULL);
+    if (!thread_ok) {
+        printf("lookup from second thread failed: ");
+        goto end;
+    }
+
+    MagicThreadCtx *tctx;
+    for (tctx = g_magic_thread_ctxs; tctx != NULL; tctx = tctx->next)
+        cnt++;
+    if (cnt != 2) {
+        printf("%d thread contexts, expected 2: ", cnt);
+        goto end;
+    }
+
+    if (SC_ATOMIC_GET(magic_libmagic_calls) != 3) {
+        printf("%"PRIu64" libmagic calls, expected 3: ",
+               (uint64_t)SC_ATOMIC_GET(magic_libmagic_calls));
+        goto end;
+    }
+
+    retval = 1;
+end:
+    MagicDeinit();
+    return retval;
+}
+
 #endif /* UNITTESTS */
 
 
@@ -601,5 +1103,7 @@ void MagicRegisterTests(void) {
     UtRegisterTest("MagicDetectTest09", MagicDetectTest09, 1); */
 
     UtRegisterTest("MagicDetectTest10ValgrindError", MagicDetectTest10ValgrindError, 1);
+    UtRegisterTest("MagicPrefilterTest01", MagicPrefilterTest01, 1);
+    UtRegisterTest("MagicThreadCtxTest01", MagicThreadCtxTest01, 1);
 #endif /* UNITTESTS */
 }
@@ -30,6 +30,7 @@ int MagicInit(void);
 void MagicDeinit(void);
 char *MagicGlobalLookup(uint8_t *, uint32_t);
 char *MagicThreadLookup(magic_t *, uint8_t *, uint32_t);
+char *MagicPrefilterLookup(uint8_t *, uint32_t);
 void MagicRegisterTests(void);
 
 #endif /* __UTIL_MAGIC_H__ */
@@ -56,13 +56,110 @@ static int PoolMemset(void *pitem, void *initdata)
  * \retval 0 or -1 if not inside */
 static int PoolDataPreAllocated(Pool *p, void *data)
 {
+    if (p->data_buffer == NULL)
+        return 0;
+
     int delta = data - p->data_buffer;
-    if ((delta < 0) || (delta > p->data_buffer_size)) {
+    if ((delta < 0) || (delta >= p->data_buffer_size)) {
         return 0;
     }
     return 1;
 }
 
+/** size of a slab element: large enough to link it in the free list
+ *  and keeping the elements aligned */
+#define POOL_SLAB_ELT_SIZE(p) \
+    ((((p)->elt_size < sizeof(void *) ? sizeof(void *) : (p)->elt_size) + 7) & ~7)
+
+/**
+ * \brief Add a slab of elements to the slab free list
+ *
+ * Bounded pools never get more slab elements than they can hand out
+ * beyond the preallocated elements.
+ *
+ * \retval 0 ok
+ * \retval -1 no more elements allowed or out of memory
+ */
+static int PoolSlabAlloc(Pool *p)
+{
+    uint32_t elts = POOL_SLAB_ELTS;
+    uint32_t elt_size = POOL_SLAB_ELT_SIZE(p);
+
+    if (p->max_buckets > 0) {
+        uint32_t left = p->max_buckets - p->preallocated - p->slab_elts;
+        if (left == 0)
+            return -1;
+        if (left < elts)
+            elts = left;
+    }
+
+    PoolSlab *slab = SCMalloc(sizeof(PoolSlab));
+    if (unlikely(slab == NULL))
+        return -1;
+
+    slab->data = SCMalloc(elts * elt_size);
+    if (unlikely(slab->data == NULL)) {
+        SCFree(slab);
+        return -1;
+    }
+    slab->elts = elts;
+
+    slab->next = p->slab_list;
+    p->slab_list = slab;
+    p->slab_elts += elts;
+
+    uint32_t u32;
+    for (u32 = 0; u32 < elts; u32++) {
+        void *elt = (uint8_t *)slab->data + u32 * elt_size;
+        *(void **)elt = p->slab_free;
+        p->slab_free = elt;
+        p->slab_free_size++;
+    }
+
+    SCLogDebug("pool %p: slab of %"PRIu32" elements added, %"PRIu32" total",
+            p, elts, p->slab_elts);
+    return 0;
+}
+
+/**
+ * \brief Get an uninitialized element from the slabs
+ *
+ * \retval elt element or NULL if none are left
+ */
+static void *PoolSlabGet(Pool *p)
+{
+    if (p->slab_free == NULL) {
+        if (PoolSlabAlloc(p) < 0)
+            return NULL;
+    }
+
+    void *elt = p->slab_free;
+    p->slab_free = *(void **)elt;
+    p->slab_free_size--;
+    return elt;
+}
+
+/**
+ * \brief Release the memory of an element that is no longer kept in the
+ *        pool. Preallocated and slab elements stay with the pool until
+ *        PoolFree(), slab elements are recycled by the next PoolGet().
+ */
+static void PoolDataRelease(Pool *p, void *data)
+{
+    if (PoolDataPreAllocated(p, data) == 1)
+        return;
+
+    if (p->Alloc == NULL) {
+        *(void **)data = p->slab_free;
+        p->slab_free = data;
+        p->slab_free_size++;
+    } else if (p->Free) {
+        p->Free(data);
+    } else {
+        SCFree(data);
+    }
+}
+
 /** \brief Init a Pool
  *
  * PoolInit() creates a ::Pool. The Alloc function must only do
@@ -73,7 +170,8 @@ static int PoolDataPreAllocated(Pool *p, void *data)
  * \param size
  * \param prealloc_size
  * \param elt_size Memory size of an element
- * \param Alloc An allocation function or NULL to use a standard SCMalloc
+ * \param Alloc An allocation function or NULL to allocate the elements
+ *        in slabs of POOL_SLAB_ELTS elements that are kept until PoolFree()
  * \param Init An init function or NULL to use a standard memset to 0
  * \param InitData Init data
  * \param Cleanup a free function or NULL if no special treatment is needed
@@ -97,6 +195,8 @@ Pool *PoolInit(uint32_t size, uint32_t prealloc_size, uint32_t elt_size,  void *
         goto error;
 
     memset(p,0,sizeof(Pool));
+    SC_ATOMIC_INIT(p->live);
+    SC_ATOMIC_INIT(p->live_max);
 
     p->max_buckets = size;
     p->preallocated = prealloc_size;
@@ -148,7 +248,7 @@ Pool *PoolInit(uint32_t size, uint32_t prealloc_size, uint32_t elt_size,  void *
             if (p->Alloc) {
                 pb->data = p->Alloc();
             } else {
-                pb->data = SCMalloc(p->elt_size);
+                pb->data = PoolSlabGet(p);
             }
             if (pb->data == NULL) {
                 SCFree(pb);
@@ -157,10 +257,7 @@ Pool *PoolInit(uint32_t size, uint32_t prealloc_size, uint32_t elt_size,  void *
             if (p->Init(pb->data, p->InitData) != 1) {
                 if (p->Cleanup)
                     p->Cleanup(pb->data);
-                if (p->Free)
-                    p->Free(pb->data);
-                else
-                    SCFree(pb->data);
+                PoolDataRelease(p, pb->data);
                 SCFree(pb);
                 goto error;
             }
@@ -211,12 +308,7 @@ void PoolFree(Pool *p) {
         p->alloc_list = pb->next;
         if (p->Cleanup)
             p->Cleanup(pb->data);
-        if (PoolDataPreAllocated(p, pb->data) == 0) {
-            if (p->Free)
-                p->Free(pb->data);
-            else
-                SCFree(pb->data);
-        }
+        PoolDataRelease(p, pb->data);
         pb->data = NULL;
         if (! pb->flags & POOL_BUCKET_PREALLOCATED) {
             SCFree(pb);
@@ -229,12 +321,7 @@ void PoolFree(Pool *p) {
         if (pb->data!= NULL) {
             if (p->Cleanup)
                 p->Cleanup(pb->data);
-            if (PoolDataPreAllocated(p, pb->data) == 0) {
-                if (p->Free)
-                    p->Free(pb->data);
-                else
-                    SCFree(pb->data);
-            }
+            PoolDataRelease(p, pb->data);
             pb->data = NULL;
         }
         if (! pb->flags & POOL_BUCKET_PREALLOCATED) {
@@ -242,10 +329,19 @@ void PoolFree(Pool *p) {
         }
     }
 
+    while (p->slab_list != NULL) {
+        PoolSlab *slab = p->slab_list;
+        p->slab_list = slab->next;
+        SCFree(slab->data);
+        SCFree(slab);
+    }
+
     if (p->pb_buffer)
         SCFree(p->pb_buffer);
     if (p->data_buffer)
         SCFree(p->data_buffer);
+    SC_ATOMIC_DESTROY(p->live);
+    SC_ATOMIC_DESTROY(p->live_max);
     SCFree(p);
 }
 
@@ -255,7 +351,23 @@ void PoolPrint(Pool *p) {
     printf("-----------------------------------------\n");
 }
 
-void *PoolGet(Pool *p) {
+/** \internal
+ *  \brief count an element handed out to a caller */
+static inline void PoolLiveIncr(Pool *p)
+{
+    uint32_t live = SC_ATOMIC_ADD(p->live, 1);
+    uint32_t live_max = SC_ATOMIC_GET(p->live_max);
+
+    while (live > live_max) {
+        if (SC_ATOMIC_CAS(&p->live_max, live_max, live))
+            break;
+        live_max = SC_ATOMIC_GET(p->live_max);
+    }
+}
+
+/** \internal
+ *  \brief get an element, the caller holds the pool lock */
+static void *PoolGetElt(Pool *p) {
     SCEnter();
 
     PoolBucket *pb = p->alloc_list;
@@ -272,21 +384,25 @@ void *PoolGet(Pool *p) {
         if (p->max_buckets == 0 || p->allocated < p->max_buckets) {
             void *pitem;
             SCLogDebug("max_buckets %"PRIu32"", p->max_buckets);
-            p->allocated++;
-
-            p->outstanding++;
-            if (p->outstanding > p->max_outstanding)
-                p->max_outstanding = p->outstanding;
 
             if (p->Alloc != NULL) {
                 pitem = p->Alloc();
             } else {
-                pitem = SCMalloc(p->elt_size);
+                pitem = PoolSlabGet(p);
             }
-            if (pitem != NULL) {
-                if (p->Init(pitem, p->InitData) != 1)
-                    SCReturnPtr(NULL, "void");
+            if (pitem == NULL)
+                SCReturnPtr(NULL, "void");
+
+            if (p->Init(pitem, p->InitData) != 1) {
+                PoolDataRelease(p, pitem);
+                SCReturnPtr(NULL, "void");
             }
+
+            p->allocated++;
+            p->outstanding++;
+            if (p->outstanding > p->max_outstanding)
+                p->max_outstanding = p->outstanding;
+
             SCReturnPtr(pitem, "void");
         } else {
             SCReturnPtr(NULL, "void");
@@ -301,7 +417,9 @@ void *PoolGet(Pool *p) {
     SCReturnPtr(ptr,"void");
 }
 
-void PoolReturn(Pool *p, void *data) {
+/** \internal
+ *  \brief return an element, the caller holds the pool lock */
+static void PoolReturnElt(Pool *p, void *data) {
     SCEnter();
 
     PoolBucket *pb = p->empty_list;
@@ -314,12 +432,7 @@ void PoolReturn(Pool *p, void *data) {
         if (p->Cleanup != NULL) {
             p->Cleanup(data);
         }
-        if (PoolDataPreAllocated(p, data) == 0) {
-            if (p->Free)
-                p->Free(data);
-            else
-                SCFree(data);
-        }
+        PoolDataRelease(p, data);
 
         SCLogDebug("tried to return data %p to the pool %p, but no more "
                    "buckets available. Just freeing the data.", data, p);
@@ -340,8 +453,140 @@ void PoolReturn(Pool *p, void *data) {
     SCReturn;
 }
 
+void *PoolGet(Pool *p) {
+    void *data = PoolGetElt(p);
+    if (data != NULL)
+        PoolLiveIncr(p);
+    return data;
+}
+
+void PoolReturn(Pool *p, void *data) {
+    PoolReturnElt(p, data);
+    (void) SC_ATOMIC_SUB(p->live, 1);
+}
+
+/** \brief number of elements in use by the callers of the pool and its
+ *         caches */
+uint32_t PoolGetLive(Pool *p) {
+    return SC_ATOMIC_GET(p->live);
+}
+
+/** \brief highest number of elements that were in use at once */
+uint32_t PoolGetLiveMax(Pool *p) {
+    return SC_ATOMIC_GET(p->live_max);
+}
+
+/**
+ * \brief Create a thread cache for a pool.
+ *
+ * \param p pool
+ * \param pool_lock lock the users of the pool hold while calling
+ *        PoolGet()/PoolReturn()
+ *
+ * \retval pc cache or NULL on error
+ */
+PoolCache *PoolCacheInit(Pool *p, SCMutex *pool_lock)
+{
+    PoolCache *pc = SCMalloc(sizeof(PoolCache));
+    if (unlikely(pc == NULL))
+        return NULL;
+    memset(pc, 0x00, sizeof(PoolCache));
+
+    pc->pool = p;
+    pc->pool_lock = pool_lock;
+    return pc;
+}
+
+/**
+ * \brief Return the elements of a thread cache to its pool and free it.
+ */
+void PoolCacheFree(PoolCache *pc)
+{
+    if (pc == NULL)
+        return;
+
+    SCMutexLock(pc->pool_lock);
+    while (pc->cnt > 0) {
+        PoolReturnElt(pc->pool, pc->elts[--pc->cnt]);
+    }
+    SCMutexUnlock(pc->pool_lock);
+
+    SCLogDebug("pool cache %p: %"PRIu64" hits, %"PRIu64" refills, %"PRIu64
+               " flushes", pc, pc->hits, pc->refills, pc->flushes);
+    SCFree(pc);
+}
+
+/**
+ * \brief Get an element through a thread cache.
+ *
+ * An empty cache is refilled with the elements that are free in the pool,
+ * up to POOL_CACHE_BATCH. Only if there are none, a single new element is
+ * allocated, so a cache never allocates ahead.
+ *
+ * \retval data element or NULL if the pool is exhausted
+ */
+void *PoolCacheGet(PoolCache *pc)
+{
+    if (pc->cnt == 0) {
+        Pool *p = pc->pool;
+
+        SCMutexLock(pc->pool_lock);
+        do {
+            void *data = PoolGetElt(p);
+            if (data == NULL)
+                break;
+            pc->elts[pc->cnt++] = data;
+        } while (pc->cnt < POOL_CACHE_BATCH && p->alloc_list != NULL);
+        SCMutexUnlock(pc->pool_lock);
+
+        if (pc->cnt == 0)
+            return NULL;
+        pc->refills++;
+    } else {
+        pc->hits++;
+    }
+
+    PoolLiveIncr(pc->pool);
+    return pc->elts[--pc->cnt];
+}
+
+/**
+ * \brief Return an element through a thread cache. The element may have
+ *        been taken from the pool by any thread.
+ *
+ * A full cache returns its oldest POOL_CACHE_BATCH elements to the pool.
+ */
+void PoolCacheReturn(PoolCache *pc, void *data)
+{
+    if (pc->cnt == POOL_CACHE_SIZE) {
+        uint32_t u32;
+
+        SCMutexLock(pc->pool_lock);
+        for (u32 = 0; u32 < POOL_CACHE_BATCH; u32++) {
+            PoolReturnElt(pc->pool, pc->elts[u32]);
+        }
+        SCMutexUnlock(pc->pool_lock);
+
+        memmove(pc->elts, pc->elts + POOL_CACHE_BATCH,
+                (POOL_CACHE_SIZE - POOL_CACHE_BATCH) * sizeof(void *));
+        pc->cnt -= POOL_CACHE_BATCH;
+        pc->flushes++;
+    }
+
+    pc->elts[pc->cnt++] = data;
+    (void) SC_ATOMIC_SUB(pc->pool->live, 1);
+}
+
 void PoolPrintSaturation(Pool *p) {
     SCLogDebug("pool %p is using %"PRIu32" out of %"PRIu32" items (%02.1f%%), max %"PRIu32" (%02.1f%%): pool struct memory %"PRIu64".", p, p->outstanding, p->max_buckets, (float)(p->outstanding/(float)(p->max_buckets))*100, p->max_outstanding, (float)(p->max_outstanding/(float)(p->max_buckets))*100, (uint64_t)(p->max_buckets * sizeof(PoolBucket)));
+    SCLogDebug("pool %p item memory in use %"PRIu64", max %"PRIu64", "
+            "slab memory %"PRIu64" (%"PRIu32" items, %"PRIu32" unused)", p,
+            (uint64_t)p->outstanding * p->elt_size,
+            (uint64_t)p->max_outstanding * p->elt_size,
+            (uint64_t)p->slab_elts * POOL_SLAB_ELT_SIZE(p),
+            p->slab_elts, p->slab_free_size);
+    SCLogDebug("pool %p live items %"PRIu32", max %"PRIu32, p,
+            PoolGetLive(p), PoolGetLiveMax(p));
 }
 
 /*
@@ -669,6 +914,367 @@ end:
         PoolFree(p);
     return retval;
 }
+/** \test pool without Alloc function recycles slab elements */
+static int PoolTestInit08 (void) {
+    int retval = 0;
+    void *data[3] = { NULL, NULL, NULL };
+    int i;
+
+    Pool *p = PoolInit(0,1,10,NULL,NULL,NULL,NULL,NULL);
+    if (p == NULL)
+        goto end;
+
+    if (p->slab_list == NULL || p->slab_elts != POOL_SLAB_ELTS ||
+        p->slab_free_size != POOL_SLAB_ELTS - 1) {
+        printf("prealloc element not taken from a slab: ");
+        goto end;
+    }
+
+    for (i = 0; i < 3; i++) {
+        data[i] = PoolGet(p);
+        if (data[i] == NULL) {
+            printf("PoolGet returned NULL: ");
+            goto end;
+        }
+    }
+
+    if (p->allocated != 3 || p->slab_free_size != POOL_SLAB_ELTS - 3) {
+        printf("p->allocated %"PRIu32", p->slab_free_size %"PRIu32": ",
+                p->allocated, p->slab_free_size);
+        goto end;
+    }
+
+    /* the first return fills the bucket, the others go back to the slab */
+    for (i = 0; i < 3; i++) {
+        PoolReturn(p, data[i]);
+    }
+
+    if (p->allocated != 1 || p->alloc_list_size != 1 ||
+        p->slab_free_size != POOL_SLAB_ELTS - 1) {
+        printf("p->allocated %"PRIu32", p->alloc_list_size %"PRIu32", "
+                "p->slab_free_size %"PRIu32": ", p->allocated,
+                p->alloc_list_size, p->slab_free_size);
+        goto end;
+    }
+
+    void *bucket_data = PoolGet(p);
+    void *slab_data = PoolGet(p);
+    if (bucket_data != data[0] || slab_data != data[2]) {
+        printf("elements not recycled: ");
+        goto end;
+    }
+    PoolReturn(p, bucket_data);
+    PoolReturn(p, slab_data);
+
+    if (p->slab_elts != POOL_SLAB_ELTS) {
+        printf("p->slab_elts %"PRIu32" != %"PRIu32": ", p->slab_elts,
+                POOL_SLAB_ELTS);
+        goto end;
+    }
+
+    retval = 1;
+end:
+    if (p != NULL)
+        PoolFree(p);
+    return retval;
+}
+
+/** \test bounded pool doesn't get more slab elements than it may hand out */
+static int PoolTestInit09 (void) {
+    int retval = 0;
+    void *data[10];
+    int i;
+
+    memset(data, 0, sizeof(data));
+
+    Pool *p = PoolInit(10,2,10,NULL,NULL,NULL,NULL,NULL);
+    if (p == NULL)
+        goto end;
+
+    for (i = 0; i < 10; i++) {
+        data[i] = PoolGet(p);
+        if (data[i] == NULL) {
+            printf("PoolGet %d returned NULL: ", i);
+            goto end;
+        }
+    }
+
+    if (PoolGet(p) != NULL) {
+        printf("PoolGet beyond max_buckets succeeded: ");
+        goto end;
+    }
+
+    if (p->slab_elts != 8 || p->slab_free_size != 0) {
+        printf("p->slab_elts %"PRIu32", p->slab_free_size %"PRIu32": ",
+                p->slab_elts, p->slab_free_size);
+        goto end;
+    }
+
+    for (i = 0; i < 10; i++) {
+        PoolReturn(p, data[i]);
+    }
+
+    if (p->alloc_list_size != 10 || p->outstanding != 0) {
+        printf("p->alloc_list_size %"PRIu32", p->outstanding %"PRIu32": ",
+                p->alloc_list_size, p->outstanding);
+        goto end;
+    }
+
+    retval = 1;
+end:
+    if (p != NULL)
+        PoolFree(p);
+    return retval;
+}
+/** \test thread cache refills from and flushes to the pool in batches */
+static int PoolTestInit10 (void) {
+    int retval = 0;
+    void *data[70];
+    PoolCache *pc = NULL;
+    SCMutex m;
+    int i;
+
+    SCMutexInit(&m, NULL);
+    memset(data, 0, sizeof(data));
+
+    Pool *p = PoolInit(0,40,10,NULL,NULL,NULL,NULL,NULL);
+    if (p == NULL)
+        goto end;
+    pc = PoolCacheInit(p, &m);
+    if (pc == NULL)
+        goto end;
+
+    for (i = 0; i < 70; i++) {
+        data[i] = PoolCacheGet(pc);
+        if (data[i] == NULL) {
+            printf("PoolCacheGet %d returned NULL: ", i);
+            goto end;
+        }
+    }
+
+    /* 32 and 8 preallocated elements, then one new element at a time */
+    if (p->allocated != 70 || p->alloc_list_size != 0 || pc->cnt != 0 ||
+        pc->refills != 32 || PoolGetLive(p) != 70) {
+        printf("p->allocated %"PRIu32", p->alloc_list_size %"PRIu32", "
+                "pc->cnt %"PRIu32", pc->refills %"PRIu64", live %"PRIu32": ",
+                p->allocated, p->alloc_list_size, pc->cnt, pc->refills,
+                PoolGetLive(p));
+        goto end;
+    }
+
+    for (i = 0; i < 70; i++) {
+        PoolCacheReturn(pc, data[i]);
+    }
+
+    if (pc->cnt != 70 - POOL_CACHE_BATCH || pc->flushes != 1 ||
+        p->alloc_list_size != POOL_CACHE_BATCH || PoolGetLive(p) != 0 ||
+        PoolGetLiveMax(p) != 70) {
+        printf("pc->cnt %"PRIu32", pc->flushes %"PRIu64", p->alloc_list_size "
+                "%"PRIu32", live %"PRIu32", max %"PRIu32": ", pc->cnt,
+                pc->flushes, p->alloc_list_size, PoolGetLive(p),
+                PoolGetLiveMax(p));
+        goto end;
+    }
+
+    /* the pool only keeps as many elements as it has buckets */
+    PoolCacheFree(pc);
+    pc = NULL;
+
+    if (p->alloc_list_size != 40 || p->allocated != 40 ||
+        p->outstanding != 0) {
+        printf("p->alloc_list_size %"PRIu32", p->allocated %"PRIu32", "
+                "p->outstanding %"PRIu32": ", p->alloc_list_size,
+                p->allocated, p->outstanding);
+        goto end;
+    }
+
+    retval = 1;
+end:
+    if (pc != NULL)
+        PoolCacheFree(pc);
+    if (p != NULL)
+        PoolFree(p);
+    SCMutexDestroy(&m);
+    return retval;
+}
+
+/** \test element returned through the cache of another thread */
+static int PoolTestInit11 (void) {
+    int retval = 0;
+    PoolCache *pc1 = NULL, *pc2 = NULL;
+    SCMutex m;
+
+    SCMutexInit(&m, NULL);
+
+    Pool *p = PoolInit(10,2,10,NULL,NULL,NULL,NULL,NULL);
+    if (p == NULL)
+        goto end;
+    pc1 = PoolCacheInit(p, &m);
+    pc2 = PoolCacheInit(p, &m);
+    if (pc1 == NULL || pc2 == NULL)
+        goto end;
+
+    void *data = PoolCacheGet(pc1);
+    if (data == NULL)
+        goto end;
+
+    PoolCacheReturn(pc2, data);
+    if (PoolCacheGet(pc2) != data || pc2->refills != 0) {
+        printf("element not reused from the second cache: ");
+        goto end;
+    }
+
+    /* and back to the pool by a thread without a cache */
+    SCMutexLock(&m);
+    PoolReturn(p, data);
+    SCMutexUnlock(&m);
+
+    if (PoolGetLive(p) != 0 || pc1->cnt != 1 || p->alloc_list_size != 1) {
+        printf("live %"PRIu32", pc1->cnt %"PRIu32", p->alloc_list_size "
+                "%"PRIu32": ", PoolGetLive(p), pc1->cnt, p->alloc_list_size);
+        goto end;
+    }
+
+    PoolCacheFree(pc1);
+    pc1 = NULL;
+    PoolCacheFree(pc2);
+    pc2 = NULL;
+
+    if (p->alloc_list_size != 2 || p->outstanding != 0) {
+        printf("p->alloc_list_size %"PRIu32", p->outstanding %"PRIu32": ",
+                p->alloc_list_size, p->outstanding);
+        goto end;
+    }
+
+    retval = 1;
+end:
+    if (pc1 != NULL)
+        PoolCacheFree(pc1);
+    if (pc2 != NULL)
+        PoolCacheFree(pc2);
+    if (p != NULL)
+        PoolFree(p);
+    SCMutexDestroy(&m);
+    return retval;
+}
+
+#ifdef PROFILING
+#define POOL_BENCH_THREADS  4
+#define POOL_BENCH_ROUNDS   250000
+#define POOL_BENCH_DEPTH    16
+
+typedef struct PoolBenchCtx_ {
+    Pool *p;
+    SCMutex *m;
+    int use_cache;
+    int failed;
+} PoolBenchCtx;
+
+static void *PoolBenchThread(void *arg)
+{
+    PoolBenchCtx *ctx = (PoolBenchCtx *)arg;
+    PoolCache *pc = NULL;
+    void *data[POOL_BENCH_DEPTH];
+    int i, j;
+
+    if (ctx->use_cache) {
+        pc = PoolCacheInit(ctx->p, ctx->m);
+        if (pc == NULL) {
+            ctx->failed = 1;
+            return NULL;
+        }
+    }
+
+    for (i = 0; i < POOL_BENCH_ROUNDS; i++) {
+        for (j = 0; j < POOL_BENCH_DEPTH; j++) {
+            if (pc != NULL) {
+                data[j] = PoolCacheGet(pc);
+            } else {
+                SCMutexLock(ctx->m);
+                data[j] = PoolGet(ctx->p);
+                SCMutexUnlock(ctx->m);
+            }
+            if (data[j] == NULL) {
+                ctx->failed = 1;
+                goto end;
+            }
+        }
+        for (j = 0; j < POOL_BENCH_DEPTH; j++) {
+            if (pc != NULL) {
+                PoolCacheReturn(pc, data[j]);
+            } else {
+                SCMutexLock(ctx->m);
+                PoolReturn(ctx->p, data[j]);
+                SCMutexUnlock(ctx->m);
+            }
+        }
+    }
+end:
+    PoolCacheFree(pc);
+    return NULL;
+}
+
+/** \internal
+ *  \brief run the get/return loop in POOL_BENCH_THREADS threads
+ *  \retval usecs elapsed or -1 on error */
+static int64_t PoolBenchRun(int use_cache)
+{
+    pthread_t threads[POOL_BENCH_THREADS];
+    PoolBenchCtx ctx[POOL_BENCH_THREADS];
+    struct timeval start, end;
+    int64_t usecs = -1;
+    SCMutex m;
+    int i;
+
+    SCMutexInit(&m, NULL);
+    Pool *p = PoolInit(0, POOL_BENCH_THREADS * POOL_BENCH_DEPTH, 512,
+                       NULL, NULL, NULL, NULL, NULL);
+    if (p == NULL)
+        goto end;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < POOL_BENCH_THREADS; i++) {
+        ctx[i].p = p;
+        ctx[i].m = &m;
+        ctx[i].use_cache = use_cache;
+        ctx[i].failed = 0;
+        if (pthread_create(&threads[i], NULL, PoolBenchThread, &ctx[i]) != 0)
+            goto end;
+    }
+    for (i = 0; i < POOL_BENCH_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        if (ctx[i].failed)
+            goto end;
+    }
+    gettimeofday(&end, NULL);
+
+    if (PoolGetLive(p) != 0 || p->outstanding != 0)
+        goto end;
+
+    usecs = (int64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+            (end.tv_usec - start.tv_usec);
+end:
+    if (p != NULL)
+        PoolFree(p);
+    SCMutexDestroy(&m);
+    return usecs;
+}
+
+/** \test allocation heavy benchmark of the shared pool with and without
+ *        thread caches. Only built with profiling. */
+static int PoolCacheBenchmark (void) {
+    int64_t locked = PoolBenchRun(0);
+    int64_t cached = PoolBenchRun(1);
+
+    if (locked < 0 || cached < 0)
+        return 0;
+
+    SCLogInfo("%d threads, %d x %d gets and returns each: locked pool "
+              "%"PRId64" us, thread caches %"PRId64" us", POOL_BENCH_THREADS,
+              POOL_BENCH_ROUNDS, POOL_BENCH_DEPTH, locked, cached);
+    return 1;
+}
+#endif /* PROFILING */
 #endif /* UNITTESTS */
 
 void PoolRegisterTests(void) {
@@ -680,6 +1286,13 @@ void PoolRegisterTests(void) {
     UtRegisterTest("PoolTestInit05", PoolTestInit05, 1);
     UtRegisterTest("PoolTestInit06", PoolTestInit06, 1);
     UtRegisterTest("PoolTestInit07", PoolTestInit07, 1);
+    UtRegisterTest("PoolTestInit08", PoolTestInit08, 1);
+    UtRegisterTest("PoolTestInit09", PoolTestInit09, 1);
+    UtRegisterTest("PoolTestInit10", PoolTestInit10, 1);
+    UtRegisterTest("PoolTestInit11", PoolTestInit11, 1);
+#ifdef PROFILING
+    UtRegisterTest("PoolCacheBenchmark", PoolCacheBenchmark, 1);
+#endif
 #endif /* UNITTESTS */
 }
 
@@ -30,8 +30,20 @@
 #ifndef __UTIL_POOL_H__
 #define __UTIL_POOL_H__
 
+#include "util-atomic.h"
+
 #define POOL_BUCKET_PREALLOCATED    (1 << 0)
 
+/** number of elements allocated at once for pools without Alloc function */
+#define POOL_SLAB_ELTS              64
+
+/* slab of pool elements */
+typedef struct PoolSlab_ {
+    void *data;
+    uint32_t elts;
+    struct PoolSlab_ *next;
+} PoolSlab;
+
 /* pool bucket structure */
 typedef struct PoolBucket_ {
     void *data;
@@ -64,8 +76,50 @@ typedef struct Pool_ {
     uint32_t elt_size;
     uint32_t outstanding;
     uint32_t max_outstanding;
+
+    /** slabs that elements beyond the preallocated ones are carved from
+     *  if the pool has no Alloc function */
+    PoolSlab *slab_list;
+    /** total number of elements in the slabs */
+    uint32_t slab_elts;
+    /** list of unused, uninitialized slab elements */
+    void *slab_free;
+    uint32_t slab_free_size;
+
+    /** elements in use by the callers, not counting the elements that
+     *  sit in thread caches. Also updated by the caches without the pool
+     *  lock. */
+    SC_ATOMIC_DECLARE(uint32_t, live);
+    SC_ATOMIC_DECLARE(uint32_t, live_max);
 } Pool;
 
+/** max number of elements in a thread cache */
+#define POOL_CACHE_SIZE             64
+/** number of elements moved between a thread cache and its pool at once */
+#define POOL_CACHE_BATCH            32
+
+/**
+ * \brief Per thread cache in front of a shared pool.
+ *
+ * Gets and returns are served from the cache without taking the pool
+ * lock. The cache is refilled from and flushed to the pool in batches.
+ * Elements freed by another thread go into the cache of that thread, or
+ * straight back to the pool if it has none, so the pool acts as the free
+ * list between threads.
+ */
+typedef struct PoolCache_ {
+    Pool *pool;
+    SCMutex *pool_lock;     /**< lock protecting pool */
+
+    uint32_t cnt;
+    void *elts[POOL_CACHE_SIZE];
+
+    /** stats */
+    uint64_t hits;
+    uint64_t refills;
+    uint64_t flushes;
+} PoolCache;
+
 /* prototypes */
 Pool* PoolInit(uint32_t, uint32_t, uint32_t, void *(*Alloc)(), int (*Init)(void *, void *), void *, void (*Cleanup)(void *), void (*Free)(void *));
 void PoolFree(Pool *);
@@ -75,6 +129,14 @@ void PoolPrintSaturation(Pool *p);
 void *PoolGet(Pool *);
 void PoolReturn(Pool *, void *);
 
+uint32_t PoolGetLive(Pool *);
+uint32_t PoolGetLiveMax(Pool *);
+
+PoolCache *PoolCacheInit(Pool *, SCMutex *);
+void PoolCacheFree(PoolCache *);
+void *PoolCacheGet(PoolCache *);
+void PoolCacheReturn(PoolCache *, void *);
+
 void PoolRegisterTests(void);
 
 #endif /* __UTIL_POOL_H__ */